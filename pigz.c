@@ -305,7 +305,7 @@
 #include <windows.h>
 #include "zlib-1.2.8/zlib.h"
 
-void pigz_init(uint32_t setprocs) {
+void pigz_init(uint32_t setprocs, uint32_t bgzf) {
   return;
 }
 
@@ -422,6 +422,18 @@ void parallel_compress(char* out_fname, uint32_t(* emitn)(uint32_t, unsigned cha
 /* sliding dictionary size for deflate */
 #define DICT 32768U
 
+/* BGZF member layout: uncompressed payload per member (leaves room for
+   incompressible data within the 64K BSIZE limit), and header/trailer sizes */
+#define BGZF_BLOCK_IN 65280U
+#define BGZF_HEADER 18U
+#define BGZF_TRAILER 8U
+
+/* empty member that terminates a BGZF file */
+local unsigned char bgzf_eof[28] = {
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+    27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
 /* largest power of 2 that fits in an unsigned int -- used to limit requests
    to zlib functions that use unsigned int lengths */
 #define MAXP2 (UINT_MAX - (UINT_MAX >> 1))
@@ -495,6 +507,7 @@ local struct {
     int procs;              /* maximum number of compression threads (>= 1) */
     size_t block;           /* uncompressed input size per thread (>= 32K) */
     int warned;             /* true if a warning has been given */
+    int bgzf;               /* true to write independent BGZF members */
 } g;
 
 /* display a complaint with the program name on stderr */
@@ -956,6 +969,59 @@ local void deflate_engine(z_stream *strm, struct space *out, int flush)
     assert(strm->avail_in == 0);
 }
 
+/* compress job->in as a series of independent BGZF members (each a complete
+   gzip stream with a BSIZE extra field, per the SAM/BAM specification) --
+   no dictionary is used, so every member can be inflated on its own */
+local void bgzf_compress_job(z_stream *strm, struct job *job)
+{
+    unsigned char *next;            /* next input byte */
+    unsigned char *head;            /* start of current member */
+    size_t left;                    /* input left to process */
+    size_t start;                   /* offset of current member */
+    unsigned len;                   /* payload size of current member */
+    unsigned long check;            /* crc-32 of current member */
+
+    next = job->in->buf;
+    left = job->in->len;
+    job->out->len = 0;
+    do {
+        len = left < BGZF_BLOCK_IN ? (unsigned)left : BGZF_BLOCK_IN;
+        while (job->out->size - job->out->len < BGZF_HEADER)
+            grow_space(job->out);
+        start = job->out->len;
+        head = job->out->buf + start;
+        head[0] = 31;
+        head[1] = 139;
+        head[2] = 8;                /* deflate */
+        head[3] = 4;                /* FEXTRA */
+        PUT4L(head + 4, 0);         /* no mtime */
+        head[8] = 0;
+        head[9] = 255;              /* unknown OS, as bgzip writes */
+        PUT2L(head + 10, 6);        /* XLEN */
+        head[12] = 'B';
+        head[13] = 'C';
+        PUT2L(head + 14, 2);        /* SLEN */
+        job->out->len += BGZF_HEADER;
+
+        (void)deflateReset(strm);
+        strm->next_in = next;
+        strm->avail_in = len;
+        deflate_engine(strm, job->out, Z_FINISH);
+
+        check = CHECK(CHECK(0L, Z_NULL, 0), next, len);
+        while (job->out->size - job->out->len < BGZF_TRAILER)
+            grow_space(job->out);
+        PUT4L(job->out->buf + job->out->len, check);
+        PUT4L(job->out->buf + job->out->len + 4, len);
+        job->out->len += BGZF_TRAILER;
+
+        /* BSIZE is the total member size minus one */
+        PUT2L(job->out->buf + start + 16, job->out->len - start - 1);
+        next += len;
+        left -= len;
+    } while (left);
+}
+
 /* get the next compression job from the head of the list, compress and compute
    the check value on the input, and put a job in the write list with the
    results -- keep looking for more jobs, returning when a job is found with a
@@ -1003,6 +1069,13 @@ local void compress_thread(void *dummy)
 	(void)deflateReset(&strm);
 	(void)deflateParams(&strm, g.level, Z_DEFAULT_STRATEGY);
 
+        if (g.bgzf) {
+            /* independent members; no dictionary, no stream-wide check */
+            job->out = get_space(&out_pool);
+            bgzf_compress_job(&strm, job);
+            goto compress_done;
+        }
+
         /* set dictionary if provided, release that input or dictionary buffer
            (not NULL if dict is true and if this is not the first work unit) */
         if (job->out != NULL) {
@@ -1079,6 +1152,7 @@ local void compress_thread(void *dummy)
             job->lens = NULL;
         }
 
+    compress_done:
         /* reserve input buffer until check value has been calculated */
         use_space(job->in);
 
@@ -1097,7 +1171,7 @@ local void compress_thread(void *dummy)
         /* calculate the check value in parallel with writing, alert the write
            thread that the calculation is complete, and drop this usage of the
            input buffer */
-        len = job->in->len;
+        len = g.bgzf ? 0 : job->in->len;
         next = job->in->buf;
         check = CHECK(0L, Z_NULL, 0);
         while (len > MAXP2) {
@@ -1135,8 +1209,8 @@ local void write_thread(void *dummy)
 
     (void)dummy;
 
-    /* build and write header */
-    head = put_header();
+    /* build and write header (each BGZF member carries its own) */
+    head = g.bgzf ? 0 : put_header();
 
     /* process output of compress threads until end of input */
     ulen = clen = 0;
@@ -1166,7 +1240,8 @@ local void write_thread(void *dummy)
         possess(job->calc);
         wait_for(job->calc, TO_BE, 1);
         release(job->calc);
-        check = COMB(check, job->check, len);
+        if (!g.bgzf)
+            check = COMB(check, job->check, len);
 
         /* free the job */
         free_lock(job->calc);
@@ -1176,8 +1251,11 @@ local void write_thread(void *dummy)
         seq++;
     } while (more);
 
-    /* write trailer */
-    put_trailer(ulen, clen, check, head);
+    /* write trailer, or the empty BGZF end-of-file marker member */
+    if (g.bgzf)
+        writen(g.outd, bgzf_eof, sizeof(bgzf_eof));
+    else
+        put_trailer(ulen, clen, check, head);
 
     /* verify no more jobs, prepare for next use */
     possess(compress_have);
@@ -1261,7 +1339,7 @@ void parallel_compress(char* out_fname, uint32_t(* emitn)(uint32_t, unsigned cha
 
         /* provide dictionary for this job, prepare dictionary for next job */
         job->out = dict;
-        if (more) {
+        if (more && !g.bgzf) {
             if (curr->len >= DICT || job->out == NULL) {
                 dict = curr;
                 use_space(dict);
@@ -1314,8 +1392,9 @@ local void cut_short(int sig)
     _exit(1);
 }
 
-/* set option defaults */
-void pigz_init(uint32_t setprocs)
+/* set option defaults -- bgzf selects block-gzipped output for all subsequent
+   parallel_compress() calls */
+void pigz_init(uint32_t setprocs, uint32_t bgzf)
 {
     signal(SIGINT, cut_short);
     g.level = Z_DEFAULT_COMPRESSION;
@@ -1328,6 +1407,7 @@ void pigz_init(uint32_t setprocs)
     yarn_abort = cut_short;
     g.block = BLOCKSIZE;            /* 128K */
     g.verbosity = 1;                /* normal message level */
+    g.bgzf = bgzf;
 }
 #endif // _WIN32
 
@@ -8,7 +8,7 @@
 
 void parallel_compress(char* out_fname, uint32_t(* emitn)(uint32_t, unsigned char*));
 
-void pigz_init(uint32_t setprocs);
+void pigz_init(uint32_t setprocs, uint32_t bgzf);
 
 int32_t write_uncompressed(char* out_fname, uint32_t(* emitn)(uint32_t, unsigned char*));
 
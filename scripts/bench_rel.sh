@@ -0,0 +1,44 @@
+#!/bin/sh
+# Times the bitwise and blocked-GEMM relationship matrix engines against each
+# other on --dummy datasets.
+#
+# usage: ./bench_rel.sh [binary] [marker ct] [indiv ct 1] {indiv ct 2} ...
+#   e.g. scripts/bench_rel.sh ./wdist 20000 5000 10000 20000
+#
+# Extra flags (e.g. "--threads 8") can be passed through WDIST_FLAGS.  All
+# files are written to a temporary directory, which is deleted at the end.
+
+if [ $# -lt 3 ]; then
+  echo "usage: $0 [binary] [marker ct] [indiv ct 1] {indiv ct 2} ..." >&2
+  exit 1
+fi
+BIN=$1
+MARKER_CT=$2
+shift 2
+WORKDIR=`mktemp -d` || exit 1
+trap 'rm -rf "$WORKDIR"' 0
+
+now() {
+  date +%s.%N
+}
+
+printf "%10s %10s %12s %12s\n" indivs markers "bitwise (s)" "gemm (s)"
+for INDIV_CT in "$@"; do
+  PREFIX=$WORKDIR/dummy$INDIV_CT
+  if ! $BIN --dummy $INDIV_CT $MARKER_CT 0.01 --make-bed --out $PREFIX > /dev/null; then
+    echo "Error: --dummy $INDIV_CT $MARKER_CT failed." >&2
+    exit 1
+  fi
+  LINE=`printf "%10s %10s" $INDIV_CT $MARKER_CT`
+  for ENGINE in bitwise gemm; do
+    START=`now`
+    if ! $BIN --bfile $PREFIX --make-rel bin --rel-engine $ENGINE $WDIST_FLAGS --out $PREFIX.$ENGINE > /dev/null; then
+      echo "Error: --rel-engine $ENGINE run failed (see $PREFIX.$ENGINE.log)." >&2
+      exit 1
+    fi
+    END=`now`
+    LINE="$LINE "`echo "$START $END" | awk '{ printf("%12.2f", $2 - $1) }'`
+  done
+  echo "$LINE"
+  rm -f $PREFIX.*
+done
@@ -0,0 +1,62 @@
+#!/bin/sh
+# Checks that a complete --genome bin file can be seeked into: record
+# genome_bin_rec_idx(id_ct, i, j) (see wdist_common.h) must hold the (i, j)
+# pair.
+#
+# usage: ./test_genome_bin_seek.sh [binary] {indiv ct} {marker ct}
+#
+# All files are written to a temporary directory, which is deleted at the end.
+
+if [ $# -lt 1 ]; then
+  echo "usage: $0 [binary] {indiv ct} {marker ct}" >&2
+  exit 1
+fi
+BIN=$1
+INDIV_CT=${2:-50}
+MARKER_CT=${3:-2000}
+WORKDIR=`mktemp -d` || exit 1
+trap 'rm -rf "$WORKDIR"' 0
+PREFIX=$WORKDIR/dummy
+
+if ! $BIN --dummy $INDIV_CT $MARKER_CT 0.01 --make-bed --out $PREFIX > /dev/null; then
+  echo "Error: --dummy $INDIV_CT $MARKER_CT failed." >&2
+  exit 1
+fi
+if ! $BIN --bfile $PREFIX --genome bin --out $PREFIX > /dev/null; then
+  echo "Error: --genome bin run failed." >&2
+  exit 1
+fi
+
+# u32 [file] [byte offset] [count]
+u32() {
+  od -A n -t u4 -j $2 -N `expr 4 \* $3` $1 | tr -s ' \n' '  ' | sed -e 's/^ //' -e 's/ $//'
+}
+
+GFILE=$PREFIX.genome.bin
+set -- `u32 $GFILE 8 4`
+ID_CT=$2
+MAX_ID_LEN=$3
+FLAGS=$4
+if [ $ID_CT -ne $INDIV_CT ] || [ `expr $FLAGS % 2` -ne 1 ]; then
+  echo "Error: unexpected header (id_ct $ID_CT, flags $FLAGS)." >&2
+  exit 1
+fi
+# magic + header + padded ID table
+REC_START=`expr 32 + \( \( $ID_CT \* $MAX_ID_LEN + 7 \) / 8 \) \* 8`
+
+FAIL=0
+LAST=`expr $ID_CT - 1`
+MID=`expr $ID_CT / 2`
+for PAIR in "0 1" "0 $LAST" "1 2" "1 $LAST" "$MID `expr $MID + 1`" "$MID $LAST" "`expr $LAST - 1` $LAST"; do
+  set -- $PAIR
+  REC_IDX=`expr \( $1 \* \( 2 \* $ID_CT - $1 - 1 \) \) / 2 + $2 - $1 - 1`
+  GOT=`u32 $GFILE \`expr $REC_START + $REC_IDX \* 32\` 2`
+  if [ "$GOT" != "$1 $2" ]; then
+    echo "FAIL: record $REC_IDX holds ($GOT), expected ($1 $2)." >&2
+    FAIL=1
+  fi
+done
+if [ $FAIL -eq 0 ]; then
+  echo "genome.bin seek check passed ($ID_CT individuals)."
+fi
+exit $FAIL
@@ -56,6 +56,7 @@
 #define LOAD_RARE_CNV 0x100
 #define LOAD_RARE_GVAR 0x200
 #define LOAD_RARE_23 0x400
+#define LOAD_RARE_GRM_SPARSE 0x800
 
 // maximum number of usable cluster computers, this is arbitrary though it
 // shouldn't be larger than 2^31 - 1
@@ -1552,18 +1553,18 @@ int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, double mind_thresh, uin
   }
   loadbuf[unfiltered_indiv_ct2l - 1] = 0;
   fill_uint_zero(missing_cts, unfiltered_indiv_ct);
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto mind_filter_ret_READ_FAIL;
   }
   ujj = unfiltered_indiv_ct2l * BITCT2;
   for (marker_uidx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto mind_filter_ret_READ_FAIL;
       }
     }
-    if (fread(loadbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+    if (bed_fread(loadbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
       goto mind_filter_ret_READ_FAIL;
     }
     lptr = loadbuf;
@@ -2317,7 +2318,7 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
 
   *indiv_f_ct_ptr = indiv_f_ct;
   *indiv_f_male_ct_ptr = indiv_f_male_ct;
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto calc_freqs_and_hwe_ret_READ_FAIL;
   }
   marker_uidx = 0;
@@ -2337,11 +2338,11 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
     for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto calc_freqs_and_hwe_ret_READ_FAIL;
 	}
       }
-      if (fread(loadbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+      if (bed_fread(loadbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
 	goto calc_freqs_and_hwe_ret_READ_FAIL;
       }
       if (marker_uidx >= next_chrom_start) {
@@ -3160,7 +3161,7 @@ int32_t write_stratified_freqs(FILE* bedfile, uintptr_t bed_offset, char* outnam
     if (marker_uidx >= chrom_end) {
       continue;
     }
-    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+    if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
       goto write_stratified_freqs_ret_READ_FAIL;
     }
     col_2_start = width_force(4, tbuf, chrom_name_write(tbuf, chrom_info_ptr, chrom_idx, zero_extra_chroms));
@@ -3193,7 +3194,7 @@ int32_t write_stratified_freqs(FILE* bedfile, uintptr_t bed_offset, char* outnam
 	cslen = (uintptr_t)(wptr - csptr);
       }
 
-      if (fread(readbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+      if (bed_fread(readbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
 	goto write_stratified_freqs_ret_READ_FAIL;
       }
       if (IS_SET(marker_reverse, marker_uidx)) {
@@ -3297,7 +3298,7 @@ int32_t write_stratified_freqs(FILE* bedfile, uintptr_t bed_offset, char* outnam
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
         marker_uidx = next_unset_ul(marker_exclude, marker_uidx, chrom_end);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto write_stratified_freqs_ret_READ_FAIL;
 	}
       }
@@ -3387,7 +3388,7 @@ int32_t write_missingness_reports(FILE* bedfile, uintptr_t bed_offset, char* out
   marker_ct_nony = marker_ct - marker_ct_y;
   fill_uint_zero(missing_cts, unfiltered_indiv_ct);
   ujj = unfiltered_indiv_ct2l * BITCT2;
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto write_missingness_reports_ret_READ_FAIL;
   }
   memcpy(outname_end, ".lmiss", 7);
@@ -3440,11 +3441,11 @@ int32_t write_missingness_reports(FILE* bedfile, uintptr_t bed_offset, char* out
     cptr = width_force(4, tbuf, chrom_name_write(tbuf, chrom_info_ptr, chrom_idx, zero_extra_chroms));
     *cptr++ = ' ';
     if (marker_uidx < chrom_end) {
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto write_missingness_reports_ret_READ_FAIL;
       }
       do {
-	if (fread(loadbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+	if (bed_fread(loadbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
 	  goto write_missingness_reports_ret_READ_FAIL;
 	}
         if (is_haploid) {
@@ -3504,7 +3505,7 @@ int32_t write_missingness_reports(FILE* bedfile, uintptr_t bed_offset, char* out
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul(marker_exclude, marker_uidx, chrom_end);
 	  if (marker_uidx < chrom_end) {
-	    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	    if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	      goto write_missingness_reports_ret_WRITE_FAIL;
 	    }
 	  }
@@ -4180,7 +4181,7 @@ int32_t write_snplist(char* outname, char* outname_end, uintptr_t unfiltered_mar
 }
 
 static inline uint32_t are_marker_pos_needed(uint64_t calculation_type, uint32_t min_bp_space, uint32_t genome_skip_write) {
-  return (calculation_type & (CALC_MAKE_BED | CALC_RECODE | CALC_GENOME | CALC_HOMOZYG | CALC_LD_PRUNE | CALC_REGRESS_PCS | CALC_MODEL | CALC_GLM)) || min_bp_space || genome_skip_write;
+  return (calculation_type & (CALC_MAKE_BED | CALC_RECODE | CALC_GENOME | CALC_HOMOZYG | CALC_LD_PRUNE | CALC_LD_REPORT | CALC_REGRESS_PCS | CALC_MODEL | CALC_GLM)) || min_bp_space || genome_skip_write;
 }
 
 static inline uint32_t are_marker_cms_needed(uint64_t calculation_type, Two_col_params* update_cm) {
@@ -4206,11 +4207,12 @@ inline int32_t distance_wt_req(uint64_t calculation_type, char* read_dists_fname
   return (((calculation_type & CALC_DISTANCE) || ((!read_dists_fname) && ((calculation_type & (CALC_IBS_TEST | CALC_GROUPDIST | CALC_REGRESS_DISTANCE))))) && (!(dist_calc_type & DISTANCE_FLAT_MISSING)));
 }
 
-int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, char* famname, char* phenoname, char* extractname, char* excludename, char* keepname, char* removename, char* keepfamname, char* removefamname, char* filtername, char* freqname, char* read_dists_fname, char* read_dists_id_fname, char* evecname, char* mergename1, char* mergename2, char* mergename3, char* makepheno_str, char* phenoname_str, Two_col_params* a1alleles, Two_col_params* a2alleles, char* recode_allele_name, char* covar_fname, char* set_fname, char* subset_fname, char* update_alleles_fname, char* read_genome_fname, Two_col_params* update_chr, Two_col_params* update_cm, Two_col_params* update_map, Two_col_params* update_name, char* update_ids_fname, char* update_parents_fname, char* update_sex_fname, char* loop_assoc_fname, char* flip_fname, char* flip_subset_fname, char* filterval, char* condition_mname, char* condition_fname, double thin_keep_prob, uint32_t min_bp_space, uint32_t mfilter_col, uint32_t filter_binary, uint32_t fam_cols, char missing_geno, int32_t missing_pheno, char output_missing_geno, char* output_missing_pheno, uint32_t mpheno_col, uint32_t pheno_modifier, Chrom_info* chrom_info_ptr, double exponent, double min_maf, double max_maf, double geno_thresh, double mind_thresh, double hwe_thresh, double rel_cutoff, double tail_bottom, double tail_top, uint64_t misc_flags, uint64_t calculation_type, uint32_t rel_calc_type, uint32_t dist_calc_type, uintptr_t groupdist_iters, uint32_t groupdist_d, uintptr_t regress_iters, uint32_t regress_d, uintptr_t regress_rel_iters, uint32_t regress_rel_d, double unrelated_herit_tol, double unrelated_herit_covg, double unrelated_herit_covr, int32_t ibc_type, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t ppc_gap, uint32_t sex_missing_pheno, uint32_t genome_modifier, double genome_min_pi_hat, double genome_max_pi_hat, Homozyg_info* homozyg_ptr, Cluster_info* cluster_ptr, uint32_t neighbor_n1, uint32_t neighbor_n2, uint32_t ld_window_size, uint32_t ld_window_kb, uint32_t ld_window_incr, double ld_last_param, uint32_t regress_pcs_modifier, uint32_t max_pcs, uint32_t recode_modifier, uint32_t allelexxxx, uint32_t merge_type, uint32_t indiv_sort, int32_t marker_pos_start, int32_t marker_pos_end, uint32_t snp_window_size, char* markername_from, char* markername_to, char* markername_snp, Range_list* snps_range_list_ptr, uint32_t covar_modifier, Range_list* covar_range_list_ptr, uint32_t write_covar_modifier, uint32_t write_covar_dummy_max_categories, uint32_t mwithin_col, uint32_t model_modifier, uint32_t model_cell_ct, uint32_t model_mperm_val, uint32_t glm_modifier, double glm_vif_thresh, uint32_t glm_xchr_model, uint32_t glm_mperm_val, Range_list* parameters_range_list_ptr, Range_list* tests_range_list_ptr, double ci_size, double pfilter, uint32_t mtest_adjust, double adjust_lambda, uint32_t gxe_mcovar, uint32_t aperm_min, uint32_t aperm_max, double aperm_alpha, double aperm_beta, double aperm_init_interval, double aperm_interval_slope, uint32_t mperm_save, uint32_t ibs_test_perms, uint32_t perm_batch_size, double lasso_h2, Ll_str** file_delete_list_ptr) {
+int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, char* famname, char* phenoname, char* extractname, char* excludename, char* keepname, char* removename, char* keepfamname, char* removefamname, char* filtername, char* freqname, char* read_dists_fname, char* read_dists_id_fname, char* evecname, char* mergename1, char* mergename2, char* mergename3, char* makepheno_str, char* phenoname_str, Two_col_params* a1alleles, Two_col_params* a2alleles, char* recode_allele_name, char* covar_fname, char* set_fname, char* subset_fname, char* update_alleles_fname, char* read_genome_fname, char* dist_stats_update_prefix, Two_col_params* update_chr, Two_col_params* update_cm, Two_col_params* update_map, Two_col_params* update_name, char* update_ids_fname, char* update_parents_fname, char* update_sex_fname, char* loop_assoc_fname, char* flip_fname, char* flip_subset_fname, char* filterval, char* condition_mname, char* condition_fname, double thin_keep_prob, uint32_t min_bp_space, uint32_t mfilter_col, uint32_t filter_binary, uint32_t fam_cols, char missing_geno, int32_t missing_pheno, char output_missing_geno, char* output_missing_pheno, uint32_t mpheno_col, uint32_t pheno_modifier, Chrom_info* chrom_info_ptr, double exponent, double min_maf, double max_maf, double geno_thresh, double mind_thresh, double hwe_thresh, double rel_cutoff, double rel_sparse_cutoff, double tail_bottom, double tail_top, uint64_t misc_flags, uint64_t calculation_type, uint32_t rel_calc_type, uint32_t dist_calc_type, uintptr_t groupdist_iters, uint32_t groupdist_d, uintptr_t regress_iters, uint32_t regress_d, uintptr_t regress_rel_iters, uint32_t regress_rel_d, double unrelated_herit_tol, double unrelated_herit_covg, double unrelated_herit_covr, int32_t ibc_type, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t matrix_passes, uint32_t ppc_gap, uint32_t sex_missing_pheno, uint32_t genome_modifier, double genome_min_pi_hat, double genome_max_pi_hat, Homozyg_info* homozyg_ptr, Cluster_info* cluster_ptr, uint32_t neighbor_n1, uint32_t neighbor_n2, uint32_t ld_window_size, uint32_t ld_window_kb, uint32_t ld_window_incr, double ld_last_param, Ld_info* ldip, uint32_t regress_pcs_modifier, uint32_t max_pcs, uint32_t recode_modifier, uint32_t allelexxxx, uint32_t merge_type, uint32_t indiv_sort, int32_t marker_pos_start, int32_t marker_pos_end, uint32_t snp_window_size, char* markername_from, char* markername_to, char* markername_snp, Range_list* snps_range_list_ptr, uint32_t covar_modifier, Range_list* covar_range_list_ptr, uint32_t write_covar_modifier, uint32_t write_covar_dummy_max_categories, uint32_t mwithin_col, uint32_t model_modifier, uint32_t model_cell_ct, uint32_t model_mperm_val, uint32_t glm_modifier, double glm_vif_thresh, uint32_t glm_xchr_model, uint32_t glm_mperm_val, Range_list* parameters_range_list_ptr, Range_list* tests_range_list_ptr, double ci_size, double pfilter, uint32_t mtest_adjust, double adjust_lambda, uint32_t gxe_mcovar, uint32_t aperm_min, uint32_t aperm_max, double aperm_alpha, double aperm_beta, double aperm_init_interval, double aperm_interval_slope, uint32_t mperm_save, uint32_t ibs_test_perms, uint32_t perm_batch_size, double lasso_h2, Ll_str** file_delete_list_ptr) {
   FILE* bedfile = NULL;
   FILE* famfile = NULL;
   FILE* phenofile = NULL;
   FILE* infile = NULL;
+  FILE* dstat_outfile = NULL;
   uintptr_t unfiltered_marker_ct = 0;
   uintptr_t* marker_exclude = NULL;
   uintptr_t max_marker_id_len = 0;
@@ -4230,6 +4232,9 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
   uint32_t marker_alleles_needed = are_marker_alleles_needed(calculation_type, freqname, homozyg_ptr, a1alleles, a2alleles);
   uint32_t zero_extra_chroms = (misc_flags / MISC_ZERO_EXTRA_CHROMS) & 1;
   uint32_t uii = 0;
+  uint32_t pass_ct;
+  uint32_t pass_idx;
+  uint32_t dstat_row_start = 0;
   int64_t llxx = 0;
   uint32_t nonfounders = (misc_flags / MISC_NONFOUNDERS) & 1;
   uint32_t pheno_all = pheno_modifier & PHENO_ALL;
@@ -4898,6 +4903,11 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
     }
     bed_offset = 3;
   }
+  if (misc_flags & MISC_BED_MMAP) {
+    if (bed_mmap_init(bedfile)) {
+      logprint("Warning: Unable to memory-map .bed file.  Falling back on buffered reads.\n");
+    }
+  }
   if (mind_thresh < 1.0) {
     retval = mind_filter(bedfile, bed_offset, mind_thresh, unfiltered_marker_ct, marker_exclude, marker_exclude_ct, unfiltered_indiv_ct, indiv_exclude, &indiv_exclude_ct, missing_geno);
     if (retval) {
@@ -4949,6 +4959,30 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
     sprintf(logbuf, "Error: Too many --parallel jobs (maximum %" PRIuPTR "/2 = %" PRIuPTR ").\n", g_indiv_ct, g_indiv_ct / 2);
     goto wdist_ret_INVALID_CMDLINE_2;
   }
+  if (matrix_passes > 1) {
+    if (parallel_tot > 1) {
+      logprint("Error: --matrix-passes cannot be used with --parallel.\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    } else if (matrix_passes > g_indiv_ct / 2) {
+      sprintf(logbuf, "Error: Too many --matrix-passes (maximum %" PRIuPTR "/2 = %" PRIuPTR ").\n", g_indiv_ct, g_indiv_ct / 2);
+      goto wdist_ret_INVALID_CMDLINE_2;
+    }
+    // these mirror the pass_ct conditions below; only automatic (unspecified)
+    // pass counts may quietly fall back to a single pass
+    if (!(calculation_type & (CALC_RELATIONSHIP | CALC_DISTANCE))) {
+      logprint("Error: --matrix-passes must be used with --make-rel, --make-grm-gz,\n--make-grm-bin, or --distance.\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    } else if (calculation_type & (CALC_REL_CUTOFF | CALC_REGRESS_REL | CALC_UNRELATED_HERITABILITY)) {
+      logprint("Error: --matrix-passes cannot be used with --rel-cutoff, --regress-rel, or\n--unrelated-heritability.\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    } else if (distance_req(calculation_type, read_dists_fname) && (calculation_type & (CALC_PLINK_DISTANCE_MATRIX | CALC_PLINK_IBS_MATRIX | CALC_IBS_TEST | CALC_GROUPDIST | CALC_REGRESS_DISTANCE | CALC_CLUSTER | CALC_NEIGHBOR))) {
+      logprint("Error: --matrix-passes cannot be used with --distance-matrix, --matrix,\n--ibs-test, --groupdist, --regress-distance, --cluster, or --neighbour.\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    } else if (((calculation_type & CALC_RELATIONSHIP) && (((rel_calc_type & REL_CALC_SHAPEMASK) == REL_CALC_SQ) || ((rel_calc_type & REL_CALC_BIN) && (!(rel_calc_type & REL_CALC_SHAPEMASK))))) || ((calculation_type & CALC_DISTANCE) && (((dist_calc_type & DISTANCE_SHAPEMASK) == DISTANCE_SQ) || ((dist_calc_type & DISTANCE_BIN) && (!(dist_calc_type & DISTANCE_SHAPEMASK)))))) {
+      logprint("Error: --matrix-passes cannot be used with square output shapes (including the\ndefault 'bin' shape).\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    }
+  }
   if (g_thread_ct > 1) {
     if ((calculation_type & (CALC_RELATIONSHIP | CALC_IBC | CALC_GDISTANCE_MASK | CALC_IBS_TEST | CALC_GROUPDIST | CALC_REGRESS_DISTANCE | CALC_GENOME | CALC_REGRESS_REL | CALC_UNRELATED_HERITABILITY)) || ((calculation_type & CALC_MODEL) && (model_modifier & (MODEL_PERM | MODEL_MPERM))) || ((calculation_type & CALC_GLM) && (glm_modifier & (GLM_PERM | GLM_MPERM))) || ((calculation_type & (CALC_CLUSTER | CALC_NEIGHBOR)) && (!read_genome_fname) && ((cluster_ptr->ppc != 0.0) || (!read_dists_fname)))) {
       sprintf(logbuf, "Using %d threads (change this with --threads).\n", g_thread_ct);
@@ -4957,6 +4991,12 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
       logprint("Using 1 thread (no multithreaded calculations invoked).\n");
     }
   }
+  if ((g_simd_level != SIMD_LEVEL_SSE2) && (distance_req(calculation_type, read_dists_fname) || (calculation_type & (CALC_LD_PRUNE | CALC_LD_REPORT)))) {
+    // the allele counters dispatch on this too, but they run almost
+    // everywhere and rarely dominate
+    sprintf(logbuf, "Using %s IBS/LD kernels (change this with --simd).\n", g_simd_level_names[g_simd_level]);
+    logprintb();
+  }
 
   if ((calculation_type & (CALC_MISSING_REPORT | CALC_GENOME | CALC_HOMOZYG)) || cluster_ptr->mds_dim_ct) {
     calc_plink_maxfid(unfiltered_indiv_ct, indiv_exclude, g_indiv_ct, person_ids, max_person_id_len, &plink_maxfid, &plink_maxiid);
@@ -5211,6 +5251,17 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
     }
   }
 
+  if (calculation_type & CALC_LD_REPORT) {
+    if (map_is_unsorted & UNSORTED_BP) {
+      logprint("Error: --r2 requires a sorted .map/.bim.  Retry this command after using\n--make-bed to sort your data.\n");
+      goto wdist_ret_INVALID_CMDLINE;
+    }
+    retval = ld_report(threads, ldip, bedfile, bed_offset, marker_ct, unfiltered_marker_ct, marker_exclude, marker_reverse, marker_ids, max_marker_id_len, plink_maxsnp, zero_extra_chroms, chrom_info_ptr, marker_pos, unfiltered_indiv_ct, founder_info, sex_male, outname, outname_end, misc_flags, hh_exists);
+    if (retval) {
+      goto wdist_ret_1;
+    }
+  }
+
   if (calculation_type & CALC_REGRESS_PCS) {
     // do this before marker_alleles is overwritten in memory...
     retval = calc_regress_pcs(evecname, regress_pcs_modifier, max_pcs, bedfile, bed_offset, marker_ct, unfiltered_marker_ct, marker_exclude, marker_reverse, marker_ids, max_marker_id_len, marker_alleles, max_marker_allele_len, zero_extra_chroms, chrom_info_ptr, marker_pos, g_indiv_ct, unfiltered_indiv_ct, indiv_exclude, person_ids, max_person_id_len, sex_nm, sex_male, pheno_d, missing_phenod, outname, outname_end, hh_exists);
@@ -5281,13 +5332,40 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
   wkspace_mark2 = wkspace_base;
 
   if (relationship_or_ibc_req(calculation_type)) {
-    if (rel_calc_type & REL_CALC_SINGLE_PREC) {
-      retval = calc_rel_f(threads, parallel_idx, parallel_tot, calculation_type, rel_calc_type, bedfile, bed_offset, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, unfiltered_indiv_ct, indiv_exclude, &indiv_exclude_ct, person_ids, max_person_id_len, ibc_type, (float)rel_cutoff, set_allele_freqs, chrom_info_ptr);
-    } else {
-      retval = calc_rel(threads, parallel_idx, parallel_tot, calculation_type, rel_calc_type, bedfile, bed_offset, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, unfiltered_indiv_ct, indiv_exclude, &indiv_exclude_ct, person_ids, max_person_id_len, ibc_type, rel_cutoff, set_allele_freqs, &rel_ibc, chrom_info_ptr);
+    // Out-of-core mode: if the triangle does not fit in the workspace, compute
+    // it as a sequence of --parallel-style row ranges (one .bed pass each),
+    // appending each finished piece to the final output file.
+    pass_ct = 1;
+    if ((parallel_tot == 1) && ((calculation_type & (CALC_RELATIONSHIP | CALC_REL_CUTOFF | CALC_REGRESS_REL | CALC_UNRELATED_HERITABILITY)) == CALC_RELATIONSHIP) && ((rel_calc_type & REL_CALC_SHAPEMASK) != REL_CALC_SQ) && ((rel_calc_type & REL_CALC_SHAPEMASK) || (!(rel_calc_type & REL_CALC_BIN)))) {
+      pass_ct = matrix_pass_ct((rel_calc_type & REL_CALC_SINGLE_PREC)? 8 : 12, rel_pass_fixed_bytes(calculation_type, rel_calc_type, unfiltered_indiv_ct), matrix_passes);
+      if (!pass_ct) {
+	goto wdist_ret_NOMEM;
+      }
     }
-    if (retval) {
-      goto wdist_ret_1;
+    for (pass_idx = 0; pass_idx < pass_ct; pass_idx++) {
+      if (pass_idx) {
+	wkspace_reset(wkspace_mark2);
+	g_indiv_missing_unwt = NULL;
+	g_missing_dbl_excluded = NULL;
+      }
+      if (pass_ct > 1) {
+	sprintf(logbuf, "Pass %u/%u:\n", pass_idx + 1, pass_ct);
+	logprintb();
+      }
+      if (rel_calc_type & REL_CALC_SINGLE_PREC) {
+	retval = calc_rel_f(threads, (pass_ct > 1)? pass_idx : parallel_idx, (pass_ct > 1)? pass_ct : parallel_tot, calculation_type, rel_calc_type, bedfile, bed_offset, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, unfiltered_indiv_ct, indiv_exclude, &indiv_exclude_ct, person_ids, max_person_id_len, ibc_type, (float)rel_cutoff, rel_sparse_cutoff, set_allele_freqs, chrom_info_ptr);
+      } else {
+	retval = calc_rel(threads, (pass_ct > 1)? pass_idx : parallel_idx, (pass_ct > 1)? pass_ct : parallel_tot, calculation_type, rel_calc_type, bedfile, bed_offset, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, unfiltered_indiv_ct, indiv_exclude, &indiv_exclude_ct, person_ids, max_person_id_len, ibc_type, rel_cutoff, rel_sparse_cutoff, set_allele_freqs, &rel_ibc, chrom_info_ptr);
+      }
+      if (retval) {
+	goto wdist_ret_1;
+      }
+      if (pass_ct > 1) {
+	retval = rel_pass_append(outname, outname_end, rel_calc_type, pass_idx);
+	if (retval) {
+	  goto wdist_ret_1;
+	}
+      }
     }
 
     if (calculation_type & CALC_REGRESS_REL) {
@@ -5314,9 +5392,54 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
     retval = RET_CALC_NOT_YET_SUPPORTED;
     goto wdist_ret_1;
   } else if (distance_req(calculation_type, read_dists_fname)) {
-    retval = calc_distance(threads, parallel_idx, parallel_tot, bedfile, bed_offset, outname, outname_end, calculation_type, dist_calc_type, marker_exclude, marker_ct, set_allele_freqs, unfiltered_indiv_ct, indiv_exclude, person_ids, max_person_id_len, chrom_info_ptr, wt_needed, marker_weight_sum, marker_weights_i, exponent);
-    if (retval) {
-      goto wdist_ret_1;
+    pass_ct = 1;
+    if ((parallel_tot == 1) && (!(dist_calc_type & DISTANCE_STATS)) && ((calculation_type & (CALC_DISTANCE | CALC_PLINK_DISTANCE_MATRIX | CALC_PLINK_IBS_MATRIX | CALC_IBS_TEST | CALC_GROUPDIST | CALC_REGRESS_DISTANCE | CALC_CLUSTER | CALC_NEIGHBOR)) == CALC_DISTANCE) && ((dist_calc_type & DISTANCE_SHAPEMASK) != DISTANCE_SQ) && ((dist_calc_type & DISTANCE_SHAPEMASK) || (!(dist_calc_type & DISTANCE_BIN)))) {
+      pass_ct = matrix_pass_ct(8 + ((dist_calc_type & DISTANCE_FLAT_MISSING)? 4 : 0) + (wt_needed? 4 : 0), distance_pass_fixed_bytes(unfiltered_indiv_ct), matrix_passes);
+      if (!pass_ct) {
+	goto wdist_ret_NOMEM;
+      }
+    }
+    if (dist_calc_type & DISTANCE_STATS) {
+      if (!dist_stats_update_prefix) {
+	*outname_end = '\0';
+      }
+      retval = dist_stats_open(&dstat_outfile, dist_stats_update_prefix? dist_stats_update_prefix : outname, dist_stats_update_prefix? 1 : 0, marker_exclude, marker_ct, marker_ids, max_marker_id_len, chrom_info_ptr, indiv_exclude, person_ids, max_person_id_len, &dstat_row_start);
+      if (retval) {
+	goto wdist_ret_1;
+      }
+      if (dstat_row_start) {
+	sprintf(logbuf, "--dist-stats-update: %u saved individuals, %" PRIuPTR " new.  Only the new rows of\nthe distance matrix will be computed and written.\n", dstat_row_start, g_indiv_ct - dstat_row_start);
+	logprintb();
+      }
+    }
+    wkspace_mark = wkspace_base;
+    for (pass_idx = 0; pass_idx < pass_ct; pass_idx++) {
+      if (pass_idx) {
+	wkspace_reset(wkspace_mark);
+      }
+      if (pass_ct > 1) {
+	sprintf(logbuf, "Pass %u/%u:\n", pass_idx + 1, pass_ct);
+	logprintb();
+      }
+      retval = calc_distance(threads, (pass_ct > 1)? pass_idx : parallel_idx, (pass_ct > 1)? pass_ct : parallel_tot, bedfile, bed_offset, outname, outname_end, calculation_type, dist_calc_type, marker_exclude, marker_ct, set_allele_freqs, unfiltered_indiv_ct, indiv_exclude, person_ids, max_person_id_len, chrom_info_ptr, wt_needed, marker_weight_sum, marker_weights_i, exponent, dstat_row_start, dstat_outfile);
+      if (retval) {
+	goto wdist_ret_1;
+      }
+      if (pass_ct > 1) {
+	retval = distance_pass_append(outname, outname_end, dist_calc_type, pass_idx);
+	if (retval) {
+	  goto wdist_ret_1;
+	}
+      }
+    }
+    if (dstat_outfile) {
+      if (!dist_stats_update_prefix) {
+	*outname_end = '\0';
+      }
+      retval = dist_stats_close(&dstat_outfile, dist_stats_update_prefix? dist_stats_update_prefix : outname, dstat_row_start, indiv_exclude, person_ids, max_person_id_len);
+      if (retval) {
+	goto wdist_ret_1;
+      }
     }
   }
 
@@ -5540,6 +5663,8 @@ int32_t wdist(char* outname, char* outname_end, char* pedname, char* mapname, ch
   fclose_cond(infile);
   fclose_cond(phenofile);
   fclose_cond(famfile);
+  fclose_cond(dstat_outfile);
+  bed_mmap_cleanup();
   fclose_cond(bedfile);
   return retval;
 }
@@ -6316,6 +6441,7 @@ int32_t main(int32_t argc, char** argv) {
   char* flip_fname = NULL;
   char* flip_subset_fname = NULL;
   char* read_genome_fname = NULL;
+  char* dist_stats_update_prefix = NULL;
   char* condition_mname = NULL;
   char* condition_fname = NULL;
   int32_t retval = 0;
@@ -6325,6 +6451,8 @@ int32_t main(int32_t argc, char** argv) {
   uint32_t mpheno_col = 0;
   uint32_t mwithin_col = 0;
   uint64_t misc_flags = 0;
+  uint32_t simd_max_level = SIMD_LEVEL_AVX512_VPOPCNT;
+  uint32_t wkspace_backing = 0;
   double thin_keep_prob = 1.0;
   uint32_t min_bp_space = 0;
   double exponent = 0.0;
@@ -6334,6 +6462,7 @@ int32_t main(int32_t argc, char** argv) {
   double mind_thresh = 1.0;
   double hwe_thresh = 0.0;
   double rel_cutoff = 0.025;
+  double rel_sparse_cutoff = 0.025;
   uint32_t cur_arg = 1;
   uint64_t calculation_type = 0;
   uint32_t rel_calc_type = 0;
@@ -6355,6 +6484,10 @@ int32_t main(int32_t argc, char** argv) {
   int32_t ibc_type = 0; // -1 for cov
   uint32_t parallel_idx = 0;
   uint32_t parallel_tot = 1;
+  uint32_t matrix_passes = 0;
+  uint32_t parallel_merge_ct = 0;
+  uint32_t checkpoint_secs = 0;
+  uint32_t checkpoint_resume = 0;
   uint32_t sex_missing_pheno = 0;
   uint32_t write_covar_modifier = 0;
   uint32_t write_covar_dummy_max_categories = 49;
@@ -6490,6 +6623,7 @@ int32_t main(int32_t argc, char** argv) {
   Chrom_info chrom_info;
   Homozyg_info homozyg;
   Cluster_info cluster;
+  Ld_info ld_info;
   Range_list snps_range_list;
   Range_list covar_range_list;
   Range_list parameters_range_list;
@@ -6513,6 +6647,7 @@ int32_t main(int32_t argc, char** argv) {
 #endif
   homozyg_init(&homozyg);
   cluster_init(&cluster);
+  ld_init(&ld_info);
   range_list_init(&snps_range_list);
   range_list_init(&covar_range_list);
   range_list_init(&parameters_range_list);
@@ -7513,6 +7648,17 @@ int32_t main(int32_t argc, char** argv) {
 	  goto main_ret_OPEN_FAIL;
 	}
 	strcpy(pedname, argv[cur_arg + 1]);
+      } else if (!memcmp(argptr2, "ed-mmap", 8)) {
+	misc_flags |= MISC_BED_MMAP;
+	goto main_param_zero;
+      } else if (!memcmp(argptr2, "gzf", 4)) {
+#if _WIN32
+	logprint("Error: --bgzf is not supported on Windows yet.\n");
+	goto main_ret_INVALID_CMDLINE;
+#else
+	misc_flags |= MISC_BGZF;
+	goto main_param_zero;
+#endif
       } else if (!memcmp(argptr2, "im", 3)) {
 	load_params |= 32;
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
@@ -7668,6 +7814,20 @@ int32_t main(int32_t argc, char** argv) {
 	  sprintf(logbuf, "Error: Invalid --cell parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
+      } else if (!memcmp(argptr2, "heckpoint", 10)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (param_ct) {
+	  // fractional minutes are permitted
+	  if (scan_double(argv[cur_arg + 1], &dxx) || (dxx < (1.0 / 60)) || (dxx > 1000000)) {
+	    sprintf(logbuf, "Error: Invalid --checkpoint interval '%s'.%s", argv[cur_arg + 1], errstr_append);
+	    goto main_ret_INVALID_CMDLINE_3;
+	  }
+	  checkpoint_secs = (uint32_t)(dxx * 60 + 0.5);
+	} else {
+	  checkpoint_secs = 1800;
+	}
       } else if (!memcmp(argptr2, "i", 2)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
@@ -8339,6 +8499,23 @@ int32_t main(int32_t argc, char** argv) {
       } else if (!memcmp(argptr2, "ecompress", 10)) {
 	logprint("Error: --decompress flag retired.  Use e.g. 'gunzip [filename]'.\n");
 	goto main_ret_INVALID_CMDLINE;
+      } else if (!memcmp(argptr2, "ist-stats", 10)) {
+	dist_calc_type |= DISTANCE_STATS;
+	goto main_param_zero;
+      } else if (!memcmp(argptr2, "ist-stats-update", 17)) {
+	if (dist_calc_type & DISTANCE_STATS) {
+	  sprintf(logbuf, "Error: --dist-stats and --dist-stats-update cannot be used together.%s", errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	// room for ".dstat.markers"
+	retval = alloc_fname(&dist_stats_update_prefix, argv[cur_arg + 1], argptr, 15);
+	if (retval) {
+	  goto main_ret_1;
+	}
+	dist_calc_type |= DISTANCE_STATS;
       } else if (!memcmp(argptr2, "istance", 8)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 7)) {
 	  goto main_ret_INVALID_CMDLINE_3;
@@ -8812,7 +8989,7 @@ int32_t main(int32_t argc, char** argv) {
 	} else {
 	  kk = 0;
 	}
-	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 5 - kk)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 6 - kk)) {
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
 	for (uii = 1; uii <= param_ct; uii++) {
@@ -8825,12 +9002,18 @@ int32_t main(int32_t argc, char** argv) {
 	  } else if (!strcmp(argv[cur_arg + uii], "unbounded")) {
 	    genome_modifier |= GENOME_IBD_UNBOUNDED;
 	  } else if (!strcmp(argv[cur_arg + uii], "nudge")) {
-            genome_modifier |= GENOME_NUDGE;
+	    genome_modifier |= GENOME_NUDGE;
+	  } else if (!strcmp(argv[cur_arg + uii], "bin")) {
+	    genome_modifier |= GENOME_OUTPUT_BIN;
 	  } else {
 	    sprintf(logbuf, "Error: Invalid --genome parameter '%s'.%s", argv[cur_arg + uii], errstr_append);
 	    goto main_ret_INVALID_CMDLINE_3;
 	  }
 	}
+	if ((genome_modifier & (GENOME_OUTPUT_GZ | GENOME_OUTPUT_BIN)) == (GENOME_OUTPUT_GZ | GENOME_OUTPUT_BIN)) {
+	  sprintf(logbuf, "Error: --genome 'gz' and 'bin' modifiers cannot be used together.%s", errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
 	calculation_type |= CALC_GENOME;
       } else if (!memcmp(argptr2, "enome-full", 11)) {
 	if (!(calculation_type & CALC_GENOME)) {
@@ -8898,7 +9081,25 @@ int32_t main(int32_t argc, char** argv) {
 	} else {
 	  memcpy(pedname, PROG_NAME_STR, 6);
 	}
-        load_rare = LOAD_RARE_GRM_BIN;
+	load_rare = LOAD_RARE_GRM_BIN;
+      } else if (!memcmp(argptr2, "rm-sparse", 10)) {
+	if (load_params || load_rare) {
+	  goto main_ret_INVALID_CMDLINE_4;
+	}
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (param_ct) {
+	  sptr = argv[cur_arg + 1];
+	  if (strlen(sptr) > (FNAMESIZE - 16)) {
+	    logprint("Error: --grm-sparse parameter too long.\n");
+	    goto main_ret_OPEN_FAIL;
+	  }
+	  strcpy(pedname, sptr);
+	} else {
+	  memcpy(pedname, PROG_NAME_STR, 6);
+	}
+	load_rare = LOAD_RARE_GRM_SPARSE;
       } else if (!memcmp(argptr2, "xe", 3)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
@@ -9558,11 +9759,62 @@ int32_t main(int32_t argc, char** argv) {
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
 	calculation_type |= CALC_GLM;
-      } else if (!memcmp(argptr2, "d-xchr", 7)) {
-        if (!(calculation_type & CALC_LD_PRUNE)) {
-          sprintf(logbuf, "Error: --ld-xchr must be used with --indep[-pairwise].%s", errstr_append);
-          goto main_ret_INVALID_CMDLINE_3;
+      } else if (!memcmp(argptr2, "d-snp", 6)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (alloc_string(&(ld_info.snpstr), argv[cur_arg + 1])) {
+	  goto main_ret_NOMEM;
+	}
+	ld_info.modifier |= LD_WINDOW_FLAGS;
+      } else if (!memcmp(argptr2, "d-snp-list", 11)) {
+	if (ld_info.snpstr) {
+	  logprint("Error: --ld-snp and --ld-snp-list cannot be used together.\n");
+	  goto main_ret_INVALID_CMDLINE;
 	}
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	retval = alloc_fname(&(ld_info.snp_list_fname), argv[cur_arg + 1], argptr, 0);
+	if (retval) {
+	  goto main_ret_1;
+	}
+	ld_info.modifier |= LD_WINDOW_FLAGS;
+      } else if (!memcmp(argptr2, "d-window", 9)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	ii = atoi(argv[cur_arg + 1]);
+	if (ii < 2) {
+	  sprintf(logbuf, "Error: Invalid --ld-window parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	ld_info.window_size = ii;
+	ld_info.modifier |= LD_WINDOW_FLAGS;
+      } else if (!memcmp(argptr2, "d-window-kb", 12)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (scan_double(argv[cur_arg + 1], &dxx) || (dxx < 0)) {
+	  sprintf(logbuf, "Error: Invalid --ld-window-kb parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (dxx > 2147483.647) {
+	  ld_info.window_bp = 2147483647;
+	} else {
+	  ld_info.window_bp = ((int32_t)(dxx * 1000 * (1 + SMALL_EPSILON)));
+	}
+	ld_info.modifier |= LD_WINDOW_FLAGS;
+      } else if (!memcmp(argptr2, "d-window-r2", 12)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (scan_double(argv[cur_arg + 1], &ld_info.window_r2) || (ld_info.window_r2 < 0.0) || (ld_info.window_r2 > 1.0)) {
+	  sprintf(logbuf, "Error: Invalid --ld-window-r2 parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	ld_info.modifier |= LD_WINDOW_FLAGS;
+      } else if (!memcmp(argptr2, "d-xchr", 7)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
@@ -9692,6 +9944,30 @@ int32_t main(int32_t argc, char** argv) {
 	  goto main_ret_INVALID_CMDLINE;
 	}
 #endif
+      } else if (!memcmp(argptr2, "emory-backing", 14)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 2)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	for (uii = 1; uii <= param_ct; uii++) {
+	  if (!strcmp(argv[cur_arg + uii], "thp")) {
+	    if (wkspace_backing & WKSPACE_BACKING_HUGETLB) {
+	      sprintf(logbuf, "Error: --memory-backing 'thp' and 'hugetlb' modifiers cannot be used together.%s", errstr_append);
+	      goto main_ret_INVALID_CMDLINE_3;
+	    }
+	    wkspace_backing |= WKSPACE_BACKING_THP;
+	  } else if (!strcmp(argv[cur_arg + uii], "hugetlb")) {
+	    if (wkspace_backing & WKSPACE_BACKING_THP) {
+	      sprintf(logbuf, "Error: --memory-backing 'thp' and 'hugetlb' modifiers cannot be used together.%s", errstr_append);
+	      goto main_ret_INVALID_CMDLINE_3;
+	    }
+	    wkspace_backing |= WKSPACE_BACKING_HUGETLB;
+	  } else if (!strcmp(argv[cur_arg + uii], "interleave")) {
+	    wkspace_backing |= WKSPACE_BACKING_INTERLEAVE;
+	  } else {
+	    sprintf(logbuf, "Error: Invalid --memory-backing parameter '%s'.%s", argv[cur_arg + uii], errstr_append);
+	    goto main_ret_INVALID_CMDLINE_3;
+	  }
+	}
       } else if (!memcmp(argptr2, "af", 3)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
@@ -9805,9 +10081,40 @@ int32_t main(int32_t argc, char** argv) {
 	  }
 	}
 	calculation_type |= CALC_RELATIONSHIP;
+      } else if (!memcmp(argptr2, "ake-grm-sparse", 15)) {
+	if (calculation_type & CALC_RELATIONSHIP) {
+	  sprintf(logbuf, "Error: --make-grm-sparse cannot be used with --make-grm-gz/--make-grm-bin.%s", errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 3)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	rel_calc_type |= REL_CALC_GRM_SPARSE;
+	uii = 0; // threshold seen?
+	for (ujj = 1; ujj <= param_ct; ujj++) {
+	  if ((!strcmp(argv[cur_arg + ujj], "ibc2")) || (!strcmp(argv[cur_arg + ujj], "ibc3"))) {
+	    if (ibc_type) {
+	      sprintf(logbuf, "Error: --make-grm-sparse '%s' modifier cannot coexist with another IBC\nmodifier.%s", argv[cur_arg + ujj], errstr_append);
+	      goto main_ret_INVALID_CMDLINE_3;
+	    }
+	    ibc_type = argv[cur_arg + ujj][3] - '0';
+	  } else if (!strcmp(argv[cur_arg + ujj], "single-prec")) {
+	    rel_calc_type |= REL_CALC_SINGLE_PREC;
+	  } else if ((!uii) && (!scan_double(argv[cur_arg + ujj], &rel_sparse_cutoff))) {
+	    if ((rel_sparse_cutoff < -1) || (rel_sparse_cutoff >= 1)) {
+	      sprintf(logbuf, "Error: Invalid --make-grm-sparse threshold '%s'.%s", argv[cur_arg + ujj], errstr_append);
+	      goto main_ret_INVALID_CMDLINE_3;
+	    }
+	    uii = 1;
+	  } else {
+	    sprintf(logbuf, "Error: Invalid --make-grm-sparse parameter '%s'.%s", argv[cur_arg + ujj], errstr_append);
+	    goto main_ret_INVALID_CMDLINE_3;
+	  }
+	}
+	calculation_type |= CALC_RELATIONSHIP;
       } else if (!memcmp(argptr2, "ake-rel", 8)) {
 	if (calculation_type & CALC_RELATIONSHIP) {
-	  sprintf(logbuf, "Error: --make-rel cannot be used with --make-grm-gz/--make-grm-bin.%s", errstr_append);
+	  sprintf(logbuf, "Error: --make-rel cannot be used with --make-grm-gz/--make-grm-bin/\n--make-grm-sparse.%s", errstr_append);
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 3)) {
@@ -9895,6 +10202,16 @@ int32_t main(int32_t argc, char** argv) {
 	}
 	calculation_type |= CALC_PLINK_IBS_MATRIX;
 	goto main_param_zero;
+      } else if (!memcmp(argptr2, "atrix-passes", 13)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	ii = atoi(argv[cur_arg + 1]);
+	if ((ii < 1) || (ii > PARALLEL_MAX)) {
+	  sprintf(logbuf, "Error: Invalid --matrix-passes parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	matrix_passes = ii;
       } else if (!memcmp(argptr2, "af-succ", 8)) {
 	misc_flags |= MISC_MAF_SUCC;
 	goto main_param_zero;
@@ -10626,7 +10943,21 @@ int32_t main(int32_t argc, char** argv) {
 	  sprintf(logbuf, "Error: Invalid --parallel total job count '%s'.%s", argv[cur_arg + 2], errstr_append);
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
-        parallel_tot = ii;
+	parallel_tot = ii;
+      } else if (!memcmp(argptr2, "arallel-merge", 14)) {
+	if (parallel_tot > 1) {
+	  sprintf(logbuf, "Error: --parallel-merge cannot be used with --parallel.%s", errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	ii = atoi(argv[cur_arg + 1]);
+	if ((ii < 2) || (ii > PARALLEL_MAX)) {
+	  sprintf(logbuf, "Error: Invalid --parallel-merge piece count '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	parallel_merge_ct = ii;
       } else if (!memcmp(argptr2, "pc-gap", 7)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
@@ -10798,7 +11129,22 @@ int32_t main(int32_t argc, char** argv) {
       break;
 
     case 'r':
-      if (!memcmp(argptr2, "emove", 6)) {
+      if (!memcmp(argptr2, "2", 2)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 0, 2)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	for (uii = 1; uii <= param_ct; uii++) {
+	  if (!strcmp(argv[cur_arg + uii], "dprime")) {
+	    ld_info.modifier |= LD_DPRIME;
+	  } else if (!strcmp(argv[cur_arg + uii], "bin")) {
+	    ld_info.modifier |= LD_BIN;
+	  } else {
+	    sprintf(logbuf, "Error: Invalid --r2 parameter '%s'.%s", argv[cur_arg + uii], errstr_append);
+	    goto main_ret_INVALID_CMDLINE_3;
+	  }
+	}
+	calculation_type |= CALC_LD_REPORT;
+      } else if (!memcmp(argptr2, "emove", 6)) {
 	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
 	  goto main_ret_INVALID_CMDLINE_3;
 	}
@@ -10829,6 +11175,18 @@ int32_t main(int32_t argc, char** argv) {
 	  }
 	}
 	calculation_type |= CALC_REL_CUTOFF;
+      } else if (!memcmp(argptr2, "el-engine", 10)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (!strcmp(argv[cur_arg + 1], "bitwise")) {
+	  rel_calc_type |= REL_CALC_ENGINE_BITWISE;
+	} else if (!strcmp(argv[cur_arg + 1], "gemm")) {
+	  rel_calc_type |= REL_CALC_ENGINE_GEMM;
+	} else {
+	  sprintf(logbuf, "Error: Invalid --rel-engine parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
       } else if (!memcmp(argptr2, "egress-distance", 16)) {
 	if (parallel_tot > 1) {
 	  sprintf(logbuf, "Error: --parallel and --regress-distance cannot be used together.%s", errstr_append);
@@ -11256,6 +11614,9 @@ int32_t main(int32_t argc, char** argv) {
 	glm_modifier |= GLM_RECESSIVE | GLM_CONDITION_RECESSIVE;
 	glm_xchr_model = 0;
 	goto main_param_zero;
+      } else if (!memcmp(argptr2, "esume", 6)) {
+	checkpoint_resume = 1;
+	goto main_param_zero;
       } else {
 	goto main_ret_INVALID_CMDLINE_2;
       }
@@ -11359,6 +11720,22 @@ int32_t main(int32_t argc, char** argv) {
 	if (retval) {
 	  goto main_ret_1;
 	}
+      } else if (!memcmp(argptr2, "imd", 4)) {
+	if (enforce_param_ct_range(param_ct, argv[cur_arg], 1, 1)) {
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
+	if (!strcmp(argv[cur_arg + 1], "sse2")) {
+	  simd_max_level = SIMD_LEVEL_SSE2;
+	} else if (!strcmp(argv[cur_arg + 1], "avx2")) {
+	  simd_max_level = SIMD_LEVEL_AVX2;
+	} else if (!strcmp(argv[cur_arg + 1], "avx512bw")) {
+	  simd_max_level = SIMD_LEVEL_AVX512;
+	} else if (!strcmp(argv[cur_arg + 1], "avx512")) {
+	  simd_max_level = SIMD_LEVEL_AVX512_VPOPCNT;
+	} else {
+	  sprintf(logbuf, "Error: Invalid --simd parameter '%s'.%s", argv[cur_arg + 1], errstr_append);
+	  goto main_ret_INVALID_CMDLINE_3;
+	}
       } else if ((!memcmp(argptr2, "imulate", 8)) || (!memcmp(argptr2, "imulate-qt", 11))) {
 	if (load_params || load_rare) {
 	  goto main_ret_INVALID_CMDLINE_4;
@@ -12154,9 +12531,77 @@ int32_t main(int32_t argc, char** argv) {
   if (!outname_end) {
     outname_end = &(outname[5]);
   }
+  simd_level_init(simd_max_level);
 
   // command-line restrictions which don't play well with alphabetical order
+  if ((misc_flags & (MISC_LD_IGNORE_X | MISC_LD_WEIGHTED_X)) && (!(calculation_type & (CALC_LD_PRUNE | CALC_LD_REPORT)))) {
+    sprintf(logbuf, "Error: --ld-xchr must be used with --indep[-pairwise] or --r2.%s", errstr_append);
+    goto main_ret_INVALID_CMDLINE_3;
+  }
+  if ((ld_info.modifier & LD_WINDOW_FLAGS) && (!(calculation_type & CALC_LD_REPORT))) {
+    sprintf(logbuf, "Error: --ld-window, --ld-window-kb, --ld-window-r2, and --ld-snp[-list] must\nbe used with --r2.%s", errstr_append);
+    goto main_ret_INVALID_CMDLINE_3;
+  }
+  if (parallel_merge_ct) {
+    // the output flags just describe which pieces to merge
+    if ((calculation_type & (~(CALC_RELATIONSHIP | CALC_DISTANCE | CALC_GENOME))) || (popcount_long(calculation_type & (CALC_RELATIONSHIP | CALC_DISTANCE | CALC_GENOME)) != 1) || load_params || load_rare || genname[0]) {
+      sprintf(logbuf, "Error: --parallel-merge must be used with exactly one of --make-rel,\n--make-grm-gz, --make-grm-bin, --distance, or --genome (with the modifiers used\nto create the pieces), and no input fileset.%s", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    } else if ((calculation_type & CALC_RELATIONSHIP) && (((rel_calc_type & REL_CALC_SHAPEMASK) == REL_CALC_SQ) || ((rel_calc_type & REL_CALC_BIN) && (!(rel_calc_type & REL_CALC_SHAPEMASK))))) {
+      sprintf(logbuf, "Error: --parallel-merge cannot be used with a square --make-rel matrix.%s", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    } else if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+      sprintf(logbuf, "Error: --parallel-merge cannot be used with --make-grm-sparse.%s", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    } else if ((calculation_type & CALC_DISTANCE) && (((dist_calc_type & DISTANCE_SHAPEMASK) == DISTANCE_SQ) || ((dist_calc_type & DISTANCE_BIN) && (!(dist_calc_type & DISTANCE_SHAPEMASK))))) {
+      sprintf(logbuf, "Error: --parallel-merge cannot be used with a square --distance matrix.%s", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    }
+  }
+  if ((rel_calc_type & REL_CALC_GRM_SPARSE) && (parallel_tot > 1)) {
+    // row offsets in the index depend on every earlier row's entry count
+    sprintf(logbuf, "Error: --make-grm-sparse cannot be used with --parallel.%s", errstr_append);
+    goto main_ret_INVALID_CMDLINE_3;
+  }
+  if (dist_calc_type & DISTANCE_STATS) {
+    if (!(calculation_type & CALC_DISTANCE)) {
+      sprintf(logbuf, "Error: --dist-stats%s must be used with --distance.%s", dist_stats_update_prefix? "-update" : "", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    } else if (exponent != 0.0) {
+      // nonzero exponents make every distance depend on allele frequencies,
+      // so old rows would change whenever individuals are added
+      sprintf(logbuf, "Error: --dist-stats%s cannot be used with --exponent.%s", dist_stats_update_prefix? "-update" : "", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    } else if ((parallel_tot > 1) || (matrix_passes > 1)) {
+      sprintf(logbuf, "Error: --dist-stats%s cannot be used with --parallel or --matrix-passes.%s", dist_stats_update_prefix? "-update" : "", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    }
+    if (dist_stats_update_prefix) {
+      // the default missing-genotype adjustment depends on allele frequencies,
+      // and square rows depend on the final individual count, so old output
+      // would not stay valid
+      if (!(dist_calc_type & DISTANCE_FLAT_MISSING)) {
+	sprintf(logbuf, "Error: --dist-stats-update requires '--distance flat-missing'.%s", errstr_append);
+	goto main_ret_INVALID_CMDLINE_3;
+      } else if (((dist_calc_type & DISTANCE_SHAPEMASK) == DISTANCE_SQ) || ((dist_calc_type & DISTANCE_SHAPEMASK) == DISTANCE_SQ0) || ((dist_calc_type & DISTANCE_BIN) && (!(dist_calc_type & DISTANCE_SHAPEMASK)))) {
+	sprintf(logbuf, "Error: --dist-stats-update requires a triangular --distance matrix.%s", errstr_append);
+	goto main_ret_INVALID_CMDLINE_3;
+      } else if (calculation_type & (CALC_PLINK_DISTANCE_MATRIX | CALC_PLINK_IBS_MATRIX | CALC_IBS_TEST | CALC_GROUPDIST | CALC_REGRESS_DISTANCE | CALC_CLUSTER | CALC_NEIGHBOR)) {
+	sprintf(logbuf, "Error: --dist-stats-update only computes the new rows of the distance matrix,\nso it cannot be combined with other distance-based calculations.%s", errstr_append);
+	goto main_ret_INVALID_CMDLINE_3;
+      }
+    }
+  }
   if (load_rare) {
+    if (load_rare == LOAD_RARE_GRM_SPARSE) {
+      if ((!(calculation_type & CALC_REL_CUTOFF)) || (calculation_type & (~(CALC_REL_CUTOFF | CALC_RELATIONSHIP))) || ((calculation_type & CALC_RELATIONSHIP) && (!(rel_calc_type & REL_CALC_GRM_SPARSE)))) {
+	sprintf(logbuf, "Error: --grm-sparse currently must be used with --rel-cutoff (possibly combined\nwith --make-grm-sparse).%s", errstr_append);
+	goto main_ret_INVALID_CMDLINE_3;
+      }
+    } else if ((load_rare & (LOAD_RARE_GRM | LOAD_RARE_GRM_BIN)) && (rel_calc_type & REL_CALC_GRM_SPARSE)) {
+      sprintf(logbuf, "Error: --make-grm-sparse cannot be used with --grm-gz/--grm-bin.%s", errstr_append);
+      goto main_ret_INVALID_CMDLINE_3;
+    }
     if (load_rare & (LOAD_RARE_GRM | LOAD_RARE_GRM_BIN)) {
       if ((!(calculation_type & (CALC_REL_CUTOFF | CALC_UNRELATED_HERITABILITY))) || (calculation_type & (~(CALC_REL_CUTOFF | CALC_RELATIONSHIP | CALC_UNRELATED_HERITABILITY)))) {
 	if (load_rare == LOAD_RARE_GRM) {
@@ -12304,7 +12749,7 @@ int32_t main(int32_t argc, char** argv) {
   if ((!calculation_type) && (!(load_rare & (LOAD_RARE_LGEN | LOAD_RARE_DUMMY | LOAD_RARE_SIMULATE | LOAD_RARE_TRANSPOSE_MASK | LOAD_RARE_23 | LOAD_RARE_CNV))) && (famname[0] || load_rare)) {
     goto main_ret_NULL_CALC;
   }
-  if (!(load_params || load_rare)) {
+  if (!(load_params || load_rare || parallel_merge_ct)) {
     sprintf(logbuf, "Error: No input dataset.%s", errstr_append);
     goto main_ret_INVALID_CMDLINE_3;
   }
@@ -12371,13 +12816,13 @@ int32_t main(int32_t argc, char** argv) {
     sprintf(logbuf, "Failed to calculate system memory.  Attempting to reserve %" PRIdPTR " MB.\n", malloc_size_mb);
   }
   logprintb();
-  wkspace_ua = (unsigned char*)malloc(malloc_size_mb * 1048576 * sizeof(char));
+  wkspace_ua = wkspace_backing_alloc(malloc_size_mb * 1048576 * sizeof(char), wkspace_backing);
   while (!wkspace_ua) {
     malloc_size_mb = (malloc_size_mb * 3) / 4;
     if (malloc_size_mb < WKSPACE_MIN_MB) {
       malloc_size_mb = WKSPACE_MIN_MB;
     }
-    wkspace_ua = (unsigned char*)malloc(malloc_size_mb * 1048576 * sizeof(char));
+    wkspace_ua = wkspace_backing_alloc(malloc_size_mb * 1048576 * sizeof(char), wkspace_backing);
     if (wkspace_ua) {
       sprintf(logbuf, "Allocated %" PRIdPTR " MB successfully, after larger attempt(s) failed.\n", malloc_size_mb);
       logprintb();
@@ -12385,6 +12830,7 @@ int32_t main(int32_t argc, char** argv) {
       goto main_ret_NOMEM;
     }
   }
+  wkspace_backing_log(wkspace_backing);
   // force 64-byte align on OS X to make cache line sensitivity work
   wkspace = (unsigned char*)CACHEALIGN((uintptr_t)wkspace_ua);
   wkspace_base = wkspace;
@@ -12393,15 +12839,17 @@ int32_t main(int32_t argc, char** argv) {
 
   tbuf[MAXLINELEN - 6] = ' ';
   tbuf[MAXLINELEN - 1] = ' ';
-  pigz_init(g_thread_ct);
-  if (load_rare & (LOAD_RARE_GRM | LOAD_RARE_GRM_BIN)) {
+  pigz_init(g_thread_ct, (misc_flags / MISC_BGZF) & 1);
+  if (parallel_merge_ct) {
+    retval = parallel_merge(outname, outname_end, calculation_type, rel_calc_type, dist_calc_type, genome_modifier, parallel_merge_ct);
+  } else if (load_rare & (LOAD_RARE_GRM | LOAD_RARE_GRM_BIN | LOAD_RARE_GRM_SPARSE)) {
     // --unrelated-heritability and --rel-cutoff batch mode special cases
 #ifndef NOLAPACK
     if (calculation_type & CALC_UNRELATED_HERITABILITY) {
       retval = unrelated_herit_batch(load_rare & LOAD_RARE_GRM_BIN, pedname, phenoname, mpheno_col, phenoname_str, missing_pheno, (misc_flags / MISC_UNRELATED_HERITABILITY_STRICT) & 1, unrelated_herit_tol, unrelated_herit_covg, unrelated_herit_covr);
     } else {
 #endif
-      retval = rel_cutoff_batch(load_rare & LOAD_RARE_GRM_BIN, pedname, outname, outname_end, rel_cutoff, rel_calc_type);
+      retval = rel_cutoff_batch(load_rare & LOAD_RARE_GRM_BIN, load_rare & LOAD_RARE_GRM_SPARSE, pedname, outname, outname_end, rel_cutoff, rel_calc_type, rel_sparse_cutoff);
 #ifndef NOLAPACK
     }
 #endif
@@ -12474,10 +12922,11 @@ int32_t main(int32_t argc, char** argv) {
     } else if (!ibc_type) {
       ibc_type = 1;
     }
-    retval = wdist(outname, outname_end, pedname, mapname, famname, phenoname, extractname, excludename, keepname, removename, keepfamname, removefamname, filtername, freqname, read_dists_fname, read_dists_id_fname, evecname, mergename1, mergename2, mergename3, makepheno_str, phenoname_str, a1alleles, a2alleles, recode_allele_name, covar_fname, set_fname, subset_fname, update_alleles_fname, read_genome_fname, update_chr, update_cm, update_map, update_name, update_ids_fname, update_parents_fname, update_sex_fname, loop_assoc_fname, flip_fname, flip_subset_fname, filterval, condition_mname, condition_fname, thin_keep_prob, min_bp_space, mfilter_col, filter_binary, fam_cols, missing_geno, missing_pheno, output_missing_geno, output_missing_pheno, mpheno_col, pheno_modifier, &chrom_info, exponent, min_maf, max_maf, geno_thresh, mind_thresh, hwe_thresh, rel_cutoff, tail_bottom, tail_top, misc_flags, calculation_type, rel_calc_type, dist_calc_type, groupdist_iters, groupdist_d, regress_iters, regress_d, regress_rel_iters, regress_rel_d, unrelated_herit_tol, unrelated_herit_covg, unrelated_herit_covr, ibc_type, parallel_idx, parallel_tot, ppc_gap, sex_missing_pheno, genome_modifier, genome_min_pi_hat, genome_max_pi_hat, &homozyg, &cluster, neighbor_n1, neighbor_n2, ld_window_size, ld_window_kb, ld_window_incr, ld_last_param, regress_pcs_modifier, max_pcs, recode_modifier, allelexxxx, merge_type, indiv_sort, marker_pos_start, marker_pos_end, snp_window_size, markername_from, markername_to, markername_snp, &snps_range_list, covar_modifier, &covar_range_list, write_covar_modifier, write_covar_dummy_max_categories, mwithin_col, model_modifier, (uint32_t)model_cell_ct, model_mperm_val, glm_modifier, glm_vif_thresh, glm_xchr_model, glm_mperm_val, &parameters_range_list, &tests_range_list, ci_size, pfilter, mtest_adjust, adjust_lambda, gxe_mcovar, aperm_min, aperm_max, aperm_alpha, aperm_beta, aperm_init_interval, aperm_interval_slope, mperm_save, ibs_test_perms, perm_batch_size, lasso_h2, &file_delete_list);
+    checkpoint_init(checkpoint_secs, checkpoint_resume);
+    retval = wdist(outname, outname_end, pedname, mapname, famname, phenoname, extractname, excludename, keepname, removename, keepfamname, removefamname, filtername, freqname, read_dists_fname, read_dists_id_fname, evecname, mergename1, mergename2, mergename3, makepheno_str, phenoname_str, a1alleles, a2alleles, recode_allele_name, covar_fname, set_fname, subset_fname, update_alleles_fname, read_genome_fname, dist_stats_update_prefix, update_chr, update_cm, update_map, update_name, update_ids_fname, update_parents_fname, update_sex_fname, loop_assoc_fname, flip_fname, flip_subset_fname, filterval, condition_mname, condition_fname, thin_keep_prob, min_bp_space, mfilter_col, filter_binary, fam_cols, missing_geno, missing_pheno, output_missing_geno, output_missing_pheno, mpheno_col, pheno_modifier, &chrom_info, exponent, min_maf, max_maf, geno_thresh, mind_thresh, hwe_thresh, rel_cutoff, rel_sparse_cutoff, tail_bottom, tail_top, misc_flags, calculation_type, rel_calc_type, dist_calc_type, groupdist_iters, groupdist_d, regress_iters, regress_d, regress_rel_iters, regress_rel_d, unrelated_herit_tol, unrelated_herit_covg, unrelated_herit_covr, ibc_type, parallel_idx, parallel_tot, matrix_passes, ppc_gap, sex_missing_pheno, genome_modifier, genome_min_pi_hat, genome_max_pi_hat, &homozyg, &cluster, neighbor_n1, neighbor_n2, ld_window_size, ld_window_kb, ld_window_incr, ld_last_param, &ld_info, regress_pcs_modifier, max_pcs, recode_modifier, allelexxxx, merge_type, indiv_sort, marker_pos_start, marker_pos_end, snp_window_size, markername_from, markername_to, markername_snp, &snps_range_list, covar_modifier, &covar_range_list, write_covar_modifier, write_covar_dummy_max_categories, mwithin_col, model_modifier, (uint32_t)model_cell_ct, model_mperm_val, glm_modifier, glm_vif_thresh, glm_xchr_model, glm_mperm_val, &parameters_range_list, &tests_range_list, ci_size, pfilter, mtest_adjust, adjust_lambda, gxe_mcovar, aperm_min, aperm_max, aperm_alpha, aperm_beta, aperm_init_interval, aperm_interval_slope, mperm_save, ibs_test_perms, perm_batch_size, lasso_h2, &file_delete_list);
   }
  main_ret_2:
-  free(wkspace_ua);
+  wkspace_backing_free(wkspace_ua);
   while (0) {
   main_ret_NOMEM:
     retval = RET_NOMEM;
@@ -12564,6 +13013,9 @@ int32_t main(int32_t argc, char** argv) {
   free_cond(flip_fname);
   free_cond(flip_subset_fname);
   free_cond(read_genome_fname);
+  free_cond(dist_stats_update_prefix);
+  free_cond(ld_info.snpstr);
+  free_cond(ld_info.snp_list_fname);
   free_cond(cluster.fname);
   free_cond(cluster.match_fname);
   free_cond(cluster.match_missing_str);
@@ -2433,7 +2433,7 @@ static uintptr_t* g_loadbuf;
 static uintptr_t* g_perm_vecs;
 
 static uint32_t* g_perm_vecst; // genotype indexing support
-static uint32_t* g_thread_git_wkspace;
+static Thread_arenas g_thread_git_arenas;
 static uint32_t* g_resultbuf;
 
 // always use genotype indexing for QT --assoc
@@ -3041,10 +3041,10 @@ THREAD_RET_TYPE assoc_maxt_thread(void* arg) {
   uint32_t model_fisher = g_model_fisher;
 #ifdef __LP64__
   uint32_t perm_ct128 = (perm_vec_ct + 127) / 128;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct128 * 288]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #else
   uint32_t perm_ct64 = (perm_vec_ct + 63) / 64;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct64 * 144]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #endif
   uint32_t* git_homrar_cts = NULL;
   uint32_t* git_missing_cts = NULL;
@@ -4048,10 +4048,10 @@ THREAD_RET_TYPE model_maxt_domrec_thread(void* arg) {
   uint32_t model_fisher = g_model_fisher;
 #ifdef __LP64__
   uint32_t perm_ct128 = (perm_vec_ct + 127) / 128;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct128 * 288]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #else
   uint32_t perm_ct64 = (perm_vec_ct + 63) / 64;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct64 * 144]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #endif
   uint32_t* git_homrar_cts = NULL;
   uint32_t* git_missing_cts = NULL;
@@ -4371,10 +4371,10 @@ THREAD_RET_TYPE model_maxt_trend_thread(void* arg) {
   uintptr_t pheno_nm_ctl2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
 #ifdef __LP64__
   uint32_t perm_ct128 = (perm_vec_ct + 127) / 128;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct128 * 288]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #else
   uint32_t perm_ct64 = (perm_vec_ct + 63) / 64;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct64 * 144]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #endif
   uint32_t* git_homrar_cts = NULL;
   uint32_t* git_missing_cts = NULL;
@@ -4656,10 +4656,10 @@ THREAD_RET_TYPE model_maxt_gen_thread(void* arg) {
   uint32_t model_fisher = g_model_fisher;
 #ifdef __LP64__
   uint32_t perm_ct128 = (perm_vec_ct + 127) / 128;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct128 * 288]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #else
   uint32_t perm_ct64 = (perm_vec_ct + 63) / 64;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct64 * 144]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #endif
   uint32_t* git_homrar_cts = NULL;
   uint32_t* git_missing_cts = NULL;
@@ -5023,10 +5023,10 @@ THREAD_RET_TYPE model_maxt_best_thread(void* arg) {
   uint32_t model_fisher = g_model_fisher;
 #ifdef __LP64__
   uint32_t perm_ct128 = (perm_vec_ct + 127) / 128;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct128 * 288]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #else
   uint32_t perm_ct64 = (perm_vec_ct + 63) / 64;
-  uint32_t* thread_git_wkspace = &(g_thread_git_wkspace[tidx * perm_ct64 * 144]);
+  uint32_t* thread_git_wkspace = (uint32_t*)thread_arena_start(&g_thread_git_arenas, tidx);
 #endif
   uint32_t* git_homrar_cts = NULL;
   uint32_t* git_missing_cts = NULL;
@@ -5814,7 +5814,8 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       //   g_maxt_thread_results: (8 * g_perm_vec_ct, cacheline-aligned) *
       //     g_thread_ct
       //   g_perm_vecst: 16 * ((g_perm_vec_ct + 127) / 128) * pheno_nm_ct
-      //   g_thread_git_wkspace: ((perm_vec_ct + 127) / 128) * 1152 * thread_ct
+      //   g_thread_git_arenas: ((perm_vec_ct + 127) / 128) * 1152 * thread_ct,
+      //     plus up to THREAD_ARENA_SLACK(thread_ct) alignment padding
       //   g_resultbuf: MODEL_BLOCKSIZE * (4 * perm_vec_ct, CL-aligned) * 3
       //   g_perm_vecs: pheno_nm_ctl2 * sizeof(intptr_t) * g_perm_vec_ct
       //   g_mperm_save_all (if needed): marker_ct * 8 * g_perm_vec_ct
@@ -5834,10 +5835,16 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       // by 128 yields 1152.  The other thread_ct dependence contributes
       // 8 * perm_vec_ct bytes, multiplying by 128 yields 1024, and
       // 1152 + 1024 = 2176.
+      ulii = wkspace_left;
+      if (ulii > THREAD_ARENA_SLACK(g_thread_ct)) {
+	ulii -= THREAD_ARENA_SLACK(g_thread_ct);
+      } else {
+	ulii = 0;
+      }
       if (mperm_save & MPERM_DUMP_ALL) {
-        g_perm_vec_ct = 128 * (wkspace_left / (128LL * sizeof(intptr_t) * pheno_nm_ctl2 + 2176LL * g_thread_ct + 1536LL + 16LL * pheno_nm_ct + 128LL * sizeof(double) * marker_ct));
+        g_perm_vec_ct = 128 * (ulii / (128LL * sizeof(intptr_t) * pheno_nm_ctl2 + 2176LL * g_thread_ct + 1536LL + 16LL * pheno_nm_ct + 128LL * sizeof(double) * marker_ct));
       } else {
-        g_perm_vec_ct = 128 * (wkspace_left / (128LL * sizeof(intptr_t) * pheno_nm_ctl2 + 2176LL * g_thread_ct + 1536LL + 16LL * pheno_nm_ct));
+        g_perm_vec_ct = 128 * (ulii / (128LL * sizeof(intptr_t) * pheno_nm_ctl2 + 2176LL * g_thread_ct + 1536LL + 16LL * pheno_nm_ct));
       }
     }
     if (g_perm_vec_ct > perms_total - g_perms_done) {
@@ -5880,13 +5887,12 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       g_perm_vecst = (uint32_t*)wkspace_alloc(ulii * pheno_nm_ct);
       ulii = ((g_perm_vec_ct + 63) / 64) * 8;
 #endif
-      g_thread_git_wkspace = (uint32_t*)wkspace_alloc(ulii * 72 * g_thread_ct);
+      if (wkspace_alloc_thread_arenas(&g_thread_git_arenas, ulii * 72, g_thread_ct)) {
+	goto model_assoc_ret_NOMEM;
+      }
       transpose_perms(g_perm_vecs, g_perm_vec_ct, pheno_nm_ct, g_perm_vecst);
-#ifdef __LP64__
-      fill_ulong_zero((uintptr_t*)g_thread_git_wkspace, ulii * 9 * g_thread_ct);
-#else
-      fill_ulong_zero((uintptr_t*)g_thread_git_wkspace, ulii * 18 * g_thread_ct);
-#endif
+      // zeroed by the threads that will use them, for NUMA locality
+      thread_arenas_touch(threads, &g_thread_git_arenas);
       if (mperm_save & MPERM_DUMP_ALL) {
 	g_mperm_save_all = (double*)wkspace_alloc(marker_ct * g_perm_vec_ct * sizeof(double));
       }
@@ -5901,7 +5907,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
   }
   chrom_fo_idx = 0xffffffffU;
   marker_uidx = next_unset_unsafe(marker_exclude, 0);
-  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
     goto model_assoc_ret_READ_FAIL;
   }
   marker_idx = 0;
@@ -5942,7 +5948,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
 	  }
 	  marker_uidx = next_unset_unsafe(marker_exclude, chrom_end);
 	}
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
       }
@@ -5991,7 +5997,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
 	  next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
 	  marker_idx2++;
 	} while ((marker_uidx < chrom_end) && g_perm_adapt_stop[marker_idx2]);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
 	if (marker_uidx >= chrom_end) {
@@ -6015,7 +6021,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
       }
@@ -7436,7 +7442,7 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
   }
   chrom_fo_idx = 0xffffffffU;
   marker_uidx = next_unset_unsafe(marker_exclude, 0);
-  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
     goto qassoc_ret_READ_FAIL;
   }
   marker_idx = 0;
@@ -7490,7 +7496,7 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
 	  next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
 	  marker_idx2++;
 	} while ((marker_uidx < chrom_end) && g_perm_adapt_stop[marker_idx2]);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto qassoc_ret_READ_FAIL;
 	}
 	if (marker_uidx >= chrom_end) {
@@ -7514,7 +7520,7 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto qassoc_ret_READ_FAIL;
 	}
       }
@@ -8392,7 +8398,7 @@ int32_t gxe_assoc(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outn
   sprintf(tbuf, " CHR %%%us   NMISS1      BETA1        SE1   NMISS2      BETA2        SE2    Z_GXE        P_GXE \n", plink_maxsnp);
   fprintf(outfile, tbuf, "SNP");
 
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto gxe_assoc_ret_READ_FAIL;
   }
   // exploit overflow for initialization
@@ -8405,7 +8411,7 @@ int32_t gxe_assoc(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outn
     for (; marker_idx < loop_end; marker_idx++) {
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto gxe_assoc_ret_READ_FAIL;
 	}
       }
@@ -8775,11 +8781,11 @@ int32_t glm_scan_conditions(char* condition_mname, char* condition_fname, uintpt
     for (condition_idx = 0; condition_idx < condition_ct; condition_idx++) {
       // scan for missing values to update indiv_valid_ct
       marker_uidx = condition_uidxs[condition_idx];
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto glm_scan_conditions_ret_READ_FAIL;
       }
       // don't use load_and_collapse since collapse bitmask not finalized
-      if (fread(loadbuf_raw, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+      if (bed_fread(loadbuf_raw, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
 	goto glm_scan_conditions_ret_READ_FAIL;
       }
       chrom_idx = get_marker_chrom(chrom_info_ptr, marker_uidx);
@@ -10741,8 +10747,11 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
   uintptr_t param_idx;
   uintptr_t param_idx_fixed;
   uintptr_t constraint_idx;
+  uintptr_t glm_arena_size;
   uintptr_t ulii;
   uintptr_t uljj;
+  Thread_arenas glm_arenas;
+  unsigned char* arena_ptr;
   double* msa_ptr;
   double se;
   double zval;
@@ -11233,7 +11242,7 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
   }
   for (param_idx_fixed = 0; param_idx_fixed < condition_ct; param_idx_fixed++) {
     marker_uidx = condition_uidxs[param_idx_fixed];
-    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+    if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
       goto glm_assoc_ret_READ_FAIL;
     }
     if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_indiv_ct, g_loadbuf, indiv_valid_ct, load_mask, IS_SET(marker_reverse, marker_uidx))) {
@@ -11538,75 +11547,89 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
 #endif
   g_glm_mt = (Glm_multithread*)malloc(g_thread_ct * sizeof(Glm_multithread));
   ulii = (perm_batch_size + (BITCT - 1)) / BITCT;
-  for (tidx = 0; tidx < g_thread_ct; tidx++) {
-    if (wkspace_alloc_d_checked(&(g_glm_mt[tidx].cur_covars_cov_major), param_ct_max * indiv_valid_ct * sizeof(double)) ||
-        wkspace_alloc_d_checked(&(g_glm_mt[tidx].cur_covars_indiv_major), param_ct_max * indiv_valid_ct * sizeof(double)) ||
-        wkspace_alloc_ul_checked(&(g_glm_mt[tidx].perm_fails), ulii * sizeof(intptr_t)) ||
-        wkspace_alloc_d_checked(&(g_glm_mt[tidx].indiv_1d_buf), indiv_valid_ct * sizeof(double)) ||
-        wkspace_alloc_d_checked(&(g_glm_mt[tidx].param_2d_buf), param_ct_max * param_ct_max * sizeof(double)) ||
-        wkspace_alloc_d_checked(&(g_glm_mt[tidx].param_2d_buf2), param_ct_max * param_ct_max * sizeof(double)) ||
-        wkspace_alloc_d_checked(&(g_glm_mt[tidx].regression_results), perm_batch_size * param_ctx_max_m1 * sizeof(double))) {
-      goto glm_assoc_ret_NOMEM;
-    }
-
-    g_glm_mt[tidx].mi_buf = (MATRIX_INVERT_BUF1_TYPE*)wkspace_alloc(param_ct_max * sizeof(MATRIX_INVERT_BUF1_TYPE));
-    if (!(g_glm_mt[tidx].mi_buf)) {
-      goto glm_assoc_ret_NOMEM;
+  uljj = MAXV(cluster_ct1 + 1, param_ct_max);
+#ifndef NOLAPACK
+  if (pheno_d) {
+    dgels_m = (int32_t)((uint32_t)indiv_valid_ct);
+    dgels_n = (int32_t)((uint32_t)param_ct_max);
+    dgels_nrhs = perm_batch_size;
+    dgels_ldb = dgels_m;
+    g_dgels_lwork = -1;
+    // no other parameters are needed for workspace query (and the matrices
+    // aren't referenced)
+    dgels_(&dgels_trans, &dgels_m, &dgels_n, &dgels_nrhs, &dyy, &dgels_m, &dyy, &dgels_ldb, &dxx, &g_dgels_lwork, &dgels_info);
+    if (dxx > 2147483647.0) {
+      logprint("Error: Multiple linear regression problem too large for current LAPACK version.\n");
+      retval = RET_CALC_NOT_YET_SUPPORTED;
+      goto glm_assoc_ret_1;
     }
+    g_dgels_lwork = (int32_t)dxx;
+  } else {
+#endif
+    g_pheno_d2 = NULL;
+#ifndef NOLAPACK
+  }
+#endif
+  // Each thread's scratch buffers live in its own arena, so they're
+  // cacheline-separated from other threads' and can be first-touched by the
+  // thread that uses them.
+  glm_arena_size = 2 * CACHEALIGN(param_ct_max * indiv_valid_ct * sizeof(double)) + CACHEALIGN(ulii * sizeof(intptr_t)) + CACHEALIGN(indiv_valid_ct * sizeof(double)) + 2 * CACHEALIGN(param_ct_max * param_ct_max * sizeof(double)) + CACHEALIGN(perm_batch_size * param_ctx_max_m1 * sizeof(double)) + CACHEALIGN(param_ct_max * sizeof(MATRIX_INVERT_BUF1_TYPE));
+  if (cluster_ct1) {
+    glm_arena_size += CACHEALIGN(indiv_valid_ct * sizeof(int32_t)) + CACHEALIGN(uljj * param_ct_max * sizeof(double)) + CACHEALIGN((cluster_ct1 + 1) * param_ct_max * sizeof(double));
+  }
+  if (constraint_ct_max) {
+    glm_arena_size += CACHEALIGN(constraint_ct_max * constraint_ct_max * sizeof(double)) + CACHEALIGN(constraint_ct_max * sizeof(double));
+  }
+#ifndef NOLAPACK
+  if (pheno_d) {
+    glm_arena_size += 2 * CACHEALIGN(constraint_ct_max * param_ct_max * sizeof(double)) + CACHEALIGN(param_ct_max * indiv_valid_ct * sizeof(double)) + CACHEALIGN(perm_batch_size * indiv_valid_ct * sizeof(double)) + CACHEALIGN(g_dgels_lwork * sizeof(double));
+  } else {
+#endif
+    glm_arena_size += CACHEALIGN(perm_batch_size * param_ct_max * sizeof(double)) + 2 * CACHEALIGN(indiv_valid_ct * sizeof(double)) + 2 * CACHEALIGN(indiv_valid_ct * param_ct_max * sizeof(double));
+#ifndef NOLAPACK
+  }
+#endif
+  if (wkspace_alloc_thread_arenas(&glm_arenas, glm_arena_size, g_thread_ct)) {
+    goto glm_assoc_ret_NOMEM;
+  }
+  for (tidx = 0; tidx < g_thread_ct; tidx++) {
+    arena_ptr = thread_arena_start(&glm_arenas, tidx);
+    g_glm_mt[tidx].cur_covars_cov_major = (double*)thread_arena_alloc(&arena_ptr, param_ct_max * indiv_valid_ct * sizeof(double));
+    g_glm_mt[tidx].cur_covars_indiv_major = (double*)thread_arena_alloc(&arena_ptr, param_ct_max * indiv_valid_ct * sizeof(double));
+    g_glm_mt[tidx].perm_fails = (uintptr_t*)thread_arena_alloc(&arena_ptr, ulii * sizeof(intptr_t));
+    g_glm_mt[tidx].indiv_1d_buf = (double*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * sizeof(double));
+    g_glm_mt[tidx].param_2d_buf = (double*)thread_arena_alloc(&arena_ptr, param_ct_max * param_ct_max * sizeof(double));
+    g_glm_mt[tidx].param_2d_buf2 = (double*)thread_arena_alloc(&arena_ptr, param_ct_max * param_ct_max * sizeof(double));
+    g_glm_mt[tidx].regression_results = (double*)thread_arena_alloc(&arena_ptr, perm_batch_size * param_ctx_max_m1 * sizeof(double));
+    g_glm_mt[tidx].mi_buf = (MATRIX_INVERT_BUF1_TYPE*)thread_arena_alloc(&arena_ptr, param_ct_max * sizeof(MATRIX_INVERT_BUF1_TYPE));
     if (cluster_ct1) {
-      ulii = MAXV(cluster_ct1 + 1, param_ct_max);
-      if (wkspace_alloc_ui_checked(&(g_glm_mt[tidx].cur_indiv_to_cluster1_buf), indiv_valid_ct * sizeof(int32_t)) ||
-          wkspace_alloc_d_checked(&(g_glm_mt[tidx].cluster_param_buf), ulii * param_ct_max * sizeof(double)) ||
-          wkspace_alloc_d_checked(&(g_glm_mt[tidx].cluster_param_buf2), (cluster_ct1 + 1) * param_ct_max * sizeof(double))) {
-	goto glm_assoc_ret_NOMEM;
-      }
+      g_glm_mt[tidx].cur_indiv_to_cluster1_buf = (uint32_t*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * sizeof(int32_t));
+      g_glm_mt[tidx].cluster_param_buf = (double*)thread_arena_alloc(&arena_ptr, uljj * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].cluster_param_buf2 = (double*)thread_arena_alloc(&arena_ptr, (cluster_ct1 + 1) * param_ct_max * sizeof(double));
     }
     if (constraint_ct_max) {
-      if (wkspace_alloc_d_checked(&(g_glm_mt[tidx].df_df_buf), constraint_ct_max * constraint_ct_max * sizeof(double)) ||
-	  wkspace_alloc_d_checked(&(g_glm_mt[tidx].df_buf), constraint_ct_max * sizeof(double))) {
-	goto glm_assoc_ret_NOMEM;
-      }
+      g_glm_mt[tidx].df_df_buf = (double*)thread_arena_alloc(&arena_ptr, constraint_ct_max * constraint_ct_max * sizeof(double));
+      g_glm_mt[tidx].df_buf = (double*)thread_arena_alloc(&arena_ptr, constraint_ct_max * sizeof(double));
     }
 #ifndef NOLAPACK
     if (pheno_d) {
-      if (wkspace_alloc_d_checked(&(g_glm_mt[tidx].param_df_buf), constraint_ct_max * param_ct_max * sizeof(double)) ||
-	  wkspace_alloc_d_checked(&(g_glm_mt[tidx].param_df_buf2), constraint_ct_max * param_ct_max * sizeof(double)) ||
-	  wkspace_alloc_d_checked(&(g_glm_mt[tidx].dgels_a), param_ct_max * indiv_valid_ct * sizeof(double)) ||
-	  wkspace_alloc_d_checked(&(g_glm_mt[tidx].dgels_b), perm_batch_size * indiv_valid_ct * sizeof(double))) {
-	goto glm_assoc_ret_NOMEM;
-      }
-      if (!tidx) {
-	dgels_m = (int32_t)((uint32_t)indiv_valid_ct);
-	dgels_n = (int32_t)((uint32_t)param_ct_max);
-	dgels_nrhs = perm_batch_size;
-	dgels_ldb = dgels_m;
-	g_dgels_lwork = -1;
-	// no other parameters are needed for workspace query
-	dgels_(&dgels_trans, &dgels_m, &dgels_n, &dgels_nrhs, g_glm_mt[0].dgels_a, &dgels_m, g_glm_mt[0].dgels_b, &dgels_ldb, &dxx, &g_dgels_lwork, &dgels_info);
-	if (dxx > 2147483647.0) {
-	  logprint("Error: Multiple linear regression problem too large for current LAPACK version.\n");
-	  retval = RET_CALC_NOT_YET_SUPPORTED;
-	  goto glm_assoc_ret_1;
-	}
-	g_dgels_lwork = (int32_t)dxx;
-      }
-      if (wkspace_alloc_d_checked(&(g_glm_mt[tidx].dgels_work), g_dgels_lwork * sizeof(double))) {
-        goto glm_assoc_ret_NOMEM;
-      }
+      g_glm_mt[tidx].param_df_buf = (double*)thread_arena_alloc(&arena_ptr, constraint_ct_max * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].param_df_buf2 = (double*)thread_arena_alloc(&arena_ptr, constraint_ct_max * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].dgels_a = (double*)thread_arena_alloc(&arena_ptr, param_ct_max * indiv_valid_ct * sizeof(double));
+      g_glm_mt[tidx].dgels_b = (double*)thread_arena_alloc(&arena_ptr, perm_batch_size * indiv_valid_ct * sizeof(double));
+      g_glm_mt[tidx].dgels_work = (double*)thread_arena_alloc(&arena_ptr, g_dgels_lwork * sizeof(double));
     } else {
 #endif
-      g_pheno_d2 = NULL;
-      if (wkspace_alloc_d_checked(&g_glm_mt[tidx].logistic_coef, perm_batch_size * param_ct_max * sizeof(double)) ||
-          wkspace_alloc_d_checked(&g_glm_mt[tidx].logistic_vbuf, indiv_valid_ct * sizeof(double)) ||
-          wkspace_alloc_d_checked(&g_glm_mt[tidx].logistic_initial_t2_buf, indiv_valid_ct * param_ct_max * sizeof(double)) ||
-          wkspace_alloc_d_checked(&g_glm_mt[tidx].logistic_t2_buf, indiv_valid_ct * param_ct_max * sizeof(double)) ||
-          wkspace_alloc_d_checked(&g_glm_mt[tidx].logistic_t3_buf, indiv_valid_ct * sizeof(double))) {
-        goto glm_assoc_ret_NOMEM;
-      }
+      g_glm_mt[tidx].logistic_coef = (double*)thread_arena_alloc(&arena_ptr, perm_batch_size * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].logistic_vbuf = (double*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * sizeof(double));
+      g_glm_mt[tidx].logistic_initial_t2_buf = (double*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].logistic_t2_buf = (double*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * param_ct_max * sizeof(double));
+      g_glm_mt[tidx].logistic_t3_buf = (double*)thread_arena_alloc(&arena_ptr, indiv_valid_ct * sizeof(double));
 #ifndef NOLAPACK
     }
 #endif
   }
+  thread_arenas_touch(threads, &glm_arenas);
 
 #ifndef NOLAPACK
   if (pheno_d) {
@@ -11777,7 +11800,7 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
   }
   chrom_fo_idx = 0xffffffffU;
   marker_uidx = next_unset_unsafe(marker_exclude, 0);
-  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
     goto glm_assoc_ret_READ_FAIL;
   }
   if (!perm_pass_idx) {
@@ -11870,7 +11893,7 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
 	  next_unset_unsafe_ck(marker_exclude, &marker_uidx);
 	  marker_idx2++;
 	} while ((marker_uidx < chrom_end) && g_perm_adapt_stop[marker_idx2]);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto glm_assoc_ret_READ_FAIL;
 	}
 	if (marker_uidx >= chrom_end) {
@@ -11892,7 +11915,7 @@ int32_t glm_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  goto glm_assoc_ret_READ_FAIL;
 	}
       }
@@ -12749,7 +12772,7 @@ int32_t glm_assoc_nosnp(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset,
   for (uii = 0; uii < condition_ct; uii++) {
     if (is_set(active_params, uii + 1)) {
       marker_uidx = condition_uidxs[uii];
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto glm_assoc_nosnp_ret_READ_FAIL;
       }
       if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_indiv_ct, loadbuf_collapsed, indiv_valid_ct, load_mask, IS_SET(marker_reverse, marker_uidx))) {
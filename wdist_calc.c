@@ -70,6 +70,7 @@
 // but we believe we have beaten down the leading constant by a large enough
 // factor to meaningfully help researchers.
 
+#include <time.h>
 #include "wdist_cluster.h"
 #include "wdist_data.h"
 #include "wdist_matrix.h"
@@ -1001,7 +1002,226 @@ static inline void ld_dot_prod_batch(__m128i* vec1, __m128i* vec2, __m128i* mask
   return_vals[2] += ((acc2.u8[0] + acc2.u8[1]) * 0x1000100010001LLU) >> 48;
 }
 
+#ifdef SIMD_DISPATCH
+// AVX2 and AVX-512 versions of the three kernels above, selected at runtime
+// based on g_simd_level.  (See load_words_avx2() and friends in
+// wdist_common.h.)
+
+static inline __attribute__((target("avx2"))) uint32_t popcount_xor_1mask_multiword_avx2(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask) {
+  __m256i acc = _mm256_setzero_si256();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 4) {
+    acc = _mm256_add_epi64(acc, popcount_avx2(_mm256_and_si256(_mm256_xor_si256(load_words_avx2(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx2(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), load_words_avx2(&(mask[widx]), MULTIPLEX_2DIST / BITCT - widx))));
+  }
+  return hsum_avx2(acc);
+}
+
+static inline __attribute__((target("avx2"))) uint32_t popcount_xor_2mask_multiword_avx2(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask1, uintptr_t* mask2) {
+  __m256i acc = _mm256_setzero_si256();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 4) {
+    acc = _mm256_add_epi64(acc, popcount_avx2(_mm256_and_si256(_mm256_xor_si256(load_words_avx2(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx2(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), _mm256_and_si256(load_words_avx2(&(mask1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx2(&(mask2[widx]), MULTIPLEX_2DIST / BITCT - widx)))));
+  }
+  return hsum_avx2(acc);
+}
+
+static __attribute__((target("avx2"))) int32_t* incr_dists_row_avx2(int32_t* idists, uintptr_t* glptr, uintptr_t* glptr2, uintptr_t* mptr, uintptr_t* mcptr_start, uintptr_t mask_fixed) {
+  if (~mask_fixed) {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_2mask_multiword_avx2(glptr, glptr2, mptr, mcptr_start);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  } else {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_1mask_multiword_avx2(glptr, glptr2, mptr);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  }
+  return idists;
+}
+
+static __attribute__((target("avx2"))) void ld_dot_prod_avx2(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uintptr_t word_ct) {
+  // same decomposition as ld_dot_prod_batch(), but the 64-bit partial sums
+  // can't overflow, so there's no need to split the work into batches
+  const __m256i m1 = _mm256_set1_epi64x(FIVEMASK);
+  __m256i acc = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  __m256i acc2 = _mm256_setzero_si256();
+  __m256i loader1;
+  __m256i loader2;
+  __m256i sum12;
+  uintptr_t widx;
+  for (widx = 0; widx < word_ct; widx += 4) {
+    loader1 = load_words_avx2(&(vec1[widx]), word_ct - widx);
+    loader2 = load_words_avx2(&(vec2[widx]), word_ct - widx);
+    acc1 = _mm256_add_epi64(acc1, popcount2_avx2(_mm256_and_si256(load_words_avx2(&(mask2[widx]), word_ct - widx), loader1)));
+    acc2 = _mm256_add_epi64(acc2, popcount2_avx2(_mm256_and_si256(load_words_avx2(&(mask1[widx]), word_ct - widx), loader2)));
+    sum12 = _mm256_and_si256(_mm256_or_si256(loader1, loader2), m1);
+    sum12 = _mm256_or_si256(sum12, _mm256_andnot_si256(_mm256_add_epi64(m1, sum12), _mm256_xor_si256(loader1, loader2)));
+    acc = _mm256_add_epi64(acc, popcount2_avx2(sum12));
+  }
+  return_vals[0] -= hsum_avx2(acc);
+  return_vals[1] += hsum_avx2(acc1);
+  return_vals[2] += hsum_avx2(acc2);
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) uint32_t popcount_xor_1mask_multiword_avx512(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask) {
+  __m512i acc = _mm512_setzero_si512();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 8) {
+    acc = _mm512_add_epi64(acc, popcount_avx512(_mm512_and_si512(_mm512_xor_si512(load_words_avx512(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), load_words_avx512(&(mask[widx]), MULTIPLEX_2DIST / BITCT - widx))));
+  }
+  return hsum_avx512(acc);
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) uint32_t popcount_xor_2mask_multiword_avx512(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask1, uintptr_t* mask2) {
+  __m512i acc = _mm512_setzero_si512();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 8) {
+    acc = _mm512_add_epi64(acc, popcount_avx512(_mm512_and_si512(_mm512_xor_si512(load_words_avx512(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), _mm512_and_si512(load_words_avx512(&(mask1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(mask2[widx]), MULTIPLEX_2DIST / BITCT - widx)))));
+  }
+  return hsum_avx512(acc);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) int32_t* incr_dists_row_avx512(int32_t* idists, uintptr_t* glptr, uintptr_t* glptr2, uintptr_t* mptr, uintptr_t* mcptr_start, uintptr_t mask_fixed) {
+  if (~mask_fixed) {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_2mask_multiword_avx512(glptr, glptr2, mptr, mcptr_start);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  } else {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_1mask_multiword_avx512(glptr, glptr2, mptr);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  }
+  return idists;
+}
+
+static __attribute__((target("avx512f,avx512bw"))) void ld_dot_prod_avx512(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uintptr_t word_ct) {
+  const __m512i m1 = _mm512_set1_epi64(FIVEMASK);
+  __m512i acc = _mm512_setzero_si512();
+  __m512i acc1 = _mm512_setzero_si512();
+  __m512i acc2 = _mm512_setzero_si512();
+  __m512i loader1;
+  __m512i loader2;
+  __m512i sum12;
+  uintptr_t widx;
+  for (widx = 0; widx < word_ct; widx += 8) {
+    loader1 = load_words_avx512(&(vec1[widx]), word_ct - widx);
+    loader2 = load_words_avx512(&(vec2[widx]), word_ct - widx);
+    acc1 = _mm512_add_epi64(acc1, popcount2_avx512(_mm512_and_si512(load_words_avx512(&(mask2[widx]), word_ct - widx), loader1)));
+    acc2 = _mm512_add_epi64(acc2, popcount2_avx512(_mm512_and_si512(load_words_avx512(&(mask1[widx]), word_ct - widx), loader2)));
+    sum12 = _mm512_and_si512(_mm512_or_si512(loader1, loader2), m1);
+    sum12 = _mm512_or_si512(sum12, andnot_avx512(_mm512_add_epi64(m1, sum12), _mm512_xor_si512(loader1, loader2)));
+    acc = _mm512_add_epi64(acc, popcount2_avx512(sum12));
+  }
+  return_vals[0] -= hsum_avx512(acc);
+  return_vals[1] += hsum_avx512(acc1);
+  return_vals[2] += hsum_avx512(acc2);
+}
+
+#ifdef SIMD_VPOPCNT
+// VPOPCNTQ versions.  A 2-bit-integer sum is popcount(v) + popcount(v & 0xaaaa...).
+static inline __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) uint32_t popcount_xor_1mask_multiword_vpopcnt(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask) {
+  __m512i acc = _mm512_setzero_si512();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 8) {
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_xor_si512(load_words_avx512(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), load_words_avx512(&(mask[widx]), MULTIPLEX_2DIST / BITCT - widx))));
+  }
+  return hsum_avx512(acc);
+}
+
+static inline __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) uint32_t popcount_xor_2mask_multiword_vpopcnt(uintptr_t* xor1, uintptr_t* xor2, uintptr_t* mask1, uintptr_t* mask2) {
+  __m512i acc = _mm512_setzero_si512();
+  uint32_t widx;
+  for (widx = 0; widx < MULTIPLEX_2DIST / BITCT; widx += 8) {
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_xor_si512(load_words_avx512(&(xor1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(xor2[widx]), MULTIPLEX_2DIST / BITCT - widx)), _mm512_and_si512(load_words_avx512(&(mask1[widx]), MULTIPLEX_2DIST / BITCT - widx), load_words_avx512(&(mask2[widx]), MULTIPLEX_2DIST / BITCT - widx)))));
+  }
+  return hsum_avx512(acc);
+}
+
+static inline __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) __m512i popcount2_vpopcnt(__m512i vv) {
+  return _mm512_add_epi64(_mm512_popcnt_epi64(vv), _mm512_popcnt_epi64(_mm512_and_si512(vv, _mm512_set1_epi64(AAAAMASK))));
+}
+
+static __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) int32_t* incr_dists_row_vpopcnt(int32_t* idists, uintptr_t* glptr, uintptr_t* glptr2, uintptr_t* mptr, uintptr_t* mcptr_start, uintptr_t mask_fixed) {
+  if (~mask_fixed) {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_2mask_multiword_vpopcnt(glptr, glptr2, mptr, mcptr_start);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  } else {
+    while (glptr < glptr2) {
+      *idists++ += popcount_xor_1mask_multiword_vpopcnt(glptr, glptr2, mptr);
+      glptr = &(glptr[MULTIPLEX_2DIST / BITCT]);
+      mptr = &(mptr[MULTIPLEX_2DIST / BITCT]);
+    }
+  }
+  return idists;
+}
+
+static __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) void ld_dot_prod_vpopcnt(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uintptr_t word_ct) {
+  const __m512i m1 = _mm512_set1_epi64(FIVEMASK);
+  __m512i acc = _mm512_setzero_si512();
+  __m512i acc1 = _mm512_setzero_si512();
+  __m512i acc2 = _mm512_setzero_si512();
+  __m512i loader1;
+  __m512i loader2;
+  __m512i sum12;
+  uintptr_t widx;
+  for (widx = 0; widx < word_ct; widx += 8) {
+    loader1 = load_words_avx512(&(vec1[widx]), word_ct - widx);
+    loader2 = load_words_avx512(&(vec2[widx]), word_ct - widx);
+    acc1 = _mm512_add_epi64(acc1, popcount2_vpopcnt(_mm512_and_si512(load_words_avx512(&(mask2[widx]), word_ct - widx), loader1)));
+    acc2 = _mm512_add_epi64(acc2, popcount2_vpopcnt(_mm512_and_si512(load_words_avx512(&(mask1[widx]), word_ct - widx), loader2)));
+    sum12 = _mm512_and_si512(_mm512_or_si512(loader1, loader2), m1);
+    sum12 = _mm512_or_si512(sum12, andnot_avx512(_mm512_add_epi64(m1, sum12), _mm512_xor_si512(loader1, loader2)));
+    acc = _mm512_add_epi64(acc, popcount2_vpopcnt(sum12));
+  }
+  return_vals[0] -= hsum_avx512(acc);
+  return_vals[1] += hsum_avx512(acc1);
+  return_vals[2] += hsum_avx512(acc2);
+}
+#endif
+
+static inline int32_t* incr_dists_row_simd(int32_t* idists, uintptr_t* glptr, uintptr_t* glptr2, uintptr_t* mptr, uintptr_t* mcptr_start, uintptr_t mask_fixed) {
+#ifdef SIMD_VPOPCNT
+  if (g_simd_level == SIMD_LEVEL_AVX512_VPOPCNT) {
+    return incr_dists_row_vpopcnt(idists, glptr, glptr2, mptr, mcptr_start, mask_fixed);
+  }
+#endif
+  if (g_simd_level >= SIMD_LEVEL_AVX512) {
+    return incr_dists_row_avx512(idists, glptr, glptr2, mptr, mcptr_start, mask_fixed);
+  }
+  return incr_dists_row_avx2(idists, glptr, glptr2, mptr, mcptr_start, mask_fixed);
+}
+#endif
+
 void ld_dot_prod(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uint32_t batch_ct_m1, uint32_t last_batch_size) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level != SIMD_LEVEL_SSE2) {
+    // each 48-byte window is 6 words
+    uintptr_t word_ct = (((uintptr_t)batch_ct_m1) * (MULTIPLEX_LD / 192) + last_batch_size) * 6;
+#ifdef SIMD_VPOPCNT
+    if (g_simd_level == SIMD_LEVEL_AVX512_VPOPCNT) {
+      ld_dot_prod_vpopcnt(vec1, vec2, mask1, mask2, return_vals, word_ct);
+      return;
+    }
+#endif
+    if (g_simd_level == SIMD_LEVEL_AVX512) {
+      ld_dot_prod_avx512(vec1, vec2, mask1, mask2, return_vals, word_ct);
+    } else {
+      ld_dot_prod_avx2(vec1, vec2, mask1, mask2, return_vals, word_ct);
+    }
+    return;
+  }
+#endif
   while (batch_ct_m1--) {
     ld_dot_prod_batch((__m128i*)vec1, (__m128i*)vec2, (__m128i*)mask1, (__m128i*)mask2, return_vals, MULTIPLEX_LD / 192);
     vec1 = &(vec1[MULTIPLEX_LD / BITCT2]);
@@ -1247,6 +1467,419 @@ static uintptr_t g_perm_ct;
 static double g_half_marker_ct_recip;
 static uint32_t g_load_dists;
 
+// ----- background marker block loading -----
+// calc_distance(), calc_rel(), calc_rel_f(), and calc_genome() stream the .bed
+// file in fixed-size marker blocks.  When there is room for a second raw
+// block buffer, the next block is read on its own thread while the main
+// thread unpacks the current one and the worker threads process it;
+// otherwise, block_load_finish() just reads synchronously.
+static FILE* g_bl_bedfile;
+static uintptr_t g_bl_bed_offset;
+static uintptr_t* g_bl_marker_exclude;
+static uint32_t g_bl_marker_ct;
+static uint32_t g_bl_block_max;
+static uintptr_t g_bl_unfiltered_indiv_ct4;
+static Chrom_info* g_bl_chrom_info_ptr;
+static double* g_bl_set_allele_freqs;
+static uint32_t* g_bl_marker_weights;
+static uint32_t g_bl_is_genome;
+static uint32_t g_bl_chrom_fo_idx;
+static uint32_t g_bl_chrom_end;
+static uintptr_t g_bl_marker_uidx;
+static uintptr_t g_bl_marker_idx;
+static unsigned char* g_bl_bufs[2];
+static double* g_bl_freq_bufs[2];
+static float* g_bl_freq_bufs_fl[2];
+static uint32_t* g_bl_wtbufs[2];
+static uint32_t* g_bl_uidx_bufs[2];
+static uint32_t g_bl_block_sizes[2];
+static uint32_t g_bl_fill_idx;
+static uint32_t g_bl_async;
+static uint32_t g_bl_pending;
+static int32_t g_bl_retval;
+static pthread_t g_bl_thread;
+// loader position after the most recently finished block, for --checkpoint
+static uintptr_t g_bl_saved_marker_uidx;
+static uintptr_t g_bl_saved_marker_idx;
+static uint32_t g_bl_saved_chrom_fo_idx;
+static uint32_t g_bl_saved_chrom_end;
+
+int32_t genome_block_load(unsigned char* loadbuf, double* set_allele_freq_buf, uint32_t* uidx_buf, uint32_t* block_size_ptr) {
+  // Same marker traversal as block_load_autosomal(), except that haploid
+  // chromosomes are skipped and raw marker indices are saved for the PPC
+  // gap precomputation.
+  FILE* bedfile = g_bl_bedfile;
+  uintptr_t unfiltered_indiv_ct4 = g_bl_unfiltered_indiv_ct4;
+  uintptr_t* marker_exclude = g_bl_marker_exclude;
+  Chrom_info* chrom_info_ptr = g_bl_chrom_info_ptr;
+  uintptr_t marker_uidx = g_bl_marker_uidx;
+  uint32_t chrom_fo_idx = g_bl_chrom_fo_idx;
+  uint32_t chrom_end = g_bl_chrom_end;
+  uint32_t block_size = g_bl_marker_ct - g_bl_marker_idx;
+  uint32_t is_x;
+  uint32_t is_y;
+  uint32_t is_haploid;
+  uint32_t ujj;
+  if (block_size > g_bl_block_max) {
+    block_size = g_bl_block_max;
+  }
+  for (ujj = 0; ujj < block_size; ujj++) {
+    if (IS_SET(marker_exclude, marker_uidx)) {
+      marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
+      if (bed_seek(bedfile, g_bl_bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
+	return RET_READ_FAIL;
+      }
+    }
+    if (marker_uidx >= chrom_end) {
+      while (1) {
+	chrom_fo_idx++;
+	refresh_chrom_info(chrom_info_ptr, marker_uidx, 1, 0, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_haploid);
+	if (!is_haploid) {
+	  break;
+	}
+	marker_uidx = next_unset_ul_unsafe(marker_exclude, chrom_end);
+	if (bed_seek(bedfile, g_bl_bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
+	  return RET_READ_FAIL;
+	}
+      }
+    }
+    if (bed_fread(&(loadbuf[ujj * unfiltered_indiv_ct4]), unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+      return RET_READ_FAIL;
+    }
+    set_allele_freq_buf[ujj] = g_bl_set_allele_freqs[marker_uidx];
+    uidx_buf[ujj] = marker_uidx;
+    marker_uidx++;
+  }
+  g_bl_marker_uidx = marker_uidx;
+  g_bl_chrom_fo_idx = chrom_fo_idx;
+  g_bl_chrom_end = chrom_end;
+  g_bl_marker_idx += block_size;
+  *block_size_ptr = block_size;
+  return 0;
+}
+
+void block_load_fill() {
+  uint32_t fill_idx = g_bl_fill_idx;
+  if (g_bl_is_genome) {
+    g_bl_retval = genome_block_load(g_bl_bufs[fill_idx], g_bl_freq_bufs[fill_idx], g_bl_uidx_bufs[fill_idx], &(g_bl_block_sizes[fill_idx]));
+  } else {
+    g_bl_retval = block_load_autosomal(g_bl_bedfile, g_bl_bed_offset, g_bl_marker_exclude, g_bl_marker_ct, g_bl_block_max, g_bl_unfiltered_indiv_ct4, g_bl_chrom_info_ptr, g_bl_set_allele_freqs, g_bl_marker_weights, g_bl_bufs[fill_idx], &g_bl_chrom_fo_idx, &g_bl_marker_uidx, &g_bl_marker_idx, &(g_bl_block_sizes[fill_idx]), g_bl_freq_bufs[fill_idx], g_bl_freq_bufs_fl[fill_idx], g_bl_wtbufs[fill_idx]);
+  }
+}
+
+THREAD_RET_TYPE block_load_thread(void* arg) {
+  block_load_fill();
+  THREAD_RETURN;
+}
+
+void block_load_init(FILE* bedfile, uintptr_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct, uint32_t block_max, uintptr_t unfiltered_indiv_ct4, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_weights, uint32_t is_genome) {
+  // Assumes the file pointer is already positioned at the first marker, if
+  // that marker isn't excluded.
+  uint32_t is_x;
+  uint32_t is_y;
+  uint32_t is_haploid;
+  g_bl_bedfile = bedfile;
+  g_bl_bed_offset = bed_offset;
+  g_bl_marker_exclude = marker_exclude;
+  g_bl_marker_ct = marker_ct;
+  g_bl_block_max = block_max;
+  g_bl_unfiltered_indiv_ct4 = unfiltered_indiv_ct4;
+  g_bl_chrom_info_ptr = chrom_info_ptr;
+  g_bl_set_allele_freqs = set_allele_freqs;
+  g_bl_marker_weights = marker_weights;
+  g_bl_is_genome = is_genome;
+  g_bl_chrom_fo_idx = 0;
+  g_bl_marker_uidx = 0;
+  g_bl_marker_idx = 0;
+  if (is_genome) {
+    refresh_chrom_info(chrom_info_ptr, 0, 1, 0, &g_bl_chrom_end, &g_bl_chrom_fo_idx, &is_x, &is_y, &is_haploid);
+  }
+  g_bl_bufs[1] = NULL;
+  g_bl_fill_idx = 0;
+  g_bl_async = 0;
+  g_bl_pending = 0;
+}
+
+void block_load_set_buf(uint32_t buf_idx, unsigned char* readbuf, double* freq_buf, float* freq_buf_fl, uint32_t* wtbuf, uint32_t* uidx_buf) {
+  // the second buffer set is optional; providing it enables read-ahead
+  g_bl_bufs[buf_idx] = readbuf;
+  g_bl_freq_bufs[buf_idx] = freq_buf;
+  g_bl_freq_bufs_fl[buf_idx] = freq_buf_fl;
+  g_bl_wtbufs[buf_idx] = wtbuf;
+  g_bl_uidx_bufs[buf_idx] = uidx_buf;
+  g_bl_async = (g_bl_bufs[1] != NULL);
+}
+
+int32_t block_load_start() {
+  // Begins loading the next block into the free buffer.  In synchronous mode,
+  // the read is deferred to block_load_finish() so that the block currently
+  // being processed isn't clobbered.
+  if (g_bl_async) {
+    if (spawn_threads(&g_bl_thread, &block_load_thread, 2)) {
+      return RET_THREAD_CREATE_FAIL;
+    }
+  }
+  g_bl_pending = 1;
+  return 0;
+}
+
+int32_t block_load_finish(uint32_t* buf_idx_ptr, uint32_t* block_size_ptr) {
+  uint32_t fill_idx = g_bl_fill_idx;
+  if (g_bl_async) {
+    join_threads(&g_bl_thread, 2);
+  } else {
+    block_load_fill();
+  }
+  g_bl_pending = 0;
+  g_bl_saved_marker_uidx = g_bl_marker_uidx;
+  g_bl_saved_marker_idx = g_bl_marker_idx;
+  g_bl_saved_chrom_fo_idx = g_bl_chrom_fo_idx;
+  g_bl_saved_chrom_end = g_bl_chrom_end;
+  *buf_idx_ptr = fill_idx;
+  *block_size_ptr = g_bl_block_sizes[fill_idx];
+  g_bl_fill_idx = fill_idx ^ g_bl_async;
+  return g_bl_retval;
+}
+
+void block_load_cleanup() {
+  // call on every exit path after block_load_start(), since an outstanding
+  // read may still be writing into workspace memory
+  if (g_bl_pending && g_bl_async) {
+    join_threads(&g_bl_thread, 2);
+  }
+  g_bl_pending = 0;
+}
+
+// ----- --checkpoint/--resume -----
+// Between marker blocks, the state of calc_distance(), calc_rel(),
+// calc_rel_f() and calc_genome() is fully described by their accumulators
+// plus the block loader position.  Every --checkpoint interval, this is
+// written to {output name}.ckpt; the write goes through a temporary file and
+// a rename, so preemption mid-write never clobbers the previous checkpoint.
+// --resume continues from that file when it exists and matches the current
+// run.
+#define CKPT_MAGIC "WDCKPT01"
+#define CKPT_MAX_ARRAYS 12
+
+#define CKPT_CALC_DISTANCE 1
+#define CKPT_CALC_REL 2
+#define CKPT_CALC_REL_F 3
+#define CKPT_CALC_GENOME 4
+
+typedef struct {
+  uint32_t version;
+  uint32_t calc_code;
+  uint32_t indiv_ct;
+  uint32_t row_start;
+  uint32_t row_end;
+  uint32_t array_ct;
+  uint64_t setup_hash;
+  uint64_t bl_marker_uidx;
+  uint64_t bl_marker_idx;
+  uint32_t bl_chrom_fo_idx;
+  uint32_t bl_chrom_end;
+} Ckpt_header;
+
+static uint32_t g_ckpt_interval; // in seconds; 0 = no checkpoints
+static uint32_t g_ckpt_resume;
+static uint32_t g_ckpt_exists;
+static time_t g_ckpt_last;
+static char g_ckpt_fname[FNAMESIZE];
+static char g_ckpt_tmpname[FNAMESIZE + 4];
+static Ckpt_header g_ckpt_hdr;
+static void* g_ckpt_ptrs[CKPT_MAX_ARRAYS];
+static uintptr_t g_ckpt_sizes[CKPT_MAX_ARRAYS];
+
+void checkpoint_init(uint32_t interval_secs, uint32_t resume) {
+  g_ckpt_interval = interval_secs;
+  g_ckpt_resume = resume;
+}
+
+uint64_t ckpt_hash(uint64_t hash, const void* data, uintptr_t byte_ct) {
+  // FNV-1a
+  const unsigned char* ucptr = (const unsigned char*)data;
+  const unsigned char* ucptr_end = &(ucptr[byte_ct]);
+  while (ucptr < ucptr_end) {
+    hash = (hash ^ (*ucptr++)) * 0x100000001b3LLU;
+  }
+  return hash;
+}
+
+uint64_t ckpt_setup_hash(uintptr_t* marker_exclude, uint32_t marker_ct, double* set_allele_freqs, uintptr_t* indiv_exclude, uint64_t calc_flags) {
+  // fingerprint of everything besides the .bed contents that the
+  // accumulators depend on
+  uint64_t hash = 0xcbf29ce484222325LLU;
+  uintptr_t marker_uidx = 0;
+  uintptr_t indiv_uidx = 0;
+  uint32_t marker_idx;
+  uint32_t indiv_idx;
+  hash = ckpt_hash(hash, &calc_flags, sizeof(int64_t));
+  for (marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
+    next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
+    hash = ckpt_hash(hash, &marker_uidx, sizeof(intptr_t));
+    if (set_allele_freqs) {
+      hash = ckpt_hash(hash, &(set_allele_freqs[marker_uidx]), sizeof(double));
+    }
+  }
+  for (indiv_idx = 0; indiv_idx < g_indiv_ct; indiv_uidx++, indiv_idx++) {
+    next_unset_ul_unsafe_ck(indiv_exclude, &indiv_uidx);
+    hash = ckpt_hash(hash, &indiv_uidx, sizeof(intptr_t));
+  }
+  return hash;
+}
+
+void ckpt_begin(char* outname, char* outname_end, const char* ext, uint32_t calc_code, uint64_t setup_hash, uint32_t parallel_idx, uint32_t parallel_tot) {
+  // call after g_thread_start[] is filled
+  char* fname_end = memcpya(g_ckpt_fname, outname, (uintptr_t)(outname_end - outname));
+  if (parallel_tot > 1) {
+    sprintf(fname_end, "%s.ckpt.%u", ext, parallel_idx + 1);
+  } else {
+    sprintf(fname_end, "%s.ckpt", ext);
+  }
+  memcpy(memcpya(g_ckpt_tmpname, g_ckpt_fname, strlen(g_ckpt_fname)), ".tmp", 5);
+  g_ckpt_hdr.version = 1;
+  g_ckpt_hdr.calc_code = calc_code;
+  g_ckpt_hdr.indiv_ct = g_indiv_ct;
+  g_ckpt_hdr.row_start = g_thread_start[0];
+  g_ckpt_hdr.row_end = g_thread_start[g_thread_ct];
+  g_ckpt_hdr.array_ct = 0;
+  g_ckpt_hdr.setup_hash = setup_hash;
+  g_ckpt_exists = 0;
+  g_ckpt_last = time(NULL);
+}
+
+void ckpt_reg(void* ptr, uintptr_t byte_ct) {
+  g_ckpt_ptrs[g_ckpt_hdr.array_ct] = ptr;
+  g_ckpt_sizes[g_ckpt_hdr.array_ct++] = byte_ct;
+}
+
+int32_t ckpt_resume(uintptr_t* marker_idx_ptr) {
+  // Call after the accumulators are registered and zeroed, and before the
+  // first block_load_start().  Restores the accumulators and moves the block
+  // loader to the first unprocessed marker.
+  FILE* infile = NULL;
+  int32_t retval = 0;
+  Ckpt_header hdr;
+  uint64_t array_size;
+  uint32_t array_idx;
+  if (!g_ckpt_resume) {
+    return 0;
+  }
+  infile = fopen(g_ckpt_fname, "rb");
+  if (!infile) {
+    sprintf(logbuf, "--resume: No checkpoint at %s; starting from the beginning.\n", g_ckpt_fname);
+    logprintb();
+    return 0;
+  }
+  if ((fread(tbuf, 1, 8, infile) < 8) || memcmp(tbuf, CKPT_MAGIC, 8) || (fread(&hdr, sizeof(Ckpt_header), 1, infile) < 1) || (hdr.version != 1)) {
+    sprintf(logbuf, "Error: %s is not a checkpoint file.\n", g_ckpt_fname);
+    goto ckpt_resume_ret_INVALID_FORMAT_2;
+  }
+  if ((hdr.calc_code != g_ckpt_hdr.calc_code) || (hdr.indiv_ct != g_ckpt_hdr.indiv_ct) || (hdr.row_start != g_ckpt_hdr.row_start) || (hdr.row_end != g_ckpt_hdr.row_end) || (hdr.array_ct != g_ckpt_hdr.array_ct) || (hdr.setup_hash != g_ckpt_hdr.setup_hash)) {
+    goto ckpt_resume_ret_MISMATCH;
+  }
+  for (array_idx = 0; array_idx < hdr.array_ct; array_idx++) {
+    if (fread(&array_size, sizeof(int64_t), 1, infile) < 1) {
+      goto ckpt_resume_ret_READ_FAIL;
+    }
+    if (array_size != g_ckpt_sizes[array_idx]) {
+      goto ckpt_resume_ret_MISMATCH;
+    }
+    if (fread(g_ckpt_ptrs[array_idx], 1, array_size, infile) < array_size) {
+      goto ckpt_resume_ret_READ_FAIL;
+    }
+  }
+  if (bed_seek(g_bl_bedfile, g_bl_bed_offset + hdr.bl_marker_uidx * g_bl_unfiltered_indiv_ct4)) {
+    goto ckpt_resume_ret_READ_FAIL;
+  }
+  g_bl_marker_uidx = hdr.bl_marker_uidx;
+  g_bl_marker_idx = hdr.bl_marker_idx;
+  g_bl_chrom_fo_idx = hdr.bl_chrom_fo_idx;
+  g_bl_chrom_end = hdr.bl_chrom_end;
+  *marker_idx_ptr = hdr.bl_marker_idx;
+  g_ckpt_exists = 1;
+  sprintf(logbuf, "Resuming from %s (%" PRIu64 " of %u markers already processed).\n", g_ckpt_fname, hdr.bl_marker_idx, g_bl_marker_ct);
+  logprintb();
+  while (0) {
+  ckpt_resume_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  ckpt_resume_ret_MISMATCH:
+    sprintf(logbuf, "Error: %s was written by a run with different input, filters, or\noptions.  Delete it to start over.\n", g_ckpt_fname);
+  ckpt_resume_ret_INVALID_FORMAT_2:
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+  fclose(infile);
+  return retval;
+}
+
+void ckpt_save_cond() {
+  // Call after a marker block is fully processed.  Failure to write a
+  // checkpoint is not fatal.
+  FILE* outfile = NULL;
+  uint64_t array_size;
+  uint32_t array_idx;
+  time_t cur_time;
+  if ((!g_ckpt_interval) || (g_bl_saved_marker_idx >= g_bl_marker_ct)) {
+    return;
+  }
+  cur_time = time(NULL);
+  if (cur_time - g_ckpt_last < (time_t)g_ckpt_interval) {
+    return;
+  }
+  g_ckpt_hdr.bl_marker_uidx = g_bl_saved_marker_uidx;
+  g_ckpt_hdr.bl_marker_idx = g_bl_saved_marker_idx;
+  g_ckpt_hdr.bl_chrom_fo_idx = g_bl_saved_chrom_fo_idx;
+  g_ckpt_hdr.bl_chrom_end = g_bl_saved_chrom_end;
+  outfile = fopen(g_ckpt_tmpname, "wb");
+  if (!outfile) {
+    goto ckpt_save_cond_ret_FAIL;
+  }
+  if (fwrite_checked(CKPT_MAGIC, 8, outfile) ||
+      fwrite_checked(&g_ckpt_hdr, sizeof(Ckpt_header), outfile)) {
+    goto ckpt_save_cond_ret_FAIL;
+  }
+  for (array_idx = 0; array_idx < g_ckpt_hdr.array_ct; array_idx++) {
+    array_size = g_ckpt_sizes[array_idx];
+    if (fwrite_checked(&array_size, sizeof(int64_t), outfile) ||
+	fwrite_checked(g_ckpt_ptrs[array_idx], array_size, outfile)) {
+      goto ckpt_save_cond_ret_FAIL;
+    }
+  }
+  if (fclose_null(&outfile)) {
+    goto ckpt_save_cond_ret_FAIL;
+  }
+#ifdef _WIN32
+  // rename() doesn't replace existing files here
+  unlink(g_ckpt_fname);
+#endif
+  if (rename(g_ckpt_tmpname, g_ckpt_fname)) {
+    goto ckpt_save_cond_ret_FAIL;
+  }
+  g_ckpt_exists = 1;
+  sprintf(logbuf, "Checkpoint written to %s (%" PRIuPTR " markers processed).\n", g_ckpt_fname, g_bl_saved_marker_idx);
+  logstr(logbuf);
+  while (0) {
+  ckpt_save_cond_ret_FAIL:
+    fclose_cond(outfile);
+    unlink(g_ckpt_tmpname);
+    sprintf(logbuf, "\nWarning: Failed to write checkpoint %s.\n", g_ckpt_fname);
+    logprintb();
+    break;
+  }
+  g_ckpt_last = time(NULL);
+}
+
+void ckpt_finish() {
+  // call once the calculation's output has been written
+  if (g_ckpt_exists) {
+    unlink(g_ckpt_fname);
+    g_ckpt_exists = 0;
+  }
+}
+
 void ibs_test_init_col_buf(uintptr_t row_idx, uintptr_t* perm_col_buf) {
   uintptr_t perm_idx = 0;
   uintptr_t block_size = BITCT;
@@ -1475,6 +2108,12 @@ void incr_dists_i(int32_t* idists, uintptr_t* geno, int32_t tidx) {
       mask_fixed &= *lptr++;
     }
     mptr = (__m128i*)g_masks;
+#ifdef SIMD_DISPATCH
+    if (g_simd_level != SIMD_LEVEL_SSE2) {
+      idists = incr_dists_row_simd(idists, geno, (uintptr_t*)glptr2, g_masks, (uintptr_t*)mcptr_start, mask_fixed);
+      continue;
+    }
+#endif
 #else
     glptr = geno;
     glptr2 = &(geno[jj]);
@@ -1508,7 +2147,19 @@ THREAD_RET_TYPE calc_idist_thread(void* arg) {
   THREAD_RETURN;
 }
 
-void incr_genome(uint32_t* genome_main, uintptr_t* geno, uint32_t tidx) {
+// --genome pair tiles.  All rows of a tile are compared against the same
+// column block of partner genotypes and masks (GENOME_TILE_COLS * 576 bytes,
+// about 300 KB), so that block stays in L2 instead of being streamed from
+// memory once per row.  Tiles are handed out through a shared counter.
+#define GENOME_TILE_ROWS 64
+#define GENOME_TILE_COLS 512
+
+static uint32_t* g_genome_tile_starts; // first tile index of each row block
+static uint32_t g_genome_tile_ct;
+static volatile uint32_t g_genome_next_tile;
+
+void incr_genome(uintptr_t* geno, uint32_t row_start, uint32_t row_end, uint32_t col_start, uint32_t col_end) {
+  uint32_t* genome_main;
 #ifdef __LP64__
   const __m128i m1 = {FIVEMASK, FIVEMASK};
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
@@ -1556,6 +2207,8 @@ void incr_genome(uint32_t* genome_main, uintptr_t* geno, uint32_t tidx) {
 #endif
   uintptr_t* glptr_back;
   uintptr_t ibs_incr;
+  uint32_t row_offset = g_thread_start[0];
+  uint32_t col_first;
   uint32_t uii;
   uint32_t ujj;
   int32_t offset;
@@ -1567,17 +2220,23 @@ void incr_genome(uint32_t* genome_main, uintptr_t* geno, uint32_t tidx) {
   int32_t lowct2 = g_ctrl_ct * 2;
   int32_t highct2 = g_case_ct * 2;
 #ifdef __LP64__
-  glptr_end = (__m128i*)(&(geno[g_indiv_ct * (GENOME_MULTIPLEX2 / BITCT)]));
+  glptr_end = (__m128i*)(&(geno[col_end * (GENOME_MULTIPLEX2 / BITCT)]));
 #else
-  glptr_end = &(geno[g_indiv_ct * (GENOME_MULTIPLEX2 / BITCT)]);
+  glptr_end = &(geno[col_end * (GENOME_MULTIPLEX2 / BITCT)]);
 #endif
-  for (uii = g_thread_start[tidx]; uii < g_thread_start[tidx + 1]; uii++) {
+  for (uii = row_start; uii < row_end; uii++) {
+    col_first = (col_start > uii)? col_start : (uii + 1);
+    if (col_first >= col_end) {
+      continue;
+    }
+    // row uii's cells start at f(uii) - f(row_offset); see calc_genome()
+    genome_main = &(g_genome_main[((int64_t)g_indiv_ct * (uii - row_offset) - ((int64_t)uii * (uii + 1) - (int64_t)row_offset * (row_offset + 1)) / 2 + (col_first - uii - 1)) * 5]);
     ujj = uii * (GENOME_MULTIPLEX2 / BITCT);
 #ifdef __LP64__
     glptr_fixed = (__m128i*)(&(geno[ujj]));
-    glptr = (__m128i*)(&(geno[ujj + (GENOME_MULTIPLEX2 / BITCT)]));
+    glptr = (__m128i*)(&(geno[col_first * (GENOME_MULTIPLEX2 / BITCT)]));
     lptr = &(g_masks[ujj]);
-    maskptr = (__m128i*)(&(g_masks[ujj + (GENOME_MULTIPLEX2 / BITCT)]));
+    maskptr = (__m128i*)(&(g_masks[col_first * (GENOME_MULTIPLEX2 / BITCT)]));
     maskptr_fixed = (__m128i*)lptr;
     mask_fixed_test = *lptr++;
     for (ujj = 0; ujj < GENOME_MULTIPLEX2 / BITCT - 1; ujj++) {
@@ -1585,13 +2244,14 @@ void incr_genome(uint32_t* genome_main, uintptr_t* geno, uint32_t tidx) {
     }
 #else
     glptr_fixed = &(geno[ujj]);
-    glptr = &(geno[ujj + (GENOME_MULTIPLEX2 / BITCT)]);
+    glptr = &(geno[col_first * (GENOME_MULTIPLEX2 / BITCT)]);
     maskptr_fixed = &(g_masks[ujj]);
     maskptr = maskptr_fixed;
     mask_fixed_test = *maskptr++;
     for (ujj = 0; ujj < GENOME_MULTIPLEX2 / BITCT - 1; ujj++) {
       mask_fixed_test &= *maskptr++;
     }
+    maskptr = &(g_masks[col_first * (GENOME_MULTIPLEX2 / BITCT)]);
 #endif
     if (~mask_fixed_test) {
       while (glptr < glptr_end) {
@@ -1894,11 +2554,55 @@ void incr_genome(uint32_t* genome_main, uintptr_t* geno, uint32_t tidx) {
   }
 }
 
+void genome_tile_init(uint32_t row_start, uint32_t row_block_ct) {
+  // row block i covers rows [row_start + i * GENOME_TILE_ROWS, ...), and only
+  // needs the column blocks that reach past its first row
+  uint32_t col_block_ct = (g_indiv_ct + GENOME_TILE_COLS - 1) / GENOME_TILE_COLS;
+  uint32_t tile_ct = 0;
+  uint32_t row_block_idx;
+  for (row_block_idx = 0; row_block_idx < row_block_ct; row_block_idx++) {
+    g_genome_tile_starts[row_block_idx] = tile_ct;
+    tile_ct += col_block_ct - (row_start + row_block_idx * GENOME_TILE_ROWS + 1) / GENOME_TILE_COLS;
+  }
+  g_genome_tile_starts[row_block_ct] = tile_ct;
+  g_genome_tile_ct = tile_ct;
+}
+
+void genome_tile_worker() {
+  uint32_t row_offset = g_thread_start[0];
+  uint32_t row_end_all = g_thread_start[g_thread_ct];
+  uint32_t row_block_idx = 0;
+  uint32_t tile_idx;
+  uint32_t row_start;
+  uint32_t row_end;
+  uint32_t col_start;
+  uint32_t col_end;
+  while (1) {
+    tile_idx = __sync_fetch_and_add(&g_genome_next_tile, 1);
+    if (tile_idx >= g_genome_tile_ct) {
+      return;
+    }
+    // tile indices are handed out in increasing order, so each thread's row
+    // block cursor only moves forward
+    while (g_genome_tile_starts[row_block_idx + 1] <= tile_idx) {
+      row_block_idx++;
+    }
+    row_start = row_offset + row_block_idx * GENOME_TILE_ROWS;
+    row_end = row_start + GENOME_TILE_ROWS;
+    if (row_end > row_end_all) {
+      row_end = row_end_all;
+    }
+    col_start = ((row_start + 1) / GENOME_TILE_COLS + tile_idx - g_genome_tile_starts[row_block_idx]) * GENOME_TILE_COLS;
+    col_end = col_start + GENOME_TILE_COLS;
+    if (col_end > g_indiv_ct) {
+      col_end = g_indiv_ct;
+    }
+    incr_genome((uintptr_t*)g_geno, row_start, row_end, col_start, col_end);
+  }
+}
+
 THREAD_RET_TYPE calc_genome_thread(void* arg) {
-  uintptr_t tidx = (uintptr_t)arg;
-  int32_t ii = g_thread_start[tidx];
-  int32_t jj = g_thread_start[0];
-  incr_genome(&(g_genome_main[((int64_t)g_indiv_ct * (ii - jj) - ((int64_t)ii * (ii + 1) - (int64_t)jj * (jj + 1)) / 2) * 5]), (uintptr_t*)g_geno, (uint32_t)tidx);
+  genome_tile_worker();
   THREAD_RETURN;
 }
 
@@ -2091,6 +2795,160 @@ THREAD_RET_TYPE calc_rel_f_thread(void* arg) {
   THREAD_RETURN;
 }
 
+// Blocked matrix-multiply relationship engine.  Instead of the 3-bit lookup
+// tables, up to REL_GEMM_BLOCK markers are expanded into a column-major
+// (individual x marker) matrix of standardized genotypes, with missing calls
+// set to zero so the usual missingness correction still applies.  Each full
+// block is then folded into the lower triangle with one matrix product per
+// REL_GEMM_TILE x REL_GEMM_TILE tile.  This touches the triangle far less
+// often than incr_dists_r(), but scripts/bench_rel.sh has not found a size
+// where it wins (incr_dists_r() was 1.6-1.9x faster from 1k to 4k
+// individuals at 20k markers, with 1 or 4 threads), so it's only used on
+// request.
+#define REL_GEMM_BLOCK (MULTIPLEX_REL * 4)
+#define REL_GEMM_TILE 256
+
+static double* g_rel_gemm_x;
+static double* g_rel_gemm_tile_bufs;
+static uint32_t* g_rel_gemm_tile_starts;
+static uint32_t g_rel_gemm_tile_ct;
+static uint32_t g_rel_gemm_marker_ct;
+static uint32_t g_rel_gemm_is_float;
+static volatile uint32_t g_rel_gemm_next_tile;
+
+int32_t rel_gemm_init(uint32_t is_float) {
+  // row block i covers rows [g_thread_start[0] + i * REL_GEMM_TILE, ...), and
+  // needs every column block below its last row
+  uint32_t row_start = g_thread_start[0];
+  uint32_t row_end = g_thread_start[g_thread_ct];
+  uint32_t row_block_ct = (row_end - row_start + REL_GEMM_TILE - 1) / REL_GEMM_TILE;
+  uint32_t tile_ct = 0;
+  uint32_t row_block_idx;
+  uint32_t uii;
+  if (wkspace_alloc_d_checked(&g_rel_gemm_x, ((uintptr_t)g_indiv_ct) * REL_GEMM_BLOCK * sizeof(double)) ||
+      wkspace_alloc_d_checked(&g_rel_gemm_tile_bufs, ((uintptr_t)g_thread_ct) * REL_GEMM_TILE * REL_GEMM_TILE * sizeof(double)) ||
+      wkspace_alloc_ui_checked(&g_rel_gemm_tile_starts, (row_block_ct + 1) * sizeof(int32_t))) {
+    return 1;
+  }
+  for (row_block_idx = 0; row_block_idx < row_block_ct; row_block_idx++) {
+    g_rel_gemm_tile_starts[row_block_idx] = tile_ct;
+    uii = row_start + (row_block_idx + 1) * REL_GEMM_TILE;
+    if (uii > row_end) {
+      uii = row_end;
+    }
+    tile_ct += (uii + REL_GEMM_TILE - 2) / REL_GEMM_TILE;
+  }
+  g_rel_gemm_tile_starts[row_block_ct] = tile_ct;
+  g_rel_gemm_tile_ct = tile_ct;
+  g_rel_gemm_marker_ct = 0;
+  g_rel_gemm_is_float = is_float;
+  return 0;
+}
+
+void rel_gemm_load_marker(unsigned char* gptr, uintptr_t* indiv_exclude, double set_allele_freq, uint32_t var_std) {
+  double* xptr = &(g_rel_gemm_x[((uintptr_t)(g_rel_gemm_marker_ct++)) * g_indiv_ct]);
+  double* xptr_end = &(xptr[g_indiv_ct]);
+  uintptr_t indiv_uidx = 0;
+  double mult = 1.0;
+  double zvals[4];
+  if (var_std) {
+    if ((set_allele_freq == 0.0) || (set_allele_freq >= 1.0 - EPSILON)) {
+      fill_double_zero(xptr, g_indiv_ct);
+      return;
+    }
+    mult = sqrt(1.0 / (2 * set_allele_freq * (1.0 - set_allele_freq)));
+  }
+  // same terms as fill_weights_r(): each pair's product is the per-marker
+  // relationship increment
+  zvals[0] = -2 * set_allele_freq * mult;
+  zvals[1] = 0;
+  zvals[2] = (1.0 - 2 * set_allele_freq) * mult;
+  zvals[3] = (2.0 - 2 * set_allele_freq) * mult;
+  do {
+    next_unset_ul_unsafe_ck(indiv_exclude, &indiv_uidx);
+    *xptr++ = zvals[(gptr[indiv_uidx / 4] >> ((indiv_uidx % 4) * 2)) & 3];
+    indiv_uidx++;
+  } while (xptr < xptr_end);
+}
+
+void rel_gemm_tile_worker(uint32_t tidx) {
+  double* tile_buf = &(g_rel_gemm_tile_bufs[((uintptr_t)tidx) * REL_GEMM_TILE * REL_GEMM_TILE]);
+  uint32_t row_offset = g_thread_start[0];
+  uint32_t row_end_all = g_thread_start[g_thread_ct];
+  uint32_t row_block_idx = 0;
+  uint32_t tile_idx;
+  uint32_t row_start;
+  uint32_t row_end;
+  uint32_t col_start;
+  uint32_t col_end;
+  uint32_t col_ct;
+  uint32_t row_idx;
+  uint32_t ujj;
+  uint32_t ukk;
+  uint64_t ullxx;
+  double* dptr;
+  double* dist_ptr;
+  float* dist_f_ptr;
+  while (1) {
+    tile_idx = __sync_fetch_and_add(&g_rel_gemm_next_tile, 1);
+    if (tile_idx >= g_rel_gemm_tile_ct) {
+      return;
+    }
+    while (g_rel_gemm_tile_starts[row_block_idx + 1] <= tile_idx) {
+      row_block_idx++;
+    }
+    row_start = row_offset + row_block_idx * REL_GEMM_TILE;
+    row_end = row_start + REL_GEMM_TILE;
+    if (row_end > row_end_all) {
+      row_end = row_end_all;
+    }
+    col_start = (tile_idx - g_rel_gemm_tile_starts[row_block_idx]) * REL_GEMM_TILE;
+    col_end = col_start + REL_GEMM_TILE;
+    if (col_end > row_end - 1) {
+      col_end = row_end - 1;
+    }
+    col_ct = col_end - col_start;
+    // tile_buf[(row - row_start) * col_ct + (col - col_start)]
+    col_major_matrix_multiply_transb(col_ct, row_end - row_start, g_rel_gemm_marker_ct, &(g_rel_gemm_x[col_start]), g_indiv_ct, &(g_rel_gemm_x[row_start]), g_indiv_ct, tile_buf);
+    row_idx = (row_start > col_start)? row_start : (col_start + 1);
+    for (; row_idx < row_end; row_idx++) {
+      ujj = ((row_idx < col_end)? row_idx : col_end) - col_start;
+      ullxx = (((uint64_t)row_idx) * (row_idx - 1) - ((uint64_t)row_offset) * (row_offset - 1)) / 2 + col_start;
+      dptr = &(tile_buf[(row_idx - row_start) * col_ct]);
+      if (g_rel_gemm_is_float) {
+	dist_f_ptr = &(g_rel_f_dists[ullxx]);
+	for (ukk = 0; ukk < ujj; ukk++) {
+	  dist_f_ptr[ukk] += (float)dptr[ukk];
+	}
+      } else {
+	dist_ptr = &(g_rel_dists[ullxx]);
+	for (ukk = 0; ukk < ujj; ukk++) {
+	  dist_ptr[ukk] += dptr[ukk];
+	}
+      }
+    }
+  }
+}
+
+THREAD_RET_TYPE rel_gemm_thread(void* arg) {
+  rel_gemm_tile_worker((uintptr_t)arg);
+  THREAD_RETURN;
+}
+
+int32_t rel_gemm_flush(pthread_t* threads) {
+  if (!g_rel_gemm_marker_ct) {
+    return 0;
+  }
+  g_rel_gemm_next_tile = 0;
+  if (spawn_threads(threads, &rel_gemm_thread, g_thread_ct)) {
+    return 1;
+  }
+  rel_gemm_tile_worker(0);
+  join_threads(threads, g_thread_ct);
+  g_rel_gemm_marker_ct = 0;
+  return 0;
+}
+
 void incr_dists_rm(uint32_t* idists, uint32_t tidx, uint32_t* thread_start) {
   // count missing intersection, optimized for sparsity
   uintptr_t* mlptr;
@@ -2118,6 +2976,21 @@ void incr_dists_rm(uint32_t* idists, uint32_t tidx, uint32_t* thread_start) {
   }
 }
 
+THREAD_RET_TYPE calc_rel_zero_thread(void* arg) {
+  // Each thread zeroes the slice of the relationship and missingness
+  // triangles it will later fill, so those pages are first touched (and, on
+  // NUMA systems, placed) by the thread that uses them.
+  uintptr_t tidx = (uintptr_t)arg;
+  int64_t ii = g_thread_start[tidx];
+  int64_t jj = g_thread_start[0];
+  int64_t kk = g_thread_start[tidx + 1];
+  uintptr_t start_offset = (ii * (ii - 1) - jj * (jj - 1)) / 2;
+  uintptr_t cell_ct = (kk * (kk - 1) - ii * (ii - 1)) / 2;
+  fill_double_zero(&(g_rel_dists[start_offset]), cell_ct);
+  fill_uint_zero(&(g_missing_dbl_excluded[start_offset]), cell_ct);
+  THREAD_RETURN;
+}
+
 THREAD_RET_TYPE calc_missing_thread(void* arg) {
   uintptr_t tidx = (uintptr_t)arg;
   int32_t ii = g_thread_start[tidx];
@@ -2128,7 +3001,9 @@ THREAD_RET_TYPE calc_missing_thread(void* arg) {
 
 void incr_dists_rm_inv(uint32_t* idists, uint32_t tidx) {
   // inverted loops for --genome --parallel
+  // idists points to the (uii, uii + 1) cell of the first row
   uintptr_t* glptr;
+  uint32_t* iptr;
   uintptr_t ulii;
   uintptr_t uljj;
   uintptr_t indiv_ct_m1 = g_indiv_ct - 1;
@@ -2138,16 +3013,17 @@ void incr_dists_rm_inv(uint32_t* idists, uint32_t tidx) {
     ulii = g_mmasks[uii];
     if (ulii) {
       glptr = &(g_mmasks[uii + 1]);
-      // ujj is deliberately biased down by 1
+      iptr = idists;
       for (ujj = uii; ujj < indiv_ct_m1; ujj++) {
-        uljj = (*glptr++) & ulii;
-        while (uljj) {
-          idists[ujj] += 1;
-          uljj &= uljj - 1;
-        }
+	uljj = (*glptr++) & ulii;
+	while (uljj) {
+	  *iptr += 1;
+	  uljj &= uljj - 1;
+	}
+	iptr++;
       }
     }
-    idists = &(idists[indiv_ct_m1 - uii - 1]);
+    idists = &(idists[indiv_ct_m1 - uii]);
   }
 }
 
@@ -2155,13 +3031,13 @@ THREAD_RET_TYPE calc_genomem_thread(void* arg) {
   uintptr_t tidx = (uintptr_t)arg;
   int32_t ii = g_thread_start[tidx];
   int32_t jj = g_thread_start[0];
+  // number of cells in rows [jj, ii); jj is nonzero under --parallel
   // f(0) = 0
-  // f(1) = indiv_ct - 2
-  // f(2) = 2 * indiv_ct - 5
-  // f(3) = 3 * indiv_ct - 9
+  // f(1) = indiv_ct - 1
+  // f(2) = 2 * indiv_ct - 3
   // ...
-  // f(n) = n * indiv_ct - (n+1)(n+2)/2 + 1
-  incr_dists_rm_inv(&(g_missing_dbl_excluded[(int64_t)g_indiv_ct * (ii - jj) - ((int64_t)(ii + 1) * (ii + 2) - (int64_t)(jj + 1) * (jj + 2)) / 2]), (uint32_t)tidx);
+  // f(n) = n * indiv_ct - n(n+1)/2
+  incr_dists_rm_inv(&(g_missing_dbl_excluded[(int64_t)g_indiv_ct * (ii - jj) - ((int64_t)ii * (ii + 1) - (int64_t)jj * (jj + 1)) / 2]), (uint32_t)tidx);
   THREAD_RETURN;
 }
 
@@ -2538,29 +3414,237 @@ void matrix_row_sum_ur(double* sums, double* matrix) {
   }
 }
 
-#ifndef NOLAPACK
-// one-trait REML via EM.
-//
-// wkbase is assumed to have space for three cache-aligned
-// indiv_ct * indiv_ct double matrices plus three more rows.  The unpacked
-// relationship matrix is stored in the SECOND slot.
-//
-// g_indiv_ct currently must be set.
-void reml_em_one_trait(double* wkbase, double* pheno, double* covg_ref, double* covr_ref, double tol, uint32_t is_strict) {
-  double ll_change;
-  int64_t mat_offset = g_indiv_ct;
-  double* rel_dists;
-  MATRIX_INVERT_BUF1_TYPE* irow;
-  __CLPK_integer lwork;
-  double* row;
-  double* row2;
-  double* work;
-  double* dptr;
-  double* dptr2;
-  double* matrix_pvg;
-  __CLPK_integer indiv_ct_li = g_indiv_ct;
-  double dxx;
-  double dyy;
+// Pipelined .grm.gz reader.  The main thread inflates the next block of text
+// while up to (g_thread_ct - 1) worker threads parse line-aligned chunks of
+// the current block, each writing its lines' relationship values directly
+// into a slab of the lower-triangle matrix.  (Row/column indices are
+// implied by line position, as in the old gzgets() loops.)
+#define GRM_GZ_BLOCK_SIZE 4194304
+
+typedef struct {
+  gzFile gz_infile;
+  char* bufs[2];
+  // [bufs[i], line_ends[i]) holds complete lines, and [line_ends[i],
+  // text_ends[i]) is a partial line to carry over to the other buffer
+  char* line_ends[2];
+  char* text_ends[2];
+  char* cur_ptr;
+  uint32_t loaded[2];
+  uint32_t buf_idx;
+  uint32_t eof;
+} Grm_gz_reader;
+
+static char* g_ggz_chunk_starts[MAX_THREADS_P1];
+static uintptr_t g_ggz_chunk_line_offsets[MAX_THREADS_P1];
+static uint32_t g_ggz_chunk_errs[MAX_THREADS];
+static double* g_ggz_slab;
+
+uint32_t grm_gz_parse_lines(char* bufptr, char* buf_end, double* slab) {
+  // Each line is "<row> <col> <nonmissing ct> <value>".
+  uint32_t uii;
+  while (bufptr < buf_end) {
+    while ((*bufptr == ' ') || (*bufptr == '\t')) {
+      bufptr++;
+    }
+    for (uii = 0; uii < 3; uii++) {
+      while (((unsigned char)(*bufptr)) > ' ') {
+	bufptr++;
+      }
+      while ((*bufptr == ' ') || (*bufptr == '\t')) {
+	bufptr++;
+      }
+    }
+    if (is_eoln_kns(*bufptr) || scan_double_fast(bufptr, slab++)) {
+      return 1;
+    }
+    bufptr = &(((char*)memchr(bufptr, '\n', buf_end - bufptr))[1]);
+  }
+  return 0;
+}
+
+THREAD_RET_TYPE grm_gz_parse_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  // thread 0 is the main (inflating) thread, so worker indices start at 1
+  g_ggz_chunk_errs[tidx - 1] = grm_gz_parse_lines(g_ggz_chunk_starts[tidx - 1], g_ggz_chunk_starts[tidx], &(g_ggz_slab[g_ggz_chunk_line_offsets[tidx - 1]]));
+  THREAD_RETURN;
+}
+
+int32_t grm_gz_load(Grm_gz_reader* grp, uint32_t buf_idx) {
+  // Fill bufs[buf_idx] with the other buffer's partial last line, followed by
+  // the next block of inflated text.
+  char* buf = grp->bufs[buf_idx];
+  char* line_end;
+  uintptr_t carry_len = (uintptr_t)(grp->text_ends[buf_idx ^ 1] - grp->line_ends[buf_idx ^ 1]);
+  uintptr_t text_len;
+  int32_t ii;
+  memcpy(buf, grp->line_ends[buf_idx ^ 1], carry_len);
+  ii = gzread(grp->gz_infile, &(buf[carry_len]), GRM_GZ_BLOCK_SIZE);
+  if (ii < 0) {
+    return RET_READ_FAIL;
+  }
+  text_len = carry_len + ((uint32_t)ii);
+  if (ii < GRM_GZ_BLOCK_SIZE) {
+    grp->eof = 1;
+    if (text_len && (buf[text_len - 1] != '\n')) {
+      buf[text_len++] = '\n';
+    }
+    grp->line_ends[buf_idx] = &(buf[text_len]);
+  } else {
+    line_end = &(buf[text_len]);
+    while ((line_end > buf) && (line_end[-1] != '\n')) {
+      line_end--;
+    }
+    if (((uintptr_t)(&(buf[text_len]) - line_end)) >= MAXLINELEN) {
+      logprint("Error: Pathologically long line in .grm.gz file.\n");
+      return RET_INVALID_FORMAT;
+    }
+    grp->line_ends[buf_idx] = line_end;
+  }
+  grp->text_ends[buf_idx] = &(buf[text_len]);
+  grp->loaded[buf_idx] = 1;
+  return 0;
+}
+
+int32_t grm_gz_init(Grm_gz_reader* grp, gzFile gz_infile) {
+  // Buffers are allocated from the workspace, so callers should allocate
+  // their own long-lived arrays first.
+  grp->gz_infile = gz_infile;
+  if (wkspace_alloc_c_checked(&(grp->bufs[0]), GRM_GZ_BLOCK_SIZE + MAXLINELEN + 1) ||
+      wkspace_alloc_c_checked(&(grp->bufs[1]), GRM_GZ_BLOCK_SIZE + MAXLINELEN + 1)) {
+    return RET_NOMEM;
+  }
+  grp->line_ends[1] = grp->bufs[1];
+  grp->text_ends[1] = grp->bufs[1];
+  grp->loaded[1] = 0;
+  grp->buf_idx = 0;
+  grp->eof = 0;
+  grp->cur_ptr = grp->bufs[0];
+  return grm_gz_load(grp, 0);
+}
+
+int32_t grm_gz_fill(Grm_gz_reader* grp, pthread_t* threads, double* slab, uintptr_t line_ct) {
+  // Parse the next line_ct lines into slab[].  Returns RET_READ_FAIL if the
+  // file ends early, and RET_INVALID_FORMAT on a malformed line.
+  uint32_t buf_idx = grp->buf_idx;
+  uint32_t worker_ct = g_thread_ct - 1;
+  char* bufptr = grp->cur_ptr;
+  char* line_end;
+  char* next_boundary;
+  uintptr_t block_len;
+  uintptr_t lines_parsed;
+  uint32_t chunk_ct;
+  uint32_t uii;
+  int32_t retval;
+  while (line_ct) {
+    line_end = grp->line_ends[buf_idx];
+    if (bufptr == line_end) {
+      grp->loaded[buf_idx] = 0;
+      buf_idx ^= 1;
+      if (!grp->loaded[buf_idx]) {
+	if (grp->eof) {
+	  return RET_READ_FAIL;
+	}
+	retval = grm_gz_load(grp, buf_idx);
+	if (retval) {
+	  return retval;
+	}
+      }
+      bufptr = grp->bufs[buf_idx];
+      continue;
+    }
+    if (!worker_ct) {
+      // single-threaded: parse one line at a time, no prefetching
+      next_boundary = &(((char*)memchr(bufptr, '\n', line_end - bufptr))[1]);
+      if (grm_gz_parse_lines(bufptr, next_boundary, slab++)) {
+	return RET_INVALID_FORMAT;
+      }
+      bufptr = next_boundary;
+      line_ct--;
+      continue;
+    }
+    // split the next min(line_ct, remaining) lines into chunks of roughly
+    // equal byte length
+    block_len = (uintptr_t)(line_end - bufptr);
+    g_ggz_chunk_starts[0] = bufptr;
+    g_ggz_chunk_line_offsets[0] = 0;
+    chunk_ct = 1;
+    next_boundary = &(bufptr[block_len / worker_ct]);
+    lines_parsed = 0;
+    while ((bufptr < line_end) && (lines_parsed < line_ct)) {
+      bufptr = &(((char*)memchr(bufptr, '\n', line_end - bufptr))[1]);
+      lines_parsed++;
+      if ((bufptr >= next_boundary) && (chunk_ct < worker_ct)) {
+	g_ggz_chunk_starts[chunk_ct] = bufptr;
+	g_ggz_chunk_line_offsets[chunk_ct++] = lines_parsed;
+	next_boundary = &(next_boundary[block_len / worker_ct]);
+      }
+    }
+    if (g_ggz_chunk_starts[chunk_ct - 1] == bufptr) {
+      chunk_ct--;
+    }
+    g_ggz_chunk_starts[chunk_ct] = bufptr;
+    g_ggz_slab = slab;
+    if (spawn_threads(threads, &grm_gz_parse_thread, chunk_ct + 1)) {
+      logprint(errstr_thread_create);
+      return RET_THREAD_CREATE_FAIL;
+    }
+    retval = 0;
+    if ((bufptr == line_end) && (!grp->loaded[buf_idx ^ 1]) && (!grp->eof)) {
+      // inflate the next block while the current one is parsed
+      retval = grm_gz_load(grp, buf_idx ^ 1);
+    }
+    join_threads(threads, chunk_ct + 1);
+    if (retval) {
+      return retval;
+    }
+    for (uii = 0; uii < chunk_ct; uii++) {
+      if (g_ggz_chunk_errs[uii]) {
+	return RET_INVALID_FORMAT;
+      }
+    }
+    slab = &(slab[lines_parsed]);
+    line_ct -= lines_parsed;
+  }
+  grp->buf_idx = buf_idx;
+  grp->cur_ptr = bufptr;
+  return 0;
+}
+
+uint32_t grm_gz_trailing_text(Grm_gz_reader* grp) {
+  // Nonzero if anything is left after the last expected line.
+  uint32_t buf_idx = grp->buf_idx;
+  if (grp->cur_ptr != grp->line_ends[buf_idx]) {
+    return 1;
+  }
+  if (grp->loaded[buf_idx ^ 1]) {
+    return (grp->text_ends[buf_idx ^ 1] != grp->bufs[buf_idx ^ 1]);
+  }
+  return (!grp->eof) && (gzgetc(grp->gz_infile) != -1);
+}
+
+#ifndef NOLAPACK
+// one-trait REML via EM.
+//
+// wkbase is assumed to have space for three cache-aligned
+// indiv_ct * indiv_ct double matrices plus three more rows.  The unpacked
+// relationship matrix is stored in the SECOND slot.
+//
+// g_indiv_ct currently must be set.
+void reml_em_one_trait(double* wkbase, double* pheno, double* covg_ref, double* covr_ref, double tol, uint32_t is_strict) {
+  double ll_change;
+  int64_t mat_offset = g_indiv_ct;
+  double* rel_dists;
+  MATRIX_INVERT_BUF1_TYPE* irow;
+  __CLPK_integer lwork;
+  double* row;
+  double* row2;
+  double* work;
+  double* dptr;
+  double* dptr2;
+  double* matrix_pvg;
+  __CLPK_integer indiv_ct_li = g_indiv_ct;
+  double dxx;
+  double dyy;
   double max_jump;
   double dzz;
   double dlg;
@@ -2790,11 +3874,18 @@ int32_t unrelated_herit_batch(uint32_t load_grm_bin, char* grmname, char* phenon
   double* pheno_ptr;
   double* rel_base;
   double* row_ptr;
+  pthread_t threads[MAX_THREADS];
+  Grm_gz_reader ggz;
+  float* slab_buf;
+  double* slab_dbuf;
+  float* fptr;
+  double* dptr;
   uint64_t fpos;
+  uintptr_t slab_elem_ct;
+  uintptr_t slab_elem_size;
+  uintptr_t row_end;
   uintptr_t ulii;
   uintptr_t uljj;
-  double dxx;
-  float fxx;
   int32_t retval;
   // 1. load IDs
   // 2. load phenotypes and check for missing indivs
@@ -2895,17 +3986,6 @@ int32_t unrelated_herit_batch(uint32_t load_grm_bin, char* grmname, char* phenon
     logprint("Error: Less than two phenotypes present.\n");
     goto unrelated_herit_batch_ret_INVALID_FORMAT;
   }
-  ulii = CACHEALIGN_DBL(pheno_nm_ct * pheno_nm_ct);
-  uljj = ulii * 3 + CACHEALIGN_DBL(pheno_nm_ct) * 3;
-  if (wkspace_alloc_d_checked(&matrix_wkbase, ulii * sizeof(double))) {
-    goto unrelated_herit_batch_ret_NOMEM;
-  }
-  g_indiv_ct = pheno_nm_ct;
-  pheno_ptr = &(matrix_wkbase[uljj - CACHEALIGN_DBL(pheno_nm_ct)]);
-  collapse_copy_phenod_incl(pheno_ptr, pheno_d, pheno_nm, unfiltered_indiv_ct, pheno_nm_ct);
-  rel_base = &(matrix_wkbase[ulii]);
-  mean_zero_var_one_in_place(pheno_nm_ct, pheno_ptr);
-  indiv_uidx = 0;
   if (load_grm_bin) {
     memcpy(grmname_end, ".grm.bin", 9);
     if (fopen_checked(&grm_binfile, grmname, "rb")) {
@@ -2919,72 +3999,97 @@ int32_t unrelated_herit_batch(uint32_t load_grm_bin, char* grmname, char* phenon
     if (fpos != ((uint64_t)unfiltered_indiv_ct) * (unfiltered_indiv_ct + 1) * 2) {
       goto unrelated_herit_batch_ret_INVALID_FORMAT_2;
     }
-    rewind(grm_binfile);
-    for (ulii = 0; ulii < pheno_nm_ct; ulii++) {
-      if (IS_SET(pheno_nm, indiv_uidx)) {
-	fpos = indiv_uidx * (indiv_uidx + 1) * (sizeof(float) / 2);
-      } else {
-        indiv_uidx = next_set_ul_unsafe(pheno_nm, indiv_uidx);
-	fpos = indiv_uidx * (indiv_uidx + 1) * (sizeof(float) / 2);
-        if (fseeko(grm_binfile, fpos, SEEK_SET)) {
-          goto unrelated_herit_batch_ret_READ_FAIL;
-	}
-      }
-      row_ptr = &(rel_base[ulii * pheno_nm_ct]);
-      indiv_uidx2 = 0;
-      for (uljj = 0; uljj <= ulii; uljj++) {
-        if (!IS_SET(pheno_nm, indiv_uidx2)) {
-          indiv_uidx2 = next_set_ul_unsafe(pheno_nm, indiv_uidx2);
-          if (fseeko(grm_binfile, fpos + (indiv_uidx2 * sizeof(float)), SEEK_SET)) {
-            goto unrelated_herit_batch_ret_READ_FAIL;
-	  }
-	}
-        fread(&fxx, 4, 1, grm_binfile);
-        *row_ptr++ = (double)fxx;
-        indiv_uidx2++;
-      }
-      indiv_uidx++;
-    }
-    fclose_null(&grm_binfile);
+    slab_elem_size = sizeof(float);
   } else {
+    // reader buffers must be allocated before the REML matrices, since
+    // those extend past the end of matrix_wkbase's allocation
     memcpy(grmname_end, ".grm.gz", 8);
     if (gzopen_checked(&grm_gzfile, grmname, "rb")) {
       goto unrelated_herit_batch_ret_OPEN_FAIL;
     }
-    ulii = 0;
-    for (indiv_uidx = 0; indiv_uidx < pheno_nm_ct; indiv_uidx++) {
+    retval = grm_gz_init(&ggz, grm_gzfile);
+    if (retval) {
+      goto unrelated_herit_batch_ret_1;
+    }
+    slab_elem_size = sizeof(double);
+  }
+  ulii = CACHEALIGN_DBL(pheno_nm_ct * pheno_nm_ct);
+  uljj = ulii * 3 + CACHEALIGN_DBL(pheno_nm_ct) * 3;
+  if (wkspace_alloc_d_checked(&matrix_wkbase, ulii * sizeof(double))) {
+    goto unrelated_herit_batch_ret_NOMEM;
+  }
+  g_indiv_ct = pheno_nm_ct;
+  pheno_ptr = &(matrix_wkbase[uljj - CACHEALIGN_DBL(pheno_nm_ct)]);
+  collapse_copy_phenod_incl(pheno_ptr, pheno_d, pheno_nm, unfiltered_indiv_ct, pheno_nm_ct);
+  rel_base = &(matrix_wkbase[ulii]);
+  mean_zero_var_one_in_place(pheno_nm_ct, pheno_ptr);
+  // load slabs of consecutive lower-triangle rows at a time (with a single
+  // fread in the .grm.bin case), into the space past reml_em_one_trait()'s
+  // matrices
+  slab_buf = (float*)(&(matrix_wkbase[uljj]));
+  slab_dbuf = &(matrix_wkbase[uljj]);
+  ulii = (uljj - ulii) * sizeof(double);
+  if (wkspace_left < ulii + unfiltered_indiv_ct * slab_elem_size) {
+    goto unrelated_herit_batch_ret_NOMEM;
+  }
+  slab_elem_ct = (wkspace_left - ulii) / slab_elem_size;
+  indiv_uidx = 0;
+  ulii = 0;
+  while (ulii < pheno_nm_ct) {
+    if (load_grm_bin) {
+      // .grm.bin rows are seekable; .grm.gz rows must all be parsed
+      indiv_uidx = next_set_ul_unsafe(pheno_nm, indiv_uidx);
+    }
+    fpos = ((uint64_t)indiv_uidx) * (indiv_uidx + 1) / 2;
+    row_end = indiv_uidx + 1;
+    while ((row_end < unfiltered_indiv_ct) && (((uint64_t)(row_end + 1)) * (row_end + 2) / 2 - fpos <= slab_elem_ct)) {
+      row_end++;
+    }
+    uljj = ((uint64_t)row_end) * (row_end + 1) / 2 - fpos;
+    if (load_grm_bin) {
+      if (fseeko(grm_binfile, fpos * sizeof(float), SEEK_SET)) {
+	goto unrelated_herit_batch_ret_READ_FAIL;
+      }
+      if (fread(slab_buf, sizeof(float), uljj, grm_binfile) < uljj) {
+	goto unrelated_herit_batch_ret_READ_FAIL;
+      }
+    } else {
+      retval = grm_gz_fill(&ggz, threads, slab_dbuf, uljj);
+      if (retval) {
+	if (retval == RET_INVALID_FORMAT) {
+	  goto unrelated_herit_batch_ret_INVALID_FORMAT_3;
+	}
+	goto unrelated_herit_batch_ret_1;
+      }
+    }
+    for (; indiv_uidx < row_end; indiv_uidx++) {
       if (!IS_SET(pheno_nm, indiv_uidx)) {
-        for (indiv_uidx2 = 0; indiv_uidx2 <= indiv_uidx; indiv_uidx2++) {
-          if (!gzgets(grm_gzfile, tbuf, MAXLINELEN)) {
-	    goto unrelated_herit_batch_ret_READ_FAIL;
-	  }
-	  if (!tbuf[MAXLINELEN - 1]) {
-	    goto unrelated_herit_batch_ret_INVALID_FORMAT_3;
-	  }
+	continue;
+      }
+      uljj = ((uint64_t)indiv_uidx) * (indiv_uidx + 1) / 2 - fpos;
+      row_ptr = &(rel_base[ulii * pheno_nm_ct]);
+      indiv_uidx2 = 0;
+      if (load_grm_bin) {
+	fptr = &(slab_buf[uljj]);
+	for (uljj = 0; uljj <= ulii; indiv_uidx2++, uljj++) {
+	  next_set_ul_unsafe_ck(pheno_nm, &indiv_uidx2);
+	  *row_ptr++ = (double)fptr[indiv_uidx2];
 	}
       } else {
-	row_ptr = &(rel_base[ulii * pheno_nm_ct]);
-	for (indiv_uidx2 = 0; indiv_uidx2 <= indiv_uidx; indiv_uidx2++) {
-	  if (!gzgets(grm_gzfile, tbuf, MAXLINELEN)) {
-	    goto unrelated_herit_batch_ret_READ_FAIL;
-	  }
-	  if (!tbuf[MAXLINELEN - 1]) {
-	    goto unrelated_herit_batch_ret_INVALID_FORMAT_3;
-	  }
-	  if (IS_SET(pheno_nm, indiv_uidx2)) {
-	    bufptr = next_item_mult(tbuf, 3);
-	    if (no_more_items_kns(bufptr)) {
-	      goto unrelated_herit_batch_ret_INVALID_FORMAT_3;
-	    }
-	    if (scan_double(bufptr, &dxx)) {
-	      goto unrelated_herit_batch_ret_INVALID_FORMAT_3;
-	    }
-            *row_ptr++ = dxx;
-	  }
+	dptr = &(slab_dbuf[uljj]);
+	for (uljj = 0; uljj <= ulii; indiv_uidx2++, uljj++) {
+	  next_set_ul_unsafe_ck(pheno_nm, &indiv_uidx2);
+	  *row_ptr++ = dptr[indiv_uidx2];
 	}
-        ulii++;
+      }
+      if (++ulii == pheno_nm_ct) {
+	break;
       }
     }
+  }
+  if (load_grm_bin) {
+    fclose_null(&grm_binfile);
+  } else {
     gzclose(grm_gzfile);
     grm_gzfile = NULL;
   }
@@ -3750,13 +4855,14 @@ int32_t calc_regress_pcs(char* evecname, uint32_t regress_pcs_modifier, uint32_t
   if (fopen_checked(&outfile, outname, "w")) {
     goto calc_regress_pcs_ret_OPEN_FAIL;
   }
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  bed_mmap_advise(BED_ADVISE_SEQUENTIAL);
+  if (bed_seek(bedfile, bed_offset)) {
     goto calc_regress_pcs_ret_READ_FAIL;
   }
   for (marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto calc_regress_pcs_ret_READ_FAIL;
       }
     }
@@ -4052,6 +5158,52 @@ static double g_cg_e12;
 static double g_cg_min_pi_hat;
 static double g_cg_max_pi_hat;
 
+static inline double genome_ibd_est(uint32_t* gm_cell, int32_t nn, uint32_t is_unbounded, double* z0_ptr, double* z1_ptr, double* z2_ptr) {
+  // method-of-moments Z0/Z1/Z2 estimate for one pair, optionally clipped to
+  // [0, 1]; returns PI_HAT
+  int32_t oo = nn - gm_cell[0] - gm_cell[1];
+  double dxx = (double)gm_cell[1] / (g_cg_e00 * nn);
+  double dyy = ((double)gm_cell[0] - dxx * g_cg_e01 * nn) / (g_cg_e11 * nn);
+  double dxx1 = ((double)oo - nn * (dxx * g_cg_e02 + dyy * g_cg_e12)) / ((double)nn);
+  double dxx2;
+  if (!is_unbounded) {
+    if (dxx > 1) {
+      dxx = 1;
+      dyy = 0;
+      dxx1 = 0;
+    } else if (dyy > 1) {
+      dyy = 1;
+      dxx = 0;
+      dxx1 = 0;
+    } else if (dxx1 > 1) {
+      dxx1 = 1;
+      dyy = 0;
+      dxx1 = 0;
+    } else if (dxx < 0) {
+      dxx2 = 1.0 / (dyy + dxx1);
+      dyy *= dxx2;
+      dxx1 *= dxx2;
+      dxx = 0;
+    }
+    if (dyy < 0) {
+      dxx2 = 1.0 / (dxx + dxx1);
+      dxx *= dxx2;
+      dxx1 *= dxx2;
+      dyy = 0;
+    }
+    if (dxx1 < 0) {
+      dxx2 = 1.0 / (dxx + dyy);
+      dxx *= dxx2;
+      dyy *= dxx2;
+      dxx1 = 0;
+    }
+  }
+  *z0_ptr = dxx;
+  *z1_ptr = dyy;
+  *z2_ptr = dxx1;
+  return dyy * 0.5 + dxx1;
+}
+
 uint32_t calc_genome_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   char* sptr_cur = (char*)(&(readbuf[overflow_ct]));
   char* readbuf_end = (char*)(&(readbuf[PIGZ_BLOCK_SIZE]));
@@ -4086,7 +5238,9 @@ uint32_t calc_genome_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
     g_cg_indiv2idx = g_cg_indiv1idx + 1;
     tbuf[0] = ' ';
   }
-  do {
+  // test at the top, since we may be called again after the last row of a
+  // --parallel piece has already been written
+  while (g_cg_indiv1idx < g_cg_tstc) {
     if (g_cg_indiv2idx == g_cg_indiv1idx + 1) {
       cptr = &(g_cg_person_ids[g_cg_indiv1idx * g_cg_max_person_id_len]);
       uii = strlen_se(cptr);
@@ -4166,48 +5320,13 @@ uint32_t calc_genome_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
       }
       nn = g_cg_marker_ct - g_indiv_missing_unwt[g_cg_indiv1idx] - g_indiv_missing_unwt[g_cg_indiv2idx] + g_missing_dbl_excluded[g_cg_mdecell];
       oo = nn - g_genome_main[g_cg_gmcell] - g_genome_main[g_cg_gmcell + 1];
-      dxx = (double)g_genome_main[g_cg_gmcell + 1] / (g_cg_e00 * nn);
-      dyy = ((double)g_genome_main[g_cg_gmcell] - dxx * g_cg_e01 * nn) / (g_cg_e11 * nn);
-      dxx1 = ((double)oo - nn * (dxx * g_cg_e02 + dyy * g_cg_e12)) / ((double)nn);
-      if (!is_unbounded) {
-	if (dxx > 1) {
-	  dxx = 1;
-	  dyy = 0;
-	  dxx1 = 0;
-	} else if (dyy > 1) {
-	  dyy = 1;
-	  dxx = 0;
-	  dxx1 = 0;
-	} else if (dxx1 > 1) {
-	  dxx1 = 1;
-	  dyy = 0;
-	  dxx1 = 0;
-	} else if (dxx < 0) {
-	  dxx2 = 1.0 / (dyy + dxx1);
-	  dyy *= dxx2;
-	  dxx1 *= dxx2;
-	  dxx = 0;
-	}
-	if (dyy < 0) {
-	  dxx2 = 1.0 / (dxx + dxx1);
-	  dxx *= dxx2;
-	  dxx1 *= dxx2;
-	  dyy = 0;
-	}
-	if (dxx1 < 0) {
-	  dxx2 = 1.0 / (dxx + dyy);
-	  dxx *= dxx2;
-	  dyy *= dxx2;
-	  dxx1 = 0;
-	}
-      }
-      dxx2 = dyy * 0.5 + dxx1; // PI_HAT
+      dxx2 = genome_ibd_est(&(g_genome_main[g_cg_gmcell]), nn, is_unbounded, &dxx, &dyy, &dxx1);
       if (filter_pi_hat && ((dxx2 < min_pi_hat) || (dxx2 > max_pi_hat))) {
 	sptr_cur = sptr_cur_start;
-        goto calc_genome_emitn_skip_line;
+	goto calc_genome_emitn_skip_line;
       }
       if (is_nudge && (dxx2 * dxx2 < dxx1)) {
-        dxx = (1 - dxx2) * (1 - dxx2);
+	dxx = (1 - dxx2) * (1 - dxx2);
 	dyy = 2 * dxx2 * (1 - dxx2);
 	dxx1 = dxx2 * dxx2;
       }
@@ -4256,7 +5375,7 @@ uint32_t calc_genome_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
     g_cg_cur_line += g_indiv_ct - g_cg_indiv1idx - 1;
     g_cg_indiv1idx++;
     g_cg_indiv2idx = g_cg_indiv1idx + 1;
-  } while (g_cg_indiv1idx < g_cg_tstc);
+  }
  calc_genome_emitn_ret:
   if (g_cg_cur_line * 100 >= g_cg_tot_lines * g_pct) {
     g_pct = (g_cg_cur_line * 100) / g_cg_tot_lines;
@@ -4266,6 +5385,140 @@ uint32_t calc_genome_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
 }
 
+int32_t calc_genome_write_bin(char* outname, uint32_t is_complete) {
+  // fixed-width counterpart of calc_genome_emitn(), for --genome bin
+  FILE* outfile = NULL;
+  Genome_bin_rec* recs = (Genome_bin_rec*)tbuf;
+  uintptr_t rec_buf_ct = (MAXLINELEN * 4) / sizeof(Genome_bin_rec);
+  uintptr_t max_person_id_len = g_cg_max_person_id_len;
+  uint32_t is_rel_check = g_cg_genome_modifier & GENOME_REL_CHECK;
+  uint32_t is_unbounded = g_cg_genome_modifier & GENOME_IBD_UNBOUNDED;
+  uint32_t is_nudge = g_cg_genome_modifier & GENOME_NUDGE;
+  uint32_t filter_pi_hat = g_cg_genome_modifier & GENOME_FILTER_PI_HAT;
+  uint32_t indiv1idx = g_thread_start[0];
+  uintptr_t gmcell = 0;
+  uintptr_t mdecell = 0;
+  uintptr_t rec_ct = 0;
+  uint64_t tot_rec_ct = 0;
+  int64_t cur_line = 0;
+  uint32_t pct = 1;
+  int32_t retval = 0;
+  Genome_bin_header hdr;
+  Genome_bin_rec* rec_ptr;
+  char* id1;
+  char* id2;
+  uint32_t* gm_cell;
+  uint32_t indiv2idx;
+  uint32_t fid1_len;
+  uint32_t uii;
+  int32_t nn;
+  double z0;
+  double z1;
+  double z2;
+  double pi_hat;
+  double dxx;
+  double dxx1;
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto calc_genome_write_bin_ret_OPEN_FAIL;
+  }
+  hdr.version = 1;
+  hdr.id_ct = g_indiv_ct;
+  hdr.max_id_len = max_person_id_len;
+  hdr.flags = is_complete? GENOME_BIN_COMPLETE : 0;
+  hdr.record_ct = 0; // patched at the end
+  if (fwrite_checked(GENOME_BIN_MAGIC, 8, outfile) ||
+      fwrite_checked(&hdr, sizeof(Genome_bin_header), outfile)) {
+    goto calc_genome_write_bin_ret_WRITE_FAIL;
+  }
+  for (indiv2idx = 0; indiv2idx < g_indiv_ct; indiv2idx++) {
+    id1 = &(g_cg_person_ids[indiv2idx * max_person_id_len]);
+    fid1_len = strlen(id1);
+    memcpy(tbuf, id1, fid1_len);
+    memset(&(tbuf[fid1_len]), 0, max_person_id_len - fid1_len);
+    if (fwrite_checked(tbuf, max_person_id_len, outfile)) {
+      goto calc_genome_write_bin_ret_WRITE_FAIL;
+    }
+  }
+  uii = (8 - ((g_indiv_ct * max_person_id_len) & 7)) & 7;
+  if (uii) {
+    memset(tbuf, 0, 8);
+    if (fwrite_checked(tbuf, uii, outfile)) {
+      goto calc_genome_write_bin_ret_WRITE_FAIL;
+    }
+  }
+  for (; indiv1idx < g_cg_tstc; indiv1idx++) {
+    id1 = &(g_cg_person_ids[indiv1idx * max_person_id_len]);
+    fid1_len = strlen_se(id1);
+    for (indiv2idx = indiv1idx + 1; indiv2idx < g_indiv_ct; indiv2idx++, gmcell += 5, mdecell++) {
+      if (is_rel_check) {
+	id2 = &(g_cg_person_ids[indiv2idx * max_person_id_len]);
+	if ((((uint32_t)strlen_se(id2)) != fid1_len) || memcmp(id1, id2, fid1_len)) {
+	  continue;
+	}
+      }
+      gm_cell = &(g_genome_main[gmcell]);
+      nn = g_cg_marker_ct - g_indiv_missing_unwt[indiv1idx] - g_indiv_missing_unwt[indiv2idx] + g_missing_dbl_excluded[mdecell];
+      pi_hat = genome_ibd_est(gm_cell, nn, is_unbounded, &z0, &z1, &z2);
+      if (filter_pi_hat && ((pi_hat < g_cg_min_pi_hat) || (pi_hat > g_cg_max_pi_hat))) {
+	continue;
+      }
+      if (is_nudge && (pi_hat * pi_hat < z2)) {
+	z0 = (1 - pi_hat) * (1 - pi_hat);
+	z1 = 2 * pi_hat * (1 - pi_hat);
+	z2 = pi_hat * pi_hat;
+      }
+      dxx = (double)gm_cell[4];
+      dxx1 = 1.0 / ((double)(gm_cell[4] + gm_cell[3]));
+      rec_ptr = &(recs[rec_ct]);
+      rec_ptr->idx1 = indiv1idx;
+      rec_ptr->idx2 = indiv2idx;
+      rec_ptr->z0 = (float)z0;
+      rec_ptr->z1 = (float)z1;
+      rec_ptr->z2 = (float)z2;
+      rec_ptr->pi_hat = (float)pi_hat;
+      rec_ptr->dst = (float)(1.0 - (gm_cell[0] + 2 * gm_cell[1]) / ((double)(2 * nn)));
+      rec_ptr->ppc = (float)normdist((dxx * dxx1 - 0.666666) / (sqrt(0.2222222 * dxx1)));
+      if (++rec_ct == rec_buf_ct) {
+	if (fwrite_checked(recs, rec_ct * sizeof(Genome_bin_rec), outfile)) {
+	  goto calc_genome_write_bin_ret_WRITE_FAIL;
+	}
+	tot_rec_ct += rec_ct;
+	rec_ct = 0;
+      }
+    }
+    cur_line += g_indiv_ct - indiv1idx - 1;
+    if (cur_line * 100 >= g_cg_tot_lines * pct) {
+      pct = (cur_line * 100) / g_cg_tot_lines;
+      printf("\rWriting... %u%%", pct++);
+      fflush(stdout);
+    }
+  }
+  if (rec_ct) {
+    if (fwrite_checked(recs, rec_ct * sizeof(Genome_bin_rec), outfile)) {
+      goto calc_genome_write_bin_ret_WRITE_FAIL;
+    }
+    tot_rec_ct += rec_ct;
+  }
+  hdr.record_ct = tot_rec_ct;
+  if (fseeko(outfile, 8, SEEK_SET) ||
+      fwrite_checked(&hdr, sizeof(Genome_bin_header), outfile)) {
+    goto calc_genome_write_bin_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&outfile)) {
+    goto calc_genome_write_bin_ret_WRITE_FAIL;
+  }
+  while (0) {
+  calc_genome_write_bin_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  calc_genome_write_bin_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  }
+  fclose_cond(outfile);
+  return retval;
+}
+
 int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, Chrom_info* chrom_info_ptr, uint32_t* marker_pos, double* set_allele_freqs, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uint32_t plink_maxfid, uint32_t plink_maxiid, uintptr_t max_person_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* founder_info, uint32_t parallel_idx, uint32_t parallel_tot, char* outname, char* outname_end, int32_t nonfounders, uint64_t calculation_type, uint32_t genome_modifier, uint32_t ppc_gap, double min_pi_hat, double max_pi_hat, uintptr_t* pheno_nm, uintptr_t* pheno_c, Pedigree_rel_info pri, uint32_t skip_write) {
   FILE* outfile = NULL;
   gzFile gz_outfile = NULL;
@@ -4280,7 +5533,11 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   uint32_t chrom_fo_idx = 0;
   char wbuf[16];
   int32_t missing_ct_buf[BITCT];
-  double set_allele_freq_buf[GENOME_MULTIPLEX];
+  double set_allele_freq_bufs[2][GENOME_MULTIPLEX];
+  uint32_t marker_uidx_bufs[2][GENOME_MULTIPLEX];
+  double* set_allele_freq_buf;
+  uint32_t* marker_uidx_buf;
+  unsigned char* bedbuf;
   unsigned char* gptr;
   char* cptr;
   uintptr_t* glptr;
@@ -4324,7 +5581,9 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   uintptr_t marker_uidx;
   uintptr_t indiv_uidx;
   uintptr_t indiv_idx;
+  uint32_t row_block_ct;
   uint32_t pct;
+  uint32_t buf_idx;
 
   g_cg_max_person_fid_len = plink_maxfid;
   g_cg_max_person_iid_len = plink_maxiid;
@@ -4351,9 +5610,11 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   // f(n) = nindiv_ct - n(n+1)/2
   tot_cells = (int64_t)g_indiv_ct * (g_cg_tstc - g_thread_start[0]) - ((int64_t)g_cg_tstc * (g_cg_tstc + 1) - (int64_t)g_thread_start[0] * (g_thread_start[0] + 1)) / 2;
   g_cg_tot_lines = cur_line + tot_cells;
+  row_block_ct = (g_cg_tstc - g_thread_start[0] + GENOME_TILE_ROWS - 1) / GENOME_TILE_ROWS;
   if (wkspace_alloc_ui_checked(&g_missing_dbl_excluded, tot_cells * sizeof(int32_t)) ||
       wkspace_alloc_ui_checked(&g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t)) ||
       wkspace_alloc_ui_checked(&g_genome_main, tot_cells * 5 * sizeof(int32_t)) ||
+      wkspace_alloc_ui_checked(&g_genome_tile_starts, (row_block_ct + 1) * sizeof(int32_t)) ||
       wkspace_alloc_uc_checked(&loadbuf, GENOME_MULTIPLEX * unfiltered_indiv_ct4) ||
       wkspace_alloc_uc_checked(&g_geno, g_indiv_ct * (GENOME_MULTIPLEX / 4)) ||
       wkspace_alloc_ul_checked(&g_masks, g_indiv_ct * (GENOME_MULTIPLEX / 4)) ||
@@ -4366,8 +5627,10 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   fill_uint_zero(g_missing_dbl_excluded, tot_cells);
   fill_uint_zero(g_indiv_missing_unwt, g_indiv_ct);
   fill_uint_zero(g_genome_main, tot_cells * 5);
+  genome_tile_init(g_thread_start[0], row_block_ct);
+  bed_mmap_advise(BED_ADVISE_SEQUENTIAL);
   if (!IS_SET(marker_exclude, 0)) {
-    if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+    if (bed_seek(bedfile, bed_offset)) {
       retval = RET_READ_FAIL;
       goto calc_genome_ret_1;
     }
@@ -4387,39 +5650,51 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   g_cg_e02 = 0.0;
   g_cg_e11 = 0.0;
   g_cg_e12 = 0.0;
+  block_load_init(bedfile, bed_offset, marker_exclude, marker_ct, GENOME_MULTIPLEX, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, NULL, 1);
+  block_load_set_buf(0, loadbuf, set_allele_freq_bufs[0], NULL, NULL, marker_uidx_bufs[0]);
+  if (!wkspace_alloc_uc_checked(&gptr, GENOME_MULTIPLEX * unfiltered_indiv_ct4)) {
+    block_load_set_buf(1, gptr, set_allele_freq_bufs[1], NULL, NULL, marker_uidx_bufs[1]);
+  }
+  ckpt_begin(outname, outname_end, ".genome", CKPT_CALC_GENOME, ckpt_setup_hash(marker_exclude, marker_ct, set_allele_freqs, indiv_exclude, ((uint64_t)ppc_gap) | (((uint64_t)(nonfounders? 1 : 0)) << 32)), parallel_idx, parallel_tot);
+  ckpt_reg(g_genome_main, tot_cells * 5 * sizeof(int32_t));
+  ckpt_reg(g_missing_dbl_excluded, tot_cells * sizeof(int32_t));
+  ckpt_reg(g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t));
+  ckpt_reg(&g_cg_e00, sizeof(double));
+  ckpt_reg(&g_cg_e01, sizeof(double));
+  ckpt_reg(&g_cg_e02, sizeof(double));
+  ckpt_reg(&g_cg_e11, sizeof(double));
+  ckpt_reg(&g_cg_e12, sizeof(double));
+  ckpt_reg(&ibd_prect, sizeof(int32_t));
+  ckpt_reg(&mp_lead_unfiltered_idx, sizeof(int32_t));
+  ckpt_reg(&mp_lead_idx, sizeof(int32_t));
+  ulii = 0;
+  retval = ckpt_resume(&ulii);
+  if (retval) {
+    goto calc_genome_ret_1;
+  }
+  g_ctrl_ct = ulii;
+  if (block_load_start()) {
+    goto calc_genome_ret_THREAD_CREATE_FAIL;
+  }
   do {
-    ukk = marker_ct - g_ctrl_ct;
-    if (ukk > GENOME_MULTIPLEX) {
-      ukk = GENOME_MULTIPLEX;
+    retval = block_load_finish(&buf_idx, &ukk);
+    if (retval) {
+      goto calc_genome_ret_1;
+    }
+    bedbuf = g_bl_bufs[buf_idx];
+    set_allele_freq_buf = set_allele_freq_bufs[buf_idx];
+    marker_uidx_buf = marker_uidx_bufs[buf_idx];
+    if (g_ctrl_ct + ukk < marker_ct) {
+      if (block_load_start()) {
+	goto calc_genome_ret_THREAD_CREATE_FAIL;
+      }
     }
     glptr2 = g_marker_window;
     for (ujj = 0; ujj < ukk; ujj++) {
-      if (IS_SET(marker_exclude, marker_uidx)) {
-	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
-	  retval = RET_READ_FAIL;
-	  goto calc_genome_ret_1;
-	}
-      }
+      marker_uidx = marker_uidx_buf[ujj];
       if (marker_uidx >= chrom_end) {
-	while (1) {
-	  chrom_fo_idx++;
-	  refresh_chrom_info(chrom_info_ptr, marker_uidx, 1, 0, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_haploid);
-	  if (!is_haploid) {
-	    break;
-	  }
-          marker_uidx = next_unset_ul_unsafe(marker_exclude, chrom_end);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
-	    retval = RET_READ_FAIL;
-	    goto calc_genome_ret_1;
-	  }
-	}
-      }
-      if (fread(&(loadbuf[ujj * unfiltered_indiv_ct4]), 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
-	retval = RET_READ_FAIL;
-	goto calc_genome_ret_1;
+	refresh_chrom_info(chrom_info_ptr, marker_uidx, 1, 0, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_haploid);
       }
-      set_allele_freq_buf[ujj] = set_allele_freqs[marker_uidx];
       // See comments in incr_genome(): the PPC test is time-critical and
       // we do a bit of unusual precomputation here to speed it up.
       //
@@ -4459,10 +5734,9 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
 
       *glptr2++ = ulii;
       *glptr2++ = ulii;
-      marker_uidx++;
     }
     if (ukk < GENOME_MULTIPLEX) {
-      memset(&(loadbuf[ukk * unfiltered_indiv_ct4]), 0, (GENOME_MULTIPLEX - ukk) * unfiltered_indiv_ct4);
+      memset(&(bedbuf[ukk * unfiltered_indiv_ct4]), 0, (GENOME_MULTIPLEX - ukk) * unfiltered_indiv_ct4);
       fill_long_zero((intptr_t*)g_geno, g_indiv_ct * (GENOME_MULTIPLEX / BITCT2));
       fill_ulong_zero(g_masks, g_indiv_ct * (GENOME_MULTIPLEX / BITCT2));
       for (umm = ukk * 2; umm < GENOME_MULTIPLEX2; umm++) {
@@ -4484,7 +5758,7 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
 	uoo = (indiv_uidx % 4) * 2;
 	ulii = 0;
 	ulkk = 0;
-        gptr = &(loadbuf[indiv_uidx / 4 + ujj * unfiltered_indiv_ct4]);
+        gptr = &(bedbuf[indiv_uidx / 4 + ujj * unfiltered_indiv_ct4]);
 	uqq = (nonfounders || IS_SET(founder_info, indiv_uidx));
 	if (uqq) {
 	  for (upp = 0; upp < BITCT2; upp++) {
@@ -4515,7 +5789,7 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
 
 	ulii = 0;
 	ulkk = 0;
-	gptr = &(loadbuf[indiv_uidx / 4 + (ujj + BITCT2) * unfiltered_indiv_ct4]);
+	gptr = &(bedbuf[indiv_uidx / 4 + (ujj + BITCT2) * unfiltered_indiv_ct4]);
 	if (uqq) {
 	  for (upp = 0; upp < BITCT2; upp++) {
 	    uljj = (gptr[upp * unfiltered_indiv_ct4] >> uoo) & 3;
@@ -4583,18 +5857,21 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
       join_threads(threads, g_thread_ct);
     }
 
+    g_genome_next_tile = 0;
     if (spawn_threads(threads, &calc_genome_thread, g_thread_ct)) {
       goto calc_genome_ret_THREAD_CREATE_FAIL;
     }
-    incr_genome(g_genome_main, (uintptr_t*)g_geno, 0);
+    genome_tile_worker();
     join_threads(threads, g_thread_ct);
     g_ctrl_ct = g_case_ct;
     printf("\r%d markers complete.", g_ctrl_ct);
     fflush(stdout);
+    ckpt_save_cond();
   } while (g_ctrl_ct < marker_ct);
   fputs("\rIBD calculations complete.  \n", stdout);
   logstr("IBD calculations complete.\n");
   if (skip_write) {
+    ckpt_finish();
     goto calc_genome_ret_1;
   }
   dxx = 1.0 / (double)ibd_prect;
@@ -4726,7 +6003,17 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   // a later part of a parallel write
   g_cg_indiv1idx = parallel_idx;
   g_cg_indiv2idx = 0;
-  if (genome_modifier & GENOME_OUTPUT_GZ) {
+  if (genome_modifier & GENOME_OUTPUT_BIN) {
+    if (parallel_tot > 1) {
+      sprintf(outname_end, ".genome.%d.bin", parallel_idx + 1);
+    } else {
+      strcpy(outname_end, ".genome.bin");
+    }
+    retval = calc_genome_write_bin(outname, (parallel_tot == 1) && (!(genome_modifier & (GENOME_REL_CHECK | GENOME_FILTER_PI_HAT))));
+    if (retval) {
+      goto calc_genome_ret_1;
+    }
+  } else if (genome_modifier & GENOME_OUTPUT_GZ) {
     if (parallel_tot > 1) {
       sprintf(outname_end, ".genome.%d.gz", parallel_idx + 1);
     } else {
@@ -4747,6 +6034,7 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
   putchar('\r');
   sprintf(logbuf, "Finished writing %s.\n", outname);
   logprintb();
+  ckpt_finish();
   while (0) {
   calc_genome_ret_NOMEM:
     retval = RET_NOMEM;
@@ -4763,6 +6051,7 @@ int32_t calc_genome(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uin
     break;
   }
  calc_genome_ret_1:
+  block_load_cleanup();
   gzclose_cond(gz_outfile);
   fclose_cond(outfile);
   if ((!retval) && (calculation_type & (CALC_CLUSTER | CALC_NEIGHBOR))) {
@@ -4931,328 +6220,447 @@ void ld_prune_start_chrom(uint32_t ld_window_kb, uint32_t* cur_chrom_ptr, uint32
   *is_y_ptr = (((int32_t)cur_chrom) == chrom_info_ptr->y_code)? 1 : 0;
 }
 
-int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, char* marker_ids, uintptr_t max_marker_id_len, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_pos, uintptr_t unfiltered_indiv_ct, uintptr_t* founder_info, uintptr_t* sex_male, uint32_t ld_window_size, uint32_t ld_window_kb, uint32_t ld_window_incr, double ld_last_param, char* outname, char* outname_end, uint64_t misc_flags, uint32_t hh_exists) {
-  // for future consideration: chromosome-based multithread/parallel?
-  unsigned char* wkspace_mark = wkspace_base;
-  FILE* outfile_in = NULL;
-  FILE* outfile_out = NULL;
-  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
-  uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
-  uintptr_t unfiltered_indiv_ctl2 = 2 * ((unfiltered_indiv_ct + (BITCT - 1)) / BITCT);
-  uintptr_t founder_ct = popcount_longs(founder_info, 0, unfiltered_indiv_ctl2 / 2);
-  uint32_t weighted_founder_ct = founder_ct;
-  uintptr_t founder_ctl = (founder_ct + BITCT - 1) / BITCT;
-#ifdef __LP64__
-  uintptr_t founder_ctv = 2 * ((founder_ct + 127) / 128);
-#else
-  uintptr_t founder_ctv = founder_ctl;
-#endif
-  uintptr_t founder_ct_mld = (founder_ct + MULTIPLEX_LD - 1) / MULTIPLEX_LD;
-  uint32_t founder_ct_mld_m1 = ((uint32_t)founder_ct_mld) - 1;
-#ifdef __LP64__
-  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 192) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 192;
-#else
-  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 48) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 48;
-#endif
-  uintptr_t founder_ct_mld_long = founder_ct_mld * (MULTIPLEX_LD / BITCT2);
-  uint32_t founder_trail_ct = founder_ct_mld_long - founder_ctl * 2;
-  uint32_t pairwise = (misc_flags / MISC_LD_PRUNE_PAIRWISE) & 1;
-  uint32_t ignore_x = (misc_flags / MISC_LD_IGNORE_X) & 1;
-  uint32_t weighted_x = (misc_flags / MISC_LD_WEIGHTED_X) & 1;
-  uint32_t nonmale_founder_ct = 0;
-  uintptr_t window_max = 0;
-  uintptr_t* geno = NULL;
-  uintptr_t* founder_include2 = NULL;
-  uintptr_t* founder_male_include2 = NULL;
-  uintptr_t* nonmale_geno = NULL;
-  uintptr_t* nonmale_masks = NULL;
-  double* cov_matrix = NULL;
-  double* new_cov_matrix = NULL;
-  MATRIX_INVERT_BUF1_TYPE* irow = NULL;
-  double* work = NULL;
-  uint32_t* idx_remap = NULL;
-  uint32_t tot_exclude_ct = 0;
-  uint32_t at_least_one_prune = 0;
-  uint32_t max_code = chrom_info_ptr->max_code;
-  int32_t retval = 0;
+// Per-thread --indep[-pairwise] window buffers.
+typedef struct {
   uintptr_t* pruned_arr;
   uint32_t* live_indices;
   uint32_t* start_arr;
-  uint32_t marker_unfiltered_idx;
-  uintptr_t marker_idx;
-  int32_t pct;
-  uint32_t pct_thresh;
-  uint32_t window_unfiltered_start;
-  uint32_t window_unfiltered_end;
-  uint32_t cur_window_size;
-  uint32_t old_window_size;
-  uint32_t uii;
-  uint32_t ujj;
-  uint32_t ukk;
-  int32_t ii;
-  uint32_t cur_chrom;
-  uint32_t chrom_end;
-  uint32_t is_haploid;
-  uint32_t is_x;
-  uint32_t is_y;
   double* marker_stdevs;
   uintptr_t* loadbuf;
+  uintptr_t* geno;
+  uintptr_t* masks;
+  uintptr_t* mmasks;
   uint32_t* missing_cts;
-  uint32_t fixed_missing_ct;
-  uintptr_t ulii;
-  double dxx;
-  double cov12;
-  uint32_t fixed_non_missing_ct;
-  uint32_t non_missing_ct;
-  int32_t dp_result[3];
-  double non_missing_recip;
-  uintptr_t* geno_fixed_vec_ptr;
-  uintptr_t* geno_var_vec_ptr;
-  uintptr_t* mask_fixed_vec_ptr;
-  uintptr_t* mask_var_vec_ptr;
-  uintptr_t cur_exclude_ct;
-  uint32_t prev_end;
-  char* sptr;
-  FILE* fptr;
-  __CLPK_integer window_rem_li;
-  __CLPK_integer old_window_rem_li;
-  uint32_t window_rem;
-  double prune_ld_r1;
-  if (!founder_ct) {
-    sprintf(logbuf, "Warning: Skipping --indep%s since there are no founders.\n", pairwise? "-pairwise" : "");
-    logprintb();
-    goto ld_prune_ret_1;
+  uintptr_t* nonmale_geno;
+  uintptr_t* nonmale_masks;
+  // --indep only, or --indep-pairwise with precomputed windows
+  double* cov_matrix;
+  // --indep only
+  double* new_cov_matrix;
+  MATRIX_INVERT_BUF1_TYPE* irow;
+  double* work;
+  uint32_t* idx_remap;
+  // first column of each row that has to be computed in the current window
+  uint32_t* r_starts;
+} Ld_window_bufs;
+
+// below this many (pair, founder block) units, r values are computed on the
+// fly by the main thread instead of being farmed out to threads
+#define LD_MT_MIN_WORK 8192
+
+static FILE* g_ld_bedfile;
+static uintptr_t g_ld_bed_offset;
+static uintptr_t g_ld_unfiltered_marker_ct;
+static uintptr_t* g_ld_marker_exclude;
+static uintptr_t* g_ld_marker_reverse;
+static Chrom_info* g_ld_chrom_info_ptr;
+static double* g_ld_set_allele_freqs;
+static uint32_t* g_ld_marker_pos;
+static uintptr_t g_ld_unfiltered_indiv_ct;
+static uintptr_t* g_ld_founder_info;
+static uintptr_t* g_ld_founder_include2;
+static uintptr_t* g_ld_founder_male_include2;
+static uintptr_t g_ld_founder_ct;
+static uintptr_t g_ld_founder_ctv;
+static uintptr_t g_ld_founder_ct_mld_long;
+static uint32_t g_ld_founder_ct_mld_m1;
+static uint32_t g_ld_founder_ct_mld_rem;
+static uint32_t g_ld_nonmale_founder_ct;
+static uint32_t g_ld_window_size;
+static uint32_t g_ld_window_kb;
+static uint32_t g_ld_window_incr;
+static uintptr_t g_ld_window_max;
+static double g_ld_last_param;
+static double g_ld_prune_r1;
+static uint32_t g_ld_pairwise;
+static uint32_t g_ld_ignore_x;
+static uint32_t g_ld_weighted_x;
+static uint32_t g_ld_hh_exists;
+static Ld_window_bufs g_ld_bufs[MAX_THREADS];
+
+// chromosome-level scheduling
+static uint32_t g_ld_chrom_parallel;
+static uint32_t* g_ld_chrom_starts;
+static uintptr_t* g_ld_chrom_exclude_cts;
+static uint32_t g_ld_chrom_ct;
+static uint32_t g_ld_next_chrom;
+static int32_t g_ld_thread_rets[MAX_THREADS];
+
+// within-window r precomputation
+static uint32_t g_ld_r_rows[MAX_THREADS + 1];
+static uint32_t g_ld_r_window_size;
+static uint32_t g_ld_r_weighted_founder_ct;
+static uint32_t g_ld_r_is_x_weighted;
+
+static uint32_t ld_hom_ct_intersect(uintptr_t* geno_vec, uintptr_t* mask_vec, uintptr_t word_ct) {
+  // Number of homozygous calls (00 or 10 in ld_process_load()'s encoding) in
+  // geno_vec where mask_vec is set, i.e. the sum of squared -1/0/1 genotypes
+  // over the individuals called at both markers.
+  uintptr_t* geno_end = &(geno_vec[word_ct]);
+  uint32_t tot = 0;
+  while (geno_vec < geno_end) {
+    tot += popcount2_long((~(*geno_vec++)) & (*mask_vec++) & FIVEMASK);
   }
+  return tot;
+}
 
-  // force founder_male_include2 allocation
-  if (alloc_collapsed_haploid_filters(unfiltered_indiv_ct, founder_ct, XMHH_EXISTS | hh_exists, 1, founder_info, sex_male, &founder_include2, &founder_male_include2)) {
-    goto ld_prune_ret_NOMEM;
+double ld_pair_r(Ld_window_bufs* bufs, uint32_t uii, uint32_t ujj, uint32_t weighted_founder_ct, uint32_t is_x_weighted, uint32_t pairwise_var, double* dprime_ptr) {
+  // Pearson r (not squared) between window markers uii and ujj.  Every r
+  // value used for a pruning decision goes through here, whichever thread
+  // computes it.
+  //
+  // The covariance is always taken over the individuals called at both
+  // markers.  Pruning divides it by each marker's standard deviation over all
+  // its calls, as PLINK does; if pairwise_var is set (--r2), the variances
+  // are taken over the same pairwise-complete set instead, so the result is
+  // the ordinary Pearson r of that set.  NaN if either variance is zero.
+  //
+  // If dprime_ptr is non-NULL, |D'| is also saved there.  Phase is unknown,
+  // so this uses the composite (genotype-based) disequilibrium, half the
+  // allele count covariance; it equals the haplotype D under Hardy-Weinberg
+  // equilibrium.
+  uintptr_t founder_ct_mld_long = g_ld_founder_ct_mld_long;
+  uintptr_t founder_ctl = (g_ld_founder_ct + BITCT - 1) / BITCT;
+  uint32_t fixed_missing_ct = bufs->missing_cts[uii];
+  uint32_t fixed_non_missing_ct = weighted_founder_ct - fixed_missing_ct;
+  uintptr_t* geno_fixed_vec_ptr = &(bufs->geno[uii * founder_ct_mld_long]);
+  uintptr_t* mask_fixed_vec_ptr = &(bufs->masks[uii * founder_ct_mld_long]);
+  uintptr_t* geno_var_vec_ptr = &(bufs->geno[ujj * founder_ct_mld_long]);
+  uintptr_t* mask_var_vec_ptr = &(bufs->masks[ujj * founder_ct_mld_long]);
+  uint32_t non_missing_ct;
+  uint32_t ssq1 = 0;
+  uint32_t ssq2 = 0;
+  int32_t dp_result[3];
+  double non_missing_recip;
+  double cov12;
+  double var1;
+  double var2;
+  double freq1;
+  double freq2;
+  double dxx;
+  double dyy;
+  dp_result[0] = weighted_founder_ct;
+  // reversed from what I initially thought because I'm passing the
+  // ujj-associated buffers before the uii-associated ones.
+  dp_result[1] = -fixed_non_missing_ct;
+  dp_result[2] = bufs->missing_cts[ujj] - weighted_founder_ct;
+  ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, g_ld_founder_ct_mld_m1, g_ld_founder_ct_mld_rem);
+  if (pairwise_var) {
+    ssq1 = ld_hom_ct_intersect(geno_fixed_vec_ptr, mask_var_vec_ptr, 2 * founder_ctl);
+    ssq2 = ld_hom_ct_intersect(geno_var_vec_ptr, mask_fixed_vec_ptr, 2 * founder_ctl);
+  }
+  if (is_x_weighted) {
+    non_missing_ct = (popcount_longs_intersect(&(bufs->nonmale_masks[uii * founder_ct_mld_long]), &(bufs->nonmale_masks[ujj * founder_ct_mld_long]), 2 * founder_ctl) + popcount_longs_intersect(mask_fixed_vec_ptr, mask_var_vec_ptr, 2 * founder_ctl)) / 2;
+    ld_dot_prod(&(bufs->nonmale_geno[ujj * founder_ct_mld_long]), &(bufs->nonmale_geno[uii * founder_ct_mld_long]), &(bufs->nonmale_masks[ujj * founder_ct_mld_long]), &(bufs->nonmale_masks[uii * founder_ct_mld_long]), dp_result, g_ld_founder_ct_mld_m1, g_ld_founder_ct_mld_rem);
+    if (pairwise_var) {
+      ssq1 += ld_hom_ct_intersect(&(bufs->nonmale_geno[uii * founder_ct_mld_long]), &(bufs->nonmale_masks[ujj * founder_ct_mld_long]), 2 * founder_ctl);
+      ssq2 += ld_hom_ct_intersect(&(bufs->nonmale_geno[ujj * founder_ct_mld_long]), &(bufs->nonmale_masks[uii * founder_ct_mld_long]), 2 * founder_ctl);
+    }
+  } else {
+    non_missing_ct = fixed_non_missing_ct - bufs->missing_cts[ujj];
+    if (fixed_missing_ct && bufs->missing_cts[ujj]) {
+      non_missing_ct += popcount_longs_intersect(&(bufs->mmasks[uii * g_ld_founder_ctv]), &(bufs->mmasks[ujj * g_ld_founder_ctv]), founder_ctl);
+    }
+  }
+  non_missing_recip = 1.0 / ((double)((int32_t)non_missing_ct));
+  cov12 = non_missing_recip * (dp_result[0] - (non_missing_recip * dp_result[1]) * dp_result[2]);
+  if (dprime_ptr) {
+    // dp_result[1] and [2] are now the sums of the (-1/0/1-coded) genotypes
+    // of ujj and uii over the individuals nonmissing at both
+    freq1 = 0.5 * (non_missing_recip * dp_result[2] + 1.0);
+    freq2 = 0.5 * (non_missing_recip * dp_result[1] + 1.0);
+    dxx = 0.5 * cov12;
+    if (dxx < 0.0) {
+      dyy = MINV(freq1 * freq2, (1.0 - freq1) * (1.0 - freq2));
+      dxx = -dxx;
+    } else {
+      dyy = MINV(freq1 * (1.0 - freq2), (1.0 - freq1) * freq2);
+    }
+    if (dyy > 0.0) {
+      dxx /= dyy;
+      *dprime_ptr = (dxx > 1.0)? 1.0 : dxx;
+    } else {
+      *dprime_ptr = NAN;
+    }
   }
-  if (weighted_x) {
-    nonmale_founder_ct = founder_ct - popcount_longs(founder_male_include2, 0, founder_ctl);
-    if (founder_ct + nonmale_founder_ct > 0x7fffffff) {
-      // no, this shouldn't ever happen, but may as well document that there
-      // theoretically is a 32-bit integer range issue here
-      logprint("Error: Too many founders for --indep[-pairwise] + --ld-xchr 3.\n");
-      goto ld_prune_ret_1;
+  if (pairwise_var) {
+    var1 = non_missing_recip * (ssq1 - (non_missing_recip * dp_result[2]) * dp_result[2]);
+    var2 = non_missing_recip * (ssq2 - (non_missing_recip * dp_result[1]) * dp_result[1]);
+    if ((var1 <= 0.0) || (var2 <= 0.0)) {
+      return NAN;
     }
+    return cov12 / sqrt(var1 * var2);
   }
+  return cov12 / (bufs->marker_stdevs[uii] * bufs->marker_stdevs[ujj]);
+}
 
-  if (ld_window_kb) {
-    // determine maximum number of markers that may need to be loaded at once
-    for (cur_chrom = 0; cur_chrom <= max_code; cur_chrom++) {
-      if (chrom_exists(chrom_info_ptr, cur_chrom)) {
-        uii = chrom_info_ptr->chrom_start[cur_chrom];
-	chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
-        do {
-	  ujj = uii + 1;
-	  while ((ujj < chrom_end) && (marker_pos[ujj] <= marker_pos[uii] + (1000 * ld_window_size))) {
-	    ujj++;
-	  }
-          if (ujj - uii > window_max) {
-	    window_max = ujj - uii;
-	  }
-	  uii++;
-	} while (ujj < chrom_end);
+THREAD_RET_TYPE ld_prune_r_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  Ld_window_bufs* bufs = &(g_ld_bufs[0]);
+  uintptr_t window_max = g_ld_window_max;
+  uint32_t row_end = g_ld_r_rows[tidx + 1];
+  uint32_t window_size = g_ld_r_window_size;
+  uint32_t uii;
+  uint32_t ujj;
+  for (uii = g_ld_r_rows[tidx]; uii < row_end; uii++) {
+    for (ujj = bufs->r_starts[uii]; ujj < window_size; ujj++) {
+      if (!IS_SET(bufs->pruned_arr, bufs->live_indices[ujj])) {
+	bufs->cov_matrix[uii * window_max + ujj] = ld_pair_r(bufs, uii, ujj, g_ld_r_weighted_founder_ct, g_ld_r_is_x_weighted, 0, NULL);
       }
     }
   }
-  if (pairwise) {
-    prune_ld_r1 = sqrt(ld_last_param);
-  } else {
-    prune_ld_r1 = 0.999999;
-  }
+  THREAD_RETURN;
+}
 
-  window_unfiltered_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, unfiltered_marker_ct);
-  if (window_unfiltered_start == unfiltered_marker_ct) {
-    sprintf(logbuf, "Error: No valid markers for --indep%s.\n", pairwise? "-pairwise" : "");
-    logprintb();
-    goto ld_prune_ret_INVALID_FORMAT;
+int32_t ld_load_marker(Ld_window_bufs* bufs, uint32_t marker_uidx, uint32_t window_idx, uint32_t is_haploid, uint32_t is_x, uint32_t is_y) {
+  uintptr_t* geno_ptr = &(bufs->geno[window_idx * g_ld_founder_ct_mld_long]);
+  uint64_t offset = g_ld_bed_offset + ((uint64_t)marker_uidx) * ((g_ld_unfiltered_indiv_ct + 3) / 4);
+  if (g_ld_chrom_parallel) {
+    // several chromosomes are being read at once
+    if (load_and_collapse_incl_at(g_ld_bedfile, offset, bufs->loadbuf, g_ld_unfiltered_indiv_ct, geno_ptr, g_ld_founder_ct, g_ld_founder_info, IS_SET(g_ld_marker_reverse, marker_uidx))) {
+      return RET_READ_FAIL;
+    }
+  } else {
+    if (bed_seek(g_ld_bedfile, offset)) {
+      return RET_READ_FAIL;
+    }
+    if (load_and_collapse_incl(g_ld_bedfile, bufs->loadbuf, g_ld_unfiltered_indiv_ct, geno_ptr, g_ld_founder_ct, g_ld_founder_info, IS_SET(g_ld_marker_reverse, marker_uidx))) {
+      return RET_READ_FAIL;
+    }
   }
-
-  if (wkspace_alloc_ul_checked(&pruned_arr, unfiltered_marker_ctl * sizeof(intptr_t))) {
-    goto ld_prune_ret_NOMEM;
+  if (is_haploid && g_ld_hh_exists) {
+    haploid_fix(g_ld_hh_exists, g_ld_founder_include2, g_ld_founder_male_include2, g_ld_founder_ct, is_x, is_y, (unsigned char*)geno_ptr);
   }
+  bufs->missing_cts[window_idx] = ld_process_load(geno_ptr, &(bufs->masks[window_idx * g_ld_founder_ct_mld_long]), &(bufs->mmasks[window_idx * g_ld_founder_ctv]), &(bufs->marker_stdevs[window_idx]), g_ld_founder_ct, is_x && (!g_ld_ignore_x), g_ld_weighted_x, g_ld_nonmale_founder_ct, g_ld_founder_male_include2, bufs->nonmale_geno, bufs->nonmale_masks, window_idx * g_ld_founder_ct_mld_long);
+  return 0;
+}
 
-  memcpy(pruned_arr, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
-
-  if (!ld_window_kb) {
-    window_max = ld_window_size;
-  }
-  ulii = window_max;
-  if (wkspace_alloc_ui_checked(&live_indices, ulii * sizeof(int32_t)) ||
-      wkspace_alloc_ui_checked(&start_arr, ulii * sizeof(int32_t)) ||
-      wkspace_alloc_d_checked(&marker_stdevs, ulii * sizeof(double)) ||
-      wkspace_alloc_ul_checked(&loadbuf, unfiltered_indiv_ctl2 * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&geno, ulii * founder_ct_mld_long * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&g_masks, ulii * founder_ct_mld_long * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&g_mmasks, ulii * founder_ctv * sizeof(intptr_t)) ||
-      wkspace_alloc_ui_checked(&missing_cts, founder_ct * sizeof(int32_t))) {
-    goto ld_prune_ret_NOMEM;
-  }
+int32_t ld_prune_chrom(pthread_t* threads, Ld_window_bufs* bufs, uint32_t window_unfiltered_start, uintptr_t* cur_exclude_ct_ptr) {
+  // Prunes the chromosome starting at window_unfiltered_start.  threads is
+  // NULL when chromosomes are being processed in parallel; otherwise large
+  // windows have their new r values computed by all threads before the
+  // (sequential) pruning pass.
+  uintptr_t* marker_exclude = g_ld_marker_exclude;
+  uintptr_t* pruned_arr = bufs->pruned_arr;
+  uint32_t* live_indices = bufs->live_indices;
+  uint32_t* start_arr = bufs->start_arr;
+  double* marker_stdevs = bufs->marker_stdevs;
+  uintptr_t* geno = bufs->geno;
+  uintptr_t* masks = bufs->masks;
+  uintptr_t* mmasks = bufs->mmasks;
+  uint32_t* missing_cts = bufs->missing_cts;
+  uintptr_t* nonmale_geno = bufs->nonmale_geno;
+  uintptr_t* nonmale_masks = bufs->nonmale_masks;
+  double* cov_matrix = bufs->cov_matrix;
+  double* new_cov_matrix = bufs->new_cov_matrix;
+  MATRIX_INVERT_BUF1_TYPE* irow = bufs->irow;
+  double* work = bufs->work;
+  uint32_t* idx_remap = bufs->idx_remap;
+  Chrom_info* chrom_info_ptr = g_ld_chrom_info_ptr;
+  uintptr_t window_max = g_ld_window_max;
+  uintptr_t founder_ct_mld_long = g_ld_founder_ct_mld_long;
+  uintptr_t founder_ctl = (g_ld_founder_ct + BITCT - 1) / BITCT;
+  uintptr_t founder_ctv = g_ld_founder_ctv;
+  uint32_t weighted_founder_ct = g_ld_founder_ct;
+  uint32_t pairwise = g_ld_pairwise;
+  uint32_t weighted_x = g_ld_weighted_x;
+  uint32_t ld_window_size = g_ld_window_size;
+  uint32_t ld_window_kb = g_ld_window_kb;
+  uint32_t ld_window_incr = g_ld_window_incr;
+  uint32_t* marker_pos = g_ld_marker_pos;
+  double prune_ld_r1 = g_ld_prune_r1;
+  uint32_t show_progress = !g_ld_chrom_parallel;
+  uint32_t at_least_one_prune = 0;
+  uintptr_t cur_exclude_ct = 0;
+  int32_t retval = 0;
+  uint32_t window_unfiltered_end;
+  uint32_t cur_window_size;
+  uint32_t old_window_size;
+  uint32_t prev_end;
+  uint32_t precomputed;
+  uint32_t cur_chrom;
+  uint32_t chrom_end;
+  uint32_t is_haploid;
+  uint32_t is_x;
+  uint32_t is_y;
+  uint32_t pct_thresh = 0;
+  int32_t pct = 1;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t ukk;
+  int32_t ii;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  double dxx;
+  __CLPK_integer window_rem_li;
+  __CLPK_integer old_window_rem_li;
+  uint32_t window_rem;
+  prev_end = 0;
+  ld_prune_start_chrom(ld_window_kb, &cur_chrom, &chrom_end, window_unfiltered_start, live_indices, start_arr, &window_unfiltered_end, ld_window_size, &cur_window_size, g_ld_unfiltered_marker_ct, pruned_arr, chrom_info_ptr, marker_pos, &is_haploid, &is_x, &is_y);
   if (weighted_x) {
-    if (wkspace_alloc_ul_checked(&nonmale_geno, ulii * founder_ct_mld_long * sizeof(intptr_t)) ||
-        wkspace_alloc_ul_checked(&nonmale_masks, ulii * founder_ct_mld_long * sizeof(intptr_t))) {
-      goto ld_prune_ret_NOMEM;
+    if (is_x) {
+      weighted_founder_ct = 2 * g_ld_founder_ct;
+    } else {
+      weighted_founder_ct = g_ld_founder_ct;
     }
   }
-  if (founder_trail_ct) {
-    for (ulii = 1; ulii <= window_max; ulii++) {
-      fill_ulong_zero(&(geno[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-      fill_ulong_zero(&(g_masks[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-      if (weighted_x) {
-	fill_ulong_zero(&(nonmale_geno[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-	fill_ulong_zero(&(nonmale_masks[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+  old_window_size = 1;
+  if (cur_window_size > 1) {
+    for (ulii = 0; ulii < (uintptr_t)cur_window_size; ulii++) {
+      retval = ld_load_marker(bufs, live_indices[ulii], ulii, is_haploid, is_x, is_y);
+      if (retval) {
+	goto ld_prune_chrom_ret_1;
       }
     }
   }
-  if (!pairwise) {
-    if (wkspace_alloc_d_checked(&cov_matrix, window_max * window_max * sizeof(double)) ||
-        wkspace_alloc_d_checked(&new_cov_matrix, window_max * window_max * sizeof(double)) ||
-        wkspace_alloc_ui_checked(&idx_remap, window_max * sizeof(int32_t))) {
-      goto ld_prune_ret_NOMEM;
-    }
-
-    irow = (MATRIX_INVERT_BUF1_TYPE*)wkspace_alloc(window_max * 2 * sizeof(MATRIX_INVERT_BUF1_TYPE));
-    if (!irow) {
-      goto ld_prune_ret_NOMEM;
-    }
-
-    if (window_max < 4) {
-      ulii = 4;
-    } else {
-      ulii = window_max;
-    }
-    if (wkspace_alloc_d_checked(&work, ulii * window_max * sizeof(double))) {
-      goto ld_prune_ret_NOMEM;
-    }
+  if (show_progress) {
+    pct_thresh = window_unfiltered_start + ((int64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100;
   }
-  do {
-    prev_end = 0;
-    ld_prune_start_chrom(ld_window_kb, &cur_chrom, &chrom_end, window_unfiltered_start, live_indices, start_arr, &window_unfiltered_end, ld_window_size, &cur_window_size, unfiltered_marker_ct, pruned_arr, chrom_info_ptr, marker_pos, &is_haploid, &is_x, &is_y);
-    if (weighted_x) {
-      if (is_x) {
-	weighted_founder_ct = 2 * founder_ct;
-      } else {
-	weighted_founder_ct = founder_ct;
-      }
-    }
-    old_window_size = 1;
+  while ((window_unfiltered_start < chrom_end) || (cur_window_size > 1)) {
     if (cur_window_size > 1) {
-      for (ulii = 0; ulii < (uintptr_t)cur_window_size; ulii++) {
-	uii = live_indices[ulii];
-	if (fseeko(bedfile, bed_offset + (uii * unfiltered_indiv_ct4), SEEK_SET)) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_indiv_ct, &(geno[ulii * founder_ct_mld_long]), founder_ct, founder_info, IS_SET(marker_reverse, uii))) {
-	  goto ld_prune_ret_READ_FAIL;
+      for (uii = 0; uii < cur_window_size; uii++) {
+	if (marker_stdevs[uii] == 0.0) {
+	  SET_BIT(pruned_arr, live_indices[uii]);
+	  cur_exclude_ct++;
+	}
+      }
+      precomputed = 0;
+      if (threads && bufs->r_starts) {
+	// Every r value the pruning pass below can ask for is a pair
+	// (uii, ujj >= first column not covered by an earlier window) of
+	// markers that are still live now, so compute all of them up front,
+	// across threads.  The pruning pass then only looks them up, so its
+	// decisions are unchanged.
+	uljj = 0;
+	for (uii = 0; uii < cur_window_size - 1; uii++) {
+	  ujj = cur_window_size;
+	  if (!IS_SET(pruned_arr, live_indices[uii])) {
+	    ujj = uii + 1;
+	    while ((ujj < cur_window_size) && (live_indices[ujj] < start_arr[uii])) {
+	      ujj++;
+	    }
+	    uljj += cur_window_size - ujj;
+	  }
+	  bufs->r_starts[uii] = ujj;
 	}
-	if (is_haploid && hh_exists) {
-	  haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[ulii * founder_ct_mld_long])));
+	if (uljj * founder_ct_mld_long >= LD_MT_MIN_WORK) {
+	  // split rows between threads by pair count
+	  g_ld_r_rows[0] = 0;
+	  uii = 0;
+	  ulii = 0;
+	  for (ukk = 1; ukk < g_thread_ct; ukk++) {
+	    while ((uii < cur_window_size - 1) && (ulii < (uljj * ukk) / g_thread_ct)) {
+	      ulii += cur_window_size - bufs->r_starts[uii];
+	      uii++;
+	    }
+	    g_ld_r_rows[ukk] = uii;
+	  }
+	  g_ld_r_rows[g_thread_ct] = cur_window_size - 1;
+	  g_ld_r_window_size = cur_window_size;
+	  g_ld_r_weighted_founder_ct = weighted_founder_ct;
+	  g_ld_r_is_x_weighted = is_x && weighted_x;
+	  if (spawn_threads(threads, &ld_prune_r_thread, g_thread_ct)) {
+	    logprint(errstr_thread_create);
+	    retval = RET_THREAD_CREATE_FAIL;
+	    goto ld_prune_chrom_ret_1;
+	  }
+	  ld_prune_r_thread((void*)0);
+	  join_threads(threads, g_thread_ct);
+	  precomputed = 1;
 	}
-        missing_cts[ulii] = ld_process_load(&(geno[ulii * founder_ct_mld_long]), &(g_masks[ulii * founder_ct_mld_long]), &(g_mmasks[ulii * founder_ctv]), &(marker_stdevs[ulii]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, ulii * founder_ct_mld_long);
       }
-    }
-    pct = 1;
-    pct_thresh = window_unfiltered_start + ((int64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100;
-    cur_exclude_ct = 0;
-    while ((window_unfiltered_start < chrom_end) || (cur_window_size > 1)) {
-      if (cur_window_size > 1) {
-	for (uii = 0; uii < cur_window_size; uii++) {
-	  if (marker_stdevs[uii] == 0.0) {
-	    SET_BIT(pruned_arr, live_indices[uii]);
-	    cur_exclude_ct++;
+      do {
+	at_least_one_prune = 0;
+	for (uii = 0; uii < cur_window_size - 1; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
 	  }
-	}
-	do {
-	  at_least_one_prune = 0;
-	  for (uii = 0; uii < cur_window_size - 1; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
+	  ujj = uii + 1;
+	  while (live_indices[ujj] < start_arr[uii]) {
+	    if (++ujj == cur_window_size) {
+	      break;
 	    }
-            fixed_missing_ct = missing_cts[uii];
-	    fixed_non_missing_ct = weighted_founder_ct - fixed_missing_ct;
-	    geno_fixed_vec_ptr = &(geno[uii * founder_ct_mld_long]);
-	    mask_fixed_vec_ptr = &(g_masks[uii * founder_ct_mld_long]);
-	    ujj = uii + 1;
-	    while (live_indices[ujj] < start_arr[uii]) {
-	      if (++ujj == cur_window_size) {
-		break;
-	      }
+	  }
+	  for (; ujj < cur_window_size; ujj++) {
+	    if (IS_SET(pruned_arr, live_indices[ujj])) {
+	      continue;
 	    }
-	    for (; ujj < cur_window_size; ujj++) {
-	      if (IS_SET(pruned_arr, live_indices[ujj])) {
-		continue;
-	      }
-	      geno_var_vec_ptr = &(geno[ujj * founder_ct_mld_long]);
-	      mask_var_vec_ptr = &(g_masks[ujj * founder_ct_mld_long]);
-
-	      dp_result[0] = weighted_founder_ct;
-	      // reversed from what I initially thought because I'm passing the
-	      // ujj-associated buffers before the uii-associated ones.
-	      dp_result[1] = -fixed_non_missing_ct;
-	      dp_result[2] = missing_cts[ujj] - weighted_founder_ct;
-	      ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
-	      if (is_x && weighted_x) {
-		non_missing_ct = (popcount_longs_intersect(&(nonmale_masks[uii * founder_ct_mld_long]), &(nonmale_masks[ujj * founder_ct_mld_long]), 2 * founder_ctl) + popcount_longs_intersect(mask_fixed_vec_ptr, mask_var_vec_ptr, 2 * founder_ctl)) / 2;
-		ld_dot_prod(&(nonmale_geno[ujj * founder_ct_mld_long]), &(nonmale_geno[uii * founder_ct_mld_long]), &(nonmale_masks[ujj * founder_ct_mld_long]), &(nonmale_masks[uii * founder_ct_mld_long]), dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
-	      } else {
-	        non_missing_ct = fixed_non_missing_ct - missing_cts[ujj];
-		if (fixed_missing_ct && missing_cts[ujj]) {
-		  non_missing_ct += popcount_longs_intersect(&(g_mmasks[uii * founder_ctv]), &(g_mmasks[ujj * founder_ctv]), founder_ctl);
-		}
-	      }
-	      non_missing_recip = 1.0 / ((double)((int32_t)non_missing_ct));
-	      cov12 = non_missing_recip * (dp_result[0] - (non_missing_recip * dp_result[1]) * dp_result[2]);
-	      // r, not squared
-	      dxx = cov12 / (marker_stdevs[uii] * marker_stdevs[ujj]);
+	    if (precomputed) {
+	      dxx = cov_matrix[uii * window_max + ujj];
+	    } else {
+	      dxx = ld_pair_r(bufs, uii, ujj, weighted_founder_ct, is_x && weighted_x, 0, NULL);
 	      if (!pairwise) {
 		cov_matrix[uii * window_max + ujj] = dxx;
 	      }
-	      if (fabs(dxx) > prune_ld_r1) {
-		at_least_one_prune = 1;
-		cur_exclude_ct++;
-		// remove marker with lower MAF
-		if (get_maf(set_allele_freqs[live_indices[uii]]) < get_maf(set_allele_freqs[live_indices[ujj]])) {
-		  SET_BIT(pruned_arr, live_indices[uii]);
-		} else {
-		  SET_BIT(pruned_arr, live_indices[ujj]);
-		  ujj++;
-		  while (ujj < cur_window_size) {
-		    if (!IS_SET(pruned_arr, live_indices[ujj])) {
-		      break;
-		    }
-		    ujj++;
-		  }
-		  if (ujj < cur_window_size) {
-		    start_arr[uii] = live_indices[ujj];
+	    }
+	    if (fabs(dxx) > prune_ld_r1) {
+	      at_least_one_prune = 1;
+	      cur_exclude_ct++;
+	      // remove marker with lower MAF
+	      if (get_maf(g_ld_set_allele_freqs[live_indices[uii]]) < get_maf(g_ld_set_allele_freqs[live_indices[ujj]])) {
+		SET_BIT(pruned_arr, live_indices[uii]);
+	      } else {
+		SET_BIT(pruned_arr, live_indices[ujj]);
+		ujj++;
+		while (ujj < cur_window_size) {
+		  if (!IS_SET(pruned_arr, live_indices[ujj])) {
+		    break;
 		  }
+		  ujj++;
+		}
+		if (ujj < cur_window_size) {
+		  start_arr[uii] = live_indices[ujj];
 		}
-		break;
 	      }
-	    }
-	    if (ujj == cur_window_size) {
-	      start_arr[uii] = window_unfiltered_end;
+	      break;
 	    }
 	  }
-	} while (at_least_one_prune);
-	if (!pairwise) {
-	  window_rem = 0;
-	  old_window_rem_li = 0;
-	  for (uii = 0; uii < old_window_size; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
-	    }
-            idx_remap[window_rem++] = uii;
+	  if (ujj == cur_window_size) {
+	    start_arr[uii] = window_unfiltered_end;
 	  }
-	  old_window_rem_li = window_rem;
-	  for (; uii < cur_window_size; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
+	}
+      } while (at_least_one_prune);
+      if (!pairwise) {
+	window_rem = 0;
+	old_window_rem_li = 0;
+	for (uii = 0; uii < old_window_size; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
+	  }
+	  idx_remap[window_rem++] = uii;
+	}
+	old_window_rem_li = window_rem;
+	for (; uii < cur_window_size; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
+	  }
+	  idx_remap[window_rem++] = uii;
+	}
+	while (window_rem > 1) {
+	  new_cov_matrix[0] = 1.0;
+	  for (uii = 1; uii < window_rem; uii++) {
+	    ukk = idx_remap[uii];
+	    for (ujj = 0; ujj < uii; ujj++) {
+	      dxx = cov_matrix[idx_remap[ujj] * window_max + ukk];
+	      new_cov_matrix[ujj * window_rem + uii] = dxx;
+	      new_cov_matrix[uii * window_rem + ujj] = dxx;
 	    }
-            idx_remap[window_rem++] = uii;
+	    new_cov_matrix[uii * (window_rem + 1)] = 1.0;
 	  }
-	  while (window_rem > 1) {
+	  window_rem_li = window_rem;
+	  ii = invert_matrix_trunc_singular(window_rem_li, new_cov_matrix, irow, work, old_window_rem_li);
+	  while (ii) {
+	    if (ii == -1) {
+	      retval = RET_NOMEM;
+	      goto ld_prune_chrom_ret_1;
+	    }
+	    ujj = ii;
+	    SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
+	    cur_exclude_ct++;
+	    window_rem--;
+	    for (uii = ujj; uii < window_rem; uii++) {
+	      idx_remap[uii] = idx_remap[uii + 1];
+	    }
 	    new_cov_matrix[0] = 1.0;
 	    for (uii = 1; uii < window_rem; uii++) {
 	      ukk = idx_remap[uii];
@@ -5265,62 +6673,34 @@ int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintpt
 	    }
 	    window_rem_li = window_rem;
 	    ii = invert_matrix_trunc_singular(window_rem_li, new_cov_matrix, irow, work, old_window_rem_li);
-	    while (ii) {
-	      if (ii == -1) {
-		goto ld_prune_ret_NOMEM;
-	      }
-	      ujj = ii;
-              SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
-	      cur_exclude_ct++;
-	      window_rem--;
-	      for (uii = ujj; uii < window_rem; uii++) {
-		idx_remap[uii] = idx_remap[uii + 1];
-	      }
-	      new_cov_matrix[0] = 1.0;
-	      for (uii = 1; uii < window_rem; uii++) {
-		ukk = idx_remap[uii];
-		for (ujj = 0; ujj < uii; ujj++) {
-		  dxx = cov_matrix[idx_remap[ujj] * window_max + ukk];
-		  new_cov_matrix[ujj * window_rem + uii] = dxx;
-		  new_cov_matrix[uii * window_rem + ujj] = dxx;
-		}
-		new_cov_matrix[uii * (window_rem + 1)] = 1.0;
-	      }
-              window_rem_li = window_rem;
-	      ii = invert_matrix_trunc_singular(window_rem_li, new_cov_matrix, irow, work, old_window_rem_li);
+	  }
+	  dxx = new_cov_matrix[0];
+	  ujj = 0;
+	  for (uii = 1; uii < window_rem; uii++) {
+	    if (new_cov_matrix[uii * (window_rem + 1)] > dxx) {
+	      dxx = new_cov_matrix[uii * (window_rem + 1)];
+	      ujj = uii;
 	    }
-	    dxx = new_cov_matrix[0];
-	    ujj = 0;
-	    for (uii = 1; uii < window_rem; uii++) {
-              if (new_cov_matrix[uii * (window_rem + 1)] > dxx) {
-		dxx = new_cov_matrix[uii * (window_rem + 1)];
-		ujj = uii;
-	      }
+	  }
+	  if (dxx > g_ld_last_param) {
+	    SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
+	    cur_exclude_ct++;
+	    window_rem--;
+	    if (idx_remap[ujj] < (uint32_t)old_window_size) {
+	      old_window_rem_li--;
 	    }
-	    if (dxx > ld_last_param) {
-	      SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
-	      cur_exclude_ct++;
-	      window_rem--;
-	      if (idx_remap[ujj] < (uint32_t)old_window_size) {
-		old_window_rem_li--;
-	      }
-	      for (uii = ujj; uii < window_rem; uii++) {
-                idx_remap[uii] = idx_remap[uii + 1];
-	      }
-	    } else {
-	      // break out
-	      window_rem = 1;
+	    for (uii = ujj; uii < window_rem; uii++) {
+	      idx_remap[uii] = idx_remap[uii + 1];
 	    }
+	  } else {
+	    // break out
+	    window_rem = 1;
 	  }
 	}
       }
-      for (uii = 0; uii < ld_window_incr; uii++) {
-	while (IS_SET(marker_exclude, window_unfiltered_start)) {
-	  if (window_unfiltered_start == chrom_end) {
-	    break;
-	  }
-	  window_unfiltered_start++;
-	}
+    }
+    for (uii = 0; uii < ld_window_incr; uii++) {
+      while (IS_SET(marker_exclude, window_unfiltered_start)) {
 	if (window_unfiltered_start == chrom_end) {
 	  break;
 	}
@@ -5329,116 +6709,414 @@ int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintpt
       if (window_unfiltered_start == chrom_end) {
 	break;
       }
-      if (window_unfiltered_start >= pct_thresh) {
-	pct = (((int64_t)(window_unfiltered_start - chrom_info_ptr->chrom_start[cur_chrom])) * 100) / (chrom_end - chrom_info_ptr->chrom_start[cur_chrom]);
-	printf("\r%d%%", pct++);
-	fflush(stdout);
-	pct_thresh = chrom_info_ptr->chrom_start[cur_chrom] + (((int64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100);
+      window_unfiltered_start++;
+    }
+    if (window_unfiltered_start == chrom_end) {
+      break;
+    }
+    if (show_progress && (window_unfiltered_start >= pct_thresh)) {
+      pct = (((int64_t)(window_unfiltered_start - chrom_info_ptr->chrom_start[cur_chrom])) * 100) / (chrom_end - chrom_info_ptr->chrom_start[cur_chrom]);
+      printf("\r%d%%", pct++);
+      fflush(stdout);
+      pct_thresh = chrom_info_ptr->chrom_start[cur_chrom] + (((int64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100);
+    }
+    ujj = 0;
+    // copy back previously loaded/computed results
+    while (live_indices[ujj] < window_unfiltered_start) {
+      ujj++;
+      if (ujj == cur_window_size) {
+	break;
       }
-      ujj = 0;
-      // copy back previously loaded/computed results
-      while (live_indices[ujj] < window_unfiltered_start) {
-	ujj++;
-	if (ujj == cur_window_size) {
-	  break;
-	}
+    }
+    for (uii = 0; ujj < cur_window_size; ujj++) {
+      if (IS_SET(pruned_arr, live_indices[ujj])) {
+	continue;
       }
-      for (uii = 0; ujj < cur_window_size; ujj++) {
-	if (IS_SET(pruned_arr, live_indices[ujj])) {
-	  continue;
-	}
-	memcpy(&(geno[uii * founder_ct_mld_long]), &(geno[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
-	memcpy(&(g_masks[uii * founder_ct_mld_long]), &(g_masks[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
-	if (is_x && weighted_x) {
-	  memcpy(&(nonmale_geno[uii * founder_ct_mld_long]), &(nonmale_geno[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
-	  memcpy(&(nonmale_masks[uii * founder_ct_mld_long]), &(nonmale_masks[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
-	}
-	memcpy(&(g_mmasks[uii * founder_ctv]), &(g_mmasks[ujj * founder_ctv]), founder_ctl * sizeof(intptr_t));
-	marker_stdevs[uii] = marker_stdevs[ujj];
-	live_indices[uii] = live_indices[ujj];
-	start_arr[uii] = start_arr[ujj];
-	missing_cts[uii] = missing_cts[ujj];
-	if (!pairwise) {
-	  for (ukk = 0; ukk < uii; ukk++) {
-	    cov_matrix[ukk * window_max + uii] = cov_matrix[idx_remap[ukk] * window_max + ujj];
-	  }
-	  idx_remap[uii] = ujj;
+      memcpy(&(geno[uii * founder_ct_mld_long]), &(geno[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
+      memcpy(&(masks[uii * founder_ct_mld_long]), &(masks[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
+      if (is_x && weighted_x) {
+	memcpy(&(nonmale_geno[uii * founder_ct_mld_long]), &(nonmale_geno[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
+	memcpy(&(nonmale_masks[uii * founder_ct_mld_long]), &(nonmale_masks[ujj * founder_ct_mld_long]), founder_ct_mld_long * sizeof(intptr_t));
+      }
+      memcpy(&(mmasks[uii * founder_ctv]), &(mmasks[ujj * founder_ctv]), founder_ctl * sizeof(intptr_t));
+      marker_stdevs[uii] = marker_stdevs[ujj];
+      live_indices[uii] = live_indices[ujj];
+      start_arr[uii] = start_arr[ujj];
+      missing_cts[uii] = missing_cts[ujj];
+      if (!pairwise) {
+	for (ukk = 0; ukk < uii; ukk++) {
+	  cov_matrix[ukk * window_max + uii] = cov_matrix[idx_remap[ukk] * window_max + ujj];
 	}
-	uii++;
+	idx_remap[uii] = ujj;
       }
+      uii++;
+    }
 
-      prev_end = uii;
-      cur_window_size = uii;
-      if (ld_window_kb) {
-	ujj = 0;
-	while ((window_unfiltered_end + ujj < chrom_end) && (marker_pos[window_unfiltered_end + ujj] <= marker_pos[window_unfiltered_start] + (1000 * ld_window_size))) {
-	  ujj++;
-	}
-      } else {
-	ujj = ld_window_incr;
+    prev_end = uii;
+    cur_window_size = uii;
+    if (ld_window_kb) {
+      ujj = 0;
+      while ((window_unfiltered_end + ujj < chrom_end) && (marker_pos[window_unfiltered_end + ujj] <= marker_pos[window_unfiltered_start] + (1000 * ld_window_size))) {
+	ujj++;
       }
-      old_window_size = cur_window_size;
-      for (uii = 0; uii < ujj; window_unfiltered_end++, uii++) {
-	next_unset_ck(marker_exclude, &window_unfiltered_end, chrom_end);
-	if (window_unfiltered_end == chrom_end) {
-	  break;
-	}
-	live_indices[cur_window_size] = window_unfiltered_end;
-	if (cur_window_size > prev_end) {
-	  start_arr[cur_window_size - 1] = window_unfiltered_end;
-	}
-	if (fseeko(bedfile, bed_offset + (window_unfiltered_end * unfiltered_indiv_ct4), SEEK_SET)) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_indiv_ct, &(geno[cur_window_size * founder_ct_mld_long]), founder_ct, founder_info, IS_SET(marker_reverse, window_unfiltered_end))) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (is_haploid && hh_exists) {
-	  haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[cur_window_size * founder_ct_mld_long])));
-	}
-	missing_cts[cur_window_size] = ld_process_load(&(geno[cur_window_size * founder_ct_mld_long]), &(g_masks[cur_window_size * founder_ct_mld_long]), &(g_mmasks[cur_window_size * founder_ctv]), &(marker_stdevs[cur_window_size]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, cur_window_size * founder_ct_mld_long);
-	cur_window_size++;
+    } else {
+      ujj = ld_window_incr;
+    }
+    old_window_size = cur_window_size;
+    bed_mmap_willneed(g_ld_bed_offset + ((uint64_t)window_unfiltered_end) * ((g_ld_unfiltered_indiv_ct + 3) / 4), ((uint64_t)ujj) * ((g_ld_unfiltered_indiv_ct + 3) / 4));
+    for (uii = 0; uii < ujj; window_unfiltered_end++, uii++) {
+      next_unset_ck(marker_exclude, &window_unfiltered_end, chrom_end);
+      if (window_unfiltered_end == chrom_end) {
+	break;
       }
+      live_indices[cur_window_size] = window_unfiltered_end;
       if (cur_window_size > prev_end) {
-	start_arr[cur_window_size] = window_unfiltered_end;
+	start_arr[cur_window_size - 1] = window_unfiltered_end;
       }
+      retval = ld_load_marker(bufs, window_unfiltered_end, cur_window_size, is_haploid, is_x, is_y);
+      if (retval) {
+	goto ld_prune_chrom_ret_1;
+      }
+      cur_window_size++;
+    }
+    if (cur_window_size > prev_end) {
+      start_arr[cur_window_size] = window_unfiltered_end;
     }
-    uii = get_marker_chrom(chrom_info_ptr, window_unfiltered_start - 1);
-    putchar('\r');
-    sprintf(logbuf, "Pruned %" PRIuPTR " marker%s from chromosome %u, leaving %" PRIuPTR ".\n", cur_exclude_ct, (cur_exclude_ct == 1)? "" : "s", uii, chrom_info_ptr->chrom_end[uii] - chrom_info_ptr->chrom_start[uii] - cur_exclude_ct);
-    logprintb();
-    tot_exclude_ct += cur_exclude_ct;
-
-    // advance chromosomes as necessary
-    window_unfiltered_start = ld_prune_next_valid_chrom_start(pruned_arr, window_unfiltered_start, chrom_info_ptr, unfiltered_marker_ct);
-  } while (window_unfiltered_start < unfiltered_marker_ct);
-
-  sprintf(logbuf, "Pruning complete.  %d of %d markers removed.\n", tot_exclude_ct, marker_ct);
-  logprintb();
-  strcpy(outname_end, ".prune.in");
-  if (fopen_checked(&outfile_in, outname, "w")) {
-    goto ld_prune_ret_OPEN_FAIL;
-  }
-  strcpy(outname_end, ".prune.out");
-  if (fopen_checked(&outfile_out, outname, "w")) {
-    goto ld_prune_ret_OPEN_FAIL;
   }
-  marker_unfiltered_idx = 0;
-  marker_idx = 0;
-  pct = 1;
-  uii = 0;
-  for (cur_chrom = 1; cur_chrom <= chrom_info_ptr->max_code; cur_chrom++) {
-    if (!IS_SET(chrom_info_ptr->chrom_mask, cur_chrom)) {
-      continue;
+  *cur_exclude_ct_ptr = cur_exclude_ct;
+ ld_prune_chrom_ret_1:
+  return retval;
+}
+
+THREAD_RET_TYPE ld_prune_chrom_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uint32_t chrom_idx;
+  int32_t retval;
+  while (1) {
+    chrom_idx = __sync_fetch_and_add(&g_ld_next_chrom, 1);
+    if (chrom_idx >= g_ld_chrom_ct) {
+      break;
     }
-    if (chrom_info_ptr->chrom_end[cur_chrom]) {
-      uii += chrom_info_ptr->chrom_end[cur_chrom] - chrom_info_ptr->chrom_start[cur_chrom];
+    retval = ld_prune_chrom(NULL, &(g_ld_bufs[tidx]), g_ld_chrom_starts[chrom_idx], &(g_ld_chrom_exclude_cts[chrom_idx]));
+    if (retval) {
+      g_ld_thread_rets[tidx] = retval;
+      break;
     }
   }
-  pct_thresh = ((int64_t)pct * uii) / 100;
-  for (cur_chrom = 1; cur_chrom <= chrom_info_ptr->max_code; cur_chrom++) {
-    chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
-    if (!chrom_end) {
+  THREAD_RETURN;
+}
+
+uint32_t ld_alloc_window_bufs(Ld_window_bufs* bufs, uintptr_t unfiltered_marker_ctl, uintptr_t* marker_exclude, uint32_t indep_bufs) {
+  // returns 1 on out-of-memory
+  uintptr_t window_max = g_ld_window_max;
+  uintptr_t founder_ct_mld_long = g_ld_founder_ct_mld_long;
+  uintptr_t unfiltered_indiv_ctl2 = 2 * ((g_ld_unfiltered_indiv_ct + (BITCT - 1)) / BITCT);
+  uintptr_t founder_trail_ct = founder_ct_mld_long - 2 * ((g_ld_founder_ct + BITCT - 1) / BITCT);
+  uintptr_t ulii;
+  if (wkspace_alloc_ul_checked(&(bufs->pruned_arr), unfiltered_marker_ctl * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&(bufs->live_indices), window_max * sizeof(int32_t)) ||
+      wkspace_alloc_ui_checked(&(bufs->start_arr), (window_max + 1) * sizeof(int32_t)) ||
+      wkspace_alloc_d_checked(&(bufs->marker_stdevs), window_max * sizeof(double)) ||
+      wkspace_alloc_ul_checked(&(bufs->loadbuf), unfiltered_indiv_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufs->geno), window_max * founder_ct_mld_long * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufs->masks), window_max * founder_ct_mld_long * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufs->mmasks), window_max * g_ld_founder_ctv * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&(bufs->missing_cts), window_max * sizeof(int32_t))) {
+    return 1;
+  }
+  memcpy(bufs->pruned_arr, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
+  bufs->nonmale_geno = NULL;
+  bufs->nonmale_masks = NULL;
+  if (g_ld_weighted_x) {
+    if (wkspace_alloc_ul_checked(&(bufs->nonmale_geno), window_max * founder_ct_mld_long * sizeof(intptr_t)) ||
+        wkspace_alloc_ul_checked(&(bufs->nonmale_masks), window_max * founder_ct_mld_long * sizeof(intptr_t))) {
+      return 1;
+    }
+  }
+  if (founder_trail_ct) {
+    for (ulii = 1; ulii <= window_max; ulii++) {
+      fill_ulong_zero(&(bufs->geno[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+      fill_ulong_zero(&(bufs->masks[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+      if (g_ld_weighted_x) {
+	fill_ulong_zero(&(bufs->nonmale_geno[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+	fill_ulong_zero(&(bufs->nonmale_masks[ulii * founder_ct_mld_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+      }
+    }
+  }
+  bufs->cov_matrix = NULL;
+  bufs->new_cov_matrix = NULL;
+  bufs->irow = NULL;
+  bufs->work = NULL;
+  bufs->idx_remap = NULL;
+  bufs->r_starts = NULL;
+  if (indep_bufs) {
+    if (wkspace_alloc_d_checked(&(bufs->cov_matrix), window_max * window_max * sizeof(double)) ||
+        wkspace_alloc_d_checked(&(bufs->new_cov_matrix), window_max * window_max * sizeof(double)) ||
+        wkspace_alloc_ui_checked(&(bufs->idx_remap), window_max * sizeof(int32_t))) {
+      return 1;
+    }
+    bufs->irow = (MATRIX_INVERT_BUF1_TYPE*)wkspace_alloc(window_max * 2 * sizeof(MATRIX_INVERT_BUF1_TYPE));
+    if (!bufs->irow) {
+      return 1;
+    }
+    ulii = (window_max < 4)? 4 : window_max;
+    if (wkspace_alloc_d_checked(&(bufs->work), ulii * window_max * sizeof(double))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int32_t ld_init_founders(uintptr_t unfiltered_indiv_ct, uintptr_t* founder_info, uintptr_t* sex_male, uint64_t misc_flags, uint32_t hh_exists, const char* flagname) {
+  // Sets the founder-related g_ld_ variables shared by --indep[-pairwise] and
+  // --r2.  g_ld_founder_ct is zero (after a warning) if there's nothing to
+  // do.
+  uintptr_t unfiltered_indiv_ctl = (unfiltered_indiv_ct + (BITCT - 1)) / BITCT;
+  uintptr_t founder_ct = popcount_longs(founder_info, 0, unfiltered_indiv_ctl);
+  uintptr_t founder_ctl = (founder_ct + BITCT - 1) / BITCT;
+  uintptr_t founder_ct_mld = (founder_ct + MULTIPLEX_LD - 1) / MULTIPLEX_LD;
+  uint32_t weighted_x = (misc_flags / MISC_LD_WEIGHTED_X) & 1;
+  uintptr_t* founder_include2 = NULL;
+  uintptr_t* founder_male_include2 = NULL;
+  g_ld_founder_ct = founder_ct;
+  if (!founder_ct) {
+    sprintf(logbuf, "Warning: Skipping --%s since there are no founders.\n", flagname);
+    logprintb();
+    return 0;
+  }
+  // force founder_male_include2 allocation
+  if (alloc_collapsed_haploid_filters(unfiltered_indiv_ct, founder_ct, XMHH_EXISTS | hh_exists, 1, founder_info, sex_male, &founder_include2, &founder_male_include2)) {
+    return RET_NOMEM;
+  }
+  g_ld_nonmale_founder_ct = 0;
+  if (weighted_x) {
+    g_ld_nonmale_founder_ct = founder_ct - popcount_longs(founder_male_include2, 0, founder_ctl);
+    if (founder_ct + g_ld_nonmale_founder_ct > 0x7fffffff) {
+      // no, this shouldn't ever happen, but may as well document that there
+      // theoretically is a 32-bit integer range issue here
+      sprintf(logbuf, "Error: Too many founders for --%s + --ld-xchr 3.\n", flagname);
+      logprintb();
+      return RET_INVALID_FORMAT;
+    }
+  }
+  g_ld_unfiltered_indiv_ct = unfiltered_indiv_ct;
+  g_ld_founder_info = founder_info;
+  g_ld_founder_include2 = founder_include2;
+  g_ld_founder_male_include2 = founder_male_include2;
+#ifdef __LP64__
+  g_ld_founder_ctv = 2 * ((founder_ct + 127) / 128);
+  g_ld_founder_ct_mld_rem = (MULTIPLEX_LD / 192) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 192;
+#else
+  g_ld_founder_ctv = founder_ctl;
+  g_ld_founder_ct_mld_rem = (MULTIPLEX_LD / 48) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 48;
+#endif
+  g_ld_founder_ct_mld_m1 = ((uint32_t)founder_ct_mld) - 1;
+  g_ld_founder_ct_mld_long = founder_ct_mld * (MULTIPLEX_LD / BITCT2);
+  g_ld_ignore_x = (misc_flags / MISC_LD_IGNORE_X) & 1;
+  g_ld_weighted_x = weighted_x;
+  g_ld_hh_exists = hh_exists;
+  g_ld_chrom_parallel = 0;
+  return 0;
+}
+
+int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, char* marker_ids, uintptr_t max_marker_id_len, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_pos, uintptr_t unfiltered_indiv_ct, uintptr_t* founder_info, uintptr_t* sex_male, uint32_t ld_window_size, uint32_t ld_window_kb, uint32_t ld_window_incr, double ld_last_param, char* outname, char* outname_end, uint64_t misc_flags, uint32_t hh_exists) {
+  // Chromosomes are independent, so with enough of them, --indep-pairwise
+  // hands whole chromosomes to threads.  Otherwise (and always for --indep,
+  // whose matrix inversion allocates from the shared workspace) chromosomes
+  // are processed in order, with large windows' r values computed by all
+  // threads.  Either way the pruning decisions are identical to the
+  // single-threaded ones.
+  unsigned char* wkspace_mark = wkspace_base;
+  FILE* outfile_in = NULL;
+  FILE* outfile_out = NULL;
+  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+  uint32_t pairwise = (misc_flags / MISC_LD_PRUNE_PAIRWISE) & 1;
+  uintptr_t window_max = 0;
+  uint32_t tot_exclude_ct = 0;
+  uint32_t max_code = chrom_info_ptr->max_code;
+  uint32_t chrom_thread_ct = 1;
+  int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
+  unsigned char* wkspace_mark2;
+  uintptr_t* pruned_arr;
+  uint32_t marker_unfiltered_idx;
+  uintptr_t marker_idx;
+  int32_t pct;
+  uint32_t pct_thresh;
+  uint32_t window_unfiltered_start;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t cur_chrom;
+  uint32_t chrom_end;
+  uintptr_t ulii;
+  uintptr_t cur_exclude_ct;
+  char* sptr;
+  FILE* fptr;
+  retval = ld_init_founders(unfiltered_indiv_ct, founder_info, sex_male, misc_flags, hh_exists, pairwise? "indep-pairwise" : "indep");
+  if (retval || (!g_ld_founder_ct)) {
+    goto ld_prune_ret_1;
+  }
+
+  if (ld_window_kb) {
+    // determine maximum number of markers that may need to be loaded at once
+    for (cur_chrom = 0; cur_chrom <= max_code; cur_chrom++) {
+      if (chrom_exists(chrom_info_ptr, cur_chrom)) {
+        uii = chrom_info_ptr->chrom_start[cur_chrom];
+	chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
+        do {
+	  ujj = uii + 1;
+	  while ((ujj < chrom_end) && (marker_pos[ujj] <= marker_pos[uii] + (1000 * ld_window_size))) {
+	    ujj++;
+	  }
+          if (ujj - uii > window_max) {
+	    window_max = ujj - uii;
+	  }
+	  uii++;
+	} while (ujj < chrom_end);
+      }
+    }
+  } else {
+    window_max = ld_window_size;
+  }
+
+  window_unfiltered_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, unfiltered_marker_ct);
+  if (window_unfiltered_start == unfiltered_marker_ct) {
+    sprintf(logbuf, "Error: No valid markers for --indep%s.\n", pairwise? "-pairwise" : "");
+    logprintb();
+    goto ld_prune_ret_INVALID_FORMAT;
+  }
+
+  g_ld_bedfile = bedfile;
+  g_ld_bed_offset = bed_offset;
+  g_ld_unfiltered_marker_ct = unfiltered_marker_ct;
+  g_ld_marker_exclude = marker_exclude;
+  g_ld_marker_reverse = marker_reverse;
+  g_ld_chrom_info_ptr = chrom_info_ptr;
+  g_ld_set_allele_freqs = set_allele_freqs;
+  g_ld_marker_pos = marker_pos;
+  g_ld_window_size = ld_window_size;
+  g_ld_window_kb = ld_window_kb;
+  g_ld_window_incr = ld_window_incr;
+  g_ld_window_max = window_max;
+  g_ld_last_param = ld_last_param;
+  g_ld_prune_r1 = pairwise? sqrt(ld_last_param) : 0.999999;
+  g_ld_pairwise = pairwise;
+
+  // list the chromosomes to process, in order
+  g_ld_chrom_starts = (uint32_t*)wkspace_base;
+  g_ld_chrom_ct = 0;
+  uii = window_unfiltered_start;
+  do {
+    g_ld_chrom_starts[g_ld_chrom_ct++] = uii;
+    uii = ld_prune_next_valid_chrom_start(marker_exclude, chrom_info_ptr->chrom_end[get_marker_chrom(chrom_info_ptr, uii)], chrom_info_ptr, unfiltered_marker_ct);
+  } while (uii < unfiltered_marker_ct);
+  wkspace_alloc(g_ld_chrom_ct * sizeof(int32_t));
+  if (wkspace_alloc_ul_checked(&g_ld_chrom_exclude_cts, g_ld_chrom_ct * sizeof(intptr_t))) {
+    goto ld_prune_ret_NOMEM;
+  }
+
+  if (ld_alloc_window_bufs(&(g_ld_bufs[0]), unfiltered_marker_ctl, marker_exclude, !pairwise)) {
+    goto ld_prune_ret_NOMEM;
+  }
+  pruned_arr = g_ld_bufs[0].pruned_arr;
+#ifndef _WIN32
+  if (pairwise && (g_thread_ct > 1) && (g_ld_chrom_ct >= g_thread_ct)) {
+    // use as many threads as there's room for
+    for (chrom_thread_ct = 1; chrom_thread_ct < g_thread_ct; chrom_thread_ct++) {
+      wkspace_mark2 = wkspace_base;
+      if (ld_alloc_window_bufs(&(g_ld_bufs[chrom_thread_ct]), unfiltered_marker_ctl, marker_exclude, 0)) {
+	wkspace_reset(wkspace_mark2);
+	break;
+      }
+    }
+  }
+#endif
+  if (chrom_thread_ct == 1) {
+    // optional window precomputation buffers
+    // (not an error if there's no room; r values are then computed inline)
+    if (pairwise && (g_thread_ct > 1)) {
+      g_ld_bufs[0].cov_matrix = (double*)wkspace_alloc(window_max * window_max * sizeof(double));
+    }
+    if ((g_thread_ct > 1) && g_ld_bufs[0].cov_matrix) {
+      g_ld_bufs[0].r_starts = (uint32_t*)wkspace_alloc(window_max * sizeof(int32_t));
+    }
+  }
+
+  // sliding window: let the kernel keep recently read rows around, and
+  // prefetch each window extension explicitly below
+  bed_mmap_advise(BED_ADVISE_NORMAL);
+  if (chrom_thread_ct > 1) {
+    sprintf(logbuf, "Pruning %u chromosomes with %u threads...", g_ld_chrom_ct, chrom_thread_ct);
+    logprintb();
+    fflush(stdout);
+    g_ld_chrom_parallel = 1;
+    g_ld_next_chrom = 0;
+    for (uii = 0; uii < chrom_thread_ct; uii++) {
+      g_ld_thread_rets[uii] = 0;
+    }
+    if (spawn_threads(threads, &ld_prune_chrom_thread, chrom_thread_ct)) {
+      goto ld_prune_ret_THREAD_CREATE_FAIL;
+    }
+    ld_prune_chrom_thread((void*)0);
+    join_threads(threads, chrom_thread_ct);
+    g_ld_chrom_parallel = 0;
+    logstr(" done.\n");
+    fputs(" done.\n", stdout);
+    for (uii = 0; uii < chrom_thread_ct; uii++) {
+      if (g_ld_thread_rets[uii]) {
+	retval = g_ld_thread_rets[uii];
+	goto ld_prune_ret_1;
+      }
+    }
+    // each thread only set bits in its own chromosomes
+    for (uii = 1; uii < chrom_thread_ct; uii++) {
+      for (ulii = 0; ulii < unfiltered_marker_ctl; ulii++) {
+	pruned_arr[ulii] |= g_ld_bufs[uii].pruned_arr[ulii];
+      }
+    }
+  }
+  for (uii = 0; uii < g_ld_chrom_ct; uii++) {
+    window_unfiltered_start = g_ld_chrom_starts[uii];
+    if (chrom_thread_ct == 1) {
+      retval = ld_prune_chrom(threads, &(g_ld_bufs[0]), window_unfiltered_start, &(g_ld_chrom_exclude_cts[uii]));
+      if (retval) {
+	goto ld_prune_ret_1;
+      }
+      putchar('\r');
+    }
+    cur_exclude_ct = g_ld_chrom_exclude_cts[uii];
+    ujj = get_marker_chrom(chrom_info_ptr, window_unfiltered_start);
+    sprintf(logbuf, "Pruned %" PRIuPTR " marker%s from chromosome %u, leaving %" PRIuPTR ".\n", cur_exclude_ct, (cur_exclude_ct == 1)? "" : "s", ujj, chrom_info_ptr->chrom_end[ujj] - chrom_info_ptr->chrom_start[ujj] - cur_exclude_ct);
+    logprintb();
+    tot_exclude_ct += cur_exclude_ct;
+  }
+
+  sprintf(logbuf, "Pruning complete.  %d of %d markers removed.\n", tot_exclude_ct, marker_ct);
+  logprintb();
+  strcpy(outname_end, ".prune.in");
+  if (fopen_checked(&outfile_in, outname, "w")) {
+    goto ld_prune_ret_OPEN_FAIL;
+  }
+  strcpy(outname_end, ".prune.out");
+  if (fopen_checked(&outfile_out, outname, "w")) {
+    goto ld_prune_ret_OPEN_FAIL;
+  }
+  marker_unfiltered_idx = 0;
+  marker_idx = 0;
+  pct = 1;
+  uii = 0;
+  for (cur_chrom = 1; cur_chrom <= chrom_info_ptr->max_code; cur_chrom++) {
+    if (!IS_SET(chrom_info_ptr->chrom_mask, cur_chrom)) {
+      continue;
+    }
+    if (chrom_info_ptr->chrom_end[cur_chrom]) {
+      uii += chrom_info_ptr->chrom_end[cur_chrom] - chrom_info_ptr->chrom_start[cur_chrom];
+    }
+  }
+  pct_thresh = ((int64_t)pct * uii) / 100;
+  for (cur_chrom = 1; cur_chrom <= chrom_info_ptr->max_code; cur_chrom++) {
+    chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
+    if (!chrom_end) {
       continue;
     }
     marker_unfiltered_idx = chrom_info_ptr->chrom_start[cur_chrom];
@@ -5478,15 +7156,16 @@ int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintpt
   ld_prune_ret_OPEN_FAIL:
     retval = RET_OPEN_FAIL;
     break;
-  ld_prune_ret_READ_FAIL:
-    retval = RET_READ_FAIL;
-    break;
   ld_prune_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
     break;
   ld_prune_ret_INVALID_FORMAT:
     retval = RET_INVALID_FORMAT;
     break;
+  ld_prune_ret_THREAD_CREATE_FAIL:
+    logprint(errstr_thread_create);
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   }
  ld_prune_ret_1:
   fclose_cond(outfile_in);
@@ -5495,61 +7174,592 @@ int32_t ld_prune(FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintpt
   return retval;
 }
 
-inline void rel_cut_arr_dec(int32_t* rel_ct_arr_elem, uint32_t* exactly_one_rel_ct_ptr) {
-  int32_t rcae = *rel_ct_arr_elem - 1;
-  *rel_ct_arr_elem = rcae;
-  if (rcae < 2) {
-    if (rcae) {
-      *exactly_one_rel_ct_ptr += 1;
-    } else {
-      *exactly_one_rel_ct_ptr -= 1;
+void ld_init(Ld_info* ldip) {
+  ldip->modifier = 0;
+  ldip->window_size = 10;
+  ldip->window_bp = 1000000;
+  ldip->window_r2 = 0.2;
+  ldip->snpstr = NULL;
+  ldip->snp_list_fname = NULL;
+}
+
+// --r2 block state.  Rows and columns are indices into g_ldr_chrom_uidxs (the
+// current chromosome's markers); window buffer slot k holds marker
+// (g_ldr_load_start + k).
+static uint32_t* g_ldr_chrom_uidxs;
+static uint32_t g_ldr_chrom_marker_ct;
+static uint32_t* g_ldr_row_idxs;
+static uint32_t g_ldr_row_starts[MAX_THREADS + 1];
+static uint32_t g_ldr_load_start;
+static uint32_t g_ldr_col_ct;
+static int32_t g_ldr_col_offset;
+static uint32_t g_ldr_window_bp;
+static float* g_ldr_r2;
+static float* g_ldr_dprime;
+
+THREAD_RET_TYPE ld_report_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  Ld_window_bufs* bufs = &(g_ld_bufs[0]);
+  uint32_t* chrom_uidxs = g_ldr_chrom_uidxs;
+  uint32_t* marker_pos = g_ld_marker_pos;
+  double* marker_stdevs = bufs->marker_stdevs;
+  uintptr_t col_ct = g_ldr_col_ct;
+  uint32_t chrom_marker_ct = g_ldr_chrom_marker_ct;
+  uint32_t load_start = g_ldr_load_start;
+  uint32_t window_bp = g_ldr_window_bp;
+  uint32_t row_end = g_ldr_row_starts[tidx + 1];
+  double dprime = 0.0;
+  double* dprime_ptr = g_ldr_dprime? (&dprime) : NULL;
+  float* r2_row;
+  float* dprime_row;
+  uint32_t row_idx;
+  uint32_t row_pos;
+  uint32_t col_idx;
+  uint32_t col_pos;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t row;
+  uintptr_t col;
+  int32_t ii;
+  double dxx;
+  for (row = g_ldr_row_starts[tidx]; row < row_end; row++) {
+    row_idx = g_ldr_row_idxs[row];
+    row_pos = marker_pos[chrom_uidxs[row_idx]];
+    uii = row_idx - load_start;
+    r2_row = &(g_ldr_r2[row * col_ct]);
+    dprime_row = g_ldr_dprime? (&(g_ldr_dprime[row * col_ct])) : NULL;
+    ii = ((int32_t)row_idx) + g_ldr_col_offset;
+    for (col = 0; col < col_ct; col++, ii++) {
+      dxx = NAN;
+      if (dprime_ptr) {
+	*dprime_ptr = NAN;
+      }
+      if ((ii >= 0) && (((uint32_t)ii) < chrom_marker_ct)) {
+	col_idx = ii;
+	col_pos = marker_pos[chrom_uidxs[col_idx]];
+	ujj = col_idx - load_start;
+	if (col_idx == row_idx) {
+	  if (marker_stdevs[uii] != 0.0) {
+	    dxx = 1.0;
+	    if (dprime_ptr) {
+	      *dprime_ptr = 1.0;
+	    }
+	  }
+	} else if ((((col_idx > row_idx)? (col_pos - row_pos) : (row_pos - col_pos)) <= window_bp) && (marker_stdevs[uii] != 0.0) && (marker_stdevs[ujj] != 0.0)) {
+	  // always pass the earlier marker first, so that a pair's value doesn't
+	  // depend on which of its markers is the target
+	  if (uii < ujj) {
+	    dxx = ld_pair_r(bufs, uii, ujj, g_ld_r_weighted_founder_ct, g_ld_r_is_x_weighted, 1, dprime_ptr);
+	  } else {
+	    dxx = ld_pair_r(bufs, ujj, uii, g_ld_r_weighted_founder_ct, g_ld_r_is_x_weighted, 1, dprime_ptr);
+	  }
+	  dxx *= dxx;
+	}
+      }
+      r2_row[col] = (float)dxx;
+      if (dprime_row) {
+	dprime_row[col] = (float)dprime;
+      }
     }
   }
+  THREAD_RETURN;
 }
 
-int32_t do_rel_cutoff(uint64_t calculation_type, double rel_cutoff, double* rel_ibc, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* outname, char* outname_end, uintptr_t unfiltered_indiv_ct, char* person_ids, uintptr_t max_person_id_len) {
-  int32_t indivs_excluded = 0;
-  uint32_t exactly_one_rel_ct = 0;
+int32_t ld_report(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uint32_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, char* marker_ids, uintptr_t max_marker_id_len, uint32_t plink_maxsnp, uint32_t zero_extra_chroms, Chrom_info* chrom_info_ptr, uint32_t* marker_pos, uintptr_t unfiltered_indiv_ct, uintptr_t* founder_info, uintptr_t* sex_male, char* outname, char* outname_end, uint64_t misc_flags, uint32_t hh_exists) {
+  // Rows (all markers, or just the --ld-snp[-list] targets) are processed in
+  // blocks: the main thread loads every marker the block's windows touch,
+  // then the block's rows are split between threads, and finally the main
+  // thread writes the block's results in order.
   unsigned char* wkspace_mark = wkspace_base;
-  double* dist_ptr = g_rel_dists;
-  double* dptr2;
-  double* dptr3;
-  double* dptr4;
-  uint32_t* giptr;
-  uint32_t* giptr2;
-  // number of too-close relations, -1 if excluded
-  int32_t* rel_ct_arr;
-  uintptr_t indiv_idx;
-  uint32_t uii;
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+  uintptr_t* target_arr = NULL;
+  uint32_t is_dprime = ldip->modifier & LD_DPRIME;
+  uint32_t is_bin = ldip->modifier & LD_BIN;
+  uint32_t window_size = ldip->window_size;
+  uint32_t window_bp = ldip->window_bp;
+  float window_r2 = (float)ldip->window_r2;
+  uint32_t max_chrom_marker_ct = 0;
+  uint32_t span_max = 0;
+  uint32_t row_ct = 0;
+  uint32_t rows_done = 0;
+  uint64_t pair_ct = 0;
+  uint32_t pct = 1;
+  int32_t retval = 0;
+  Ld_bin_header bin_header;
+  Ld_bin_row bin_row;
+  Ld_window_bufs* bufs;
+  unsigned char* wkspace_mark2;
+  uint32_t* chrom_uidxs;
+  char* sorted_ids;
+  uint32_t* id_map;
+  char* wptr_start;
+  char* wptr_b;
+  char* wptr;
+  char* sptr;
+  uintptr_t col_ct;
+  uintptr_t load_min;
+  uintptr_t load_max;
+  uintptr_t row_max;
+  uintptr_t row_back;
   uintptr_t ulii;
-  int32_t kk;
-  int32_t mm;
-  int32_t retval;
-  
-  // Algorithm:
-  // - Whenever there is at least one individual with exactly one
-  // remaining too-close relation, prune the other side of that
-  // relationship, because doing so is never suboptimal.
-  // - Otherwise, there's no efficient rule that is always optimal
-  // (assuming P != NP, anyway), so we use a simple heuristic: prune the
-  // first individual with the largest number of remaining too-close
-  // relationships.
-
-  if (wkspace_alloc_i_checked(&rel_ct_arr, g_indiv_ct * sizeof(int32_t))) {
-    return RET_NOMEM;
-  }
-  fill_int_zero(rel_ct_arr, g_indiv_ct);
-  for (indiv_idx = 1; indiv_idx < g_indiv_ct; indiv_idx++) {
-    for (uii = 0; uii < indiv_idx; uii++) {
-      if (*dist_ptr++ > rel_cutoff) {
-	rel_ct_arr[indiv_idx] += 1;
-	rel_ct_arr[uii] += 1;
+  uint32_t chrom_start;
+  uint32_t chrom_end;
+  uint32_t chrom_first_midx;
+  uint32_t chrom_marker_ct;
+  uint32_t cur_chrom;
+  uint32_t is_haploid;
+  uint32_t is_x;
+  uint32_t is_y;
+  uint32_t block_row_ct;
+  uint32_t load_start;
+  uint32_t load_end;
+  uint32_t row_idx;
+  uint32_t thread_ct;
+  uint32_t pct_thresh;
+  uint32_t chrom_name_len;
+  uint32_t slen;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t ukk;
+  int32_t ii;
+  float fxx;
+  char chrom_name_buf[16];
+  retval = ld_init_founders(unfiltered_indiv_ct, founder_info, sex_male, misc_flags, hh_exists, "r2");
+  if (retval || (!g_ld_founder_ct)) {
+    goto ld_report_ret_1;
+  }
+  g_ld_bedfile = bedfile;
+  g_ld_bed_offset = bed_offset;
+  g_ld_unfiltered_marker_ct = unfiltered_marker_ct;
+  g_ld_marker_exclude = marker_exclude;
+  g_ld_marker_reverse = marker_reverse;
+  g_ld_chrom_info_ptr = chrom_info_ptr;
+  g_ld_marker_pos = marker_pos;
+  g_ld_pairwise = 1;
+
+  if (ldip->snpstr || ldip->snp_list_fname) {
+    if (wkspace_alloc_ul_checked(&target_arr, unfiltered_marker_ctl * sizeof(intptr_t))) {
+      goto ld_report_ret_NOMEM;
+    }
+    fill_ulong_zero(target_arr, unfiltered_marker_ctl);
+    if (ldip->snpstr) {
+      ii = get_uidx_from_unsorted(ldip->snpstr, marker_exclude, marker_ct, marker_ids, max_marker_id_len);
+      if (ii == -1) {
+	sprintf(logbuf, "Error: --ld-snp marker '%s' not found.\n", ldip->snpstr);
+	logprintb();
+	goto ld_report_ret_INVALID_CMDLINE;
+      }
+      SET_BIT(target_arr, ii);
+    } else {
+      wkspace_mark2 = wkspace_base;
+      retval = sort_item_ids(&sorted_ids, &id_map, unfiltered_marker_ct, marker_exclude, unfiltered_marker_ct - marker_ct, marker_ids, max_marker_id_len, 0, 0, strcmp_deref);
+      if (retval) {
+	goto ld_report_ret_1;
+      }
+      if (fopen_checked(&infile, ldip->snp_list_fname, "r")) {
+	goto ld_report_ret_OPEN_FAIL;
+      }
+      uii = 0; // IDs not found
+      while (fgets(tbuf, MAXLINELEN, infile)) {
+	sptr = skip_initial_spaces(tbuf);
+	if (is_eoln_kns(*sptr)) {
+	  continue;
+	}
+	read_next_terminate(sptr, sptr);
+	ii = bsearch_str(sptr, sorted_ids, max_marker_id_len, 0, marker_ct - 1);
+	if (ii == -1) {
+	  uii++;
+	} else {
+	  SET_BIT(target_arr, id_map[(uint32_t)ii]);
+	}
+      }
+      if (!feof(infile)) {
+	goto ld_report_ret_READ_FAIL;
+      }
+      fclose_null(&infile);
+      wkspace_reset(wkspace_mark2);
+      if (uii) {
+	sprintf(logbuf, "Warning: %u --ld-snp-list ID%s not found.\n", uii, (uii == 1)? "" : "s");
+	logprintb();
       }
     }
   }
-  for (indiv_idx = 0; indiv_idx < g_indiv_ct; indiv_idx++) {
-    if (rel_ct_arr[indiv_idx] == 1) {
-      exactly_one_rel_ct++;
+
+  if (wkspace_alloc_ui_checked(&chrom_uidxs, marker_ct * sizeof(int32_t))) {
+    goto ld_report_ret_NOMEM;
+  }
+  g_ldr_chrom_uidxs = chrom_uidxs;
+  // Pass 1: row count, largest chromosome, and the widest one-sided window
+  // (in markers) actually attainable under both --ld-window and
+  // --ld-window-kb.
+  chrom_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, unfiltered_marker_ct);
+  while (chrom_start < unfiltered_marker_ct) {
+    cur_chrom = get_marker_chrom(chrom_info_ptr, chrom_start);
+    chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
+    chrom_marker_ct = 0;
+    for (uii = chrom_start; uii < chrom_end; uii++) {
+      uii = next_unset(marker_exclude, uii, chrom_end);
+      if (uii == chrom_end) {
+	break;
+      }
+      chrom_uidxs[chrom_marker_ct++] = uii;
+      if ((!target_arr) || IS_SET(target_arr, uii)) {
+	row_ct++;
+      }
+    }
+    if (chrom_marker_ct > max_chrom_marker_ct) {
+      max_chrom_marker_ct = chrom_marker_ct;
+    }
+    ujj = 0;
+    for (uii = 0; uii < chrom_marker_ct; uii++) {
+      if (ujj <= uii) {
+	ujj = uii + 1;
+      }
+      while ((ujj < chrom_marker_ct) && (ujj - uii < window_size) && (marker_pos[chrom_uidxs[ujj]] - marker_pos[chrom_uidxs[uii]] <= window_bp)) {
+	ujj++;
+      }
+      if (ujj - uii - 1 > span_max) {
+	span_max = ujj - uii - 1;
+      }
+    }
+    chrom_start = ld_prune_next_valid_chrom_start(marker_exclude, chrom_end, chrom_info_ptr, unfiltered_marker_ct);
+  }
+  if (!row_ct) {
+    logprint(target_arr? "Error: No --r2 target markers on chromosomes 1+.\n" : "Error: No valid markers for --r2.\n");
+    goto ld_report_ret_INVALID_FORMAT;
+  }
+  if (target_arr) {
+    row_back = span_max;
+    col_ct = 2 * span_max + 1;
+    g_ldr_col_offset = -((int32_t)span_max);
+  } else {
+    row_back = 0;
+    col_ct = span_max;
+    g_ldr_col_offset = 1;
+  }
+  g_ldr_col_ct = col_ct;
+  g_ldr_window_bp = window_bp;
+
+  // Size the blocks.  Halve the marker buffer until it fits (but never below
+  // one row's window), then the row buffer.
+  load_min = row_back + span_max + 1;
+  load_max = max_chrom_marker_ct;
+  if (load_max > 65536) {
+    load_max = 65536;
+  }
+  if (load_max < load_min) {
+    load_max = load_min;
+  }
+  row_max = load_max;
+  bufs = &(g_ld_bufs[0]);
+  wkspace_mark2 = wkspace_base;
+  while (1) {
+    g_ld_window_max = load_max;
+    if ((!ld_alloc_window_bufs(bufs, unfiltered_marker_ctl, marker_exclude, 0)) &&
+        (!wkspace_alloc_ui_checked(&g_ldr_row_idxs, row_max * sizeof(int32_t))) &&
+        (!wkspace_alloc_f_checked(&g_ldr_r2, row_max * col_ct * sizeof(float)))) {
+      g_ldr_dprime = NULL;
+      if ((!is_dprime) || (!wkspace_alloc_f_checked(&g_ldr_dprime, row_max * col_ct * sizeof(float)))) {
+	break;
+      }
+    }
+    wkspace_reset(wkspace_mark2);
+    if (load_max > load_min) {
+      load_max /= 2;
+      if (load_max < load_min) {
+	load_max = load_min;
+      }
+      if (row_max > load_max) {
+	row_max = load_max;
+      }
+    } else if (row_max > 1) {
+      row_max /= 2;
+    } else {
+      goto ld_report_ret_NOMEM;
+    }
+  }
+
+  if (is_bin) {
+    memcpy(outname_end, ".ld.bin", 8);
+    if (fopen_checked(&outfile, outname, "wb")) {
+      goto ld_report_ret_OPEN_FAIL;
+    }
+    bin_header.version = 1;
+    bin_header.flags = (is_dprime? LD_BIN_DPRIME : 0) | (target_arr? LD_BIN_TARGETS : 0);
+    bin_header.row_ct = row_ct;
+    bin_header.col_ct = col_ct;
+    bin_header.marker_ct = marker_ct;
+    bin_header.window_size = window_size;
+    bin_header.window_bp = window_bp;
+    bin_header.reserved = 0;
+    if (fwrite_checked(LD_BIN_MAGIC, 8, outfile) || fwrite_checked(&bin_header, sizeof(Ld_bin_header), outfile)) {
+      goto ld_report_ret_WRITE_FAIL;
+    }
+  } else {
+    memcpy(outname_end, ".ld", 4);
+    if (fopen_checked(&outfile, outname, "w")) {
+      goto ld_report_ret_OPEN_FAIL;
+    }
+    sprintf(tbuf, " CHR_A         BP_A %%%us  CHR_B         BP_B %%%us           R2%%s\n", plink_maxsnp, plink_maxsnp);
+    fprintf(outfile, tbuf, "SNP_A", "SNP_B", is_dprime? "           DP" : "");
+  }
+  sprintf(logbuf, "--r2: %u row%s, window %u marker%s / %g kb", row_ct, (row_ct == 1)? "" : "s", window_size, (window_size == 1)? "" : "s", ((double)window_bp) * 0.001);
+  logprintb();
+  if (!is_bin) {
+    sprintf(logbuf, ", r^2 >= %g", ldip->window_r2);
+    logprintb();
+  }
+  logprint(".\n");
+  fputs("0%", stdout);
+  fflush(stdout);
+  pct_thresh = ((uint64_t)row_ct) / 100;
+  bed_mmap_advise(BED_ADVISE_NORMAL);
+  chrom_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, unfiltered_marker_ct);
+  while (chrom_start < unfiltered_marker_ct) {
+    cur_chrom = get_marker_chrom(chrom_info_ptr, chrom_start);
+    chrom_end = chrom_info_ptr->chrom_end[cur_chrom];
+    chrom_first_midx = chrom_start - popcount_bit_idx(marker_exclude, 0, chrom_start);
+    chrom_marker_ct = 0;
+    for (uii = chrom_start; uii < chrom_end; uii++) {
+      uii = next_unset(marker_exclude, uii, chrom_end);
+      if (uii == chrom_end) {
+	break;
+      }
+      chrom_uidxs[chrom_marker_ct++] = uii;
+    }
+    g_ldr_chrom_marker_ct = chrom_marker_ct;
+    is_haploid = IS_SET(chrom_info_ptr->haploid_mask, cur_chrom);
+    is_x = (((int32_t)cur_chrom) == chrom_info_ptr->x_code)? 1 : 0;
+    is_y = (((int32_t)cur_chrom) == chrom_info_ptr->y_code)? 1 : 0;
+    g_ld_r_is_x_weighted = is_x && g_ld_weighted_x;
+    g_ld_r_weighted_founder_ct = g_ld_r_is_x_weighted? (2 * g_ld_founder_ct) : g_ld_founder_ct;
+    // right-aligned chromosome name for the CHR_B column
+    wptr = chrom_name_write(chrom_name_buf, chrom_info_ptr, cur_chrom, zero_extra_chroms);
+    chrom_name_len = (uintptr_t)(wptr - chrom_name_buf);
+    row_idx = 0;
+    while (1) {
+      if (target_arr) {
+	while ((row_idx < chrom_marker_ct) && (!IS_SET(target_arr, chrom_uidxs[row_idx]))) {
+	  row_idx++;
+	}
+      }
+      if (row_idx == chrom_marker_ct) {
+	break;
+      }
+      // gather rows while their windows fit in the buffer
+      load_start = (row_idx > row_back)? (row_idx - row_back) : 0;
+      block_row_ct = 0;
+      do {
+	ujj = row_idx + span_max + 1;
+	if (ujj > chrom_marker_ct) {
+	  ujj = chrom_marker_ct;
+	}
+	if (ujj - load_start > load_max) {
+	  break;
+	}
+	g_ldr_row_idxs[block_row_ct++] = row_idx++;
+	if (target_arr) {
+	  while ((row_idx < chrom_marker_ct) && (!IS_SET(target_arr, chrom_uidxs[row_idx]))) {
+	    row_idx++;
+	  }
+	}
+      } while ((row_idx < chrom_marker_ct) && (block_row_ct < row_max));
+      // load the markers those windows cover (with sparse targets, the
+      // markers between windows are skipped)
+      load_end = load_start;
+      for (ukk = 0; ukk < block_row_ct; ukk++) {
+	uii = g_ldr_row_idxs[ukk];
+	uii = (uii > row_back)? (uii - row_back) : 0;
+	if (uii < load_end) {
+	  uii = load_end;
+	}
+	ujj = g_ldr_row_idxs[ukk] + span_max + 1;
+	if (ujj > chrom_marker_ct) {
+	  ujj = chrom_marker_ct;
+	}
+	for (; uii < ujj; uii++) {
+	  retval = ld_load_marker(bufs, chrom_uidxs[uii], uii - load_start, is_haploid, is_x, is_y);
+	  if (retval) {
+	    goto ld_report_ret_1;
+	  }
+	}
+	if (ujj > load_end) {
+	  load_end = ujj;
+	}
+      }
+      g_ldr_load_start = load_start;
+      thread_ct = 1;
+      if ((g_thread_ct > 1) && (((uint64_t)block_row_ct) * col_ct * g_ld_founder_ct_mld_long >= LD_MT_MIN_WORK)) {
+	thread_ct = (block_row_ct < g_thread_ct)? block_row_ct : g_thread_ct;
+      }
+      for (uii = 0; uii <= thread_ct; uii++) {
+	g_ldr_row_starts[uii] = (((uint64_t)block_row_ct) * uii) / thread_ct;
+      }
+      if (thread_ct > 1) {
+	if (spawn_threads(threads, &ld_report_thread, thread_ct)) {
+	  goto ld_report_ret_THREAD_CREATE_FAIL;
+	}
+      }
+      ld_report_thread((void*)0);
+      join_threads(threads, thread_ct);
+
+      for (ukk = 0; ukk < block_row_ct; ukk++) {
+	uii = g_ldr_row_idxs[ukk];
+	if (is_bin) {
+	  bin_row.row_marker = chrom_first_midx + uii;
+	  bin_row.first_col = ((int32_t)(chrom_first_midx + uii)) + g_ldr_col_offset;
+	  if (fwrite_checked(&bin_row, sizeof(Ld_bin_row), outfile) || fwrite_checked(&(g_ldr_r2[ukk * col_ct]), col_ct * sizeof(float), outfile)) {
+	    goto ld_report_ret_WRITE_FAIL;
+	  }
+	  if (is_dprime && fwrite_checked(&(g_ldr_dprime[ukk * col_ct]), col_ct * sizeof(float), outfile)) {
+	    goto ld_report_ret_WRITE_FAIL;
+	  }
+	  continue;
+	}
+	wptr = width_force(6, tbuf, chrom_name_write(tbuf, chrom_info_ptr, cur_chrom, zero_extra_chroms));
+	wptr = memseta(wptr, 32, 3);
+	wptr = uint32_writew10(wptr, marker_pos[chrom_uidxs[uii]]);
+	*wptr++ = ' ';
+	sptr = &(marker_ids[chrom_uidxs[uii] * max_marker_id_len]);
+	slen = strlen(sptr);
+	wptr = memcpya(memseta(wptr, 32, plink_maxsnp - slen), sptr, slen);
+	wptr_start = memseta(wptr, 32, (chrom_name_len < 7)? (7 - chrom_name_len) : 1);
+	wptr_start = memcpya(wptr_start, chrom_name_buf, chrom_name_len);
+	ii = ((int32_t)uii) + g_ldr_col_offset;
+	for (ulii = 0; ulii < col_ct; ulii++, ii++) {
+	  fxx = g_ldr_r2[ukk * col_ct + ulii];
+	  // NaN fails this test too
+	  if ((!(fxx >= window_r2)) || (((uint32_t)ii) == uii)) {
+	    continue;
+	  }
+	  ujj = chrom_uidxs[(uint32_t)ii];
+	  wptr_b = memseta(wptr_start, 32, 3);
+	  wptr_b = uint32_writew10(wptr_b, marker_pos[ujj]);
+	  *wptr_b++ = ' ';
+	  sptr = &(marker_ids[ujj * max_marker_id_len]);
+	  slen = strlen(sptr);
+	  wptr_b = memcpya(memseta(wptr_b, 32, plink_maxsnp - slen), sptr, slen);
+	  *wptr_b++ = ' ';
+	  wptr = width_force(12, wptr_b, float_g_write(wptr_b, fxx));
+	  if (is_dprime) {
+	    *wptr++ = ' ';
+	    wptr = width_force(12, wptr, float_g_write(wptr, g_ldr_dprime[ukk * col_ct + ulii]));
+	  }
+	  *wptr++ = '\n';
+	  if (fwrite_checked(tbuf, wptr - tbuf, outfile)) {
+	    goto ld_report_ret_WRITE_FAIL;
+	  }
+	  pair_ct++;
+	}
+      }
+      rows_done += block_row_ct;
+      if (rows_done >= pct_thresh) {
+	pct = (((uint64_t)rows_done) * 100) / row_ct;
+	printf("\r%u%%", pct++);
+	fflush(stdout);
+	pct_thresh = (((uint64_t)row_ct) * pct) / 100;
+      }
+    }
+    chrom_start = ld_prune_next_valid_chrom_start(marker_exclude, chrom_end, chrom_info_ptr, unfiltered_marker_ct);
+  }
+  if (fclose_null(&outfile)) {
+    goto ld_report_ret_WRITE_FAIL;
+  }
+  putchar('\r');
+  if (is_bin) {
+    sprintf(logbuf, "--r2: %u x %" PRIuPTR " LD band written to %s.\n", row_ct, col_ct, outname);
+  } else {
+    sprintf(logbuf, "--r2: %" PRIu64 " pair%s written to %s.\n", pair_ct, (pair_ct == 1)? "" : "s", outname);
+  }
+  logprintb();
+  while (0) {
+  ld_report_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  ld_report_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  ld_report_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  ld_report_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  ld_report_ret_INVALID_FORMAT:
+    retval = RET_INVALID_FORMAT;
+    break;
+  ld_report_ret_INVALID_CMDLINE:
+    retval = RET_INVALID_CMDLINE;
+    break;
+  ld_report_ret_THREAD_CREATE_FAIL:
+    logprint(errstr_thread_create);
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
+  }
+ ld_report_ret_1:
+  fclose_cond(infile);
+  fclose_cond(outfile);
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+inline void rel_cut_arr_dec(int32_t* rel_ct_arr_elem, uint32_t* exactly_one_rel_ct_ptr) {
+  int32_t rcae = *rel_ct_arr_elem - 1;
+  *rel_ct_arr_elem = rcae;
+  if (rcae < 2) {
+    if (rcae) {
+      *exactly_one_rel_ct_ptr += 1;
+    } else {
+      *exactly_one_rel_ct_ptr -= 1;
+    }
+  }
+}
+
+int32_t do_rel_cutoff(uint64_t calculation_type, double rel_cutoff, double* rel_ibc, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* outname, char* outname_end, uintptr_t unfiltered_indiv_ct, char* person_ids, uintptr_t max_person_id_len) {
+  int32_t indivs_excluded = 0;
+  uint32_t exactly_one_rel_ct = 0;
+  unsigned char* wkspace_mark = wkspace_base;
+  double* dist_ptr = g_rel_dists;
+  double* dptr2;
+  double* dptr3;
+  double* dptr4;
+  uint32_t* giptr;
+  uint32_t* giptr2;
+  // number of too-close relations, -1 if excluded
+  int32_t* rel_ct_arr;
+  uintptr_t indiv_idx;
+  uint32_t uii;
+  uintptr_t ulii;
+  int32_t kk;
+  int32_t mm;
+  int32_t retval;
+  
+  // Algorithm:
+  // - Whenever there is at least one individual with exactly one
+  // remaining too-close relation, prune the other side of that
+  // relationship, because doing so is never suboptimal.
+  // - Otherwise, there's no efficient rule that is always optimal
+  // (assuming P != NP, anyway), so we use a simple heuristic: prune the
+  // first individual with the largest number of remaining too-close
+  // relationships.
+
+  if (wkspace_alloc_i_checked(&rel_ct_arr, g_indiv_ct * sizeof(int32_t))) {
+    return RET_NOMEM;
+  }
+  fill_int_zero(rel_ct_arr, g_indiv_ct);
+  for (indiv_idx = 1; indiv_idx < g_indiv_ct; indiv_idx++) {
+    for (uii = 0; uii < indiv_idx; uii++) {
+      if (*dist_ptr++ > rel_cutoff) {
+	rel_ct_arr[indiv_idx] += 1;
+	rel_ct_arr[uii] += 1;
+      }
+    }
+  }
+  for (indiv_idx = 0; indiv_idx < g_indiv_ct; indiv_idx++) {
+    if (rel_ct_arr[indiv_idx] == 1) {
+      exactly_one_rel_ct++;
     }
   }
   while (1) {
@@ -5699,6 +7909,11 @@ FILE* g_rcb_in_binfile;
 FILE* g_rcb_in_bin_nfile;
 gzFile g_rcb_cur_gzfile;
 int32_t* g_rcb_rel_ct_arr;
+// current .grm.bin/.grm.N.bin row
+float* g_rcb_bin_row;
+float* g_rcb_bin_nrow;
+// set by rel_cutoff_batch_rbin_emitn() on a short read
+uint32_t g_rcb_read_fail;
 
 uint32_t rel_cutoff_batch_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   char* sptr_cur = (char*)(&(readbuf[overflow_ct]));
@@ -5751,37 +7966,29 @@ uint32_t rel_cutoff_batch_rbin_emitn(uint32_t overflow_ct, unsigned char* readbu
   char wbuf[16];
   char* cptr;
   uint32_t wbuf_ct;
-  uint32_t uii;
-  float fxx;
 
   while (g_rcb_row < g_rcb_indiv_ct) {
     if (g_rcb_rel_ct_arr[g_rcb_row] == -1) {
       fseeko(g_rcb_in_binfile, (g_rcb_row + 1) * sizeof(float), SEEK_CUR);
       fseeko(g_rcb_in_bin_nfile, (g_rcb_row + 1) * sizeof(float), SEEK_CUR);
     } else {
+      if (!g_rcb_col) {
+	// first visit to this row; load all of it
+	if ((fread(g_rcb_bin_row, sizeof(float), g_rcb_row + 1, g_rcb_in_binfile) < g_rcb_row + 1) || (fread(g_rcb_bin_nrow, sizeof(float), g_rcb_row + 1, g_rcb_in_bin_nfile) < g_rcb_row + 1)) {
+	  goto rel_cutoff_batch_rbin_emitn_ret_READ_FAIL;
+	}
+      }
       cptr = uint32_writex(wbuf, g_rcb_new_row, '\t');
       wbuf_ct = (uintptr_t)(cptr - wbuf);
-      while (g_rcb_col <= g_rcb_row) {
+      for (; g_rcb_col <= g_rcb_row; g_rcb_col++) {
 	if (g_rcb_rel_ct_arr[g_rcb_col] == -1) {
-	  uii = g_rcb_col;
-	  while (++g_rcb_col <= g_rcb_row) {
-	    if (g_rcb_rel_ct_arr[g_rcb_col] != -1) {
-	      break;
-	    }
-	  }
-	  fseeko(g_rcb_in_binfile, (g_rcb_col - uii) * sizeof(float), SEEK_CUR);
-	  fseeko(g_rcb_in_bin_nfile, (g_rcb_col - uii) * sizeof(float), SEEK_CUR);
-	  if (g_rcb_col > g_rcb_row) {
-	    break;
-	  }
+	  continue;
 	}
 	sptr_cur = uint32_writex(memcpya(sptr_cur, wbuf, wbuf_ct), ++g_rcb_new_col, '\t');
-	fread(&fxx, 4, 1, g_rcb_in_bin_nfile);
-	sptr_cur = uint32_writex(sptr_cur, (int32_t)fxx, '\t');
-	fread(&fxx, 4, 1, g_rcb_in_binfile);
-	sptr_cur = float_e_writex(sptr_cur, fxx, '\n');
-	g_rcb_col++;
+	sptr_cur = uint32_writex(sptr_cur, (int32_t)g_rcb_bin_nrow[g_rcb_col], '\t');
+	sptr_cur = float_e_writex(sptr_cur, g_rcb_bin_row[g_rcb_col], '\n');
 	if (sptr_cur >= readbuf_end) {
+	  g_rcb_col++;
 	  goto rel_cutoff_batch_rbin_emitn_ret;
 	}
       }
@@ -5800,143 +8007,443 @@ uint32_t rel_cutoff_batch_rbin_emitn(uint32_t overflow_ct, unsigned char* readbu
     }
     g_rcb_col = 0;
   }  
+  while (0) {
+  rel_cutoff_batch_rbin_emitn_ret_READ_FAIL:
+    // end the stream; the caller checks g_rcb_read_fail
+    g_rcb_read_fail = 1;
+    g_rcb_row = g_rcb_indiv_ct;
+    break;
+  }
  rel_cutoff_batch_rbin_emitn_ret:
   return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
 }
 
-int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, char* outname_end, double rel_cutoff, uint32_t rel_calc_type) {
-  // Specialized --rel-cutoff usable on larger files.
-  char* grmname_end = (char*)memchr(grmname, 0, FNAMESIZE);
-  uintptr_t indiv_ct = 0;
-  FILE* idfile = NULL;
-  FILE* outfile = NULL;
-  FILE* out_bin_nfile = NULL;
-  gzFile cur_gzfile = NULL;
-  gzFile gz_outfile = NULL;
+int32_t rel_sparse_open(char* grmname, char* grmname_end, uintptr_t indiv_ct, FILE** infile_ptr, Rel_sparse_header* hdr_ptr) {
+  char magic[8];
+  memcpy(grmname_end, ".grm.sparse.bin", 16);
+  if (fopen_checked(infile_ptr, grmname, "rb")) {
+    return RET_OPEN_FAIL;
+  }
+  if ((fread(magic, 1, 8, *infile_ptr) < 8) || (fread(hdr_ptr, sizeof(Rel_sparse_header), 1, *infile_ptr) < 1)) {
+    return RET_READ_FAIL;
+  }
+  if (memcmp(magic, REL_SPARSE_MAGIC, 8) || (hdr_ptr->version != 1)) {
+    logprint("Error: Improperly formatted .grm.sparse.bin file.\n");
+    return RET_INVALID_FORMAT;
+  }
+  if (hdr_ptr->indiv_ct != indiv_ct) {
+    logprint("Error: .grm.sparse.bin individual count does not match .grm.id file.\n");
+    return RET_INVALID_FORMAT;
+  }
+  return 0;
+}
+
+int32_t rel_sparse_prune(char* grmname, char* grmname_end, uintptr_t indiv_ct, double rel_cutoff, int32_t* rel_ct_arr, uint32_t* indivs_excluded_ptr) {
+  // Same greedy pruning as the bit-table code in rel_cutoff_batch(), on an
+  // adjacency list built from a .grm.sparse.bin file.  An edge is still
+  // present iff both endpoints have a positive relative count, so nothing
+  // needs to be cleared as individuals are pruned.  Neighbor lists come out
+  // sorted, so "first remaining neighbor" matches the bit-table scan order.
+  FILE* infile = NULL;
   unsigned char* wkspace_mark = wkspace_base;
-  uint32_t indivs_excluded = 0;
   uint32_t exactly_one_rel_ct = 0;
-  uintptr_t* compact_rel_table;
-  uintptr_t* rtptr;
-  char* bufptr;
-  uint64_t ullii;
-  uint64_t ulljj;
-  uintptr_t tot_words;
-  uintptr_t words_left;
-  uintptr_t wl_floor;
-  uintptr_t cur_word;
-  uintptr_t ulii;
-  uintptr_t uljj;
-  uintptr_t ulkk;
-  uint32_t inword_idx;
-  uint32_t inword_bound;
-  uint32_t uii;
+  uint32_t indivs_excluded = 0;
+  float rel_cutoff_f = (float)rel_cutoff;
+  int32_t retval = 0;
+  Rel_sparse_header hdr;
+  Rel_sparse_rec* recbuf;
+  Rel_sparse_rec* recptr;
+  Rel_sparse_rec* recptr_end;
+  uintptr_t* edge_starts;
+  uintptr_t* edge_fills;
+  uint32_t* adj = NULL;
+  uintptr_t recbuf_ct;
+  uintptr_t cur_ct;
+  uint64_t rec_left;
+  uint32_t pass_idx;
   uint32_t row;
   uint32_t col;
-  uintptr_t indiv_idx;
-  int32_t* rel_ct_arr;
-  float rel_cutoff_f;
-  float fxx;
-  float fyy;
-  double dxx;
-  int32_t retval;
+  uint32_t next_col;
+  uintptr_t adj_idx;
+  uint32_t uii;
   int32_t kk;
-  int32_t mm;
   int32_t cur_prune;
-  g_rcb_in_binfile = NULL;
-  g_rcb_in_bin_nfile = NULL;
-  g_rcb_cur_gzfile = NULL;
-  memcpy(grmname_end, ".grm.id", 8);
-  if (fopen_checked(&idfile, grmname, "r")) {
-    goto rel_cutoff_batch_ret_OPEN_FAIL;
-  }
-  tbuf[MAXLINELEN - 1] = ' ';
-  while (fgets(tbuf, MAXLINELEN, idfile)) {
-    if (!tbuf[MAXLINELEN - 1]) {
-      logprint("Error: Pathologically long line in .grm.id file.\n");
-      goto rel_cutoff_batch_ret_INVALID_FORMAT_1;
-    }
-    if (is_eoln_kns(*(skip_initial_spaces(tbuf)))) {
-      continue;
-    }
-    indiv_ct++;
-  }
-  if (!feof(idfile)) {
-    goto rel_cutoff_batch_ret_READ_FAIL;
+  retval = rel_sparse_open(grmname, grmname_end, indiv_ct, &infile, &hdr);
+  if (retval) {
+    goto rel_sparse_prune_ret_1;
   }
-  fclose_null(&idfile);
-  ullii = indiv_ct;
-  ullii = ((ullii * (ullii - 1)) / 2 + BITCT - 1) / BITCT;
-#ifndef __LP64__
-  if (ullii >= 0x20000000) {
-    goto rel_cutoff_batch_ret_NOMEM;
+  if (rel_cutoff < hdr.threshold) {
+    sprintf(logbuf, "Error: --rel-cutoff value is below the .grm.sparse.bin storage threshold\n(%g).\n", hdr.threshold);
+    logprintb();
+    goto rel_sparse_prune_ret_INVALID_CMDLINE;
   }
-#endif
-  tot_words = ullii;
-  if (wkspace_alloc_ul_checked(&compact_rel_table, tot_words * sizeof(intptr_t))) {
-    goto rel_cutoff_batch_ret_NOMEM;
+  if (wkspace_alloc_ul_checked(&edge_starts, (indiv_ct + 1) * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&edge_fills, indiv_ct * sizeof(intptr_t))) {
+    goto rel_sparse_prune_ret_NOMEM;
   }
-  fill_ulong_zero(compact_rel_table, tot_words);
-  if (wkspace_alloc_i_checked(&rel_ct_arr, indiv_ct * sizeof(int32_t))) {
-    goto rel_cutoff_batch_ret_NOMEM;
+  recbuf_ct = 65536;
+  if (wkspace_alloc_c_checked((char**)(&recbuf), recbuf_ct * sizeof(Rel_sparse_rec))) {
+    goto rel_sparse_prune_ret_NOMEM;
   }
   fill_int_zero(rel_ct_arr, indiv_ct);
-
   fputs("Reading... 0%", stdout);
   fflush(stdout);
-  words_left = tot_words;
-  rtptr = compact_rel_table;
-  row = 0;
-  col = 0;
-  if (load_grm_bin) {
-    memcpy(grmname_end, ".grm.bin", 9);
-    if (fopen_checked(&g_rcb_in_binfile, grmname, "rb")) {
-      goto rel_cutoff_batch_ret_OPEN_FAIL;
-    }
-    rel_cutoff_f = (float)rel_cutoff;
-    for (g_pct = 1; g_pct <= 100; g_pct++) {
-      wl_floor = (((uint64_t)tot_words) * (100 - g_pct)) / 100;
-      while (words_left > wl_floor) {
-	cur_word = 0;
-	if (--words_left) {
-	  inword_bound = BITCT;
-	} else {
-	  // only indiv_ct mod (BITCT * 2) matters for remainder
-	  uii = indiv_ct & (BITCT * 2 - 1);
-	  inword_bound = ((uii * (uii - 1)) / 2) & (BITCT - 1);
-	  if (!inword_bound) {
-	    inword_bound = BITCT;
-	  }
+  // pass 0 validates the file and counts relatives, pass 1 fills in the
+  // adjacency lists
+  for (pass_idx = 0; pass_idx < 2; pass_idx++) {
+    if (fseeko(infile, 8 + sizeof(Rel_sparse_header), SEEK_SET)) {
+      goto rel_sparse_prune_ret_READ_FAIL;
+    }
+    rec_left = hdr.entry_ct;
+    row = 0;
+    next_col = 0;
+    while (rec_left) {
+      cur_ct = (rec_left > recbuf_ct)? recbuf_ct : rec_left;
+      if (fread(recbuf, sizeof(Rel_sparse_rec), cur_ct, infile) < cur_ct) {
+	goto rel_sparse_prune_ret_READ_FAIL;
+      }
+      rec_left -= cur_ct;
+      recptr_end = &(recbuf[cur_ct]);
+      for (recptr = recbuf; recptr < recptr_end; recptr++) {
+	col = recptr->col;
+	if ((row == indiv_ct) || (col < next_col) || (col > row)) {
+	  goto rel_sparse_prune_ret_INVALID_FORMAT;
+	}
+	if (col == row) {
+	  row++;
+	  next_col = 0;
+	  continue;
 	}
-	for (inword_idx = 0; inword_idx < inword_bound; inword_idx++) {
-	  if (!fread(&fxx, 4, 1, g_rcb_in_binfile)) {
-	    goto rel_cutoff_batch_ret_READ_FAIL;
-	  }
-	  if (row == col) {
-	    row++;
-	    col = 0;
-	    if (!fread(&fxx, 4, 1, g_rcb_in_binfile)) {
-	      goto rel_cutoff_batch_ret_READ_FAIL;
-	    }
-	  }
-	  if (fxx > rel_cutoff_f) {
+	next_col = col + 1;
+	if (recptr->val > rel_cutoff_f) {
+	  if (!pass_idx) {
 	    rel_ct_arr[row] += 1;
 	    rel_ct_arr[col] += 1;
-	    cur_word |= (ONELU << inword_idx);
+	  } else {
+	    adj[edge_fills[row]++] = col;
+	    adj[edge_fills[col]++] = row;
 	  }
-	  col++;
 	}
-	*rtptr++ = cur_word;
       }
-      if (g_pct < 100) {
-	if (g_pct > 10) {
-	  putchar('\b');
+    }
+    if (row != indiv_ct) {
+      goto rel_sparse_prune_ret_INVALID_FORMAT;
+    }
+    if (!pass_idx) {
+      edge_starts[0] = 0;
+      for (uii = 0; uii < indiv_ct; uii++) {
+	edge_fills[uii] = edge_starts[uii];
+	edge_starts[uii + 1] = edge_starts[uii] + rel_ct_arr[uii];
+      }
+      if (wkspace_alloc_ui_checked(&adj, edge_starts[indiv_ct] * sizeof(int32_t))) {
+	goto rel_sparse_prune_ret_NOMEM;
+      }
+      fputs("\b\b50%", stdout);
+      fflush(stdout);
+    }
+  }
+  fclose_null(&infile);
+  putchar('\r');
+  sprintf(logbuf, "%s read complete.  Pruning.\n", grmname);
+  logprintb();
+
+  for (uii = 0; uii < indiv_ct; uii++) {
+    if (rel_ct_arr[uii] == 1) {
+      exactly_one_rel_ct++;
+    }
+  }
+  while (1) {
+    kk = 0;
+    cur_prune = -1;
+    if (exactly_one_rel_ct) {
+      while (rel_ct_arr[kk] != 1) {
+	kk++;
+      }
+      for (adj_idx = edge_starts[kk]; rel_ct_arr[adj[adj_idx]] <= 0; adj_idx++);
+      cur_prune = adj[adj_idx];
+      rel_ct_arr[kk] = 0;
+      exactly_one_rel_ct--;
+      if (rel_ct_arr[cur_prune] == 1) {
+	exactly_one_rel_ct--;
+	rel_ct_arr[cur_prune] = -1;
+	indivs_excluded++;
+	continue;
+      }
+    } else {
+      for (uii = 0; uii < indiv_ct; uii++) {
+	if (rel_ct_arr[uii] > kk) {
+	  kk = rel_ct_arr[uii];
+	  cur_prune = uii;
 	}
-	printf("\b\b%u%%", g_pct);
-	fflush(stdout);
+      }
+      if (cur_prune == -1) {
+	break;
       }
     }
-    fclose_null(&g_rcb_in_binfile);
+    for (adj_idx = edge_starts[cur_prune]; adj_idx < edge_starts[cur_prune + 1]; adj_idx++) {
+      if (rel_ct_arr[adj[adj_idx]] > 0) {
+	rel_cut_arr_dec(&(rel_ct_arr[adj[adj_idx]]), &exactly_one_rel_ct);
+      }
+    }
+    rel_ct_arr[cur_prune] = -1;
+    indivs_excluded++;
+  }
+  *indivs_excluded_ptr = indivs_excluded;
+  while (0) {
+  rel_sparse_prune_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  rel_sparse_prune_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  rel_sparse_prune_ret_INVALID_FORMAT:
+    putchar('\n');
+    logprint("Error: Improperly formatted .grm.sparse.bin file.\n");
+    retval = RET_INVALID_FORMAT;
+    break;
+  rel_sparse_prune_ret_INVALID_CMDLINE:
+    retval = RET_INVALID_CMDLINE;
+    break;
+  }
+ rel_sparse_prune_ret_1:
+  fclose_cond(infile);
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+int32_t rel_sparse_prune_write(char* grmname, char* grmname_end, char* outname, char* outname_end, uintptr_t indiv_ct, int32_t* rel_ct_arr, double threshold) {
+  // Rewrites an already-validated .grm.sparse.bin/.idx pair without the
+  // pruned individuals.  The storage threshold can only go up.
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  FILE* idx_outfile = NULL;
+  unsigned char* wkspace_mark = wkspace_base;
+  int32_t retval = 0;
+  Rel_sparse_header hdr;
+  Rel_sparse_rec* recbuf;
+  Rel_sparse_rec* recptr;
+  Rel_sparse_rec* recptr_end;
+  Rel_sparse_rec* wptr;
+  uint32_t* new_idxs;
+  uint64_t* row_starts;
+  float threshold_f;
+  uintptr_t recbuf_ct;
+  uintptr_t cur_ct;
+  uint64_t rec_left;
+  uint64_t entry_ct = 0;
+  uint32_t new_indiv_ct = 0;
+  uint32_t row;
+  uint32_t col;
+  retval = rel_sparse_open(grmname, grmname_end, indiv_ct, &infile, &hdr);
+  if (retval) {
+    goto rel_sparse_prune_write_ret_1;
+  }
+  if (threshold < hdr.threshold) {
+    threshold = hdr.threshold;
+  }
+  threshold_f = (float)threshold;
+  if (wkspace_alloc_ui_checked(&new_idxs, indiv_ct * sizeof(int32_t)) ||
+      wkspace_alloc_ull_checked(&row_starts, (indiv_ct + 1) * sizeof(int64_t))) {
+    goto rel_sparse_prune_write_ret_NOMEM;
+  }
+  for (row = 0; row < indiv_ct; row++) {
+    new_idxs[row] = new_indiv_ct;
+    if (rel_ct_arr[row] != -1) {
+      new_indiv_ct++;
+    }
+  }
+  recbuf_ct = 65536;
+  if (wkspace_alloc_c_checked((char**)(&recbuf), recbuf_ct * sizeof(Rel_sparse_rec))) {
+    goto rel_sparse_prune_write_ret_NOMEM;
+  }
+  memcpy(outname_end, ".grm.sparse.bin", 16);
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto rel_sparse_prune_write_ret_OPEN_FAIL;
+  }
+  hdr.indiv_ct = new_indiv_ct;
+  hdr.threshold = threshold;
+  if (fwrite_checked(REL_SPARSE_MAGIC, 8, outfile) ||
+      fwrite_checked(&hdr, sizeof(Rel_sparse_header), outfile)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  rec_left = hdr.entry_ct;
+  row = 0;
+  row_starts[0] = 0;
+  while (rec_left) {
+    cur_ct = (rec_left > recbuf_ct)? recbuf_ct : rec_left;
+    if (fread(recbuf, sizeof(Rel_sparse_rec), cur_ct, infile) < cur_ct) {
+      goto rel_sparse_prune_write_ret_READ_FAIL;
+    }
+    rec_left -= cur_ct;
+    recptr_end = &(recbuf[cur_ct]);
+    // compact in place
+    wptr = recbuf;
+    for (recptr = recbuf; recptr < recptr_end; recptr++) {
+      col = recptr->col;
+      if ((rel_ct_arr[row] != -1) && (rel_ct_arr[col] != -1) && ((col == row) || (recptr->val > threshold_f))) {
+	wptr->col = new_idxs[col];
+	wptr->val = recptr->val;
+	wptr++;
+	entry_ct++;
+      }
+      if (col == row) {
+	if (rel_ct_arr[row] != -1) {
+	  row_starts[new_idxs[row] + 1] = entry_ct;
+	}
+	row++;
+      }
+    }
+    if (fwrite_checked(recbuf, (uintptr_t)(wptr - recbuf) * sizeof(Rel_sparse_rec), outfile)) {
+      goto rel_sparse_prune_write_ret_WRITE_FAIL;
+    }
+  }
+  hdr.entry_ct = entry_ct;
+  if (fseeko(outfile, 8, SEEK_SET)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  if (fwrite_checked(&hdr, sizeof(Rel_sparse_header), outfile)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&outfile)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  memcpy(outname_end, ".grm.sparse.idx", 16);
+  if (fopen_checked(&idx_outfile, outname, "wb")) {
+    goto rel_sparse_prune_write_ret_OPEN_FAIL;
+  }
+  if (fwrite_checked(row_starts, (new_indiv_ct + 1) * sizeof(int64_t), idx_outfile)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&idx_outfile)) {
+    goto rel_sparse_prune_write_ret_WRITE_FAIL;
+  }
+  memcpy(outname_end, ".grm.sparse.bin", 16);
+  sprintf(logbuf, "Pruned relationship matrix written to %s.\n", outname);
+  logprintb();
+  while (0) {
+  rel_sparse_prune_write_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  rel_sparse_prune_write_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  rel_sparse_prune_write_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  rel_sparse_prune_write_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  }
+ rel_sparse_prune_write_ret_1:
+  fclose_cond(infile);
+  fclose_cond(outfile);
+  fclose_cond(idx_outfile);
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+int32_t rel_cutoff_batch(uint32_t load_grm_bin, uint32_t load_grm_sparse, char* grmname, char* outname, char* outname_end, double rel_cutoff, uint32_t rel_calc_type, double rel_sparse_cutoff) {
+  // Specialized --rel-cutoff usable on larger files.
+  char* grmname_end = (char*)memchr(grmname, 0, FNAMESIZE);
+  uintptr_t indiv_ct = 0;
+  FILE* idfile = NULL;
+  FILE* outfile = NULL;
+  FILE* out_bin_nfile = NULL;
+  gzFile cur_gzfile = NULL;
+  gzFile gz_outfile = NULL;
+  unsigned char* wkspace_mark = wkspace_base;
+  uint32_t indivs_excluded = 0;
+  uint32_t exactly_one_rel_ct = 0;
+  uintptr_t* compact_rel_table;
+  uintptr_t* rtptr;
+  char* bufptr;
+  uint64_t ullii;
+  uint64_t ulljj;
+  uintptr_t tot_words;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  uint32_t inword_idx;
+  uint32_t inword_bound;
+  uint32_t uii;
+  uint32_t row;
+  uint32_t col;
+  uintptr_t indiv_idx;
+  int32_t* rel_ct_arr;
+  pthread_t threads[MAX_THREADS];
+  Grm_gz_reader ggz;
+  float* slab_buf;
+  double* slab_dbuf;
+  float* fptr;
+  double* dptr;
+  uintptr_t slab_elem_ct;
+  uintptr_t slab_elem_size;
+  float rel_cutoff_f = (float)rel_cutoff;
+  float fxx;
+  float fyy;
+  int32_t retval;
+  int32_t kk;
+  int32_t mm;
+  int32_t cur_prune;
+  g_rcb_in_binfile = NULL;
+  g_rcb_in_bin_nfile = NULL;
+  g_rcb_cur_gzfile = NULL;
+  memcpy(grmname_end, ".grm.id", 8);
+  if (fopen_checked(&idfile, grmname, "r")) {
+    goto rel_cutoff_batch_ret_OPEN_FAIL;
+  }
+  tbuf[MAXLINELEN - 1] = ' ';
+  while (fgets(tbuf, MAXLINELEN, idfile)) {
+    if (!tbuf[MAXLINELEN - 1]) {
+      logprint("Error: Pathologically long line in .grm.id file.\n");
+      goto rel_cutoff_batch_ret_INVALID_FORMAT_1;
+    }
+    if (is_eoln_kns(*(skip_initial_spaces(tbuf)))) {
+      continue;
+    }
+    indiv_ct++;
+  }
+  if (!feof(idfile)) {
+    goto rel_cutoff_batch_ret_READ_FAIL;
+  }
+  fclose_null(&idfile);
+  if (load_grm_sparse) {
+    if (wkspace_alloc_i_checked(&rel_ct_arr, indiv_ct * sizeof(int32_t))) {
+      goto rel_cutoff_batch_ret_NOMEM;
+    }
+    retval = rel_sparse_prune(grmname, grmname_end, indiv_ct, rel_cutoff, rel_ct_arr, &indivs_excluded);
+    if (retval) {
+      goto rel_cutoff_batch_ret_1;
+    }
+    goto rel_cutoff_batch_write_ids;
+  }
+  ullii = indiv_ct;
+  ullii = ((ullii * (ullii - 1)) / 2 + BITCT - 1) / BITCT;
+#ifndef __LP64__
+  if (ullii >= 0x20000000) {
+    goto rel_cutoff_batch_ret_NOMEM;
+  }
+#endif
+  tot_words = ullii;
+  if (wkspace_alloc_ul_checked(&compact_rel_table, tot_words * sizeof(intptr_t))) {
+    goto rel_cutoff_batch_ret_NOMEM;
+  }
+  fill_ulong_zero(compact_rel_table, tot_words);
+  if (wkspace_alloc_i_checked(&rel_ct_arr, indiv_ct * sizeof(int32_t))) {
+    goto rel_cutoff_batch_ret_NOMEM;
+  }
+  fill_int_zero(rel_ct_arr, indiv_ct);
+
+  fputs("Reading... 0%", stdout);
+  fflush(stdout);
+  row = 0;
+  col = 0;
+  if (load_grm_bin) {
+    memcpy(grmname_end, ".grm.bin", 9);
+    if (fopen_checked(&g_rcb_in_binfile, grmname, "rb")) {
+      goto rel_cutoff_batch_ret_OPEN_FAIL;
+    }
+    slab_elem_size = sizeof(float);
   } else {
     memcpy(grmname_end, ".grm.gz", 8);
     if (gzopen_checked(&cur_gzfile, grmname, "rb")) {
@@ -5945,59 +8452,80 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
     if (gzbuffer(cur_gzfile, 131072)) {
       goto rel_cutoff_batch_ret_NOMEM;
     }
-    for (g_pct = 1; g_pct <= 100; g_pct++) {
-      wl_floor = (((uint64_t)tot_words) * (100 - g_pct)) / 100;
-      while (words_left > wl_floor) {
-	cur_word = 0;
-	if (--words_left) {
-	  inword_bound = BITCT;
-	} else {
-	  // only indiv_ct mod (BITCT * 2) matters for remainder
-	  uii = indiv_ct & (BITCT * 2 - 1);
-	  inword_bound = ((uii * (uii - 1)) / 2) & (BITCT - 1);
-	  if (!inword_bound) {
-	    inword_bound = BITCT;
-	  }
+    retval = grm_gz_init(&ggz, cur_gzfile);
+    if (retval) {
+      goto rel_cutoff_batch_ret_1;
+    }
+    slab_elem_size = sizeof(double);
+  }
+  // read slabs of whole rows at a time into the rest of the workspace
+  slab_elem_ct = wkspace_left / slab_elem_size;
+  if (slab_elem_ct < indiv_ct) {
+    goto rel_cutoff_batch_ret_NOMEM;
+  }
+  slab_buf = (float*)wkspace_base;
+  slab_dbuf = (double*)wkspace_base;
+  g_pct = 1;
+  g_rcb_progress = 0;
+  g_rcb_hundredth = 1 + ((((uint64_t)indiv_ct) * (indiv_ct - 1)) / 200);
+  ulljj = 0; // lower-triangle index of start of slab
+  while (row < indiv_ct) {
+    uii = row + 1;
+    while ((uii < indiv_ct) && (((uint64_t)(uii + 1)) * (uii + 2) / 2 - ulljj <= slab_elem_ct)) {
+      uii++;
+    }
+    ulii = ((uint64_t)uii) * (uii + 1) / 2 - ulljj;
+    if (load_grm_bin) {
+      if (fread(slab_buf, sizeof(float), ulii, g_rcb_in_binfile) < ulii) {
+	goto rel_cutoff_batch_ret_READ_FAIL;
+      }
+    } else {
+      retval = grm_gz_fill(&ggz, threads, slab_dbuf, ulii);
+      if (retval) {
+	if (retval == RET_INVALID_FORMAT) {
+	  goto rel_cutoff_batch_ret_INVALID_FORMAT_2;
 	}
-	for (inword_idx = 0; inword_idx < inword_bound; inword_idx++) {
-	  if (!gzgets(cur_gzfile, tbuf, MAXLINELEN)) {
-	    goto rel_cutoff_batch_ret_READ_FAIL;
-	  }
-	  if (row == col) {
-	    row++;
-	    col = 0;
-	    if (!gzgets(cur_gzfile, tbuf, MAXLINELEN)) {
-	      goto rel_cutoff_batch_ret_READ_FAIL;
-	    }
-	  }
-	  bufptr = next_item_mult(tbuf, 3);
-	  if (no_more_items_kns(bufptr)) {
-	    goto rel_cutoff_batch_ret_INVALID_FORMAT_2;
-	  }
-	  if (scan_double(bufptr, &dxx)) {
-	    goto rel_cutoff_batch_ret_INVALID_FORMAT_2;
+	goto rel_cutoff_batch_ret_1;
+      }
+    }
+    for (; row < uii; row++) {
+      // bit index of (row, 0) in compact_rel_table
+      ullii = (((uint64_t)row) * (row - 1)) / 2;
+      if (load_grm_bin) {
+	fptr = &(slab_buf[((uint64_t)row) * (row + 1) / 2 - ulljj]);
+	for (col = 0; col < row; col++) {
+	  if (fptr[col] > rel_cutoff_f) {
+	    rel_ct_arr[row] += 1;
+	    rel_ct_arr[col] += 1;
+	    SET_BIT(compact_rel_table, ullii + col);
 	  }
-	  if (dxx > rel_cutoff) {
+	}
+      } else {
+	dptr = &(slab_dbuf[((uint64_t)row) * (row + 1) / 2 - ulljj]);
+	for (col = 0; col < row; col++) {
+	  if (dptr[col] > rel_cutoff) {
 	    rel_ct_arr[row] += 1;
 	    rel_ct_arr[col] += 1;
-	    cur_word |= (ONELU << inword_idx);
+	    SET_BIT(compact_rel_table, ullii + col);
 	  }
-	  col++;
 	}
-	*rtptr++ = cur_word;
       }
-      if (g_pct < 100) {
+      g_rcb_progress += row;
+      if (g_rcb_progress >= g_pct * g_rcb_hundredth) {
 	if (g_pct > 10) {
 	  putchar('\b');
 	}
-	printf("\b\b%u%%", g_pct);
+	g_pct = 1 + (g_rcb_progress / g_rcb_hundredth);
+	printf("\b\b%u%%", g_pct - 1);
 	fflush(stdout);
       }
     }
-    if (!gzgets(cur_gzfile, tbuf, MAXLINELEN)) {
-      goto rel_cutoff_batch_ret_READ_FAIL;
-    }
-    if (gzgets(cur_gzfile, tbuf, MAXLINELEN)) {
+    ulljj += ulii;
+  }
+  if (load_grm_bin) {
+    fclose_null(&g_rcb_in_binfile);
+  } else {
+    if (grm_gz_trailing_text(&ggz)) {
       goto rel_cutoff_batch_ret_INVALID_FORMAT_2;
     }
     gzclose(cur_gzfile);
@@ -6165,6 +8693,7 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
     indivs_excluded++;
   }
 
+ rel_cutoff_batch_write_ids:
   memcpy(grmname_end, ".grm.id", 8);
   if (fopen_checked(&idfile, grmname, "r")) {
     goto rel_cutoff_batch_ret_OPEN_FAIL;
@@ -6197,7 +8726,12 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
   logprintb();
   sprintf(logbuf, "Remaining individual IDs written to %s.\n", outname);
   logprintb();
-  if (rel_calc_type & (REL_CALC_GRM | REL_CALC_GRM_BIN)) {
+  if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+    retval = rel_sparse_prune_write(grmname, grmname_end, outname, outname_end, indiv_ct, rel_ct_arr, rel_sparse_cutoff);
+    if (retval) {
+      goto rel_cutoff_batch_ret_1;
+    }
+  } else if (rel_calc_type & (REL_CALC_GRM | REL_CALC_GRM_BIN)) {
     g_pct = 1;
     g_rcb_row = 0;
     g_rcb_col = 0;
@@ -6206,6 +8740,10 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
     g_rcb_progress = 0;
     g_rcb_hundredth = 1 + ((((uint64_t)indiv_ct) * (indiv_ct - 1)) / 200);
     if (load_grm_bin) {
+      if (wkspace_alloc_f_checked(&g_rcb_bin_row, indiv_ct * sizeof(float)) ||
+	  wkspace_alloc_f_checked(&g_rcb_bin_nrow, indiv_ct * sizeof(float))) {
+	goto rel_cutoff_batch_ret_NOMEM;
+      }
       memcpy(grmname_end, ".grm.bin", 9);
       if (fopen_checked(&g_rcb_in_binfile, grmname, "rb")) {
 	goto rel_cutoff_batch_ret_OPEN_FAIL;
@@ -6229,6 +8767,7 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
       g_rcb_indiv_ct = indiv_ct;
       g_rcb_rel_ct_arr = rel_ct_arr;
       if (load_grm_bin) {
+	g_rcb_read_fail = 0;
 	if (rel_calc_type & REL_CALC_GZ) {
 	  memcpy(outname_end, ".grm.gz", 8);
 	  parallel_compress(outname, rel_cutoff_batch_rbin_emitn);
@@ -6239,6 +8778,9 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
 	    goto rel_cutoff_batch_ret_1;
 	  }
 	}
+	if (g_rcb_read_fail) {
+	  goto rel_cutoff_batch_ret_READ_FAIL;
+	}
       } else {
 	if (rel_calc_type & REL_CALC_GZ) {
 	  memcpy(outname_end, ".grm.gz", 8);
@@ -6272,25 +8814,20 @@ int32_t rel_cutoff_batch(uint32_t load_grm_bin, char* grmname, char* outname, ch
 	  }
 	} else {
 	  if (load_grm_bin) {
-	    while (g_rcb_col <= g_rcb_row) {
-	      if (rel_ct_arr[g_rcb_col] == -1) {
-		uii = g_rcb_col;
-		while (++g_rcb_col <= g_rcb_row) {
-		  if (rel_ct_arr[g_rcb_col] != -1) {
-		    break;
-		  }
-		}
-		fseeko(g_rcb_in_bin_nfile, (g_rcb_col - uii) * sizeof(float), SEEK_CUR);
-		fseeko(g_rcb_in_bin_nfile, (g_rcb_col - uii) * sizeof(float), SEEK_CUR);
-		if (g_rcb_col > g_rcb_row) {
-		  break;
-		}
+	    // load the whole row, then compact it in place
+	    if ((fread(g_rcb_bin_row, sizeof(float), g_rcb_row + 1, g_rcb_in_binfile) < g_rcb_row + 1) || (fread(g_rcb_bin_nrow, sizeof(float), g_rcb_row + 1, g_rcb_in_bin_nfile) < g_rcb_row + 1)) {
+	      goto rel_cutoff_batch_ret_READ_FAIL;
+	    }
+	    uii = 0;
+	    for (; g_rcb_col <= g_rcb_row; g_rcb_col++) {
+	      if (rel_ct_arr[g_rcb_col] != -1) {
+		g_rcb_bin_row[uii] = g_rcb_bin_row[g_rcb_col];
+		g_rcb_bin_nrow[uii++] = g_rcb_bin_nrow[g_rcb_col];
 	      }
-	      fread(&fxx, 4, 1, g_rcb_in_bin_nfile);
-	      fwrite(&fxx, 4, 1, out_bin_nfile);
-	      fread(&fxx, 4, 1, g_rcb_in_binfile);
-	      fwrite(&fxx, 4, 1, outfile);
-	      g_rcb_col++;
+	    }
+	    fwrite(g_rcb_bin_nrow, sizeof(float), uii, out_bin_nfile);
+	    if (fwrite_checked(g_rcb_bin_row, uii * sizeof(float), outfile)) {
+	      goto rel_cutoff_batch_ret_WRITE_FAIL;
 	    }
 	  } else {
 	    while (g_rcb_col <= g_rcb_row) {
@@ -6618,64 +9155,1021 @@ uint32_t calc_rel_sq_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
 	goto calc_rel_sq_emitn_ret;
       }
     }
-    if (g_cr_indiv2idx == g_cr_indiv1idx) {
-      sptr_cur = double_g_write(sptr_cur, *g_cr_ibc_ptr++);
-      g_cr_indiv2idx++;
+    if (g_cr_indiv2idx == g_cr_indiv1idx) {
+      sptr_cur = double_g_write(sptr_cur, *g_cr_ibc_ptr++);
+      g_cr_indiv2idx++;
+    }
+    while (g_cr_indiv2idx < g_indiv_ct) {
+      *sptr_cur = '\t';
+      sptr_cur = double_g_write(&(sptr_cur[1]), g_rel_dists[tri_coord_no_diag(g_cr_indiv1idx, g_cr_indiv2idx)]);
+      g_cr_indiv2idx++;
+      if (sptr_cur >= readbuf_end) {
+	goto calc_rel_sq_emitn_ret;
+      }
+    }
+    *sptr_cur++ = '\n';
+    g_cr_indiv1idx++;
+    if ((g_cr_indiv1idx - g_cr_min_indiv) * 100LLU >= ((uint64_t)g_pct) * (g_cr_max_indiv1idx - g_cr_min_indiv)) {
+      g_pct = ((g_cr_indiv1idx - g_cr_min_indiv) * 100LLU) / (g_cr_max_indiv1idx - g_cr_min_indiv);
+      printf("\rWriting... %u%%", g_pct++);
+      fflush(stdout);
+    }
+    g_cr_indiv2idx = 0;
+  }
+ calc_rel_sq_emitn_ret:
+  return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
+}
+
+uint32_t calc_rel_grm_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
+  char* sptr_cur = (char*)(&(readbuf[overflow_ct]));
+  char* readbuf_end = (char*)(&(readbuf[PIGZ_BLOCK_SIZE]));
+  char wbuf[16];
+  char* wbuf_end;
+  uint32_t wbuf_len;
+  uint32_t uii;
+  while (g_cr_indiv1idx < g_cr_max_indiv1idx) {
+    uii = g_cr_marker_ct - g_indiv_missing_unwt[g_cr_indiv1idx];
+    wbuf_end = uint32_writex(wbuf, g_cr_indiv1idx + 1, '\t');
+    wbuf_len = (uintptr_t)(wbuf_end - wbuf);
+    while (g_cr_indiv2idx < g_cr_indiv1idx) {
+      sptr_cur = double_e_writex(uint32_writex(uint32_writex(memcpya(sptr_cur, wbuf, wbuf_len), g_cr_indiv2idx + 1, '\t'), (uii - g_indiv_missing_unwt[g_cr_indiv2idx]) + (*g_cr_mdeptr++), '\t'), *g_cr_dist_ptr++, '\n');
+      g_cr_indiv2idx++;
+      if (sptr_cur >= readbuf_end) {
+	goto calc_rel_grm_emitn_ret;
+      }
+    }
+    sptr_cur = double_e_writex(uint32_writex(uint32_writex(memcpya(sptr_cur, wbuf, wbuf_len), ++g_cr_indiv1idx, '\t'), uii, '\t'), *g_cr_ibc_ptr++, '\n');
+    if ((((uint64_t)g_cr_indiv1idx) * (g_cr_indiv1idx + 1) / 2 - g_cr_start_offset) >= g_cr_hundredth * g_pct) {
+      g_pct = (((uint64_t)g_cr_indiv1idx) * (g_cr_indiv1idx + 1) / 2 - g_cr_start_offset) / g_cr_hundredth;
+      printf("\rWriting... %u%%", g_pct++);
+      fflush(stdout);
+    }
+    g_cr_indiv2idx = 0;
+  }
+ calc_rel_grm_emitn_ret:
+  return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
+}
+
+// When the lower triangle doesn't fit in the workspace, --make-rel,
+// --make-grm-gz/--make-grm-bin, and --distance are run as several in-process
+// passes over the .bed file.  Each pass computes the row range --parallel
+// would assign to piece k, and its output is appended to the final file
+// before the next pass starts, so only one piece is ever resident.
+// MATRIX_PASS_SLACK covers the cacheline rounding of each pass's workspace
+// allocations.
+#define MATRIX_PASS_SLACK (64 * CACHELINE)
+
+uintptr_t rel_pass_fixed_bytes(uint64_t calculation_type, uint32_t rel_calc_type, uintptr_t unfiltered_indiv_ct) {
+  // Workspace calc_rel()/calc_rel_f() allocate per pass besides the
+  // triangle: per-individual buffers and the two .bed marker blocks.
+  uintptr_t per_indiv = sizeof(int32_t) + ((calculation_type & CALC_IBC)? 3 : 1) * sizeof(double) + 3 * sizeof(intptr_t);
+  uintptr_t fixed = 2 * MULTIPLEX_REL * ((unfiltered_indiv_ct + 3) / 4) + MATRIX_PASS_SLACK;
+  if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+    // rel_sparse_write() row index, plus at least one row of records
+    per_indiv += sizeof(int64_t) + sizeof(int32_t) + sizeof(Rel_sparse_rec);
+  }
+  if (rel_calc_type & REL_CALC_ENGINE_GEMM) {
+    per_indiv += REL_GEMM_BLOCK * sizeof(double);
+    fixed += ((uintptr_t)g_thread_ct) * REL_GEMM_TILE * REL_GEMM_TILE * sizeof(double) + (g_indiv_ct / REL_GEMM_TILE + 2) * sizeof(int32_t);
+  }
+  return per_indiv * g_indiv_ct + fixed;
+}
+
+uintptr_t distance_pass_fixed_bytes(uintptr_t unfiltered_indiv_ct) {
+  // Same for calc_distance(), assuming the larger exponent-0 buffers.
+  uintptr_t per_indiv = 2 * (MULTIPLEX_2DIST / 8) + sizeof(intptr_t) + 2 * sizeof(int32_t);
+  return per_indiv * g_indiv_ct + 2 * MULTIPLEX_DIST * ((unfiltered_indiv_ct + 3) / 4) + MATRIX_PASS_SLACK;
+}
+
+static uint64_t matrix_pass_max_pairs(uint32_t pass_ct) {
+  // largest piece triangle_fill() hands out when splitting into pass_ct
+  // row ranges
+  uint64_t max_pairs = 0;
+  uint64_t cur_pairs;
+  uint32_t pass_idx;
+  int32_t row_start;
+  int32_t row_end;
+  for (pass_idx = 0; pass_idx < pass_ct; pass_idx++) {
+    parallel_bounds(g_indiv_ct, 1, pass_idx, pass_ct, &row_start, &row_end);
+    cur_pairs = ((((int64_t)row_end) * (row_end - 1)) - ((int64_t)row_start) * (row_start - 1)) / 2;
+    if (cur_pairs > max_pairs) {
+      max_pairs = cur_pairs;
+    }
+  }
+  return max_pairs;
+}
+
+uint32_t matrix_pass_ct(uintptr_t bytes_per_pair, uintptr_t pass_fixed_bytes, uint32_t forced_pass_ct) {
+  // Returns 1 if no splitting is needed, or 0 (after logging the minimum
+  // workspace size) if the largest piece doesn't fit even when split into
+  // the maximum number of passes.  bytes_per_pair should cover every
+  // triangle-sized buffer the calculation allocates, and pass_fixed_bytes
+  // everything else a pass allocates.
+  uint64_t tri_pairs = (((uint64_t)g_indiv_ct) * (g_indiv_ct - 1)) / 2;
+  uint32_t max_pass_ct = (g_indiv_ct < 4)? 1 : (g_indiv_ct / 2);
+  uint64_t avail_pairs;
+  uint64_t ullii;
+  uint32_t pass_ct;
+  if (forced_pass_ct) {
+    return forced_pass_ct;
+  }
+  if (wkspace_left > pass_fixed_bytes) {
+    avail_pairs = (wkspace_left - pass_fixed_bytes) / bytes_per_pair;
+    if (tri_pairs <= avail_pairs) {
+      return 1;
+    }
+    if (avail_pairs) {
+      ullii = (tri_pairs + avail_pairs - 1) / avail_pairs;
+      // triangle_fill() can only split at row boundaries, so the largest
+      // piece may need a few more passes than the average suggests
+      for (pass_ct = (ullii > 2)? ((uint32_t)ullii) : 2; pass_ct <= max_pass_ct; pass_ct++) {
+	if (matrix_pass_max_pairs(pass_ct) <= avail_pairs) {
+	  sprintf(logbuf, "Triangle does not fit in %" PRIu64 " MB of workspace; splitting into %u passes.\n", (uint64_t)(wkspace_left >> 20), pass_ct);
+	  logprintb();
+	  return pass_ct;
+	}
+      }
+    }
+  }
+  ullii = pass_fixed_bytes + matrix_pass_max_pairs(max_pass_ct) * bytes_per_pair;
+  sprintf(logbuf, "Triangle needs at least %" PRIu64 " MB of workspace, even split into %u passes (%" PRIu64 " MB available).\n", (ullii + 0xfffff) >> 20, max_pass_ct, (uint64_t)(wkspace_left >> 20));
+  logprintb();
+  return 0;
+}
+
+// --make-grm-sparse writer.  The finished triangle is scanned in row chunks.
+// Each thread compacts its share of a chunk into its own region of the
+// output buffer; the regions are sized for the worst case (every cell
+// stored), so they can't overflow, and they're written in thread order.
+static double* g_rsp_dists;
+static float* g_rsp_dists_f;
+static double* g_rsp_ibc;
+static float* g_rsp_ibc_f;
+static double g_rsp_threshold;
+static uint64_t g_rsp_start_offset;
+static uint32_t* g_rsp_row_ents;
+static uint32_t g_rsp_thread_rows[MAX_THREADS + 1];
+static Rel_sparse_rec* g_rsp_thread_bufs[MAX_THREADS];
+static uintptr_t g_rsp_thread_ents[MAX_THREADS];
+
+THREAD_RET_TYPE rel_sparse_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uint32_t row = g_rsp_thread_rows[tidx];
+  uint32_t row_end = g_rsp_thread_rows[tidx + 1];
+  uint32_t* row_ents = &(g_rsp_row_ents[row - g_rsp_thread_rows[0]]);
+  Rel_sparse_rec* recptr = g_rsp_thread_bufs[tidx];
+  float threshold_f = (float)g_rsp_threshold;
+  Rel_sparse_rec* row_recptr;
+  double* dptr;
+  float* fptr;
+  uint32_t col;
+  for (; row < row_end; row++) {
+    row_recptr = recptr;
+    if (g_rsp_dists_f) {
+      fptr = &(g_rsp_dists_f[(((uint64_t)row) * (row - 1)) / 2 - g_rsp_start_offset]);
+      for (col = 0; col < row; col++) {
+	if (fptr[col] > threshold_f) {
+	  recptr->col = col;
+	  recptr->val = fptr[col];
+	  recptr++;
+	}
+      }
+      recptr->val = g_rsp_ibc_f[row];
+    } else {
+      dptr = &(g_rsp_dists[(((uint64_t)row) * (row - 1)) / 2 - g_rsp_start_offset]);
+      for (col = 0; col < row; col++) {
+	if (dptr[col] > g_rsp_threshold) {
+	  recptr->col = col;
+	  recptr->val = (float)dptr[col];
+	  recptr++;
+	}
+      }
+      recptr->val = (float)g_rsp_ibc[row];
+    }
+    recptr->col = row;
+    recptr++;
+    *row_ents++ = (uint32_t)(recptr - row_recptr);
+  }
+  g_rsp_thread_ents[tidx] = (uintptr_t)(recptr - g_rsp_thread_bufs[tidx]);
+  THREAD_RETURN;
+}
+
+int32_t rel_sparse_write(pthread_t* threads, char* outname, char* outname_end, double* rel_dists, float* rel_dists_f, double* ibc_ptr, float* ibc_f_ptr, uint32_t min_indiv, uint32_t max_indiv, double threshold, uint32_t pass_idx) {
+  // Writes rows [min_indiv, max_indiv).  ibc_ptr/ibc_f_ptr must point to the
+  // diagonal entry of row min_indiv.  Under --matrix-passes, later passes
+  // append to the files started by pass 0 instead of writing separate pieces,
+  // since their row offsets depend on the earlier passes' entry counts.
+  unsigned char* wkspace_mark = wkspace_base;
+  FILE* outfile = NULL;
+  FILE* idx_outfile = NULL;
+  uint32_t row_ct = max_indiv - min_indiv;
+  uint64_t tot_cells = ((((uint64_t)max_indiv) * (max_indiv + 1)) - (((uint64_t)min_indiv) * (min_indiv + 1))) / 2;
+  uint64_t done_cells = 0;
+  uint32_t pct = 0;
+  int32_t retval = 0;
+  Rel_sparse_header hdr;
+  Rel_sparse_rec* recbuf;
+  uint64_t* row_starts;
+  uint32_t* row_ents;
+  uint64_t entry_ct;
+  uintptr_t max_cells;
+  uintptr_t chunk_cells;
+  uintptr_t cur_cells;
+  uint32_t chunk_start;
+  uint32_t chunk_end;
+  uint32_t row;
+  uint32_t tidx;
+  if (wkspace_alloc_ull_checked(&row_starts, row_ct * sizeof(int64_t)) ||
+      wkspace_alloc_ui_checked(&row_ents, row_ct * sizeof(int32_t))) {
+    goto rel_sparse_write_ret_NOMEM;
+  }
+  recbuf = (Rel_sparse_rec*)wkspace_base;
+  max_cells = wkspace_left / sizeof(Rel_sparse_rec);
+  if (max_cells < max_indiv) {
+    goto rel_sparse_write_ret_NOMEM;
+  }
+  if (max_cells > 0x1000000) {
+    max_cells = 0x1000000;
+    if (max_cells < max_indiv) {
+      max_cells = max_indiv;
+    }
+  }
+  memcpy(outname_end, ".grm.sparse.bin", 16);
+  if (!pass_idx) {
+    if (fopen_checked(&outfile, outname, "wb")) {
+      goto rel_sparse_write_ret_OPEN_FAIL;
+    }
+    hdr.version = 1;
+    hdr.indiv_ct = g_indiv_ct;
+    hdr.threshold = threshold;
+    hdr.entry_ct = 0;
+    if (fwrite_checked(REL_SPARSE_MAGIC, 8, outfile) ||
+        fwrite_checked(&hdr, sizeof(Rel_sparse_header), outfile)) {
+      goto rel_sparse_write_ret_WRITE_FAIL;
+    }
+  } else {
+    if (fopen_checked(&outfile, outname, "r+b")) {
+      goto rel_sparse_write_ret_OPEN_FAIL;
+    }
+    if (fseeko(outfile, 8, SEEK_SET) ||
+        (fread(&hdr, sizeof(Rel_sparse_header), 1, outfile) < 1) ||
+        fseeko(outfile, 0, SEEK_END)) {
+      goto rel_sparse_write_ret_READ_FAIL;
+    }
+  }
+  entry_ct = hdr.entry_ct;
+  g_rsp_dists = rel_dists;
+  g_rsp_dists_f = rel_dists_f;
+  g_rsp_ibc = ibc_ptr? (&(ibc_ptr[-((intptr_t)min_indiv)])) : NULL;
+  g_rsp_ibc_f = ibc_f_ptr? (&(ibc_f_ptr[-((intptr_t)min_indiv)])) : NULL;
+  g_rsp_threshold = threshold;
+  g_rsp_start_offset = (((uint64_t)min_indiv) * (min_indiv - 1)) / 2;
+  fputs("Writing... 0%", stdout);
+  fflush(stdout);
+  for (chunk_start = min_indiv; chunk_start < max_indiv; chunk_start = chunk_end) {
+    chunk_cells = 0;
+    for (chunk_end = chunk_start; (chunk_end < max_indiv) && (chunk_cells + chunk_end + 1 <= max_cells); chunk_end++) {
+      chunk_cells += chunk_end + 1;
+    }
+    // split the chunk's rows between threads by cell count
+    g_rsp_thread_rows[0] = chunk_start;
+    g_rsp_thread_bufs[0] = recbuf;
+    row = chunk_start;
+    cur_cells = 0;
+    for (tidx = 1; tidx < g_thread_ct; tidx++) {
+      while ((row < chunk_end) && (cur_cells < (chunk_cells * tidx) / g_thread_ct)) {
+	cur_cells += row + 1;
+	row++;
+      }
+      g_rsp_thread_rows[tidx] = row;
+      g_rsp_thread_bufs[tidx] = &(recbuf[cur_cells]);
+    }
+    g_rsp_thread_rows[g_thread_ct] = chunk_end;
+    g_rsp_row_ents = &(row_ents[chunk_start - min_indiv]);
+    if (spawn_threads(threads, &rel_sparse_thread, g_thread_ct)) {
+      goto rel_sparse_write_ret_THREAD_CREATE_FAIL;
+    }
+    rel_sparse_thread((void*)0);
+    join_threads(threads, g_thread_ct);
+    for (tidx = 0; tidx < g_thread_ct; tidx++) {
+      if (fwrite_checked(g_rsp_thread_bufs[tidx], g_rsp_thread_ents[tidx] * sizeof(Rel_sparse_rec), outfile)) {
+	goto rel_sparse_write_ret_WRITE_FAIL;
+      }
+    }
+    done_cells += chunk_cells;
+    if ((done_cells * 100) / tot_cells > pct) {
+      pct = (done_cells * 100) / tot_cells;
+      printf("\rWriting... %u%%", pct);
+      fflush(stdout);
+    }
+  }
+  for (row = 0; row < row_ct; row++) {
+    row_starts[row] = entry_ct;
+    entry_ct += row_ents[row];
+  }
+  hdr.entry_ct = entry_ct;
+  if (fseeko(outfile, 8, SEEK_SET)) {
+    goto rel_sparse_write_ret_WRITE_FAIL;
+  }
+  if (fwrite_checked(&hdr, sizeof(Rel_sparse_header), outfile)) {
+    goto rel_sparse_write_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&outfile)) {
+    goto rel_sparse_write_ret_WRITE_FAIL;
+  }
+  memcpy(outname_end, ".grm.sparse.idx", 16);
+  if (fopen_checked(&idx_outfile, outname, pass_idx? "ab" : "wb")) {
+    goto rel_sparse_write_ret_OPEN_FAIL;
+  }
+  if (fwrite_checked(row_starts, row_ct * sizeof(int64_t), idx_outfile)) {
+    goto rel_sparse_write_ret_WRITE_FAIL;
+  }
+  if (max_indiv == g_indiv_ct) {
+    if (fwrite_checked(&entry_ct, sizeof(int64_t), idx_outfile)) {
+      goto rel_sparse_write_ret_WRITE_FAIL;
+    }
+  }
+  if (fclose_null(&idx_outfile)) {
+    goto rel_sparse_write_ret_WRITE_FAIL;
+  }
+  memcpy(outname_end, ".grm.sparse.bin", 16);
+  while (0) {
+  rel_sparse_write_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  rel_sparse_write_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  rel_sparse_write_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  rel_sparse_write_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  rel_sparse_write_ret_THREAD_CREATE_FAIL:
+    logprint(errstr_thread_create);
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
+  }
+  fclose_cond(outfile);
+  fclose_cond(idx_outfile);
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+int32_t rel_pass_append(char* outname, char* outname_end, uint32_t rel_calc_type, uint32_t pass_idx) {
+  const char* ext;
+  int32_t retval;
+  if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+    // rel_sparse_write() already appended to the final files
+    return 0;
+  } else if (rel_calc_type & REL_CALC_GRM_BIN) {
+    retval = append_part_file(outname, outname_end, ".grm.N.bin", pass_idx, !pass_idx);
+    if (retval) {
+      return retval;
+    }
+    ext = ".grm.bin";
+  } else if (rel_calc_type & REL_CALC_BIN) {
+    ext = ".rel.bin";
+  } else if (rel_calc_type & REL_CALC_GRM) {
+    ext = (rel_calc_type & REL_CALC_GZ)? ".grm.gz" : ".grm";
+  } else {
+    ext = (rel_calc_type & REL_CALC_GZ)? ".rel.gz" : ".rel";
+  }
+  return append_part_file(outname, outname_end, ext, pass_idx, !pass_idx);
+}
+
+int32_t distance_pass_append(char* outname, char* outname_end, uint32_t dist_calc_type, uint32_t pass_idx) {
+  const char* suffix = (dist_calc_type & DISTANCE_BIN)? ".bin" : ((dist_calc_type & DISTANCE_GZ)? ".gz" : "");
+  char ext[16];
+  int32_t retval;
+  if (dist_calc_type & DISTANCE_ALCT) {
+    sprintf(ext, ".dist%s", suffix);
+    retval = append_part_file(outname, outname_end, ext, pass_idx, !pass_idx);
+    if (retval) {
+      return retval;
+    }
+  }
+  if (dist_calc_type & DISTANCE_IBS) {
+    sprintf(ext, ".mibs%s", suffix);
+    retval = append_part_file(outname, outname_end, ext, pass_idx, !pass_idx);
+    if (retval) {
+      return retval;
+    }
+  }
+  if (dist_calc_type & DISTANCE_1_MINUS_IBS) {
+    sprintf(ext, ".mdist%s", suffix);
+    return append_part_file(outname, outname_end, ext, pass_idx, !pass_idx);
+  }
+  return 0;
+}
+
+// --parallel-merge row layouts
+#define PMERGE_TRI 0
+#define PMERGE_TRI_NODIAG 1
+#define PMERGE_SQ0 2
+#define PMERGE_GRM 3
+#define PMERGE_GENOME 4
+
+uint64_t pmerge_entry_ct(uint32_t row_start, uint32_t row_end, uintptr_t indiv_ct, uint32_t layout) {
+  // number of matrix entries (.grm/.genome lines) in rows [row_start, row_end)
+  uint64_t start = row_start;
+  uint64_t end = row_end;
+  if (layout == PMERGE_SQ0) {
+    return (end - start) * indiv_ct;
+  } else if (layout == PMERGE_TRI_NODIAG) {
+    return (end * (end - 1) - start * (start - 1)) / 2;
+  } else if (layout == PMERGE_GENOME) {
+    return (end - start) * (indiv_ct - 1) - (end * (end - 1) - start * (start - 1)) / 2;
+  }
+  return (end * (end + 1) - start * (start + 1)) / 2;
+}
+
+void pmerge_part_bounds(uintptr_t indiv_ct, uint32_t part_idx, uint32_t part_ct, uint32_t layout, uint32_t* row_start_ptr, uint32_t* row_end_ptr) {
+  int32_t lbound;
+  int32_t ubound;
+  if (layout == PMERGE_GENOME) {
+    // calc_genome() hands out pieces from the bottom of the triangle up
+    parallel_bounds(indiv_ct, 1, part_ct - part_idx - 1, part_ct, &lbound, &ubound);
+    *row_start_ptr = indiv_ct - ubound;
+    *row_end_ptr = indiv_ct - lbound;
+  } else {
+    parallel_bounds(indiv_ct, 1, part_idx, part_ct, &lbound, &ubound);
+    // the first piece's bound is 1, but it includes row 0
+    *row_start_ptr = (lbound == 1)? 0 : lbound;
+    *row_end_ptr = ubound;
+  }
+}
+
+int32_t pmerge_text_part(char* part_fname, FILE* outfile, uint32_t layout, uintptr_t indiv_ct, uint32_t row_start, uint32_t row_end, uint32_t is_first, uint32_t* genome_tok_ct_ptr, uint64_t* line_ct_ptr) {
+  // Streams one (possibly gzipped) text piece through a token counter,
+  // checking that it contains exactly rows [row_start, row_end).  .genome
+  // pieces are only checked for a consistent column count, and for a header
+  // line iff is_first is set.  The decompressed text is copied to outfile if
+  // it isn't NULL.
+  gzFile gz_infile = NULL;
+  uint32_t cur_row = row_start;
+  uint32_t cur_col = 0;
+  uint32_t tok_ct = 0;
+  uint32_t in_tok = 0;
+  uint32_t at_first_line = (layout == PMERGE_GENOME);
+  uint32_t header_state = 0;
+  uint64_t line_ct = 0;
+  int32_t retval = 0;
+  uint32_t tok_vals[2];
+  unsigned char* bufptr;
+  unsigned char* buf_end;
+  uint32_t last_char;
+  uint32_t row_tok_ct;
+  uint32_t ucc;
+  int32_t ii;
+  if (gzopen_checked(&gz_infile, part_fname, "rb")) {
+    goto pmerge_text_part_ret_OPEN_FAIL;
+  }
+  if (gzbuffer(gz_infile, 131072)) {
+    goto pmerge_text_part_ret_NOMEM;
+  }
+  if ((layout == PMERGE_TRI_NODIAG) && (!cur_row) && row_end) {
+    // row 0 of a distance triangle is empty, and isn't written at all
+    cur_row = 1;
+  }
+  last_char = '\n';
+  while (1) {
+    ii = gzread(gz_infile, tbuf, MAXLINELEN * 4);
+    if (ii < 0) {
+      goto pmerge_text_part_ret_READ_FAIL;
+    } else if (!ii) {
+      break;
+    }
+    if (outfile && fwrite_checked(tbuf, ii, outfile)) {
+      goto pmerge_text_part_ret_WRITE_FAIL;
+    }
+    bufptr = (unsigned char*)tbuf;
+    buf_end = &(bufptr[(uint32_t)ii]);
+    last_char = buf_end[-1];
+    for (; bufptr < buf_end; bufptr++) {
+      ucc = *bufptr;
+      if (ucc > ' ') {
+	if (!in_tok) {
+	  in_tok = 1;
+	  if (tok_ct < 2) {
+	    tok_vals[tok_ct] = 0;
+	  }
+	  if (at_first_line && (!tok_ct)) {
+	    // check for "FID1"
+	    header_state = 1;
+	  }
+	  tok_ct++;
+	}
+	if (tok_ct <= 2) {
+	  ucc -= '0';
+	  tok_vals[tok_ct - 1] = (ucc < 10)? (tok_vals[tok_ct - 1] * 10 + ucc) : 0xffffffffU;
+	}
+	if ((tok_ct == 1) && header_state && (header_state < 6)) {
+	  header_state = ((header_state < 5) && (*bufptr == (unsigned char)("FID1"[header_state - 1])))? (header_state + 1) : 6;
+	}
+	continue;
+      }
+      in_tok = 0;
+      if ((ucc != '\n') || (!tok_ct)) {
+	continue;
+      }
+      if (layout == PMERGE_GENOME) {
+	if (at_first_line) {
+	  at_first_line = 0;
+	  if ((header_state == 5) != is_first) {
+	    goto pmerge_text_part_ret_BAD_HEADER;
+	  }
+	  if (is_first) {
+	    *genome_tok_ct_ptr = tok_ct;
+	    tok_ct = 0;
+	    continue;
+	  }
+	}
+	if (tok_ct != *genome_tok_ct_ptr) {
+	  goto pmerge_text_part_ret_BAD_LINE;
+	}
+      } else {
+	if (cur_row == row_end) {
+	  goto pmerge_text_part_ret_BAD_LINE;
+	}
+	if (layout == PMERGE_GRM) {
+	  if ((tok_ct != 4) || (tok_vals[0] != cur_row + 1) || (tok_vals[1] != cur_col + 1)) {
+	    goto pmerge_text_part_ret_BAD_LINE;
+	  }
+	  if (++cur_col > cur_row) {
+	    cur_row++;
+	    cur_col = 0;
+	  }
+	} else {
+	  if (layout == PMERGE_SQ0) {
+	    row_tok_ct = indiv_ct;
+	  } else {
+	    row_tok_ct = cur_row + (layout == PMERGE_TRI);
+	  }
+	  if (tok_ct != row_tok_ct) {
+	    goto pmerge_text_part_ret_BAD_LINE;
+	  }
+	  cur_row++;
+	}
+      }
+      line_ct++;
+      tok_ct = 0;
+    }
+  }
+  if (last_char != '\n') {
+    sprintf(logbuf, "Error: %s does not end with a newline (truncated file?).\n", part_fname);
+    goto pmerge_text_part_ret_INVALID_FORMAT_2;
+  }
+  if (layout == PMERGE_GENOME) {
+    if (is_first && (!(*genome_tok_ct_ptr))) {
+      goto pmerge_text_part_ret_BAD_HEADER;
+    }
+  } else if ((cur_row != row_end) || cur_col) {
+    sprintf(logbuf, "Error: %s ends early (it should cover rows %u-%u).\n", part_fname, row_start + 1, row_end);
+    goto pmerge_text_part_ret_INVALID_FORMAT_2;
+  }
+  *line_ct_ptr = line_ct;
+  while (0) {
+  pmerge_text_part_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  pmerge_text_part_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  pmerge_text_part_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  pmerge_text_part_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  pmerge_text_part_ret_BAD_HEADER:
+    if (is_first) {
+      sprintf(logbuf, "Error: %s is missing its header line.\n", part_fname);
+    } else {
+      sprintf(logbuf, "Error: %s has a header line, so it isn't a later piece.\n", part_fname);
+    }
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  pmerge_text_part_ret_BAD_LINE:
+    if (layout == PMERGE_GENOME) {
+      sprintf(logbuf, "Error: Line %" PRIu64 " of %s has the wrong number of columns.\n", line_ct + 1 + is_first, part_fname);
+    } else {
+      sprintf(logbuf, "Error: Line %" PRIu64 " of %s doesn't match the expected matrix shape (this\npiece should cover rows %u-%u).\n", line_ct + 1, part_fname, row_start + 1, row_end);
+    }
+  pmerge_text_part_ret_INVALID_FORMAT_2:
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+  gzclose_cond(gz_infile);
+  return retval;
+}
+
+int32_t pmerge_bin_part(char* part_fname, FILE* outfile, uint64_t expected_size) {
+  FILE* infile = NULL;
+  int64_t fsize;
+  if (fopen_checked(&infile, part_fname, "rb")) {
+    return RET_OPEN_FAIL;
+  }
+  if (fseeko(infile, 0, SEEK_END)) {
+    fclose(infile);
+    return RET_READ_FAIL;
+  }
+  fsize = ftello(infile);
+  fclose(infile);
+  if ((uint64_t)fsize != expected_size) {
+    sprintf(logbuf, "Error: %s is %" PRId64 " bytes, but this piece should be %" PRIu64 "\nbytes.\n", part_fname, fsize, expected_size);
+    logprintb();
+    return RET_INVALID_FORMAT;
+  }
+  return fappend_file(part_fname, outfile);
+}
+
+int32_t pmerge_genome_bin(char* outname, char* outname_end, uint32_t part_ct) {
+  // .genome.bin pieces all carry the full ID table, so here we can check that
+  // the pieces came from the same run as well as checking their row ranges.
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  Genome_bin_rec* recs = (Genome_bin_rec*)tbuf;
+  uintptr_t rec_buf_ct = (MAXLINELEN * 4) / sizeof(Genome_bin_rec);
+  uint64_t last_key = 0;
+  uint64_t tot_rec_ct = 0;
+  uintptr_t id_block_size = 0;
+  char* id_block = NULL;
+  int32_t retval = 0;
+  char part_fname[FNAMESIZE];
+  Genome_bin_header hdr;
+  Genome_bin_header part_hdr;
+  Genome_bin_rec* rec_ptr;
+  uint64_t recs_left;
+  uint64_t cur_key;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uint32_t part_idx;
+  uint32_t row_start;
+  uint32_t row_end;
+  strcpy(outname_end, ".genome.bin");
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto pmerge_genome_bin_ret_OPEN_FAIL;
+  }
+  for (part_idx = 0; part_idx < part_ct; part_idx++) {
+    sprintf(part_fname, "%s", outname);
+    sprintf(&(part_fname[outname_end - outname]), ".genome.%u.bin", part_idx + 1);
+    if (fopen_checked(&infile, part_fname, "rb")) {
+      goto pmerge_genome_bin_ret_OPEN_FAIL;
+    }
+    if ((fread(tbuf, 1, 8, infile) < 8) || memcmp(tbuf, GENOME_BIN_MAGIC, 8) || (fread(&part_hdr, sizeof(Genome_bin_header), 1, infile) < 1) || (part_hdr.version != 1)) {
+      sprintf(logbuf, "Error: %s is not a --genome bin file.\n", part_fname);
+      goto pmerge_genome_bin_ret_INVALID_FORMAT_2;
+    }
+    if (!part_idx) {
+      hdr = part_hdr;
+      id_block_size = ((uintptr_t)hdr.id_ct) * hdr.max_id_len;
+      id_block_size += (8 - (id_block_size & 7)) & 7;
+      if (wkspace_alloc_c_checked(&id_block, id_block_size)) {
+	goto pmerge_genome_bin_ret_NOMEM;
+      }
+      if (fread(id_block, 1, id_block_size, infile) < id_block_size) {
+	goto pmerge_genome_bin_ret_READ_FAIL;
+      }
+      hdr.flags = 0;
+      hdr.record_ct = 0;
+      if (fwrite_checked(GENOME_BIN_MAGIC, 8, outfile) ||
+	  fwrite_checked(&hdr, sizeof(Genome_bin_header), outfile) ||
+	  fwrite_checked(id_block, id_block_size, outfile)) {
+	goto pmerge_genome_bin_ret_WRITE_FAIL;
+      }
+    } else {
+      if ((part_hdr.id_ct != hdr.id_ct) || (part_hdr.max_id_len != hdr.max_id_len)) {
+	goto pmerge_genome_bin_ret_ID_MISMATCH;
+      }
+      for (ulii = 0; ulii < id_block_size; ulii += uljj) {
+	uljj = id_block_size - ulii;
+	if (uljj > MAXLINELEN * 4) {
+	  uljj = MAXLINELEN * 4;
+	}
+	if (fread(tbuf, 1, uljj, infile) < uljj) {
+	  goto pmerge_genome_bin_ret_READ_FAIL;
+	}
+	if (memcmp(tbuf, &(id_block[ulii]), uljj)) {
+	  goto pmerge_genome_bin_ret_ID_MISMATCH;
+	}
+      }
+    }
+    pmerge_part_bounds(hdr.id_ct, part_idx, part_ct, PMERGE_GENOME, &row_start, &row_end);
+    recs_left = part_hdr.record_ct;
+    if (recs_left > pmerge_entry_ct(row_start, row_end, hdr.id_ct, PMERGE_GENOME)) {
+      goto pmerge_genome_bin_ret_BAD_RANGE;
+    }
+    while (recs_left) {
+      ulii = (recs_left > rec_buf_ct)? rec_buf_ct : recs_left;
+      if (fread(recs, sizeof(Genome_bin_rec), ulii, infile) < ulii) {
+	goto pmerge_genome_bin_ret_READ_FAIL;
+      }
+      for (rec_ptr = recs; rec_ptr < &(recs[ulii]); rec_ptr++) {
+	cur_key = (((uint64_t)rec_ptr->idx1) << 32) | rec_ptr->idx2;
+	if ((rec_ptr->idx1 < row_start) || (rec_ptr->idx1 >= row_end) || (rec_ptr->idx2 <= rec_ptr->idx1) || (rec_ptr->idx2 >= hdr.id_ct) || (cur_key <= last_key)) {
+	  goto pmerge_genome_bin_ret_BAD_RANGE;
+	}
+	last_key = cur_key;
+      }
+      if (fwrite_checked(recs, ulii * sizeof(Genome_bin_rec), outfile)) {
+	goto pmerge_genome_bin_ret_WRITE_FAIL;
+      }
+      recs_left -= ulii;
+    }
+    if (fread(tbuf, 1, 1, infile)) {
+      goto pmerge_genome_bin_ret_BAD_RANGE;
+    }
+    tot_rec_ct += part_hdr.record_ct;
+    fclose_null(&infile);
+  }
+  sprintf(&(part_fname[outname_end - outname]), ".genome.%u.bin", part_ct + 1);
+  infile = fopen(part_fname, "rb");
+  if (infile) {
+    sprintf(logbuf, "Error: %s exists, so there appear to be more than %u pieces.\n", part_fname, part_ct);
+    goto pmerge_genome_bin_ret_INVALID_FORMAT_2;
+  }
+  hdr.record_ct = tot_rec_ct;
+  if (tot_rec_ct == (((uint64_t)hdr.id_ct) * (hdr.id_ct - 1)) / 2) {
+    hdr.flags = GENOME_BIN_COMPLETE;
+  }
+  if (fseeko(outfile, 8, SEEK_SET) ||
+      fwrite_checked(&hdr, sizeof(Genome_bin_header), outfile)) {
+    goto pmerge_genome_bin_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&outfile)) {
+    goto pmerge_genome_bin_ret_WRITE_FAIL;
+  }
+  while (0) {
+  pmerge_genome_bin_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  pmerge_genome_bin_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  pmerge_genome_bin_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  pmerge_genome_bin_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  pmerge_genome_bin_ret_ID_MISMATCH:
+    sprintf(logbuf, "Error: %s has a different individual ID list than piece 1.\n", part_fname);
+    goto pmerge_genome_bin_ret_INVALID_FORMAT_2;
+  pmerge_genome_bin_ret_BAD_RANGE:
+    sprintf(logbuf, "Error: %s contains records outside its row range (%u-%u).\n", part_fname, row_start + 1, row_end);
+  pmerge_genome_bin_ret_INVALID_FORMAT_2:
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+  fclose_cond(infile);
+  fclose_cond(outfile);
+  if (retval) {
+    unlink(outname);
+  }
+  return retval;
+}
+
+int32_t pmerge_id_ct(char* id_fname, uintptr_t* indiv_ct_ptr) {
+  // piece 1 is the only one which writes the .id file
+  FILE* infile = NULL;
+  uintptr_t indiv_ct = 0;
+  if (fopen_checked(&infile, id_fname, "r")) {
+    return RET_OPEN_FAIL;
+  }
+  tbuf[MAXLINELEN - 1] = ' ';
+  while (fgets(tbuf, MAXLINELEN, infile)) {
+    if (!tbuf[MAXLINELEN - 1]) {
+      sprintf(logbuf, "Error: Pathologically long line in %s.\n", id_fname);
+      logprintb();
+      fclose(infile);
+      return RET_INVALID_FORMAT;
+    }
+    if (!is_eoln_kns(*skip_initial_spaces(tbuf))) {
+      indiv_ct++;
+    }
+  }
+  if (ferror(infile)) {
+    fclose(infile);
+    return RET_READ_FAIL;
+  }
+  fclose(infile);
+  if (indiv_ct < 2) {
+    sprintf(logbuf, "Error: %s lists fewer than two individuals.\n", id_fname);
+    logprintb();
+    return RET_INVALID_FORMAT;
+  }
+  *indiv_ct_ptr = indiv_ct;
+  return 0;
+}
+
+int32_t parallel_merge(char* outname, char* outname_end, uint64_t calculation_type, uint32_t rel_calc_type, uint32_t dist_calc_type, uint32_t genome_modifier, uint32_t part_ct) {
+  // Stitches together the pieces written by --parallel 1 [part_ct] ...
+  // --parallel [part_ct] [part_ct], after checking that each piece covers
+  // exactly the rows it should.  Text pieces are streamed through a
+  // validator; gzipped pieces are validated and then appended as-is (since
+  // concatenated gzip members form a valid gzip file); binary pieces are
+  // checked by size.  The pieces are left in place.
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  unsigned char* wkspace_mark = wkspace_base;
+  uint64_t* line_cts = NULL;
+  uintptr_t indiv_ct = 0;
+  uint32_t output_ct = 0;
+  uint32_t genome_tok_ct = 0;
+  uint32_t elem_size = 0;
+  int32_t retval = 0;
+  char part_fname[FNAMESIZE];
+  char exts[3][16];
+  char id_ext[16];
+  const char* suffix;
+  uint64_t tot_line_ct;
+  uint32_t layouts[3];
+  uint32_t layout;
+  uint32_t is_gz;
+  uint32_t output_idx;
+  uint32_t part_idx;
+  uint32_t row_start;
+  uint32_t row_end;
+  if (calculation_type & CALC_GENOME) {
+    layout = PMERGE_GENOME;
+    if (genome_modifier & GENOME_OUTPUT_BIN) {
+      retval = pmerge_genome_bin(outname, outname_end, part_ct);
+      if (retval) {
+	goto parallel_merge_ret_1;
+      }
+      sprintf(logbuf, "--parallel-merge: %u pieces merged into %s.\n", part_ct, outname);
+      logprintb();
+      goto parallel_merge_ret_1;
+    }
+    strcpy(exts[0], (genome_modifier & GENOME_OUTPUT_GZ)? ".genome.gz" : ".genome");
+    output_ct = 1;
+    if (wkspace_alloc_ull_checked(&line_cts, part_ct * sizeof(int64_t))) {
+      goto parallel_merge_ret_NOMEM;
+    }
+  } else if (calculation_type & CALC_RELATIONSHIP) {
+    layout = ((rel_calc_type & REL_CALC_SHAPEMASK) == REL_CALC_SQ0)? PMERGE_SQ0 : PMERGE_TRI;
+    if (rel_calc_type & REL_CALC_GRM_BIN) {
+      strcpy(exts[0], ".grm.bin");
+      strcpy(exts[1], ".grm.N.bin");
+      output_ct = 2;
+      elem_size = sizeof(float);
+      layout = PMERGE_TRI;
+    } else if (rel_calc_type & REL_CALC_BIN) {
+      strcpy(exts[0], ".rel.bin");
+      output_ct = 1;
+      elem_size = (rel_calc_type & REL_CALC_SINGLE_PREC)? sizeof(float) : sizeof(double);
+    } else if (rel_calc_type & REL_CALC_GRM) {
+      strcpy(exts[0], (rel_calc_type & REL_CALC_GZ)? ".grm.gz" : ".grm");
+      output_ct = 1;
+      layout = PMERGE_GRM;
+    } else {
+      strcpy(exts[0], (rel_calc_type & REL_CALC_GZ)? ".rel.gz" : ".rel");
+      output_ct = 1;
+    }
+    strcpy(id_ext, (rel_calc_type & (REL_CALC_GRM | REL_CALC_GRM_BIN))? ".grm.id" : ".rel.id");
+  } else {
+    layout = ((dist_calc_type & DISTANCE_SHAPEMASK) == DISTANCE_SQ0)? PMERGE_SQ0 : PMERGE_TRI_NODIAG;
+    if (dist_calc_type & DISTANCE_BIN) {
+      suffix = ".bin";
+      elem_size = sizeof(double);
+    } else {
+      suffix = (dist_calc_type & DISTANCE_GZ)? ".gz" : "";
+    }
+    // text .mibs triangles include the diagonal
+    if (dist_calc_type & DISTANCE_ALCT) {
+      layouts[output_ct] = layout;
+      sprintf(exts[output_ct++], ".dist%s", suffix);
+    }
+    if (dist_calc_type & DISTANCE_IBS) {
+      layouts[output_ct] = ((layout == PMERGE_TRI_NODIAG) && (!elem_size))? PMERGE_TRI : layout;
+      sprintf(exts[output_ct++], ".mibs%s", suffix);
     }
-    while (g_cr_indiv2idx < g_indiv_ct) {
-      *sptr_cur = '\t';
-      sptr_cur = double_g_write(&(sptr_cur[1]), g_rel_dists[tri_coord_no_diag(g_cr_indiv1idx, g_cr_indiv2idx)]);
-      g_cr_indiv2idx++;
-      if (sptr_cur >= readbuf_end) {
-	goto calc_rel_sq_emitn_ret;
-      }
+    if (dist_calc_type & DISTANCE_1_MINUS_IBS) {
+      layouts[output_ct] = layout;
+      sprintf(exts[output_ct++], ".mdist%s", suffix);
     }
-    *sptr_cur++ = '\n';
-    g_cr_indiv1idx++;
-    if ((g_cr_indiv1idx - g_cr_min_indiv) * 100LLU >= ((uint64_t)g_pct) * (g_cr_max_indiv1idx - g_cr_min_indiv)) {
-      g_pct = ((g_cr_indiv1idx - g_cr_min_indiv) * 100LLU) / (g_cr_max_indiv1idx - g_cr_min_indiv);
-      printf("\rWriting... %u%%", g_pct++);
-      fflush(stdout);
+    // the .id files are identical, so just check the first one
+    strcpy(id_ext, exts[0]);
+    strcpy(&(id_ext[strlen(id_ext) - strlen(suffix)]), ".id");
+  }
+  if (layout != PMERGE_GENOME) {
+    strcpy(outname_end, id_ext);
+    retval = pmerge_id_ct(outname, &indiv_ct);
+    if (retval) {
+      goto parallel_merge_ret_1;
+    }
+    if (part_ct > indiv_ct / 2) {
+      sprintf(logbuf, "Error: %s lists only %" PRIuPTR " individuals, so there can't be %u\npieces.\n", outname, indiv_ct, part_ct);
+      goto parallel_merge_ret_INVALID_FORMAT_2;
     }
-    g_cr_indiv2idx = 0;
   }
- calc_rel_sq_emitn_ret:
-  return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
-}
-
-uint32_t calc_rel_grm_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
-  char* sptr_cur = (char*)(&(readbuf[overflow_ct]));
-  char* readbuf_end = (char*)(&(readbuf[PIGZ_BLOCK_SIZE]));
-  char wbuf[16];
-  char* wbuf_end;
-  uint32_t wbuf_len;
-  uint32_t uii;
-  while (g_cr_indiv1idx < g_cr_max_indiv1idx) {
-    uii = g_cr_marker_ct - g_indiv_missing_unwt[g_cr_indiv1idx];
-    wbuf_end = uint32_writex(wbuf, g_cr_indiv1idx + 1, '\t');
-    wbuf_len = (uintptr_t)(wbuf_end - wbuf);
-    while (g_cr_indiv2idx < g_cr_indiv1idx) {
-      sptr_cur = double_e_writex(uint32_writex(uint32_writex(memcpya(sptr_cur, wbuf, wbuf_len), g_cr_indiv2idx + 1, '\t'), (uii - g_indiv_missing_unwt[g_cr_indiv2idx]) + (*g_cr_mdeptr++), '\t'), *g_cr_dist_ptr++, '\n');
-      g_cr_indiv2idx++;
-      if (sptr_cur >= readbuf_end) {
-	goto calc_rel_grm_emitn_ret;
+  for (output_idx = 0; output_idx < output_ct; output_idx++) {
+    if (calculation_type & CALC_DISTANCE) {
+      layout = layouts[output_idx];
+    }
+    is_gz = (!elem_size) && (strlen(exts[output_idx]) > 3) && (!strcmp(&(exts[output_idx][strlen(exts[output_idx]) - 3]), ".gz"));
+    strcpy(outname_end, exts[output_idx]);
+    if (fopen_checked(&outfile, outname, "wb")) {
+      goto parallel_merge_ret_OPEN_FAIL;
+    }
+    for (part_idx = 0; part_idx <= part_ct; part_idx++) {
+      if (layout == PMERGE_GENOME) {
+	strcpy(part_fname, outname);
+	sprintf(&(part_fname[outname_end - outname]), ".genome.%u%s", part_idx + 1, is_gz? ".gz" : "");
+      } else {
+	part_fname_write(part_fname, outname, outname_end, exts[output_idx], part_idx);
+      }
+      if (part_idx == part_ct) {
+	// a surplus piece means the pieces were written with a different count
+	infile = fopen(part_fname, "rb");
+	if (infile) {
+	  fclose(infile);
+	  sprintf(logbuf, "Error: %s exists, so there appear to be more than %u pieces.\n", part_fname, part_ct);
+	  goto parallel_merge_ret_INVALID_FORMAT_2;
+	}
+	break;
+      }
+      if (layout == PMERGE_GENOME) {
+	// row ranges can only be checked after the individual count is known
+	row_start = 0;
+	row_end = 0;
+      } else {
+	pmerge_part_bounds(indiv_ct, part_idx, part_ct, layout, &row_start, &row_end);
+      }
+      if (elem_size) {
+	retval = pmerge_bin_part(part_fname, outfile, pmerge_entry_ct(row_start, row_end, indiv_ct, layout) * elem_size);
+      } else {
+	retval = pmerge_text_part(part_fname, is_gz? NULL : outfile, layout, indiv_ct, row_start, row_end, !part_idx, &genome_tok_ct, &tot_line_ct);
+	if ((!retval) && is_gz) {
+	  retval = fappend_file(part_fname, outfile);
+	}
+	if (line_cts) {
+	  line_cts[part_idx] = tot_line_ct;
+	}
+      }
+      if (retval) {
+	goto parallel_merge_ret_1;
       }
     }
-    sptr_cur = double_e_writex(uint32_writex(uint32_writex(memcpya(sptr_cur, wbuf, wbuf_len), ++g_cr_indiv1idx, '\t'), uii, '\t'), *g_cr_ibc_ptr++, '\n');
-    if ((((uint64_t)g_cr_indiv1idx) * (g_cr_indiv1idx + 1) / 2 - g_cr_start_offset) >= g_cr_hundredth * g_pct) {
-      g_pct = (((uint64_t)g_cr_indiv1idx) * (g_cr_indiv1idx + 1) / 2 - g_cr_start_offset) / g_cr_hundredth;
-      printf("\rWriting... %u%%", g_pct++);
-      fflush(stdout);
+    if (fclose_null(&outfile)) {
+      goto parallel_merge_ret_WRITE_FAIL;
     }
-    g_cr_indiv2idx = 0;
+    if (line_cts && (!(genome_modifier & (GENOME_REL_CHECK | GENOME_FILTER_PI_HAT)))) {
+      // every pair is present, so the total line count determines the
+      // individual count
+      tot_line_ct = 0;
+      for (part_idx = 0; part_idx < part_ct; part_idx++) {
+	tot_line_ct += line_cts[part_idx];
+      }
+      indiv_ct = (uintptr_t)((1 + sqrt((double)(1 + 8 * tot_line_ct))) * 0.5);
+      if ((((uint64_t)indiv_ct) * (indiv_ct - 1)) / 2 != tot_line_ct) {
+	sprintf(logbuf, "Error: The pieces contain %" PRIu64 " pairs in total, which is not n(n-1)/2 for\nany n.  (Use --rel-check/--min/--max here if they were used to create them.)\n", tot_line_ct);
+	goto parallel_merge_ret_INVALID_FORMAT_2;
+      }
+      for (part_idx = 0; part_idx < part_ct; part_idx++) {
+	pmerge_part_bounds(indiv_ct, part_idx, part_ct, layout, &row_start, &row_end);
+	if (line_cts[part_idx] != pmerge_entry_ct(row_start, row_end, indiv_ct, layout)) {
+	  sprintf(logbuf, "Error: Piece %u contains %" PRIu64 " pairs, but with %" PRIuPTR " individuals it should\ncontain %" PRIu64 ".\n", part_idx + 1, line_cts[part_idx], indiv_ct, pmerge_entry_ct(row_start, row_end, indiv_ct, layout));
+	  goto parallel_merge_ret_INVALID_FORMAT_2;
+	}
+      }
+    }
+    sprintf(logbuf, "--parallel-merge: %u pieces merged into %s.\n", part_ct, outname);
+    logprintb();
   }
- calc_rel_grm_emitn_ret:
-  return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
+  while (0) {
+  parallel_merge_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  parallel_merge_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  parallel_merge_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  parallel_merge_ret_INVALID_FORMAT_2:
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+ parallel_merge_ret_1:
+  if (outfile) {
+    fclose(outfile);
+    unlink(outname);
+  } else if (retval && (layout == PMERGE_GENOME) && output_ct) {
+    unlink(outname);
+  }
+  wkspace_reset(wkspace_mark);
+  return retval;
 }
 
-int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, uint64_t calculation_type, uint32_t rel_calc_type, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uint32_t marker_ct, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* person_ids, uintptr_t max_person_id_len, int32_t ibc_type, double rel_cutoff, double* set_allele_freqs, double** rel_ibc_ptr, Chrom_info* chrom_info_ptr) {
+int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, uint64_t calculation_type, uint32_t rel_calc_type, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uint32_t marker_ct, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* person_ids, uintptr_t max_person_id_len, int32_t ibc_type, double rel_cutoff, double rel_sparse_cutoff, double* set_allele_freqs, double** rel_ibc_ptr, Chrom_info* chrom_info_ptr) {
   uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
-  uintptr_t marker_uidx = 0;
   uintptr_t marker_idx = 0;
   FILE* outfile = NULL;
   gzFile gz_outfile = NULL;
@@ -6684,14 +10178,15 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
   double* dist_ptr = NULL;
   double* dptr3 = NULL;
   double* dptr4 = NULL;
-  uint32_t chrom_fo_idx = 0;
   double* dptr2;
-  double set_allele_freq_buf[MULTIPLEX_DIST];
+  double set_allele_freq_bufs[2][MULTIPLEX_REL];
+  double* set_allele_freq_buf;
   char wbuf[96];
   char* wptr;
   char* fam_id;
   char* indiv_id;
   uint32_t cur_markers_loaded;
+  uint32_t buf_idx;
   uint32_t win_marker_idx;
   uintptr_t indiv_uidx;
   uintptr_t indiv_idx;
@@ -6706,6 +10201,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
   uint32_t rel_shape;
   uint32_t min_indiv;
   uint32_t max_parallel_indiv;
+  uint32_t use_gemm = 0;
   unsigned char* wkspace_mark;
   unsigned char* gptr;
   unsigned char* gptr2;
@@ -6728,12 +10224,10 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
       if (wkspace_alloc_ui_checked(&g_missing_dbl_excluded, llxx * sizeof(int32_t))) {
 	goto calc_rel_ret_NOMEM;
       }
-      fill_int_zero((int32_t*)g_missing_dbl_excluded, llxx);
     }
     if (wkspace_alloc_d_checked(&g_rel_dists, llxx * sizeof(double))) {
       goto calc_rel_ret_NOMEM;
     }
-    fill_double_zero(g_rel_dists, llxx);
   }
   if (calculation_type & CALC_IBC) {
     uii = g_indiv_ct * 3;
@@ -6750,9 +10244,17 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     if (wkspace_alloc_ui_checked(&g_missing_dbl_excluded, llxx * sizeof(int32_t))) {
       goto calc_rel_ret_NOMEM;
     }
-    fill_int_zero((int32_t*)g_missing_dbl_excluded, llxx);
   }
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (relationship_req(calculation_type)) {
+    if (spawn_threads(threads, &calc_rel_zero_thread, g_thread_ct)) {
+      goto calc_rel_ret_THREAD_CREATE_FAIL;
+    }
+    ulii = 0;
+    calc_rel_zero_thread((void*)ulii);
+    join_threads(threads, g_thread_ct);
+  }
+  bed_mmap_advise(BED_ADVISE_SEQUENTIAL);
+  if (bed_seek(bedfile, bed_offset)) {
     goto calc_rel_ret_READ_FAIL;
   }
   if (wkspace_alloc_uc_checked(&g_geno, g_indiv_ct * sizeof(intptr_t)) ||
@@ -6774,17 +10276,53 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     logprintb();
     marker_ct -= uii;
   }
+  if (relationship_req(calculation_type) && (rel_calc_type & REL_CALC_ENGINE_GEMM)) {
+    if (rel_gemm_init(0)) {
+      goto calc_rel_ret_NOMEM;
+    }
+    use_gemm = 1;
+    logprint("Using blocked matrix-multiply relationship engine.\n");
+  }
 
+  block_load_init(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_REL, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, NULL, 0);
+  block_load_set_buf(0, gptr, set_allele_freq_bufs[0], NULL, NULL, NULL);
+  if (!wkspace_alloc_uc_checked(&gptr, MULTIPLEX_REL * unfiltered_indiv_ct4)) {
+    block_load_set_buf(1, gptr, set_allele_freq_bufs[1], NULL, NULL, NULL);
+  }
+  // rel_calc_type only matters through the engine choice; output shape and
+  // compression can differ between the interrupted and resumed runs
+  ckpt_begin(outname, outname_end, ".rel", CKPT_CALC_REL, ckpt_setup_hash(marker_exclude, marker_ct, set_allele_freqs, indiv_exclude, ((uint64_t)((uint32_t)ibc_type)) | (((uint64_t)use_gemm) << 32) | (((uint64_t)relationship_req(calculation_type)) << 33) | (((uint64_t)((calculation_type & CALC_IBC)? 1 : 0)) << 34)), parallel_idx, parallel_tot);
+  if (relationship_req(calculation_type)) {
+    ckpt_reg(g_rel_dists, llxx * sizeof(double));
+    ckpt_reg(g_missing_dbl_excluded, llxx * sizeof(int32_t));
+  }
+  ckpt_reg(g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t));
+  ckpt_reg(rel_ibc, ((calculation_type & CALC_IBC)? 3 : 1) * g_indiv_ct * sizeof(double));
+  retval = ckpt_resume(&marker_idx);
+  if (retval) {
+    goto calc_rel_ret_1;
+  }
+  if (block_load_start()) {
+    goto calc_rel_ret_THREAD_CREATE_FAIL;
+  }
   // See comments at the beginning of this file, and those in the main
   // CALC_DISTANCE loop.  The main difference between this calculation and
   // the (nonzero exponent) distance calculation is that we have to pad
   // each marker to 3 bits and use + instead of XOR to distinguish the
   // cases.
   do {
-    retval = block_load_autosomal(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_REL, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, NULL, gptr, &chrom_fo_idx, &marker_uidx, &marker_idx, &cur_markers_loaded, set_allele_freq_buf, NULL, NULL);
+    retval = block_load_finish(&buf_idx, &cur_markers_loaded);
     if (retval) {
       goto calc_rel_ret_1;
     }
+    gptr = g_bl_bufs[buf_idx];
+    set_allele_freq_buf = set_allele_freq_bufs[buf_idx];
+    marker_idx += cur_markers_loaded;
+    if (marker_idx < marker_ct) {
+      if (block_load_start()) {
+	goto calc_rel_ret_THREAD_CREATE_FAIL;
+      }
+    }
     if (cur_markers_loaded < MULTIPLEX_REL) {
       memset(&(gptr[cur_markers_loaded * unfiltered_indiv_ct4]), 0, (MULTIPLEX_REL - cur_markers_loaded) * unfiltered_indiv_ct4);
       fill_double_zero(&(set_allele_freq_buf[cur_markers_loaded]), MULTIPLEX_REL - cur_markers_loaded);
@@ -6825,7 +10363,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
       } else {
 	update_rel_ibc(rel_ibc, (uintptr_t*)g_geno, &(set_allele_freq_buf[win_marker_idx]), ibc_type, g_indiv_ct);
       }
-      if (relationship_req(calculation_type)) {
+      if (relationship_req(calculation_type) && (!use_gemm)) {
 	fill_weights_r(g_weights, &(set_allele_freq_buf[win_marker_idx]), (ibc_type != -1)? 1 : 0);
 	if (spawn_threads(threads, &calc_rel_thread, g_thread_ct)) {
 	  goto calc_rel_ret_THREAD_CREATE_FAIL;
@@ -6834,6 +10372,16 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
 	join_threads(threads, g_thread_ct);
       }
     }
+    if (use_gemm) {
+      for (uii = 0; uii < cur_markers_loaded; uii++) {
+	rel_gemm_load_marker(&(gptr[uii * unfiltered_indiv_ct4]), indiv_exclude, set_allele_freq_buf[uii], (ibc_type != -1)? 1 : 0);
+      }
+      if ((g_rel_gemm_marker_ct > REL_GEMM_BLOCK - MULTIPLEX_REL) || (marker_idx == marker_ct)) {
+	if (rel_gemm_flush(threads)) {
+	  goto calc_rel_ret_THREAD_CREATE_FAIL;
+	}
+      }
+    }
     if (relationship_req(calculation_type)) {
       if (spawn_threads(threads, &calc_missing_thread, g_thread_ct)) {
 	goto calc_rel_ret_THREAD_CREATE_FAIL;
@@ -6843,6 +10391,11 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     }
     printf("\r%" PRIuPTR " markers complete.", marker_idx);
     fflush(stdout);
+    if (!g_rel_gemm_marker_ct) {
+      // markers buffered for the matrix-multiply engine aren't in g_rel_dists
+      // yet
+      ckpt_save_cond();
+    }
   } while (marker_idx < marker_ct);
   if (relationship_req(calculation_type)) {
     putchar('\r');
@@ -6942,7 +10495,12 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     g_pct = 1;
     g_cr_start_offset = ((uint64_t)min_indiv * (min_indiv - 1)) / 2;
     g_cr_hundredth = 1 + (((((uint64_t)max_parallel_indiv * (max_parallel_indiv + 1)) / 2) - g_cr_start_offset) / 100);
-    if (rel_calc_type & REL_CALC_BIN) {
+    if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+      retval = rel_sparse_write(threads, outname, outname_end, g_rel_dists, NULL, dptr2, NULL, min_indiv, max_parallel_indiv, rel_sparse_cutoff, parallel_idx);
+      if (retval) {
+	goto calc_rel_ret_1;
+      }
+    } else if (rel_calc_type & REL_CALC_BIN) {
       if (rel_shape == REL_CALC_SQ0) {
 	fill_double_zero((double*)g_geno, g_indiv_ct - 1);
       }
@@ -7085,6 +10643,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
       }
     }
   }
+  ckpt_finish();
   wkspace_reset(wkspace_mark);
   while (0) {
   calc_rel_ret_NOMEM:
@@ -7105,6 +10664,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     break;
   }
  calc_rel_ret_1:
+  block_load_cleanup();
   fclose_cond(outfile);
   gzclose_cond(gz_outfile);
   return retval;
@@ -7240,14 +10800,13 @@ uint32_t calc_rel_f_grm_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
 }
 
-int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, uint64_t calculation_type, uint32_t rel_calc_type, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uint32_t marker_ct, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* person_ids, uintptr_t max_person_id_len, int32_t ibc_type, float rel_cutoff, double* set_allele_freqs, Chrom_info* chrom_info_ptr) {
+int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, uint64_t calculation_type, uint32_t rel_calc_type, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uint32_t marker_ct, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t* indiv_exclude_ct_ptr, char* person_ids, uintptr_t max_person_id_len, int32_t ibc_type, float rel_cutoff, double rel_sparse_cutoff, double* set_allele_freqs, Chrom_info* chrom_info_ptr) {
   // N.B. ACTA may currently outperform this when compiled with ICC and run on
   // a heavily multicore 64-bit Linux system.  If ACTA ever gets to the point
   // where it wins when compiled with gcc, on both 32- and 64-bit systems with
   // as few as a single core, and on OS X/Windows as well as Linux, then it's
   // time to replace this with the ACTA implementation.
   uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
-  uintptr_t marker_uidx = 0;
   uintptr_t marker_idx = 0;
   FILE* outfile = NULL;
   FILE* out_bin_nfile = NULL;
@@ -7257,12 +10816,13 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
   float* dist_ptr = NULL;
   float* dptr3 = NULL;
   float* dptr4 = NULL;
-  uint32_t chrom_fo_idx = 0;
   float* dptr2;
-  float set_allele_freq_buf[MULTIPLEX_DIST];
+  float set_allele_freq_bufs[2][MULTIPLEX_REL];
+  float* set_allele_freq_buf;
   char wbuf[96];
   char* wptr;
   uint32_t cur_markers_loaded;
+  uint32_t buf_idx;
   uint32_t win_marker_idx;
   uintptr_t indiv_uidx;
   uintptr_t indiv_idx;
@@ -7279,6 +10839,7 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
   uint32_t rel_shape;
   uint32_t min_indiv;
   uint32_t max_parallel_indiv;
+  uint32_t use_gemm = 0;
   unsigned char* wkspace_mark;
   unsigned char* gptr;
   unsigned char* gptr2;
@@ -7318,7 +10879,8 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     }
     fill_int_zero((int32_t*)g_missing_dbl_excluded, ullxx);
   }
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  bed_mmap_advise(BED_ADVISE_SEQUENTIAL);
+  if (bed_seek(bedfile, bed_offset)) {
     goto calc_rel_f_ret_READ_FAIL;
   }
   if (wkspace_alloc_uc_checked(&g_geno, g_indiv_ct * sizeof(intptr_t)) ||
@@ -7339,12 +10901,46 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     logprintb();
     marker_ct -= uii;
   }
+  if (relationship_req(calculation_type) && (rel_calc_type & REL_CALC_ENGINE_GEMM)) {
+    if (rel_gemm_init(1)) {
+      goto calc_rel_f_ret_NOMEM;
+    }
+    use_gemm = 1;
+    logprint("Using blocked matrix-multiply relationship engine.\n");
+  }
 
+  block_load_init(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_REL, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, NULL, 0);
+  block_load_set_buf(0, gptr, NULL, set_allele_freq_bufs[0], NULL, NULL);
+  if (!wkspace_alloc_uc_checked(&gptr, MULTIPLEX_REL * unfiltered_indiv_ct4)) {
+    block_load_set_buf(1, gptr, NULL, set_allele_freq_bufs[1], NULL, NULL);
+  }
+  ckpt_begin(outname, outname_end, ".rel", CKPT_CALC_REL_F, ckpt_setup_hash(marker_exclude, marker_ct, set_allele_freqs, indiv_exclude, ((uint64_t)((uint32_t)ibc_type)) | (((uint64_t)use_gemm) << 32) | (((uint64_t)relationship_req(calculation_type)) << 33) | (((uint64_t)((calculation_type & CALC_IBC)? 1 : 0)) << 34)), parallel_idx, parallel_tot);
+  if (relationship_req(calculation_type)) {
+    ckpt_reg(g_rel_f_dists, ullxx * sizeof(float));
+    ckpt_reg(g_missing_dbl_excluded, ullxx * sizeof(int32_t));
+  }
+  ckpt_reg(g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t));
+  ckpt_reg(rel_ibc, ((calculation_type & CALC_IBC)? 3 : 1) * g_indiv_ct * sizeof(float));
+  retval = ckpt_resume(&marker_idx);
+  if (retval) {
+    goto calc_rel_f_ret_1;
+  }
+  if (block_load_start()) {
+    goto calc_rel_f_ret_THREAD_CREATE_FAIL;
+  }
   do {
-    retval = block_load_autosomal(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_REL, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, NULL, gptr, &chrom_fo_idx, &marker_uidx, &marker_idx, &cur_markers_loaded, NULL, set_allele_freq_buf, NULL);
+    retval = block_load_finish(&buf_idx, &cur_markers_loaded);
     if (retval) {
       goto calc_rel_f_ret_1;
     }
+    gptr = g_bl_bufs[buf_idx];
+    set_allele_freq_buf = set_allele_freq_bufs[buf_idx];
+    marker_idx += cur_markers_loaded;
+    if (marker_idx < marker_ct) {
+      if (block_load_start()) {
+	goto calc_rel_f_ret_THREAD_CREATE_FAIL;
+      }
+    }
     if (cur_markers_loaded < MULTIPLEX_REL) {
       memset(&(gptr[cur_markers_loaded * unfiltered_indiv_ct4]), 0, (MULTIPLEX_REL - cur_markers_loaded) * unfiltered_indiv_ct4);
       fill_float_zero(&(set_allele_freq_buf[cur_markers_loaded]), MULTIPLEX_REL - cur_markers_loaded);
@@ -7386,7 +10982,7 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
       } else {
 	update_rel_f_ibc(rel_ibc, (uintptr_t*)g_geno, &(set_allele_freq_buf[win_marker_idx]), ibc_type, g_indiv_ct);
       }
-      if (relationship_req(calculation_type)) {
+      if (relationship_req(calculation_type) && (!use_gemm)) {
 	fill_weights_r_f(g_weights_f, &(set_allele_freq_buf[win_marker_idx]), (ibc_type != -1)? 1 : 0);
 	if (spawn_threads(threads, &calc_rel_f_thread, g_thread_ct)) {
 	  goto calc_rel_f_ret_THREAD_CREATE_FAIL;
@@ -7395,6 +10991,16 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
 	join_threads(threads, g_thread_ct);
       }
     }
+    if (use_gemm) {
+      for (uii = 0; uii < cur_markers_loaded; uii++) {
+	rel_gemm_load_marker(&(gptr[uii * unfiltered_indiv_ct4]), indiv_exclude, (double)set_allele_freq_buf[uii], (ibc_type != -1)? 1 : 0);
+      }
+      if ((g_rel_gemm_marker_ct > REL_GEMM_BLOCK - MULTIPLEX_REL) || (marker_idx == marker_ct)) {
+	if (rel_gemm_flush(threads)) {
+	  goto calc_rel_f_ret_THREAD_CREATE_FAIL;
+	}
+      }
+    }
     if (relationship_req(calculation_type)) {
       if (spawn_threads(threads, &calc_missing_thread, g_thread_ct)) {
 	goto calc_rel_f_ret_THREAD_CREATE_FAIL;
@@ -7404,6 +11010,9 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     }
     printf("\r%" PRIuPTR " markers complete.", marker_idx);
     fflush(stdout);
+    if (!g_rel_gemm_marker_ct) {
+      ckpt_save_cond();
+    }
   } while (marker_idx < marker_ct);
   if (relationship_req(calculation_type)) {
     putchar('\r');
@@ -7496,7 +11105,12 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     g_cr_start_offset = ((uint64_t)min_indiv * (min_indiv - 1)) / 2;
     g_cr_hundredth = 1 + (((((uint64_t)max_parallel_indiv * (max_parallel_indiv + 1)) / 2) - g_cr_start_offset) / 100);
 
-    if (rel_calc_type & REL_CALC_BIN) {
+    if (rel_calc_type & REL_CALC_GRM_SPARSE) {
+      retval = rel_sparse_write(threads, outname, outname_end, NULL, g_rel_f_dists, NULL, dptr2, min_indiv, max_parallel_indiv, rel_sparse_cutoff, parallel_idx);
+      if (retval) {
+	goto calc_rel_f_ret_1;
+      }
+    } else if (rel_calc_type & REL_CALC_BIN) {
       if (rel_shape == REL_CALC_SQ0) {
 	fill_float_zero((float*)g_geno, g_indiv_ct - 1);
       }
@@ -7545,16 +11159,16 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     } else if (rel_calc_type & REL_CALC_GRM_BIN) {
       memcpy(outname_end, ".grm.N.bin", 11);
       if (parallel_tot > 1) {
-	outname[10] = '.';
-	uint32_writex(&(outname[11]), parallel_idx + 1, '\0');
+	outname_end[10] = '.';
+	uint32_writex(&(outname_end[11]), parallel_idx + 1, '\0');
       }
       if (fopen_checked(&out_bin_nfile, outname, "wb")) {
 	goto calc_rel_f_ret_OPEN_FAIL;
       }
       memcpy(outname_end, ".grm.bin", 9);
       if (parallel_tot > 1) {
-	outname[8] = '.';
-	uint32_writex(&(outname[9]), parallel_idx + 1, '\0');
+	outname_end[8] = '.';
+	uint32_writex(&(outname_end[9]), parallel_idx + 1, '\0');
       }
       if (fopen_checked(&outfile, outname, "wb")) {
 	goto calc_rel_f_ret_OPEN_FAIL;
@@ -7673,6 +11287,7 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
       }
     }
   }
+  ckpt_finish();
   wkspace_reset(wkspace_mark);
   while (0) {
   calc_rel_f_ret_NOMEM:
@@ -7693,6 +11308,7 @@ int32_t calc_rel_f(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_
     break;
   }
  calc_rel_f_ret_1:
+  block_load_cleanup();
   fclose_cond(outfile);
   fclose_cond(out_bin_nfile);
   gzclose_cond(gz_outfile);
@@ -7734,7 +11350,7 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
       wkspace_alloc_uc_checked(&bedbuf, MULTIPLEX_DIST * unfiltered_indiv_ct4)) {
     goto calc_ibm_ret_NOMEM;
   }
-  fseeko(bedfile, bed_offset, SEEK_SET);
+  bed_seek(bedfile, bed_offset);
   uii = count_non_autosomal_markers(chrom_info_ptr, marker_exclude, 1);
   marker_ct_autosomal = marker_ct - uii;
   if (uii) {
@@ -7802,7 +11418,208 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
   return retval;
 }
 
-int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uint64_t calculation_type, uint32_t dist_calc_type, uintptr_t* marker_exclude, uint32_t marker_ct, double* set_allele_freqs, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len, Chrom_info* chrom_info_ptr, uint32_t wt_needed, uint32_t marker_weight_sum, uint32_t* marker_weights_i, double exponent) {
+int32_t dist_stats_open(FILE** outfile_ptr, char* prefix, uint32_t is_update, uintptr_t* marker_exclude, uint32_t marker_ct, char* marker_ids, uintptr_t max_marker_id_len, Chrom_info* chrom_info_ptr, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len, uint32_t* row_start_ptr) {
+  // Creates {prefix}.dstat.bin/.dstat.markers, or (is_update) checks that the
+  // saved ones were computed on the same autosomal markers and on a leading
+  // subset of the current individuals.  On success, *outfile_ptr is positioned
+  // for appending rows, and *row_start_ptr is the first row to compute.
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  char* prefix_end = &(prefix[strlen(prefix)]);
+  uint32_t marker_ct_autosomal = marker_ct - count_non_autosomal_markers(chrom_info_ptr, marker_exclude, 1);
+  uintptr_t marker_uidx = 0;
+  uintptr_t indiv_uidx = 0;
+  uint32_t chrom_fo_idx = 0xffffffffU;
+  uint32_t chrom_end = 0;
+  uint32_t line_idx = 0;
+  int32_t retval = 0;
+  Dist_stats_header hdr;
+  uint64_t expected_size;
+  uint32_t marker_idx;
+  char* bufptr;
+  if (!is_update) {
+    memcpy(prefix_end, ".dstat.markers", 15);
+    if (fopen_checked(&outfile, prefix, "w")) {
+      goto dist_stats_open_ret_OPEN_FAIL;
+    }
+    for (marker_idx = 0; marker_idx < marker_ct_autosomal; marker_uidx++, marker_idx++) {
+      marker_uidx = next_autosomal_unsafe(marker_exclude, marker_uidx, chrom_info_ptr, &chrom_end, &chrom_fo_idx);
+      fputs(&(marker_ids[marker_uidx * max_marker_id_len]), outfile);
+      if (putc_checked('\n', outfile)) {
+	goto dist_stats_open_ret_WRITE_FAIL;
+      }
+    }
+    if (fclose_null(&outfile)) {
+      goto dist_stats_open_ret_WRITE_FAIL;
+    }
+    memcpy(prefix_end, ".dstat.bin", 11);
+    if (fopen_checked(outfile_ptr, prefix, "wb")) {
+      goto dist_stats_open_ret_OPEN_FAIL;
+    }
+    hdr.version = 1;
+    hdr.marker_ct = marker_ct_autosomal;
+    hdr.indiv_ct = 0; // patched by dist_stats_close()
+    hdr.reserved = 0;
+    if (fwrite_checked(DIST_STATS_MAGIC, 8, *outfile_ptr) ||
+	fwrite_checked(&hdr, sizeof(Dist_stats_header), *outfile_ptr)) {
+      goto dist_stats_open_ret_WRITE_FAIL;
+    }
+    *row_start_ptr = 0;
+    goto dist_stats_open_ret_1;
+  }
+  memcpy(prefix_end, ".dstat.bin", 11);
+  if (fopen_checked(outfile_ptr, prefix, "r+b")) {
+    goto dist_stats_open_ret_OPEN_FAIL;
+  }
+  if ((fread(tbuf, 1, 8, *outfile_ptr) < 8) || memcmp(tbuf, DIST_STATS_MAGIC, 8) || (fread(&hdr, sizeof(Dist_stats_header), 1, *outfile_ptr) < 1) || (hdr.version != 1)) {
+    sprintf(logbuf, "Error: %s is not a --dist-stats file.\n", prefix);
+    goto dist_stats_open_ret_INVALID_FORMAT_2;
+  }
+  expected_size = 8 + sizeof(Dist_stats_header) + ((((uint64_t)hdr.indiv_ct) * (hdr.indiv_ct - 1)) / 2) * sizeof(Dist_stats_rec);
+  if ((hdr.indiv_ct < 2) || fseeko(*outfile_ptr, 0, SEEK_END) || (((uint64_t)ftello(*outfile_ptr)) != expected_size)) {
+    sprintf(logbuf, "Error: %s is truncated, or was left behind by an interrupted\n--dist-stats-update run.\n", prefix);
+    goto dist_stats_open_ret_INVALID_FORMAT_2;
+  }
+  if (hdr.marker_ct != marker_ct_autosomal) {
+    sprintf(logbuf, "Error: %s was computed on %u autosomal marker%s, but %u remain\nafter filtering.\n", prefix, hdr.marker_ct, (hdr.marker_ct == 1)? "" : "s", marker_ct_autosomal);
+    goto dist_stats_open_ret_INVALID_FORMAT_2;
+  }
+  if (hdr.indiv_ct >= g_indiv_ct) {
+    sprintf(logbuf, "Error: --dist-stats-update needs new individuals, but %s already\ncovers %u and only %" PRIuPTR " are loaded.\n", prefix, hdr.indiv_ct, g_indiv_ct);
+    goto dist_stats_open_ret_INVALID_FORMAT_2;
+  }
+  memcpy(prefix_end, ".dstat.markers", 15);
+  if (fopen_checked(&infile, prefix, "r")) {
+    goto dist_stats_open_ret_OPEN_FAIL;
+  }
+  tbuf[MAXLINELEN - 1] = ' ';
+  for (marker_idx = 0; marker_idx < marker_ct_autosomal; marker_uidx++, marker_idx++) {
+    marker_uidx = next_autosomal_unsafe(marker_exclude, marker_uidx, chrom_info_ptr, &chrom_end, &chrom_fo_idx);
+    if (!fgets(tbuf, MAXLINELEN, infile)) {
+      goto dist_stats_open_ret_MARKER_MISMATCH;
+    }
+    if (!tbuf[MAXLINELEN - 1]) {
+      goto dist_stats_open_ret_MARKER_MISMATCH;
+    }
+    bufptr = &(tbuf[strlen(tbuf)]);
+    while ((bufptr > tbuf) && ((bufptr[-1] == '\n') || (bufptr[-1] == '\r'))) {
+      *(--bufptr) = '\0';
+    }
+    if (strcmp(tbuf, &(marker_ids[marker_uidx * max_marker_id_len]))) {
+      goto dist_stats_open_ret_MARKER_MISMATCH;
+    }
+  }
+  if (fgets(tbuf, MAXLINELEN, infile)) {
+    goto dist_stats_open_ret_MARKER_MISMATCH;
+  }
+  if (fclose_null(&infile)) {
+    goto dist_stats_open_ret_READ_FAIL;
+  }
+  memcpy(prefix_end, ".dstat.id", 10);
+  if (fopen_checked(&infile, prefix, "r")) {
+    goto dist_stats_open_ret_OPEN_FAIL;
+  }
+  for (; line_idx < hdr.indiv_ct; indiv_uidx++, line_idx++) {
+    next_unset_ul_unsafe_ck(indiv_exclude, &indiv_uidx);
+    if ((!fgets(tbuf, MAXLINELEN, infile)) || (!tbuf[MAXLINELEN - 1])) {
+      goto dist_stats_open_ret_ID_MISMATCH;
+    }
+    bufptr = &(tbuf[strlen(tbuf)]);
+    while ((bufptr > tbuf) && ((bufptr[-1] == '\n') || (bufptr[-1] == '\r'))) {
+      *(--bufptr) = '\0';
+    }
+    if (strcmp(tbuf, &(person_ids[indiv_uidx * max_person_id_len]))) {
+      goto dist_stats_open_ret_ID_MISMATCH;
+    }
+  }
+  if (fgets(tbuf, MAXLINELEN, infile)) {
+    goto dist_stats_open_ret_ID_MISMATCH;
+  }
+  *row_start_ptr = hdr.indiv_ct;
+  while (0) {
+  dist_stats_open_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  dist_stats_open_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  dist_stats_open_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  dist_stats_open_ret_MARKER_MISMATCH:
+    sprintf(logbuf, "Error: Marker %u of %s does not match the current marker list.\n", marker_idx + 1, prefix);
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  dist_stats_open_ret_ID_MISMATCH:
+    sprintf(logbuf, "Error: %s does not match the first %u individuals of the current\ndataset (line %u differs).  New individuals must be added after the saved ones.\n", prefix, hdr.indiv_ct, line_idx + 1);
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  dist_stats_open_ret_INVALID_FORMAT_2:
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+ dist_stats_open_ret_1:
+  *prefix_end = '\0';
+  fclose_cond(infile);
+  fclose_cond(outfile);
+  if (retval) {
+    fclose_cond(*outfile_ptr);
+    *outfile_ptr = NULL;
+  }
+  return retval;
+}
+
+int32_t dist_stats_close(FILE** outfile_ptr, char* prefix, uint32_t row_start, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len) {
+  // Records the new individual count in the header, then appends the new
+  // individuals' IDs to {prefix}.dstat.id.
+  FILE* outfile = NULL;
+  char* prefix_end = &(prefix[strlen(prefix)]);
+  uint32_t indiv_ct = g_indiv_ct;
+  uintptr_t indiv_uidx = 0;
+  uint32_t indiv_idx = 0;
+  int32_t retval = 0;
+  // indiv_ct is the third header field
+  if (fseeko(*outfile_ptr, 8 + 2 * sizeof(int32_t), SEEK_SET) ||
+      fwrite_checked(&indiv_ct, sizeof(int32_t), *outfile_ptr) ||
+      fclose_null(outfile_ptr)) {
+    goto dist_stats_close_ret_WRITE_FAIL;
+  }
+  memcpy(prefix_end, ".dstat.id", 10);
+  if (fopen_checked(&outfile, prefix, row_start? "a" : "w")) {
+    goto dist_stats_close_ret_OPEN_FAIL;
+  }
+  for (; indiv_idx < indiv_ct; indiv_uidx++, indiv_idx++) {
+    next_unset_ul_unsafe_ck(indiv_exclude, &indiv_uidx);
+    if (indiv_idx >= row_start) {
+      fputs(&(person_ids[indiv_uidx * max_person_id_len]), outfile);
+      if (putc_checked('\n', outfile)) {
+	goto dist_stats_close_ret_WRITE_FAIL;
+      }
+    }
+  }
+  if (fclose_null(&outfile)) {
+    goto dist_stats_close_ret_WRITE_FAIL;
+  }
+  memcpy(prefix_end, ".dstat.bin", 11);
+  sprintf(logbuf, "Pairwise distance statistics for %u individuals (%u new) written to\n%s.\n", indiv_ct, indiv_ct - row_start, prefix);
+  logprintb();
+  while (0) {
+  dist_stats_close_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  dist_stats_close_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  }
+  *prefix_end = '\0';
+  fclose_cond(outfile);
+  return retval;
+}
+
+int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_tot, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uint64_t calculation_type, uint32_t dist_calc_type, uintptr_t* marker_exclude, uint32_t marker_ct, double* set_allele_freqs, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len, Chrom_info* chrom_info_ptr, uint32_t wt_needed, uint32_t marker_weight_sum, uint32_t* marker_weights_i, double exponent, uint32_t row_start, FILE* dstat_outfile) {
   FILE* outfile = NULL;
   FILE* outfile2 = NULL;
   FILE* outfile3 = NULL;
@@ -7817,8 +11634,10 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   uint32_t exp0 = (exponent == 0.0);
   uint32_t* giptr = NULL;
   uint32_t* giptr2 = NULL;
-  double set_allele_freq_buf[MULTIPLEX_DIST];
-  uint32_t wtbuf[MULTIPLEX_DIST];
+  double set_allele_freq_bufs[2][MULTIPLEX_DIST];
+  uint32_t wtbufs[2][MULTIPLEX_DIST];
+  double* set_allele_freq_buf;
+  uint32_t* wtbuf;
   char wbuf[16];
   char* wptr;
   unsigned char* wkspace_mark;
@@ -7845,9 +11664,17 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   double dxx;
   uint32_t marker_ct_autosomal;
   uint32_t multiplex;
+  uint32_t buf_idx;
   uint32_t chrom_end;
   int64_t llxx;
-  triangle_fill(g_thread_start, g_indiv_ct, g_thread_ct, parallel_idx, parallel_tot, 1, 1);
+  uint64_t ckpt_hash_val;
+  Dist_stats_rec* dstat_recs;
+  if (row_start) {
+    // --dist-stats-update: only the new individuals' rows
+    triangle_fill_range(g_thread_start, g_indiv_ct, g_thread_ct, row_start, g_indiv_ct, 1, 1);
+  } else {
+    triangle_fill(g_thread_start, g_indiv_ct, g_thread_ct, parallel_idx, parallel_tot, 1, 1);
+  }
   llxx = g_thread_start[g_thread_ct];
   llxx = ((llxx * (llxx - 1)) - (int64_t)g_thread_start[0] * (g_thread_start[0] - 1)) / 2;
   dists_alloc = llxx * sizeof(double);
@@ -7856,7 +11683,7 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     goto calc_distance_ret_NOMEM;
   }
 #endif
-  if ((calculation_type & (CALC_PLINK_DISTANCE_MATRIX | CALC_PLINK_IBS_MATRIX)) || (dist_calc_type & DISTANCE_FLAT_MISSING)) {
+  if ((calculation_type & (CALC_PLINK_DISTANCE_MATRIX | CALC_PLINK_IBS_MATRIX)) || (dist_calc_type & DISTANCE_FLAT_MISSING) || dstat_outfile) {
     if (wkspace_alloc_ui_checked(&g_missing_dbl_excluded, llxx * sizeof(int32_t)) ||
         wkspace_alloc_ui_checked(&g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t))) {
       goto calc_distance_ret_NOMEM;
@@ -7909,18 +11736,66 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   if (wkspace_alloc_uc_checked(&bedbuf, multiplex * unfiltered_indiv_ct4)) {
     goto calc_distance_ret_NOMEM;
   }
-  fseeko(bedfile, bed_offset, SEEK_SET);
+  bed_mmap_advise(BED_ADVISE_SEQUENTIAL);
+  bed_seek(bedfile, bed_offset);
   uii = count_non_autosomal_markers(chrom_info_ptr, marker_exclude, 1);
   marker_ct_autosomal = marker_ct - uii;
   if (uii) {
     sprintf(logbuf, "Excluding %u marker%s on non-autosomes from distance matrix calc.\n", uii, (uii == 1)? "" : "s");
     logprintb();
   }
+  fill_int_zero((int32_t*)wtbufs, 2 * MULTIPLEX_DIST);
+  block_load_init(bedfile, bed_offset, marker_exclude, marker_ct_autosomal, multiplex, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, marker_weights_i, 0);
+  block_load_set_buf(0, bedbuf, set_allele_freq_bufs[0], NULL, wt_needed? wtbufs[0] : NULL, NULL);
+  if (!wkspace_alloc_uc_checked(&bedbuf, multiplex * unfiltered_indiv_ct4)) {
+    block_load_set_buf(1, bedbuf, set_allele_freq_bufs[1], NULL, wt_needed? wtbufs[1] : NULL, NULL);
+  }
+  ckpt_hash_val = ckpt_setup_hash(marker_exclude, marker_ct, set_allele_freqs, indiv_exclude, ((uint64_t)dist_calc_type) | (((uint64_t)wt_needed) << 32) | (((uint64_t)unwt_needed) << 33));
+  ckpt_hash_val = ckpt_hash(ckpt_hash_val, &exponent, sizeof(double));
+  if (wt_needed) {
+    ckpt_hash_val = ckpt_hash(ckpt_hash_val, marker_weights_i, marker_ct * sizeof(int32_t));
+  }
+  ckpt_begin(outname, outname_end, ".dist", CKPT_CALC_DISTANCE, ckpt_hash_val, parallel_idx, parallel_tot);
+  if (exp0) {
+    ckpt_reg(g_idists, llxx * sizeof(int32_t));
+  } else {
+    ckpt_reg(g_dists, llxx * sizeof(double));
+  }
+  if (unwt_needed) {
+    ckpt_reg(g_missing_dbl_excluded, llxx * sizeof(int32_t));
+    ckpt_reg(g_indiv_missing_unwt, g_indiv_ct * sizeof(int32_t));
+  }
+  if (wt_needed) {
+    ckpt_reg(g_missing_tot_weights, llxx * sizeof(int32_t));
+    ckpt_reg(g_indiv_missing, g_indiv_ct * sizeof(int32_t));
+  }
+  retval = ckpt_resume(&marker_idx);
+  if (retval) {
+    goto calc_distance_ret_1;
+  }
+  if (marker_idx < marker_ct_autosomal) {
+    if (block_load_start()) {
+      goto calc_distance_ret_THREAD_CREATE_FAIL;
+    }
+  }
   while (marker_idx < marker_ct_autosomal) {
-    for (ujj = 0; ujj < multiplex; ujj++) {
-      set_allele_freq_buf[ujj] = 0.5;
+    retval = block_load_finish(&buf_idx, &ujj);
+    if (retval) {
+      goto calc_distance_ret_1;
+    }
+    bedbuf = g_bl_bufs[buf_idx];
+    set_allele_freq_buf = set_allele_freq_bufs[buf_idx];
+    wtbuf = wtbufs[buf_idx];
+    marker_idx += ujj;
+    if (marker_idx < marker_ct_autosomal) {
+      if (block_load_start()) {
+	goto calc_distance_ret_THREAD_CREATE_FAIL;
+      }
+    }
+    for (ukk = ujj; ukk < multiplex; ukk++) {
+      set_allele_freq_buf[ukk] = 0.5;
+      wtbuf[ukk] = 0;
     }
-    fill_int_zero((int32_t*)wtbuf, multiplex);
 
     // For each pair (g_j, g_k) of 2-bit PLINK genotypes, we perform the
     // following operations:
@@ -7965,10 +11840,6 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     // See the comments at the beginning of this file for discussion of
     // the zero exponent special case.
 
-    retval = block_load_autosomal(bedfile, bed_offset, marker_exclude, marker_ct_autosomal, multiplex, unfiltered_indiv_ct4, chrom_info_ptr, set_allele_freqs, marker_weights_i, bedbuf, &chrom_fo_idx, &marker_uidx, &marker_idx, &ujj, set_allele_freq_buf, NULL, wt_needed? wtbuf : NULL);
-    if (retval) {
-      goto calc_distance_ret_1;
-    }
     if (ujj < multiplex) {
       memset(&(bedbuf[ujj * unfiltered_indiv_ct4]), 0, (multiplex - ujj) * unfiltered_indiv_ct4);
       if (exp0) {
@@ -8122,9 +11993,29 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     }
     printf("\r%" PRIuPTR " markers complete.", marker_idx);
     fflush(stdout);
+    ckpt_save_cond();
   }
   putchar('\r');
   logprint("Distance matrix calculation complete.\n");
+  if (dstat_outfile) {
+    // must happen before the missingness adjustments below overwrite g_idists
+    // (exp0 is guaranteed here)
+    dstat_recs = (Dist_stats_rec*)g_geno;
+    iptr = g_idists;
+    giptr = g_missing_dbl_excluded;
+    tstc = g_thread_start[g_thread_ct];
+    for (indiv_idx = g_thread_start[0]; indiv_idx < tstc; indiv_idx++) {
+      giptr2 = g_indiv_missing_unwt;
+      uii = marker_ct_autosomal - giptr2[indiv_idx];
+      for (ujj = 0; ujj < indiv_idx; ujj++) {
+	dstat_recs[ujj].dist = *iptr++;
+	dstat_recs[ujj].nonmissing = uii - (*giptr2++) + (*giptr++);
+      }
+      if (fwrite_checked(dstat_recs, indiv_idx * sizeof(Dist_stats_rec), dstat_outfile)) {
+	goto calc_distance_ret_WRITE_FAIL;
+      }
+    }
+  }
   if (calculation_type & CALC_PLINK_DISTANCE_MATRIX) {
     strcpy(outname_end, ".mdist");
     if (fopen_checked(&outfile, outname, "w")) {
@@ -8306,6 +12197,7 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
       }
     }
   }
+  ckpt_finish();
   wkspace_reset(wkspace_mark);
 
   while (0) {
@@ -8324,6 +12216,7 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     break;
   }
  calc_distance_ret_1:
+  block_load_cleanup();
   fclose_cond(outfile);
   fclose_cond(outfile2);
   fclose_cond(outfile3);
@@ -8571,7 +12464,7 @@ int32_t calc_cluster_neighbor(pthread_t* threads, FILE* bedfile, uintptr_t bed_o
     // calculate entire distance matrix, or use already-calculated matrix in
     // memory
     if (!g_dists) {
-      retval = calc_distance(threads, 0, 1, bedfile, bed_offset, outname, outname_end, 0, DISTANCE_FLAT_MISSING | DISTANCE_CLUSTER, marker_exclude, marker_ct, set_allele_freqs, unfiltered_indiv_ct, indiv_exclude, person_ids, max_person_id_len, chrom_info_ptr, 0, 0, NULL, 0.0);
+      retval = calc_distance(threads, 0, 1, bedfile, bed_offset, outname, outname_end, 0, DISTANCE_FLAT_MISSING | DISTANCE_CLUSTER, marker_exclude, marker_ct, set_allele_freqs, unfiltered_indiv_ct, indiv_exclude, person_ids, max_person_id_len, chrom_info_ptr, 0, 0, NULL, 0.0, 0, NULL);
       if (retval) {
         goto calc_cluster_neighbor_ret_1;
       }
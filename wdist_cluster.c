@@ -1,5 +1,9 @@
 #include "wdist_cluster.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #ifdef __APPLE__
 
 #include <Accelerate/Accelerate.h>
@@ -608,14 +612,77 @@ int32_t cluster_alloc_and_populate_magic_nums(uint32_t cluster_ct, uint32_t* clu
   return 0;
 }
 
+int32_t read_genome_bin_open(FILE* bin_infile, char* read_genome_fname, uintptr_t indiv_ct, char* sorted_ids, uint32_t* id_map, uintptr_t max_person_id_len, uint32_t** bin_id_map_ptr, uint32_t* bin_id_ct_ptr, uint64_t* record_ct_ptr) {
+  // reads the .genome.bin header and ID table (file position just past the
+  // magic number), and maps file sample indices to current indiv_idx values
+  // (0xffffffffU if absent); leaves the file positioned at the first record
+  Genome_bin_header hdr;
+  struct stat statbuf;
+  uint32_t* bin_id_map;
+  uint64_t ids_size;
+  uint32_t id_idx;
+  uint32_t slen;
+  int32_t ii;
+  if (!fread(&hdr, sizeof(Genome_bin_header), 1, bin_infile)) {
+    return RET_READ_FAIL;
+  }
+  if (hdr.version != 1) {
+    sprintf(logbuf, "Error: Unsupported %s format version.\n", read_genome_fname);
+    logprintb();
+    return RET_INVALID_FORMAT;
+  }
+  ids_size = ((((uint64_t)hdr.id_ct) * hdr.max_id_len) + 7) & (~(7LLU));
+  if (fstat(fileno(bin_infile), &statbuf) || (hdr.max_id_len < 4) || (hdr.max_id_len > MAXLINELEN) || (((uint64_t)statbuf.st_size) != 8 + sizeof(Genome_bin_header) + ids_size + hdr.record_ct * sizeof(Genome_bin_rec))) {
+    sprintf(logbuf, "Error: %s is truncated or corrupted.\n", read_genome_fname);
+    logprintb();
+    return RET_INVALID_FORMAT;
+  }
+  if (wkspace_alloc_ui_checked(bin_id_map_ptr, hdr.id_ct * sizeof(int32_t))) {
+    return RET_NOMEM;
+  }
+  bin_id_map = *bin_id_map_ptr;
+  for (id_idx = 0; id_idx < hdr.id_ct; id_idx++) {
+    if (!fread(tbuf, hdr.max_id_len, 1, bin_infile)) {
+      return RET_READ_FAIL;
+    }
+    if (!memchr(tbuf, '\0', hdr.max_id_len)) {
+      sprintf(logbuf, "Error: %s is truncated or corrupted.\n", read_genome_fname);
+      logprintb();
+      return RET_INVALID_FORMAT;
+    }
+    slen = strlen(tbuf);
+    ii = -1;
+    if (indiv_ct && (slen < max_person_id_len)) {
+      ii = bsearch_str(tbuf, sorted_ids, max_person_id_len, 0, indiv_ct - 1);
+    }
+    bin_id_map[id_idx] = (ii == -1)? 0xffffffffU : id_map[(uint32_t)ii];
+  }
+  if (fseeko(bin_infile, 8 + sizeof(Genome_bin_header) + ids_size, SEEK_SET)) {
+    return RET_READ_FAIL;
+  }
+  *bin_id_ct_ptr = hdr.id_ct;
+  *record_ct_ptr = hdr.record_ct;
+  return 0;
+}
+
 int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t indiv_ct, char* person_ids, uintptr_t max_person_id_len, uintptr_t* cluster_merge_prevented, double* cluster_sorted_ibs, uint32_t neighbor_n2, double* neighbor_quantiles, uint32_t* neighbor_qindices, uint32_t* ppc_fail_counts, double min_ppc, uint32_t is_max_dist, uintptr_t cluster_ct, uint32_t* cluster_starts, uint32_t* indiv_to_cluster) {
   unsigned char* wkspace_mark = wkspace_base;
   gzFile gz_infile = NULL;
+  FILE* bin_infile = NULL;
+  unsigned char* bin_map = NULL;
+  uint32_t* bin_id_map = NULL;
+  Genome_bin_rec* rec_ptr = NULL;
+  Genome_bin_rec* rec_end = NULL;
+  uint64_t bin_map_size = 0;
+  uint64_t recs_left = 0;
+  uint32_t bin_id_ct = 0;
   uint32_t neighbor_load_quantiles = neighbor_quantiles && cluster_sorted_ibs;
   uint32_t ppc_warning = cluster_merge_prevented? 0 : 1;
   uintptr_t loaded_entry_ct = 0;
   uint32_t ppc_fail = 0;
   char* idbuf = &(tbuf[MAXLINELEN]);
+  Genome_bin_rec* rec_buf = NULL;
+  uintptr_t rec_buf_ct = 65536;
   char* sorted_ids;
   uint32_t* id_map;
   char* bufptr;
@@ -626,6 +693,7 @@ int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uint
   double cur_ibs;
   double cur_ppc;
   uintptr_t tcoord;
+  uintptr_t ulii;
   uint32_t uii;
   int32_t ii;
   int32_t retval;
@@ -633,74 +701,133 @@ int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uint
   if (retval) {
     goto read_genome_ret_1;
   }
-  if (gzopen_checked(&gz_infile, read_genome_fname, "rb")) {
+  // --genome bin output is recognized by its magic number
+  if (fopen_checked(&bin_infile, read_genome_fname, "rb")) {
     goto read_genome_ret_OPEN_FAIL;
   }
-  tbuf[MAXLINELEN - 1] = ' ';
-  // header line
-  do {
-    if (!gzgets(gz_infile, tbuf, MAXLINELEN)) {
-      goto read_genome_ret_READ_FAIL;
-    }
-    if (!tbuf[MAXLINELEN - 1]) {
-      goto read_genome_ret_INVALID_FORMAT_3;
-    }
-    bufptr = skip_initial_spaces(tbuf);
-  } while (is_eoln_kns(*bufptr));
-  // a little bit of input validation
-  if (memcmp(bufptr, "FID1", 4)) {
-    logprint("Error: Invalid --read-genome input file.\n");
-    goto read_genome_ret_INVALID_FORMAT;
-  }
-  while (gzgets(gz_infile, tbuf, MAXLINELEN)) {
-    if (!tbuf[MAXLINELEN - 1]) {
-      goto read_genome_ret_INVALID_FORMAT_3;
+  if ((fread(tbuf, 1, 8, bin_infile) == 8) && (!memcmp(tbuf, GENOME_BIN_MAGIC, 8))) {
+    retval = read_genome_bin_open(bin_infile, read_genome_fname, indiv_ct, sorted_ids, id_map, max_person_id_len, &bin_id_map, &bin_id_ct, &recs_left);
+    if (retval) {
+      goto read_genome_ret_1;
+    }
+#ifndef _WIN32
+    if (recs_left && ((sizeof(intptr_t) == 8) || (recs_left < 0x1000000))) {
+      bin_map_size = ftello(bin_infile) + recs_left * sizeof(Genome_bin_rec);
+      bin_map = (unsigned char*)mmap(NULL, bin_map_size, PROT_READ, MAP_SHARED, fileno(bin_infile), 0);
+      if (bin_map == (unsigned char*)MAP_FAILED) {
+	bin_map = NULL;
+      } else {
+	madvise(bin_map, bin_map_size, MADV_SEQUENTIAL);
+	rec_ptr = (Genome_bin_rec*)(&(bin_map[ftello(bin_infile)]));
+	rec_end = &(rec_ptr[recs_left]);
+	recs_left = 0;
+      }
     }
-    fam_id = skip_initial_spaces(tbuf);
-    if (is_eoln_kns(*fam_id)) {
-      continue;
+#endif
+    // fallback when mapping is unavailable: read records in blocks
+    if (recs_left && wkspace_alloc_c_checked((char**)(&rec_buf), rec_buf_ct * sizeof(Genome_bin_rec))) {
+      goto read_genome_ret_NOMEM;
     }
-    indiv_id = next_item(fam_id);
-    bufptr = next_item_mult(indiv_id, 2);
-    if (no_more_items(bufptr)) {
-      goto read_genome_ret_INVALID_FORMAT_4;
+  } else {
+    fclose_null(&bin_infile);
+    if (gzopen_checked(&gz_infile, read_genome_fname, "rb")) {
+      goto read_genome_ret_OPEN_FAIL;
     }
-    ii = bsearch_fam_indiv(idbuf, sorted_ids, max_person_id_len, indiv_ct, fam_id, indiv_id);
-    if (ii == -1) {
-      continue;
+    // header line
+    do {
+      if (!gzgets(gz_infile, tbuf, MAXLINELEN)) {
+	goto read_genome_ret_READ_FAIL;
+      }
+      if (!tbuf[MAXLINELEN - 1]) {
+	goto read_genome_ret_INVALID_FORMAT_3;
+      }
+      bufptr = skip_initial_spaces(tbuf);
+    } while (is_eoln_kns(*bufptr));
+    // a little bit of input validation
+    if (memcmp(bufptr, "FID1", 4)) {
+      logprint("Error: Invalid --read-genome input file.\n");
+      goto read_genome_ret_INVALID_FORMAT;
     }
-    indiv_idx1 = id_map[(uint32_t)ii];
-    fam_id = next_item(indiv_id);
-    indiv_id = bufptr;
-    ii = bsearch_fam_indiv(idbuf, sorted_ids, max_person_id_len, indiv_ct, fam_id, indiv_id);
-    if (ii == -1) {
-      continue;
+  }
+  while (1) {
+    if (bin_id_map) {
+      if (rec_ptr == rec_end) {
+	if (!recs_left) {
+	  break;
+	}
+	ulii = (recs_left > rec_buf_ct)? rec_buf_ct : recs_left;
+	if (fread(rec_buf, sizeof(Genome_bin_rec), ulii, bin_infile) < ulii) {
+	  goto read_genome_ret_READ_FAIL;
+	}
+	rec_ptr = rec_buf;
+	rec_end = &(rec_buf[ulii]);
+	recs_left -= ulii;
+      }
+      if ((rec_ptr->idx1 >= bin_id_ct) || (rec_ptr->idx2 >= bin_id_ct)) {
+	sprintf(logbuf, "Error: Invalid individual index in %s.\n", read_genome_fname);
+	goto read_genome_ret_INVALID_FORMAT_2;
+      }
+      indiv_idx1 = bin_id_map[rec_ptr->idx1];
+      indiv_idx2 = bin_id_map[rec_ptr->idx2];
+      cur_ibs = rec_ptr->dst;
+      cur_ppc = rec_ptr->ppc;
+      rec_ptr++;
+      if ((indiv_idx1 == 0xffffffffU) || (indiv_idx2 == 0xffffffffU)) {
+	continue;
+      }
+    } else {
+      if (!gzgets(gz_infile, tbuf, MAXLINELEN)) {
+	break;
+      }
+      if (!tbuf[MAXLINELEN - 1]) {
+	goto read_genome_ret_INVALID_FORMAT_3;
+      }
+      fam_id = skip_initial_spaces(tbuf);
+      if (is_eoln_kns(*fam_id)) {
+	continue;
+      }
+      indiv_id = next_item(fam_id);
+      bufptr = next_item_mult(indiv_id, 2);
+      if (no_more_items(bufptr)) {
+	goto read_genome_ret_INVALID_FORMAT_4;
+      }
+      ii = bsearch_fam_indiv(idbuf, sorted_ids, max_person_id_len, indiv_ct, fam_id, indiv_id);
+      if (ii == -1) {
+	continue;
+      }
+      indiv_idx1 = id_map[(uint32_t)ii];
+      fam_id = next_item(indiv_id);
+      indiv_id = bufptr;
+      ii = bsearch_fam_indiv(idbuf, sorted_ids, max_person_id_len, indiv_ct, fam_id, indiv_id);
+      if (ii == -1) {
+	continue;
+      }
+      indiv_idx2 = id_map[(uint32_t)ii];
+      bufptr = next_item_mult(indiv_id, 8); // distance
+      fam_id = next_item(bufptr); // repurposed to PPC test value
+      if (no_more_items(fam_id)) {
+	goto read_genome_ret_INVALID_FORMAT_4;
+      }
+      if ((min_ppc != 0.0) && scan_double(fam_id, &cur_ppc)) {
+	logprint("Error: Invalid PPC test value in --read-genome input file.\n");
+	goto read_genome_ret_INVALID_FORMAT;
+      }
+      if (scan_double(bufptr, &cur_ibs)) {
+	logprint("Error: Invalid IBS value in --read-genome input file.\n");
+	goto read_genome_ret_INVALID_FORMAT;
+      }
     }
-    indiv_idx2 = id_map[(uint32_t)ii];
     if (indiv_idx2 == indiv_idx1) {
       logprint("Error: FID1/IID1 matches FID2/IID2 in --read-genome input file line.\n");
       goto read_genome_ret_INVALID_FORMAT;
     }
-    bufptr = next_item_mult(indiv_id, 8); // distance
-    fam_id = next_item(bufptr); // repurposed to PPC test value
-    if (no_more_items(fam_id)) {
-      goto read_genome_ret_INVALID_FORMAT_4;
-    }
     if (min_ppc != 0.0) {
-      if (scan_double(fam_id, &cur_ppc)) {
-	logprint("Error: Invalid PPC test value in --read-genome input file.\n");
-	goto read_genome_ret_INVALID_FORMAT;
-      }
       ppc_fail = (cur_ppc < min_ppc)? 1 : 0;
       if (ppc_fail && ppc_fail_counts) {
 	ppc_fail_counts[indiv_idx1] += 1;
 	ppc_fail_counts[indiv_idx2] += 1;
       }
     }
-    if (scan_double(bufptr, &cur_ibs)) {
-      logprint("Error: Invalid IBS value in --read-genome input file.\n");
-      goto read_genome_ret_INVALID_FORMAT;
-    }
     if (neighbor_load_quantiles) {
       update_neighbor(indiv_ct, neighbor_n2, indiv_idx1, indiv_idx2, cur_ibs, neighbor_quantiles, neighbor_qindices);
     }
@@ -735,7 +862,7 @@ int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uint
       }
     }
   }
-  if (!gzeof(gz_infile)) {
+  if (gz_infile && (!gzeof(gz_infile))) {
     goto read_genome_ret_READ_FAIL;
   }
   if (loaded_entry_ct != (indiv_ct * (indiv_ct - 1)) / 2) {
@@ -743,6 +870,9 @@ int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uint
     goto read_genome_ret_INVALID_FORMAT_2;
   }
   while (0) {
+  read_genome_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
   read_genome_ret_OPEN_FAIL:
     retval = RET_OPEN_FAIL;
     break;
@@ -764,6 +894,12 @@ int32_t read_genome(char* read_genome_fname, uintptr_t unfiltered_indiv_ct, uint
   }
  read_genome_ret_1:
   wkspace_reset(wkspace_mark);
+#ifndef _WIN32
+  if (bin_map) {
+    munmap(bin_map, bin_map_size);
+  }
+#endif
+  fclose_cond(bin_infile);
   gzclose_cond(gz_infile);
   return retval;
 }
@@ -1,6 +1,14 @@
 #include "wdist_common.h"
 #include "pigz.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 const char errstr_fopen[] = "Error: Failed to open %s.\n";
 const char errstr_append[] = "\nFor more information, try '" PROG_NAME_STR " --help [flag name]' or '" PROG_NAME_STR " --help | more'.\n";
 const char errstr_thread_create[] = "\nError: Failed to create thread.\n";
@@ -17,6 +25,31 @@ int32_t debug_on = 0;
 int32_t log_failed = 0;
 uintptr_t g_indiv_ct;
 uint32_t g_thread_ct;
+uint32_t g_simd_level = SIMD_LEVEL_SSE2;
+const char* g_simd_level_names[] = {"SSE2", "AVX2", "AVX-512", "AVX-512 VPOPCNTDQ"};
+
+uint32_t simd_level_init(uint32_t max_level) {
+  uint32_t level = SIMD_LEVEL_SSE2;
+#ifdef SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    level = SIMD_LEVEL_AVX2;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+      level = SIMD_LEVEL_AVX512;
+#ifdef SIMD_VPOPCNT
+      if (__builtin_cpu_supports("avx512vpopcntdq")) {
+	level = SIMD_LEVEL_AVX512_VPOPCNT;
+      }
+#endif
+    }
+  }
+#endif
+  if (level > max_level) {
+    level = max_level;
+  }
+  g_simd_level = level;
+  return level;
+}
 
 uint32_t push_ll_str(Ll_str** ll_stack_ptr, const char* ss) {
   uint32_t slen = strlen(ss);
@@ -105,6 +138,231 @@ void wkspace_reset(void* new_base) {
   wkspace_left += freed_bytes;
 }
 
+#ifdef __linux__
+// set by wkspace_backing_alloc(), for wkspace_backing_free() and
+// wkspace_backing_log()
+static uintptr_t g_wkspace_map_size = 0;
+static uint32_t g_wkspace_backing_obtained = 0;
+static uint32_t g_wkspace_numa_node_ct = 0;
+static uint32_t g_wkspace_hugetlb_kb = 0;
+
+#define WKSPACE_THP_ALIGN 2097152
+
+// from linux/mempolicy.h
+#define WKSPACE_MPOL_INTERLEAVE 3
+
+uint32_t numa_online_mask(uint64_t* mask_ptr) {
+  // Parses /sys/devices/system/node/online (e.g. "0-1,4"), and returns the
+  // number of online nodes (only nodes 0..63 are considered).
+  FILE* infile = fopen("/sys/devices/system/node/online", "r");
+  char buf[256];
+  char* bufptr;
+  uint64_t mask = 0;
+  uint32_t node_ct = 0;
+  uint32_t range_start;
+  uint32_t range_end;
+  *mask_ptr = 0;
+  if (!infile) {
+    return 0;
+  }
+  if (!fgets(buf, 256, infile)) {
+    fclose(infile);
+    return 0;
+  }
+  fclose(infile);
+  bufptr = buf;
+  while (((unsigned char)(*bufptr)) - 48 < 10) {
+    range_start = strtoul(bufptr, &bufptr, 10);
+    range_end = range_start;
+    if (*bufptr == '-') {
+      range_end = strtoul(&(bufptr[1]), &bufptr, 10);
+    }
+    for (; (range_start <= range_end) && (range_start < 64); range_start++) {
+      if (!(mask & (1LLU << range_start))) {
+	mask |= 1LLU << range_start;
+	node_ct++;
+      }
+    }
+    if (*bufptr != ',') {
+      break;
+    }
+    bufptr++;
+  }
+  *mask_ptr = mask;
+  return node_ct;
+}
+
+uint32_t hugetlb_default_kb() {
+  // Returns the default explicit huge page size in KB, or 0 if the kernel
+  // doesn't report one.
+  FILE* infile = fopen("/proc/meminfo", "r");
+  char buf[256];
+  uint32_t retval = 0;
+  if (!infile) {
+    return 0;
+  }
+  while (fgets(buf, 256, infile)) {
+    if (!memcmp(buf, "Hugepagesize:", 13)) {
+      retval = strtoul(&(buf[13]), NULL, 10);
+      break;
+    }
+  }
+  fclose(infile);
+  return retval;
+}
+
+uint32_t thp_never() {
+  // Returns 1 if transparent huge pages are disabled system-wide.
+  FILE* infile = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  char buf[256];
+  uint32_t retval = 1;
+  if (!infile) {
+    return 1;
+  }
+  if (fgets(buf, 256, infile)) {
+    retval = (strstr(buf, "[never]") != NULL);
+  }
+  fclose(infile);
+  return retval;
+}
+#endif
+
+unsigned char* wkspace_backing_alloc(uintptr_t size, uint32_t backing_modifier) {
+#ifdef __linux__
+  unsigned char* map_start = (unsigned char*)MAP_FAILED;
+  unsigned char* aligned_start;
+  uintptr_t map_size;
+  uintptr_t hugetlb_size;
+  uint64_t node_mask;
+  g_wkspace_map_size = 0;
+  g_wkspace_backing_obtained = 0;
+  g_wkspace_numa_node_ct = 0;
+  if (!backing_modifier) {
+    return (unsigned char*)malloc(size);
+  }
+  if (backing_modifier & WKSPACE_BACKING_HUGETLB) {
+    g_wkspace_hugetlb_kb = hugetlb_default_kb();
+    if (g_wkspace_hugetlb_kb) {
+      // length must be a multiple of the huge page size; this fails unless
+      // enough pages have been reserved (vm.nr_hugepages)
+      hugetlb_size = ((uintptr_t)g_wkspace_hugetlb_kb) * 1024;
+      map_size = ((size + hugetlb_size - 1) / hugetlb_size) * hugetlb_size;
+      map_start = (unsigned char*)mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (map_start != MAP_FAILED) {
+	g_wkspace_backing_obtained |= WKSPACE_BACKING_HUGETLB;
+      }
+    }
+  }
+  if (map_start == MAP_FAILED) {
+    if (backing_modifier & (WKSPACE_BACKING_THP | WKSPACE_BACKING_HUGETLB)) {
+      // over-map, then trim to a 2 MB-aligned range so that transparent huge
+      // pages can cover all of it
+      map_start = (unsigned char*)mmap(NULL, size + WKSPACE_THP_ALIGN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (map_start == MAP_FAILED) {
+	return NULL;
+      }
+      aligned_start = (unsigned char*)((((uintptr_t)map_start) + (WKSPACE_THP_ALIGN - 1)) & (~((uintptr_t)(WKSPACE_THP_ALIGN - 1))));
+      map_size = (size + (WKSPACE_THP_ALIGN - 1)) & (~((uintptr_t)(WKSPACE_THP_ALIGN - 1)));
+      if (aligned_start != map_start) {
+	munmap(map_start, (uintptr_t)(aligned_start - map_start));
+      }
+      if ((uintptr_t)(&(map_start[size + WKSPACE_THP_ALIGN]) - &(aligned_start[map_size]))) {
+        munmap(&(aligned_start[map_size]), (uintptr_t)(&(map_start[size + WKSPACE_THP_ALIGN]) - &(aligned_start[map_size])));
+      }
+      map_start = aligned_start;
+      if ((!madvise(map_start, map_size, MADV_HUGEPAGE)) && (!thp_never())) {
+	g_wkspace_backing_obtained |= WKSPACE_BACKING_THP;
+      }
+    } else {
+      map_size = size;
+      map_start = (unsigned char*)mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (map_start == MAP_FAILED) {
+	return NULL;
+      }
+    }
+  }
+  if (backing_modifier & WKSPACE_BACKING_INTERLEAVE) {
+    // Nothing has been touched yet, so the policy applies to every page.
+    // Raw syscall to avoid a libnuma dependency.
+    g_wkspace_numa_node_ct = numa_online_mask(&node_mask);
+    if (g_wkspace_numa_node_ct > 1) {
+      if (!syscall(SYS_mbind, map_start, map_size, WKSPACE_MPOL_INTERLEAVE, &node_mask, 65, 0)) {
+	g_wkspace_backing_obtained |= WKSPACE_BACKING_INTERLEAVE;
+      }
+    }
+  }
+  g_wkspace_map_size = map_size;
+  return map_start;
+#else
+  return (unsigned char*)malloc(size);
+#endif
+}
+
+void wkspace_backing_free(unsigned char* wkspace_ua) {
+#ifdef __linux__
+  if (g_wkspace_map_size) {
+    munmap(wkspace_ua, g_wkspace_map_size);
+    g_wkspace_map_size = 0;
+    return;
+  }
+#endif
+  free(wkspace_ua);
+}
+
+void wkspace_backing_log(uint32_t backing_modifier) {
+#ifdef __linux__
+  char* bufptr;
+  if (!backing_modifier) {
+    return;
+  }
+  bufptr = memcpya(logbuf, "Main workspace backing: ", 24);
+  if (g_wkspace_backing_obtained & WKSPACE_BACKING_HUGETLB) {
+    bufptr += sprintf(bufptr, "%u kB explicit huge pages", g_wkspace_hugetlb_kb);
+  } else if (g_wkspace_backing_obtained & WKSPACE_BACKING_THP) {
+    bufptr = strcpya(bufptr, "transparent huge pages");
+    if (backing_modifier & WKSPACE_BACKING_HUGETLB) {
+      bufptr = strcpya(bufptr, " (explicit huge pages unavailable)");
+    }
+  } else if (backing_modifier & (WKSPACE_BACKING_THP | WKSPACE_BACKING_HUGETLB)) {
+    bufptr = strcpya(bufptr, "ordinary pages (huge pages unavailable)");
+  } else {
+    bufptr = strcpya(bufptr, "ordinary pages");
+  }
+  if (backing_modifier & WKSPACE_BACKING_INTERLEAVE) {
+    if (g_wkspace_backing_obtained & WKSPACE_BACKING_INTERLEAVE) {
+      bufptr += sprintf(bufptr, ", interleaved across %u NUMA nodes", g_wkspace_numa_node_ct);
+    } else if (g_wkspace_numa_node_ct < 2) {
+      bufptr = strcpya(bufptr, ", not interleaved (single NUMA node)");
+    } else {
+      bufptr = strcpya(bufptr, ", not interleaved (mbind failed)");
+    }
+  }
+  memcpy(bufptr, ".\n", 3);
+  logprintb();
+#else
+  if (backing_modifier) {
+    logprint("Warning: --memory-backing is only supported on Linux; using ordinary malloc.\n");
+  }
+#endif
+}
+
+int32_t wkspace_alloc_thread_arenas(Thread_arenas* tap, uintptr_t per_thread_size, uint32_t thread_ct) {
+  uintptr_t stride = CACHEALIGN(per_thread_size);
+  unsigned char* base = wkspace_base;
+  if (stride >= THREAD_ARENA_PAGE_MIN) {
+    // page-align the blocks so no page straddles two threads' memory
+    stride = (stride + (THREAD_ARENA_PAGE - 1)) & (~((uintptr_t)(THREAD_ARENA_PAGE - 1)));
+    base = (unsigned char*)((((uintptr_t)wkspace_base) + (THREAD_ARENA_PAGE - 1)) & (~((uintptr_t)(THREAD_ARENA_PAGE - 1))));
+  }
+  if (!wkspace_alloc((uintptr_t)(base - wkspace_base) + stride * thread_ct)) {
+    return 1;
+  }
+  tap->base = base;
+  tap->stride = stride;
+  tap->thread_ct = thread_ct;
+  return 0;
+}
+
 uint32_t match_upper(char* ss, const char* fixed_str) {
   // Returns whether uppercased ss matches nonempty fixed_str.  Assumes
   // fixed_str contains nothing but letters and a null terminator.
@@ -185,6 +443,107 @@ uint32_t scan_two_doubles(char* ss, double* val1p, double* val2p) {
   return (ss == ss2)? 1 : 0;
 }
 
+static const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+uint32_t scan_double_fast(char* ss, double* valp) {
+  // Same result as scan_double(), but plain decimals with at most 15
+  // significant digits and a net power-of-ten exponent in [-22, 22] are
+  // converted with one correctly rounded multiplication or division
+  // (Clinger's fast path); everything else is handed to strtod().
+  char* sptr = ss;
+  uint64_t mantissa = 0;
+  uint32_t digit_ct = 0;
+  int32_t exp10 = 0;
+  int32_t exp_explicit = 0;
+  uint32_t is_neg = 0;
+  uint32_t exp_is_neg = 0;
+  uint32_t uii;
+  if ((*sptr == '-') || (*sptr == '+')) {
+    is_neg = (*sptr++ == '-');
+  }
+  while (*sptr == '0') {
+    sptr++;
+    digit_ct = 1;
+  }
+  while (1) {
+    uii = ((unsigned char)(*sptr)) - '0';
+    if (uii > 9) {
+      break;
+    }
+    mantissa = mantissa * 10 + uii;
+    sptr++;
+    if (++digit_ct > 15) {
+      return scan_double(ss, valp);
+    }
+  }
+  if (*sptr == '.') {
+    sptr++;
+    if ((!mantissa) && (*sptr == '0')) {
+      // leading zeroes after the decimal point aren't significant
+      do {
+	sptr++;
+	exp10--;
+      } while (*sptr == '0');
+      digit_ct = 1;
+    }
+    while (1) {
+      uii = ((unsigned char)(*sptr)) - '0';
+      if (uii > 9) {
+	break;
+      }
+      mantissa = mantissa * 10 + uii;
+      sptr++;
+      exp10--;
+      if (++digit_ct > 15) {
+	return scan_double(ss, valp);
+      }
+    }
+  }
+  if (!digit_ct) {
+    return scan_double(ss, valp);
+  }
+  if ((*sptr == 'e') || (*sptr == 'E')) {
+    sptr++;
+    if ((*sptr == '-') || (*sptr == '+')) {
+      exp_is_neg = (*sptr++ == '-');
+    }
+    uii = ((unsigned char)(*sptr)) - '0';
+    if (uii > 9) {
+      return scan_double(ss, valp);
+    }
+    do {
+      exp_explicit = exp_explicit * 10 + uii;
+      if (exp_explicit > 999) {
+	return scan_double(ss, valp);
+      }
+      uii = ((unsigned char)(*(++sptr))) - '0';
+    } while (uii <= 9);
+    exp10 += exp_is_neg? (-exp_explicit) : exp_explicit;
+  }
+  if (((unsigned char)(*sptr)) > ' ') {
+    // hex, inf/nan, or trailing junk: let strtod() sort it out
+    return scan_double(ss, valp);
+  }
+  if (!mantissa) {
+    exp10 = 0;
+  }
+  if (exp10 < 0) {
+    if (exp10 < -22) {
+      return scan_double(ss, valp);
+    }
+    *valp = ((double)((int64_t)mantissa)) / kPow10[-exp10];
+  } else {
+    if (exp10 > 22) {
+      return scan_double(ss, valp);
+    }
+    *valp = ((double)((int64_t)mantissa)) * kPow10[exp10];
+  }
+  if (is_neg) {
+    *valp = -(*valp);
+  }
+  return 0;
+}
+
 int32_t get_next_noncomment(FILE* fptr, char** lptr_ptr) {
   char* lptr;
   do {
@@ -3322,17 +3681,15 @@ void parallel_bounds(uint32_t ct, int32_t start, uint32_t parallel_idx, uint32_t
   *bound_end_ptr = triangle_divide((ct_tot * (parallel_idx + 1)) / parallel_tot, modif);
 }
 
-// set align to 1 for no alignment
-void triangle_fill(uint32_t* target_arr, uint32_t ct, uint32_t pieces, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t start, uint32_t align) {
+// Splits rows [lbound, ubound) of the triangle into pieces of roughly equal
+// area.  Set align to 1 for no alignment.
+void triangle_fill_range(uint32_t* target_arr, uint32_t ct, uint32_t pieces, int32_t lbound, int32_t ubound, uint32_t start, uint32_t align) {
   int32_t modif = 1 - start * 2;
   uint32_t cur_piece = 1;
   int64_t ct_tr;
   int64_t cur_prod;
-  int32_t lbound;
-  int32_t ubound;
   uint32_t uii;
   uint32_t align_m1;
-  parallel_bounds(ct, start, parallel_idx, parallel_tot, &lbound, &ubound);
   // x(x+1)/2 is divisible by y iff (x % (2y)) is 0 or (2y - 1).
   align *= 2;
   align_m1 = align - 1;
@@ -3355,6 +3712,14 @@ void triangle_fill(uint32_t* target_arr, uint32_t ct, uint32_t pieces, uint32_t
   }
 }
 
+// set align to 1 for no alignment
+void triangle_fill(uint32_t* target_arr, uint32_t ct, uint32_t pieces, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t start, uint32_t align) {
+  int32_t lbound;
+  int32_t ubound;
+  parallel_bounds(ct, start, parallel_idx, parallel_tot, &lbound, &ubound);
+  triangle_fill_range(target_arr, ct, pieces, lbound, ubound, start, align);
+}
+
 int32_t write_ids(char* outname, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len) {
   uintptr_t indiv_uidx = 0;
   FILE* outfile;
@@ -3378,6 +3743,72 @@ int32_t write_ids(char* outname, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv
   return 0;
 }
 
+void part_fname_write(char* part_fname, char* outname, char* outname_end, const char* ext, uint32_t part_idx) {
+  // Writes the name --parallel uses for piece part_idx of {outname}{ext}
+  // (i.e. the piece number inserted before a trailing ".gz") to part_fname,
+  // and leaves {outname}{ext} in outname.
+  uint32_t ext_len = strlen(ext);
+  uint32_t gz_len = 0;
+  char* wptr;
+  if ((ext_len > 3) && (!memcmp(&(ext[ext_len - 3]), ".gz", 3))) {
+    gz_len = 3;
+  }
+  memcpy(outname_end, ext, ext_len - gz_len);
+  wptr = &(outname_end[ext_len - gz_len]);
+  *wptr++ = '.';
+  wptr = uint32_write(wptr, part_idx + 1);
+  memcpy(wptr, ".gz", gz_len);
+  wptr[gz_len] = '\0';
+  memcpy(part_fname, outname, &(wptr[gz_len + 1]) - outname);
+  memcpy(outname_end, ext, ext_len + 1);
+}
+
+int32_t fappend_file(const char* fname, FILE* outfile) {
+  FILE* infile = NULL;
+  int32_t retval = 0;
+  uintptr_t read_ct;
+  if (fopen_checked(&infile, fname, "rb")) {
+    return RET_OPEN_FAIL;
+  }
+  while (1) {
+    read_ct = fread(tbuf, 1, MAXLINELEN, infile);
+    if (!read_ct) {
+      break;
+    }
+    if (fwrite_checked(tbuf, read_ct, outfile)) {
+      retval = RET_WRITE_FAIL;
+      break;
+    }
+  }
+  if ((!retval) && ferror(infile)) {
+    retval = RET_READ_FAIL;
+  }
+  fclose(infile);
+  return retval;
+}
+
+int32_t append_part_file(char* outname, char* outname_end, const char* ext, uint32_t part_idx, uint32_t is_first) {
+  // Appends {outname}{ext} piece part_idx to {outname}{ext}, truncating the
+  // latter first if is_first is set, and then deletes the piece.
+  // Concatenated gzip members are still a valid gzip file, so this works for
+  // every non-square output shape.
+  FILE* outfile = NULL;
+  int32_t retval;
+  char part_fname[FNAMESIZE];
+  part_fname_write(part_fname, outname, outname_end, ext, part_idx);
+  if (fopen_checked(&outfile, outname, is_first? "wb" : "ab")) {
+    return RET_OPEN_FAIL;
+  }
+  retval = fappend_file(part_fname, outfile);
+  if (fclose_null(&outfile) && (!retval)) {
+    retval = RET_WRITE_FAIL;
+  }
+  if (!retval) {
+    unlink(part_fname);
+  }
+  return retval;
+}
+
 int32_t distance_d_write_ids(char* outname, char* outname_end, uint32_t dist_calc_type, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len) {
   int32_t retval;
   if (dist_calc_type & DISTANCE_ALCT) {
@@ -4302,8 +4733,324 @@ void vertical_bitct_subtract(uintptr_t* bit_arr, uint32_t item_ct, uint32_t* sum
   }
 }
 
+#ifdef SIMD_DISPATCH
+// AVX2 and AVX-512 versions of the 64-bit frequency counters below.  All the
+// masks have only even bits set, so two counts that are summed anyway can be
+// packed into one vector (the second shifted left by 1) and popcounted
+// together.  Byte counts are flushed to 64-bit sums every 31 vectors, so these
+// don't care how the caller splits up the work.  (The AVX-512 versions shift
+// 16-bit lanes to dodge a spurious GCC warning; that's equivalent here since
+// only even bits are kept.)
+//
+// count_3freq and count_01 can't pack their counts, and their AVX2 versions
+// were no faster than the SSE2 code, so they only have AVX-512 versions.
+static __attribute__((target("avx2"))) void count_2freq_dbl_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* mask1p, uintptr_t* mask2p, uint32_t* ct1abp, uint32_t* ct1cp, uint32_t* ct2abp, uint32_t* ct2cp) {
+  __m256i acc1_ab = _mm256_setzero_si256();
+  __m256i acc1_c = _mm256_setzero_si256();
+  __m256i acc2_ab = _mm256_setzero_si256();
+  __m256i acc2_c = _mm256_setzero_si256();
+  __m256i acc1_ab_bytes;
+  __m256i acc1_c_bytes;
+  __m256i acc2_ab_bytes;
+  __m256i acc2_c_bytes;
+  __m256i loader;
+  __m256i loader2;
+  __m256i loader3;
+  __m256i loader4;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 4;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc1_ab_bytes = _mm256_setzero_si256();
+    acc1_c_bytes = _mm256_setzero_si256();
+    acc2_ab_bytes = _mm256_setzero_si256();
+    acc2_c_bytes = _mm256_setzero_si256();
+    do {
+      loader = load_words_avx2(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm256_srli_epi64(loader, 1);
+      loader3 = load_words_avx2(&(mask1p[widx]), word_ct - widx);
+      loader4 = load_words_avx2(&(mask2p[widx]), word_ct - widx);
+      acc1_ab_bytes = _mm256_add_epi8(acc1_ab_bytes, popcount_bytes_avx2(_mm256_and_si256(loader, _mm256_or_si256(loader3, _mm256_slli_epi64(loader3, 1)))));
+      acc1_c_bytes = _mm256_add_epi8(acc1_c_bytes, popcount_bytes_avx2(_mm256_and_si256(_mm256_andnot_si256(loader2, loader), loader3)));
+      acc2_ab_bytes = _mm256_add_epi8(acc2_ab_bytes, popcount_bytes_avx2(_mm256_and_si256(loader, _mm256_or_si256(loader4, _mm256_slli_epi64(loader4, 1)))));
+      acc2_c_bytes = _mm256_add_epi8(acc2_c_bytes, popcount_bytes_avx2(_mm256_and_si256(_mm256_andnot_si256(loader2, loader), loader4)));
+      widx += 4;
+    } while (widx < block_end);
+    acc1_ab = _mm256_add_epi64(acc1_ab, _mm256_sad_epu8(acc1_ab_bytes, _mm256_setzero_si256()));
+    acc1_c = _mm256_add_epi64(acc1_c, _mm256_sad_epu8(acc1_c_bytes, _mm256_setzero_si256()));
+    acc2_ab = _mm256_add_epi64(acc2_ab, _mm256_sad_epu8(acc2_ab_bytes, _mm256_setzero_si256()));
+    acc2_c = _mm256_add_epi64(acc2_c, _mm256_sad_epu8(acc2_c_bytes, _mm256_setzero_si256()));
+  }
+  *ct1abp += hsum_avx2(acc1_ab);
+  *ct1cp += hsum_avx2(acc1_c);
+  *ct2abp += hsum_avx2(acc2_ab);
+  *ct2cp += hsum_avx2(acc2_c);
+}
+
+static __attribute__((target("avx2"))) void count_set_freq_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  __m256i acc = _mm256_setzero_si256();
+  __m256i accm = _mm256_setzero_si256();
+  __m256i acc_bytes;
+  __m256i accm_bytes;
+  __m256i loader;
+  __m256i loader2;
+  __m256i loader3;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 4;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_bytes = _mm256_setzero_si256();
+    accm_bytes = _mm256_setzero_si256();
+    do {
+      loader = load_words_avx2(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm256_srli_epi64(loader, 1);
+      loader3 = load_words_avx2(&(include_vec[widx]), word_ct - widx);
+      acc_bytes = _mm256_add_epi8(acc_bytes, popcount_bytes_avx2(_mm256_or_si256(_mm256_and_si256(loader2, loader3), _mm256_slli_epi64(_mm256_and_si256(_mm256_and_si256(loader, loader2), loader3), 1))));
+      accm_bytes = _mm256_add_epi8(accm_bytes, popcount_bytes_avx2(_mm256_and_si256(loader, _mm256_andnot_si256(loader2, loader3))));
+      widx += 4;
+    } while (widx < block_end);
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(acc_bytes, _mm256_setzero_si256()));
+    accm = _mm256_add_epi64(accm, _mm256_sad_epu8(accm_bytes, _mm256_setzero_si256()));
+  }
+  *set_ctp += hsum_avx2(acc);
+  *missing_ctp += hsum_avx2(accm);
+}
+
+static __attribute__((target("avx2"))) void count_set_freq_x_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uintptr_t* male_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  __m256i acc = _mm256_setzero_si256();
+  __m256i accm = _mm256_setzero_si256();
+  __m256i acc_bytes;
+  __m256i accm_bytes;
+  __m256i loader;
+  __m256i loader2;
+  __m256i loader3;
+  __m256i males;
+  __m256i nonmales;
+  __m256i missings;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 4;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_bytes = _mm256_setzero_si256();
+    accm_bytes = _mm256_setzero_si256();
+    do {
+      loader = load_words_avx2(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm256_srli_epi64(loader, 1);
+      loader3 = load_words_avx2(&(include_vec[widx]), word_ct - widx);
+      males = load_words_avx2(&(male_vec[widx]), word_ct - widx);
+      nonmales = _mm256_andnot_si256(males, loader3);
+      males = _mm256_and_si256(males, loader3);
+      missings = _mm256_or_si256(_mm256_and_si256(loader, _mm256_andnot_si256(loader2, nonmales)), _mm256_and_si256(_mm256_xor_si256(loader, loader2), males));
+      acc_bytes = _mm256_add_epi8(acc_bytes, popcount_bytes_avx2(_mm256_or_si256(_mm256_and_si256(loader2, nonmales), _mm256_slli_epi64(_mm256_and_si256(_mm256_and_si256(loader, loader2), loader3), 1))));
+      accm_bytes = _mm256_add_epi8(accm_bytes, popcount_bytes_avx2(_mm256_or_si256(missings, _mm256_slli_epi64(_mm256_or_si256(males, _mm256_and_si256(missings, nonmales)), 1))));
+      widx += 4;
+    } while (widx < block_end);
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(acc_bytes, _mm256_setzero_si256()));
+    accm = _mm256_add_epi64(accm, _mm256_sad_epu8(accm_bytes, _mm256_setzero_si256()));
+  }
+  *set_ctp += hsum_avx2(acc);
+  *missing_ctp += hsum_avx2(accm);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) void count_2freq_dbl_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* mask1p, uintptr_t* mask2p, uint32_t* ct1abp, uint32_t* ct1cp, uint32_t* ct2abp, uint32_t* ct2cp) {
+  __m512i acc1_ab = _mm512_setzero_si512();
+  __m512i acc1_c = _mm512_setzero_si512();
+  __m512i acc2_ab = _mm512_setzero_si512();
+  __m512i acc2_c = _mm512_setzero_si512();
+  __m512i acc1_ab_bytes;
+  __m512i acc1_c_bytes;
+  __m512i acc2_ab_bytes;
+  __m512i acc2_c_bytes;
+  __m512i loader;
+  __m512i loader2;
+  __m512i loader3;
+  __m512i loader4;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 8;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc1_ab_bytes = _mm512_setzero_si512();
+    acc1_c_bytes = _mm512_setzero_si512();
+    acc2_ab_bytes = _mm512_setzero_si512();
+    acc2_c_bytes = _mm512_setzero_si512();
+    do {
+      loader = load_words_avx512(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm512_srli_epi16(loader, 1);
+      loader3 = load_words_avx512(&(mask1p[widx]), word_ct - widx);
+      loader4 = load_words_avx512(&(mask2p[widx]), word_ct - widx);
+      acc1_ab_bytes = _mm512_add_epi8(acc1_ab_bytes, popcount_bytes_avx512(_mm512_and_si512(loader, _mm512_or_si512(loader3, _mm512_slli_epi16(loader3, 1)))));
+      acc1_c_bytes = _mm512_add_epi8(acc1_c_bytes, popcount_bytes_avx512(_mm512_and_si512(andnot_avx512(loader2, loader), loader3)));
+      acc2_ab_bytes = _mm512_add_epi8(acc2_ab_bytes, popcount_bytes_avx512(_mm512_and_si512(loader, _mm512_or_si512(loader4, _mm512_slli_epi16(loader4, 1)))));
+      acc2_c_bytes = _mm512_add_epi8(acc2_c_bytes, popcount_bytes_avx512(_mm512_and_si512(andnot_avx512(loader2, loader), loader4)));
+      widx += 8;
+    } while (widx < block_end);
+    acc1_ab = _mm512_add_epi64(acc1_ab, _mm512_sad_epu8(acc1_ab_bytes, _mm512_setzero_si512()));
+    acc1_c = _mm512_add_epi64(acc1_c, _mm512_sad_epu8(acc1_c_bytes, _mm512_setzero_si512()));
+    acc2_ab = _mm512_add_epi64(acc2_ab, _mm512_sad_epu8(acc2_ab_bytes, _mm512_setzero_si512()));
+    acc2_c = _mm512_add_epi64(acc2_c, _mm512_sad_epu8(acc2_c_bytes, _mm512_setzero_si512()));
+  }
+  *ct1abp += hsum_avx512(acc1_ab);
+  *ct1cp += hsum_avx512(acc1_c);
+  *ct2abp += hsum_avx512(acc2_ab);
+  *ct2cp += hsum_avx512(acc2_c);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) void count_3freq_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* maskp, uint32_t* even_ctp, uint32_t* odd_ctp, uint32_t* homset_ctp) {
+  __m512i acc_even = _mm512_setzero_si512();
+  __m512i acc_odd = _mm512_setzero_si512();
+  __m512i acc_homset = _mm512_setzero_si512();
+  __m512i acc_even_bytes;
+  __m512i acc_odd_bytes;
+  __m512i acc_homset_bytes;
+  __m512i loader;
+  __m512i loader2;
+  __m512i odds;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 8;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_even_bytes = _mm512_setzero_si512();
+    acc_odd_bytes = _mm512_setzero_si512();
+    acc_homset_bytes = _mm512_setzero_si512();
+    do {
+      loader = load_words_avx512(&(lptr[widx]), word_ct - widx);
+      loader2 = load_words_avx512(&(maskp[widx]), word_ct - widx);
+      odds = _mm512_and_si512(loader2, _mm512_srli_epi16(loader, 1));
+      acc_even_bytes = _mm512_add_epi8(acc_even_bytes, popcount_bytes_avx512(_mm512_and_si512(loader2, loader)));
+      acc_odd_bytes = _mm512_add_epi8(acc_odd_bytes, popcount_bytes_avx512(odds));
+      acc_homset_bytes = _mm512_add_epi8(acc_homset_bytes, popcount_bytes_avx512(_mm512_and_si512(odds, loader)));
+      widx += 8;
+    } while (widx < block_end);
+    acc_even = _mm512_add_epi64(acc_even, _mm512_sad_epu8(acc_even_bytes, _mm512_setzero_si512()));
+    acc_odd = _mm512_add_epi64(acc_odd, _mm512_sad_epu8(acc_odd_bytes, _mm512_setzero_si512()));
+    acc_homset = _mm512_add_epi64(acc_homset, _mm512_sad_epu8(acc_homset_bytes, _mm512_setzero_si512()));
+  }
+  *even_ctp += hsum_avx512(acc_even);
+  *odd_ctp += hsum_avx512(acc_odd);
+  *homset_ctp += hsum_avx512(acc_homset);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) void count_set_freq_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  __m512i acc = _mm512_setzero_si512();
+  __m512i accm = _mm512_setzero_si512();
+  __m512i acc_bytes;
+  __m512i accm_bytes;
+  __m512i loader;
+  __m512i loader2;
+  __m512i loader3;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 8;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_bytes = _mm512_setzero_si512();
+    accm_bytes = _mm512_setzero_si512();
+    do {
+      loader = load_words_avx512(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm512_srli_epi16(loader, 1);
+      loader3 = load_words_avx512(&(include_vec[widx]), word_ct - widx);
+      acc_bytes = _mm512_add_epi8(acc_bytes, popcount_bytes_avx512(_mm512_or_si512(_mm512_and_si512(loader2, loader3), _mm512_slli_epi16(_mm512_and_si512(_mm512_and_si512(loader, loader2), loader3), 1))));
+      accm_bytes = _mm512_add_epi8(accm_bytes, popcount_bytes_avx512(_mm512_and_si512(loader, andnot_avx512(loader2, loader3))));
+      widx += 8;
+    } while (widx < block_end);
+    acc = _mm512_add_epi64(acc, _mm512_sad_epu8(acc_bytes, _mm512_setzero_si512()));
+    accm = _mm512_add_epi64(accm, _mm512_sad_epu8(accm_bytes, _mm512_setzero_si512()));
+  }
+  *set_ctp += hsum_avx512(acc);
+  *missing_ctp += hsum_avx512(accm);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) void count_set_freq_x_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uintptr_t* male_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  __m512i acc = _mm512_setzero_si512();
+  __m512i accm = _mm512_setzero_si512();
+  __m512i acc_bytes;
+  __m512i accm_bytes;
+  __m512i loader;
+  __m512i loader2;
+  __m512i loader3;
+  __m512i males;
+  __m512i nonmales;
+  __m512i missings;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 8;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_bytes = _mm512_setzero_si512();
+    accm_bytes = _mm512_setzero_si512();
+    do {
+      loader = load_words_avx512(&(lptr[widx]), word_ct - widx);
+      loader2 = _mm512_srli_epi16(loader, 1);
+      loader3 = load_words_avx512(&(include_vec[widx]), word_ct - widx);
+      males = load_words_avx512(&(male_vec[widx]), word_ct - widx);
+      nonmales = andnot_avx512(males, loader3);
+      males = _mm512_and_si512(males, loader3);
+      missings = _mm512_or_si512(_mm512_and_si512(loader, andnot_avx512(loader2, nonmales)), _mm512_and_si512(_mm512_xor_si512(loader, loader2), males));
+      acc_bytes = _mm512_add_epi8(acc_bytes, popcount_bytes_avx512(_mm512_or_si512(_mm512_and_si512(loader2, nonmales), _mm512_slli_epi16(_mm512_and_si512(_mm512_and_si512(loader, loader2), loader3), 1))));
+      accm_bytes = _mm512_add_epi8(accm_bytes, popcount_bytes_avx512(_mm512_or_si512(missings, _mm512_slli_epi16(_mm512_or_si512(males, _mm512_and_si512(missings, nonmales)), 1))));
+      widx += 8;
+    } while (widx < block_end);
+    acc = _mm512_add_epi64(acc, _mm512_sad_epu8(acc_bytes, _mm512_setzero_si512()));
+    accm = _mm512_add_epi64(accm, _mm512_sad_epu8(accm_bytes, _mm512_setzero_si512()));
+  }
+  *set_ctp += hsum_avx512(acc);
+  *missing_ctp += hsum_avx512(accm);
+}
+
+static __attribute__((target("avx512f,avx512bw"))) uintptr_t count_01_avx512(uintptr_t* lptr, uintptr_t word_ct) {
+  __m512i acc = _mm512_setzero_si512();
+  __m512i acc_bytes;
+  __m512i loader;
+  uintptr_t widx = 0;
+  uintptr_t block_end;
+  while (widx < word_ct) {
+    block_end = widx + 31 * 8;
+    if (block_end > word_ct) {
+      block_end = word_ct;
+    }
+    acc_bytes = _mm512_setzero_si512();
+    do {
+      loader = load_words_avx512(&(lptr[widx]), word_ct - widx);
+      acc_bytes = _mm512_add_epi8(acc_bytes, popcount_bytes_avx512(_mm512_and_si512(andnot_avx512(_mm512_srli_epi16(loader, 1), loader), _mm512_set1_epi64(FIVEMASK))));
+      widx += 8;
+    } while (widx < block_end);
+    acc = _mm512_add_epi64(acc, _mm512_sad_epu8(acc_bytes, _mm512_setzero_si512()));
+  }
+  return hsum_avx512(acc);
+}
+#endif
+
 #ifdef __LP64__
 void count_2freq_dbl_60v(__m128i* vptr, __m128i* vend, __m128i* mask1vp, __m128i* mask2vp, uint32_t* ct1abp, uint32_t* ct1cp, uint32_t* ct2abp, uint32_t* ct2cp) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level != SIMD_LEVEL_SSE2) {
+    if (g_simd_level >= SIMD_LEVEL_AVX512) {
+      count_2freq_dbl_avx512((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)mask1vp, (uintptr_t*)mask2vp, ct1abp, ct1cp, ct2abp, ct2cp);
+      return;
+    }
+    count_2freq_dbl_avx2((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)mask1vp, (uintptr_t*)mask2vp, ct1abp, ct1cp, ct2abp, ct2cp);
+    return;
+  }
+#endif
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
   const __m128i m4 = {0x0f0f0f0f0f0f0f0fLLU, 0x0f0f0f0f0f0f0f0fLLU};
   __m128i loader;
@@ -4386,6 +5133,12 @@ void count_2freq_dbl_60v(__m128i* vptr, __m128i* vend, __m128i* mask1vp, __m128i
 }
 
 void count_3freq_120v(__m128i* vptr, __m128i* vend, __m128i* maskvp, uint32_t* even_ctp, uint32_t* odd_ctp, uint32_t* homset_ctp) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level >= SIMD_LEVEL_AVX512) {
+    count_3freq_avx512((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)maskvp, even_ctp, odd_ctp, homset_ctp);
+    return;
+  }
+#endif
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
   const __m128i m4 = {0x0f0f0f0f0f0f0f0fLLU, 0x0f0f0f0f0f0f0f0fLLU};
   __m128i loader;
@@ -4685,6 +5438,16 @@ void count_3freq_12(uintptr_t* lptr, uintptr_t* maskp, uint32_t* ctap, uint32_t*
 
 #ifdef __LP64__
 void count_set_freq_60v(__m128i* vptr, __m128i* vend, __m128i* include_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level != SIMD_LEVEL_SSE2) {
+    if (g_simd_level >= SIMD_LEVEL_AVX512) {
+      count_set_freq_avx512((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)include_vec, set_ctp, missing_ctp);
+      return;
+    }
+    count_set_freq_avx2((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)include_vec, set_ctp, missing_ctp);
+    return;
+  }
+#endif
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
   const __m128i m4 = {0x0f0f0f0f0f0f0f0fLLU, 0x0f0f0f0f0f0f0f0fLLU};
   const __m128i m8 = {0x00ff00ff00ff00ffLLU, 0x00ff00ff00ff00ffLLU};
@@ -4800,6 +5563,16 @@ void count_set_freq_hap_120v(__m128i* vptr, __m128i* vend, __m128i* include_vec,
 }
 
 void count_set_freq_x_60v(__m128i* vptr, __m128i* vend, __m128i* include_vec, __m128i* male_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level != SIMD_LEVEL_SSE2) {
+    if (g_simd_level >= SIMD_LEVEL_AVX512) {
+      count_set_freq_x_avx512((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)include_vec, (uintptr_t*)male_vec, set_ctp, missing_ctp);
+      return;
+    }
+    count_set_freq_x_avx2((uintptr_t*)vptr, (uintptr_t)(vend - vptr) * 2, (uintptr_t*)include_vec, (uintptr_t*)male_vec, set_ctp, missing_ctp);
+    return;
+  }
+#endif
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
   const __m128i m4 = {0x0f0f0f0f0f0f0f0fLLU, 0x0f0f0f0f0f0f0f0fLLU};
   const __m128i m8 = {0x00ff00ff00ff00ffLLU, 0x00ff00ff00ff00ffLLU};
@@ -4943,6 +5716,11 @@ void count_set_freq_y_120v(__m128i* vptr, __m128i* vend, __m128i* include_vec, _
 uintptr_t count_01_vecs(__m128i* vptr, uintptr_t vct) {
   // counts number of aligned 01s (i.e. PLINK missing genotypes) in
   // [vptr, vend).  Assumes number of words in interval is a multiple of 12.
+#ifdef SIMD_DISPATCH
+  if (g_simd_level >= SIMD_LEVEL_AVX512) {
+    return count_01_avx512((uintptr_t*)vptr, vct * 2);
+  }
+#endif
   const __m128i m1 = {FIVEMASK, FIVEMASK};
   const __m128i m2 = {0x3333333333333333LLU, 0x3333333333333333LLU};
   const __m128i m4 = {0x0f0f0f0f0f0f0f0fLLU, 0x0f0f0f0f0f0f0f0fLLU};
@@ -5828,6 +6606,124 @@ void reverse_loadbuf(unsigned char* loadbuf, uintptr_t unfiltered_indiv_ct) {
   }
 }
 
+// At most one .bed file is mapped at a time; bed_seek()/bed_fread() check the
+// FILE* so that other binary files (e.g. --bmerge inputs) are unaffected.
+FILE* g_bed_map_file = NULL;
+unsigned char* g_bed_map = NULL;
+uint64_t g_bed_map_size = 0;
+uint64_t g_bed_map_pos = 0;
+
+uint32_t bed_mmap_init(FILE* bedfile) {
+#ifdef _WIN32
+  return 1;
+#else
+  struct stat statbuf;
+  void* map_ptr;
+  if (fstat(fileno(bedfile), &statbuf) || (!statbuf.st_size)) {
+    return 1;
+  }
+  if ((sizeof(intptr_t) == 4) && (((uint64_t)statbuf.st_size) >= 0x40000000LLU)) {
+    // don't exhaust 32-bit address space
+    return 1;
+  }
+  map_ptr = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fileno(bedfile), 0);
+  if (map_ptr == MAP_FAILED) {
+    return 1;
+  }
+  g_bed_map_file = bedfile;
+  g_bed_map = (unsigned char*)map_ptr;
+  g_bed_map_size = statbuf.st_size;
+  g_bed_map_pos = 0;
+  return 0;
+#endif
+}
+
+void bed_mmap_advise(uint32_t advice) {
+#ifndef _WIN32
+  int32_t madv;
+  if (!g_bed_map) {
+    return;
+  }
+  if (advice == BED_ADVISE_SEQUENTIAL) {
+    madv = MADV_SEQUENTIAL;
+  } else if (advice == BED_ADVISE_RANDOM) {
+    madv = MADV_RANDOM;
+  } else {
+    madv = MADV_NORMAL;
+  }
+  madvise(g_bed_map, g_bed_map_size, madv);
+#endif
+}
+
+void bed_mmap_willneed(uint64_t offset, uint64_t len) {
+#ifndef _WIN32
+  uint64_t start;
+  if ((!g_bed_map) || (offset >= g_bed_map_size)) {
+    return;
+  }
+  if (len > g_bed_map_size - offset) {
+    len = g_bed_map_size - offset;
+  }
+  // madvise() requires a page-aligned start address
+  start = offset & (~((uint64_t)4095));
+  madvise(&(g_bed_map[start]), len + (offset - start), MADV_WILLNEED);
+#endif
+}
+
+void bed_mmap_cleanup() {
+#ifndef _WIN32
+  if (g_bed_map) {
+    munmap(g_bed_map, g_bed_map_size);
+  }
+#endif
+  g_bed_map_file = NULL;
+  g_bed_map = NULL;
+}
+
+int32_t bed_seek(FILE* bedfile, uint64_t offset) {
+  if (bedfile == g_bed_map_file) {
+    if (offset > g_bed_map_size) {
+      return -1;
+    }
+    g_bed_map_pos = offset;
+    return 0;
+  }
+  return fseeko(bedfile, offset, SEEK_SET);
+}
+
+uintptr_t bed_fread(void* buf, uintptr_t len, FILE* bedfile) {
+  if (bedfile == g_bed_map_file) {
+    if (len > g_bed_map_size - g_bed_map_pos) {
+      len = g_bed_map_size - g_bed_map_pos;
+    }
+    memcpy(buf, &(g_bed_map[g_bed_map_pos]), len);
+    g_bed_map_pos += len;
+    return len;
+  }
+  return fread(buf, 1, len, bedfile);
+}
+
+static inline unsigned char* bed_mmap_row(FILE* bedfile, uintptr_t len) {
+  // Returns a pointer into the mapping when the current row (plus word
+  // padding, since the collapse loops read whole words) is addressable, and
+  // advances the cursor past it; returns NULL otherwise.  This lets rows be
+  // collapsed straight out of the page cache.  Rows start at arbitrary byte
+  // offsets, though, so callers may only read one through a uintptr_t* when
+  // bed_mmap_word_aligned() holds; otherwise they copy it into their own
+  // buffer first.
+  unsigned char* retval;
+  if ((bedfile != g_bed_map_file) || ((len + sizeof(intptr_t) - 1) > g_bed_map_size - g_bed_map_pos)) {
+    return NULL;
+  }
+  retval = &(g_bed_map[g_bed_map_pos]);
+  g_bed_map_pos += len;
+  return retval;
+}
+
+static inline uint32_t bed_mmap_word_aligned(unsigned char* mapped_row) {
+  return !(((uintptr_t)mapped_row) % sizeof(intptr_t));
+}
+
 // this will probably be exported later
 static inline void collapse_copy_2bitarr(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t unfiltered_indiv_ct, uint32_t indiv_ct, uintptr_t* indiv_exclude) {
   uintptr_t cur_write = 0;
@@ -5862,10 +6758,19 @@ static inline void collapse_copy_2bitarr(uintptr_t* rawbuf, uintptr_t* mainbuf,
 
 uint32_t load_and_collapse(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_exclude, uint32_t do_reverse) {
   uint32_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+  unsigned char* mapped_row = NULL;
   if (unfiltered_indiv_ct == indiv_ct) {
     rawbuf = mainbuf;
+  } else {
+    mapped_row = bed_mmap_row(bedfile, unfiltered_indiv_ct4);
   }
-  if (fread(rawbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+  if (mapped_row) {
+    if (bed_mmap_word_aligned(mapped_row)) {
+      rawbuf = (uintptr_t*)mapped_row;
+    } else {
+      memcpy(rawbuf, mapped_row, unfiltered_indiv_ct4);
+    }
+  } else if (bed_fread(rawbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
     return RET_READ_FAIL;
   }
   if (unfiltered_indiv_ct != indiv_ct) {
@@ -5910,10 +6815,54 @@ void collapse_copy_2bitarr_incl(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t
 
 uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_include, uint32_t do_reverse) {
   uint32_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+  unsigned char* mapped_row = NULL;
+  if (unfiltered_indiv_ct == indiv_ct) {
+    rawbuf = mainbuf;
+  } else {
+    mapped_row = bed_mmap_row(bedfile, unfiltered_indiv_ct4);
+  }
+  if (mapped_row) {
+    if (bed_mmap_word_aligned(mapped_row)) {
+      rawbuf = (uintptr_t*)mapped_row;
+    } else {
+      memcpy(rawbuf, mapped_row, unfiltered_indiv_ct4);
+    }
+  } else if (bed_fread(rawbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+    return RET_READ_FAIL;
+  }
+  if (unfiltered_indiv_ct != indiv_ct) {
+    collapse_copy_2bitarr_incl(rawbuf, mainbuf, unfiltered_indiv_ct, indiv_ct, indiv_include);
+  }
+  if (do_reverse) {
+    reverse_loadbuf((unsigned char*)mainbuf, indiv_ct);
+  }
+  return 0;
+}
+
+uint32_t load_and_collapse_incl_at(FILE* bedfile, uint64_t offset, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_include, uint32_t do_reverse) {
+  // Like bed_seek() + load_and_collapse_incl(), but leaves the shared file
+  // position alone, so several threads can read rows concurrently.
+  uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+#ifdef _WIN32
+  if (bed_seek(bedfile, offset)) {
+    return RET_READ_FAIL;
+  }
+  return load_and_collapse_incl(bedfile, rawbuf, unfiltered_indiv_ct, mainbuf, indiv_ct, indiv_include, do_reverse);
+#else
   if (unfiltered_indiv_ct == indiv_ct) {
     rawbuf = mainbuf;
   }
-  if (fread(rawbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+  if (bedfile == g_bed_map_file) {
+    if ((offset > g_bed_map_size) || (unfiltered_indiv_ct4 > g_bed_map_size - offset)) {
+      return RET_READ_FAIL;
+    }
+    if ((unfiltered_indiv_ct != indiv_ct) && (unfiltered_indiv_ct4 + sizeof(intptr_t) - 1 <= g_bed_map_size - offset) && bed_mmap_word_aligned(&(g_bed_map[offset]))) {
+      // see bed_mmap_row()
+      rawbuf = (uintptr_t*)(&(g_bed_map[offset]));
+    } else {
+      memcpy(rawbuf, &(g_bed_map[offset]), unfiltered_indiv_ct4);
+    }
+  } else if (pread(fileno(bedfile), rawbuf, unfiltered_indiv_ct4, offset) < (intptr_t)unfiltered_indiv_ct4) {
     return RET_READ_FAIL;
   }
   if (unfiltered_indiv_ct != indiv_ct) {
@@ -5923,6 +6872,7 @@ uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfil
     reverse_loadbuf((unsigned char*)mainbuf, indiv_ct);
   }
   return 0;
+#endif
 }
 
 uint32_t block_load_autosomal(FILE* bedfile, int32_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct_autosomal, uint32_t block_max_size, uintptr_t unfiltered_indiv_ct4, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_weights, unsigned char* readbuf, uint32_t* chrom_fo_idx_ptr, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr, double* set_allele_freq_buf, float* set_allele_freq_buf_fl, uint32_t* wtbuf) {
@@ -5945,7 +6895,7 @@ uint32_t block_load_autosomal(FILE* bedfile, int32_t bed_offset, uintptr_t* mark
   while (markers_read < block_max_size) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	return RET_READ_FAIL;
       }
     }
@@ -5959,12 +6909,12 @@ uint32_t block_load_autosomal(FILE* bedfile, int32_t bed_offset, uintptr_t* mark
 	  break;
 	}
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, chrom_end);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	  return RET_READ_FAIL;
 	}
       }
     }
-    if (fread(&(readbuf[markers_read * unfiltered_indiv_ct4]), 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+    if (bed_fread(&(readbuf[markers_read * unfiltered_indiv_ct4]), unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
       return RET_READ_FAIL;
     }
     if (set_allele_freq_buf) {
@@ -7196,6 +8146,7 @@ int32_t distance_d_write(FILE** outfile_ptr, FILE** outfile2_ptr, FILE** outfile
 	  fflush(stdout);
 	} while (g_pct <= 100);
 	distance_print_done(1, outname, outname_end);
+	g_pct = 1;
       }
       if (write_1mibs_matrix) {
 	dist_ptr = dists;
@@ -7843,6 +8794,28 @@ int32_t spawn_threads(pthread_t* threads, void* (*start_routine)(void*), uintptr
   return 0;
 }
 
+static Thread_arenas* g_touch_arenas;
+
+THREAD_RET_TYPE thread_arenas_touch_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  memset(thread_arena_start(g_touch_arenas, tidx), 0, g_touch_arenas->stride);
+  THREAD_RETURN;
+}
+
+void thread_arenas_touch(pthread_t* threads, Thread_arenas* tap) {
+  // Zeroes every block from its own thread.  Page placement is only a
+  // performance hint, so if threads can't be created, just zero everything
+  // from the main thread.
+  uintptr_t ulii = 0;
+  g_touch_arenas = tap;
+  if (spawn_threads(threads, &thread_arenas_touch_thread, tap->thread_ct)) {
+    memset(tap->base, 0, tap->stride * tap->thread_ct);
+    return;
+  }
+  thread_arenas_touch_thread((void*)ulii);
+  join_threads(threads, tap->thread_ct);
+}
+
 // ----- multithread globals -----
 static double* g_pheno_d;
 static uintptr_t g_jackknife_iters;
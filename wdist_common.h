@@ -14,6 +14,10 @@
 // Uncomment this to build this without CBLAS/CLAPACK.
 // #define NOLAPACK
 
+// Uncomment this to always use the baseline SSE2 popcount kernels, even when
+// the CPU supports AVX2/AVX-512.
+// #define NO_SIMD_DISPATCH
+
 // Uncomment this to prevent all unstable features from being accessible from
 // the command line.
 // #define STABLE_BUILD
@@ -98,6 +102,17 @@ typedef union {
 #define ZEROLU 0LLU
 #define ONELU 1LLU
 
+// The AVX2/AVX-512 kernels are compiled with per-function target attributes,
+// so the binary as a whole still only requires SSE2; simd_level_init() picks
+// the widest supported kernel set at startup.
+#if defined(__x86_64__) && (!defined(NO_SIMD_DISPATCH)) && (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define SIMD_DISPATCH
+#include <immintrin.h>
+#if defined(__clang__) || (__GNUC__ >= 8)
+#define SIMD_VPOPCNT
+#endif
+#endif
+
 #if _WIN32 // i.e. Win64
 
 #ifndef PRIuPTR
@@ -193,6 +208,8 @@ typedef union {
 #define MISC_CMH_BD 0x800000LLU
 #define MISC_CMH2 0x1000000LLU
 #define MISC_LASSO_REPORT_ZEROES 0x2000000LLU
+#define MISC_BED_MMAP 0x4000000LLU
+#define MISC_BGZF 0x8000000LLU
 
 #define CALC_RELATIONSHIP 1LLU
 #define CALC_IBC 2LLU
@@ -229,6 +246,7 @@ typedef union {
 #define CALC_CMH 0x80000000LLU
 #define CALC_HOMOG 0x100000000LLU
 #define CALC_LASSO 0x200000000LLU
+#define CALC_LD_REPORT 0x400000000LLU
 
 // necessary to patch heterozygous haploids/female Y chromosome genotypes
 // during loading?
@@ -295,6 +313,13 @@ typedef union {
 
 #define REL_CALC_SINGLE_PREC 128
 
+// --rel-engine; if neither is set, the engine is chosen by sample size
+#define REL_CALC_ENGINE_BITWISE 256
+#define REL_CALC_ENGINE_GEMM 512
+
+// --make-grm-sparse
+#define REL_CALC_GRM_SPARSE 1024
+
 #define DISTANCE_SQ 1
 #define DISTANCE_SQ0 2
 #define DISTANCE_TRI 3
@@ -308,6 +333,8 @@ typedef union {
 #define DISTANCE_FLAT_MISSING 0x80
 #define DISTANCE_3D 0x100
 #define DISTANCE_CLUSTER 0x200
+// --dist-stats/--dist-stats-update
+#define DISTANCE_STATS 0x400
 
 #define RECODE_12 1
 #define RECODE_TAB 2
@@ -341,6 +368,121 @@ typedef union {
 #define GENOME_NUDGE 0x10
 // separate flag to ensure behavior is unchanged under --unbounded
 #define GENOME_FILTER_PI_HAT 0x20
+#define GENOME_OUTPUT_BIN 0x40
+
+// Binary .genome.bin layout (native byte order, like .grm.bin):
+//   8-byte magic, Genome_bin_header, id_ct null-padded "FID\tIID" slots of
+//   max_id_len bytes (padded to a multiple of 8), then record_ct
+//   Genome_bin_rec entries sorted by (idx1, idx2).  When GENOME_BIN_COMPLETE
+//   is set, every pair is present, so the (i, j) pair (i < j) is record
+//   genome_bin_rec_idx(id_ct, i, j) and the file can be seeked into directly.
+//   Note that this is row-major upper-triangle order, not the lower-triangle
+//   order of tri_coord_no_diag().
+#define GENOME_BIN_MAGIC "WDGENOM1"
+#define GENOME_BIN_COMPLETE 1
+
+typedef struct {
+  uint32_t version;
+  uint32_t id_ct;
+  uint32_t max_id_len;
+  uint32_t flags;
+  uint64_t record_ct;
+} Genome_bin_header;
+
+typedef struct {
+  uint32_t idx1;
+  uint32_t idx2;
+  float z0;
+  float z1;
+  float z2;
+  float pi_hat;
+  float dst;
+  float ppc;
+} Genome_bin_rec;
+
+// --dist-stats .dstat.bin layout (native byte order): 8-byte magic,
+//   Dist_stats_header, then one Dist_stats_rec per pair in lower-triangle row
+//   order ((1,0), (2,0), (2,1), (3,0), ...).  dist is the allele-count
+//   distance summed over markers where both individuals are nonmissing (so IBS
+//   is 1 - dist / (2 * nonmissing)).  Since new individuals only add rows,
+//   --dist-stats-update appends to the file in place.
+#define DIST_STATS_MAGIC "WDDSTAT1"
+
+typedef struct {
+  uint32_t version;
+  uint32_t marker_ct;
+  uint32_t indiv_ct;
+  uint32_t reserved;
+} Dist_stats_header;
+
+typedef struct {
+  uint32_t dist;
+  uint32_t nonmissing;
+} Dist_stats_rec;
+
+// --make-grm-sparse .grm.sparse.bin layout (native byte order): 8-byte magic,
+//   Rel_sparse_header, then one Rel_sparse_rec per stored entry.  Rows are in
+//   order, and within row i the stored columns j <= i are increasing; every
+//   off-diagonal entry above the threshold is present, and so is every
+//   diagonal entry.  The matching .grm.sparse.idx is (indiv_ct + 1) uint64s:
+//   the index of the first entry of each row, followed by entry_ct.
+#define REL_SPARSE_MAGIC "WDGRMSP1"
+
+typedef struct {
+  uint32_t version;
+  uint32_t indiv_ct;
+  double threshold;
+  uint64_t entry_ct;
+} Rel_sparse_header;
+
+typedef struct {
+  uint32_t col;
+  float val;
+} Rel_sparse_rec;
+
+// --r2 bin .ld.bin layout (native byte order): 8-byte magic, Ld_bin_header,
+//   then row_ct fixed-size rows.  Each row is an Ld_bin_row followed by
+//   col_ct r^2 floats, and then col_ct |D'| floats if LD_BIN_DPRIME is set.
+//   Markers are numbered 0..(marker_ct - 1) in .bim order after filtering
+//   (i.e. --write-snplist order); row k's cells are markers first_col,
+//   first_col + 1, etc.  A cell is NaN if it's outside the row's window
+//   (including other chromosomes) or r^2 is undefined there.  Without
+//   --ld-snp[-list], there's one row per marker on chromosomes 1+ and
+//   first_col is always row_marker + 1; otherwise rows are the targets, and
+//   each window is centered on the target.
+#define LD_BIN_MAGIC "WDLDBIN1"
+#define LD_BIN_DPRIME 1
+#define LD_BIN_TARGETS 2
+
+typedef struct {
+  uint32_t version;
+  uint32_t flags;
+  uint32_t row_ct;
+  uint32_t col_ct;
+  uint32_t marker_ct;
+  uint32_t window_size;
+  uint32_t window_bp;
+  uint32_t reserved;
+} Ld_bin_header;
+
+typedef struct {
+  uint32_t row_marker;
+  int32_t first_col;
+} Ld_bin_row;
+
+typedef struct {
+  uint32_t modifier;
+  uint32_t window_size;
+  uint32_t window_bp;
+  double window_r2;
+  char* snpstr;
+  char* snp_list_fname;
+} Ld_info;
+
+#define LD_DPRIME 1
+#define LD_BIN 2
+// any of --ld-window, --ld-window-kb, --ld-window-r2, --ld-snp[-list]
+#define LD_WINDOW_FLAGS 4
 
 #define WRITE_COVAR_PHENO 1
 #define WRITE_COVAR_NO_PARENTS 2
@@ -555,6 +697,18 @@ extern int32_t log_failed;
 extern uintptr_t g_indiv_ct;
 extern uint32_t g_thread_ct;
 
+#define SIMD_LEVEL_SSE2 0
+#define SIMD_LEVEL_AVX2 1
+#define SIMD_LEVEL_AVX512 2
+#define SIMD_LEVEL_AVX512_VPOPCNT 3
+
+extern uint32_t g_simd_level;
+extern const char* g_simd_level_names[];
+
+// Sets g_simd_level to the widest kernel set supported by both the CPU and
+// this build, capped at max_level.
+uint32_t simd_level_init(uint32_t max_level);
+
 typedef struct ll_str_struct {
   struct ll_str_struct* next;
   char ss[];
@@ -646,6 +800,22 @@ extern uintptr_t wkspace_left;
 
 unsigned char* wkspace_alloc(uintptr_t size);
 
+// --memory-backing modifiers
+#define WKSPACE_BACKING_THP 1
+#define WKSPACE_BACKING_HUGETLB 2
+#define WKSPACE_BACKING_INTERLEAVE 4
+
+// Allocates the block underlying the main workspace.  With no backing
+// modifiers this is a plain malloc; otherwise (Linux only) it's an anonymous
+// mapping, with huge pages and/or NUMA interleaving applied where possible.
+// Either way, release it with wkspace_backing_free().
+unsigned char* wkspace_backing_alloc(uintptr_t size, uint32_t backing_modifier);
+
+void wkspace_backing_free(unsigned char* wkspace_ua);
+
+// Logs what wkspace_backing_alloc() actually obtained.
+void wkspace_backing_log(uint32_t backing_modifier);
+
 static inline int32_t wkspace_alloc_c_checked(char** dc_ptr, uintptr_t size) {
   *dc_ptr = (char*)wkspace_alloc(size);
   return (*dc_ptr)? 0 : 1;
@@ -691,6 +861,39 @@ static inline int32_t wkspace_alloc_ull_checked(uint64_t** ullp_ptr, uintptr_t s
   return (*ullp_ptr)? 0 : 1;
 }
 
+// Per-thread scratch arenas, carved out of the workspace stack.  Each thread
+// gets one block; blocks start on a cacheline boundary (and on a page
+// boundary once they're at least THREAD_ARENA_PAGE_MIN bytes), so threads
+// never share a line.  thread_arenas_touch() has each block zeroed by the
+// thread with the same index, so under the usual first-touch policy its pages
+// end up on that thread's NUMA node instead of the main thread's.
+#define THREAD_ARENA_PAGE 4096
+#define THREAD_ARENA_PAGE_MIN (16 * THREAD_ARENA_PAGE)
+
+typedef struct {
+  unsigned char* base;
+  uintptr_t stride;
+  uint32_t thread_ct;
+} Thread_arenas;
+
+// worst-case bytes wkspace_alloc_thread_arenas() reserves beyond
+// thread_ct * CACHEALIGN(per_thread_size)
+#define THREAD_ARENA_SLACK(thread_ct) (((uintptr_t)(thread_ct)) * THREAD_ARENA_PAGE)
+
+int32_t wkspace_alloc_thread_arenas(Thread_arenas* tap, uintptr_t per_thread_size, uint32_t thread_ct);
+
+static inline unsigned char* thread_arena_start(Thread_arenas* tap, uint32_t tidx) {
+  return &(tap->base[tidx * tap->stride]);
+}
+
+// bump allocation within a single block; caller is responsible for sizing
+// the block as the sum of CACHEALIGN(size) over all its buffers
+static inline unsigned char* thread_arena_alloc(unsigned char** arena_ptr, uintptr_t size) {
+  unsigned char* retval = *arena_ptr;
+  *arena_ptr += CACHEALIGN(size);
+  return retval;
+}
+
 void wkspace_reset(void* new_base);
 
 static inline unsigned char* top_alloc(uintptr_t* topsize_ptr, uint32_t size) {
@@ -797,6 +1000,8 @@ static inline uint32_t scan_double(char* ss, double* valp) {
   return (ss == ss2)? 1 : 0;
 }
 
+uint32_t scan_double_fast(char* ss, double* valp);
+
 uint32_t scan_two_doubles(char* ss, double* val1p, double* val2p);
 
 static inline char* memseta(char* target, const unsigned char val, uintptr_t ct) {
@@ -1079,6 +1284,12 @@ static inline uint32_t tri_coord_no_diag_32(uint32_t small_coord, uint32_t big_c
   return ((big_coord * (big_coord - 1)) / 2) + small_coord;
 }
 
+static inline uint64_t genome_bin_rec_idx(uint64_t id_ct, uint64_t idx1, uint64_t idx2) {
+  // position of the (idx1, idx2) record in a complete .genome.bin file;
+  // idx1 < idx2 < id_ct
+  return ((idx1 * (2 * id_ct - idx1 - 1)) / 2) + (idx2 - idx1 - 1);
+}
+
 // let the compiler worry about the second argument's bit width here
 #define SET_BIT(aa, bb) (aa[(bb) / BITCT] |= ONELU << ((bb) % BITCT))
 
@@ -1507,10 +1718,20 @@ int32_t eval_affection(char* bufptr, int32_t missing_pheno, uint32_t missing_phe
 
 uint32_t triangle_divide(int64_t cur_prod, int32_t modif);
 
+void parallel_bounds(uint32_t ct, int32_t start, uint32_t parallel_idx, uint32_t parallel_tot, int32_t* bound_start_ptr, int32_t* bound_end_ptr);
+
+void triangle_fill_range(uint32_t* target_arr, uint32_t ct, uint32_t pieces, int32_t lbound, int32_t ubound, uint32_t start, uint32_t align);
+
 void triangle_fill(uint32_t* target_arr, uint32_t ct, uint32_t pieces, uint32_t parallel_idx, uint32_t parallel_tot, uint32_t start, uint32_t align);
 
 int32_t write_ids(char* outname, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len);
 
+void part_fname_write(char* part_fname, char* outname, char* outname_end, const char* ext, uint32_t part_idx);
+
+int32_t fappend_file(const char* fname, FILE* outfile);
+
+int32_t append_part_file(char* outname, char* outname_end, const char* ext, uint32_t part_idx, uint32_t is_first);
+
 int32_t distance_d_write_ids(char* outname, char* outname_end, uint32_t dist_calc_type, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, char* person_ids, uintptr_t max_person_id_len);
 
 int32_t relationship_req(uint64_t calculation_type);
@@ -1584,6 +1805,91 @@ static inline uint32_t popcount_long(uintptr_t val) {
   return popcount2_long(val - ((val >> 1) & FIVEMASK));
 }
 
+#ifdef SIMD_DISPATCH
+// Building blocks for the AVX2 and AVX-512 kernels.  Genotype buffers are only
+// guaranteed to be 16-byte aligned, so unaligned loads are used throughout,
+// and a trailing partial vector is handled with a masked load instead of
+// reading past the end of the buffer.
+//
+// Popcounts are evaluated with a 4-bit lookup table (vpshufb) followed by
+// vpsadbw, which leaves 64-bit partial sums.  popcount_bytes_...() skips the
+// vpsadbw step; each byte is <= 8, so up to 31 of these can be summed with
+// 8-bit adds before flushing.  The popcount2 variants sum 2-bit integers
+// instead of bits; their lookup table maps each nibble to the sum of its two
+// 2-bit fields.
+static inline __attribute__((target("avx2"))) __m256i load_words_avx2(uintptr_t* lptr, uintptr_t word_ct) {
+  if (word_ct >= 4) {
+    return _mm256_loadu_si256((__m256i*)lptr);
+  }
+  return _mm256_maskload_epi64((long long*)lptr, _mm256_cmpgt_epi64(_mm256_set1_epi64x(word_ct), _mm256_setr_epi64x(0, 1, 2, 3)));
+}
+
+static inline __attribute__((target("avx2"))) __m256i popcount_bytes_avx2(__m256i vv) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i m4 = _mm256_set1_epi8(15);
+  __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(vv, m4));
+  __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi64(vv, 4), m4));
+  return _mm256_add_epi8(lo, hi);
+}
+
+static inline __attribute__((target("avx2"))) __m256i popcount_avx2(__m256i vv) {
+  return _mm256_sad_epu8(popcount_bytes_avx2(vv), _mm256_setzero_si256());
+}
+
+static inline __attribute__((target("avx2"))) __m256i popcount2_avx2(__m256i vv) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6, 0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6);
+  const __m256i m4 = _mm256_set1_epi8(15);
+  __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(vv, m4));
+  __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi64(vv, 4), m4));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+static inline __attribute__((target("avx2"))) uintptr_t hsum_avx2(__m256i vv) {
+  __m128i ww = _mm_add_epi64(_mm256_castsi256_si128(vv), _mm256_extracti128_si256(vv, 1));
+  return (uintptr_t)(_mm_cvtsi128_si64(ww) + _mm_extract_epi64(ww, 1));
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) __m512i load_words_avx512(uintptr_t* lptr, uintptr_t word_ct) {
+  if (word_ct >= 8) {
+    return _mm512_loadu_si512(lptr);
+  }
+  return _mm512_maskz_loadu_epi64((__mmask8)((1U << word_ct) - 1), lptr);
+}
+
+// Same lookup tables as the AVX2 versions, packed into 64-bit lanes.
+static inline __attribute__((target("avx512f,avx512bw"))) __m512i popcount_bytes_avx512(__m512i vv) {
+  const __m512i lookup = _mm512_set4_epi64(0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL);
+  const __m512i m4 = _mm512_set1_epi8(15);
+  __m512i lo = _mm512_shuffle_epi8(lookup, _mm512_and_si512(vv, m4));
+  __m512i hi = _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(vv, 4), m4));
+  return _mm512_add_epi8(lo, hi);
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) __m512i popcount_avx512(__m512i vv) {
+  return _mm512_sad_epu8(popcount_bytes_avx512(vv), _mm512_setzero_si512());
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) __m512i popcount2_avx512(__m512i vv) {
+  const __m512i lookup = _mm512_set4_epi64(0x0605040305040302LL, 0x0403020103020100LL, 0x0605040305040302LL, 0x0403020103020100LL);
+  const __m512i m4 = _mm512_set1_epi8(15);
+  __m512i lo = _mm512_shuffle_epi8(lookup, _mm512_and_si512(vv, m4));
+  __m512i hi = _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(vv, 4), m4));
+  return _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512());
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) __m512i andnot_avx512(__m512i aa, __m512i bb) {
+  // _mm512_andnot_si512() and _mm512_srli_epi64() trip a spurious
+  // -Wmaybe-uninitialized in GCC 12; the zero-masked form doesn't.
+  return _mm512_maskz_andnot_epi64(0xff, aa, bb);
+}
+
+static inline __attribute__((target("avx512f,avx512bw"))) uintptr_t hsum_avx512(__m512i vv) {
+  uintptr_t partial_sums[8];
+  _mm512_storeu_si512(partial_sums, vv);
+  return partial_sums[0] + partial_sums[1] + partial_sums[2] + partial_sums[3] + partial_sums[4] + partial_sums[5] + partial_sums[6] + partial_sums[7];
+}
+#endif
+
 uintptr_t popcount_longs(uintptr_t* lptr, uintptr_t start_idx, uintptr_t end_idx);
 
 uintptr_t popcount_bit_idx(uintptr_t* lptr, uintptr_t start_idx, uintptr_t end_idx);
@@ -1648,6 +1954,27 @@ void count_genders(uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t unfiltered_
 
 void reverse_loadbuf(unsigned char* loadbuf, uintptr_t unfiltered_indiv_ct);
 
+// Optional memory-mapped .bed access (--bed-mmap).  Once bed_mmap_init() has
+// succeeded, bed_seek() and bed_fread() on that FILE* address the mapping
+// directly instead of going through stdio, and load_and_collapse{_incl}()
+// collapse straight from the mapped row.  On any other FILE*, they fall
+// through to fseeko()/fread().
+#define BED_ADVISE_NORMAL 0
+#define BED_ADVISE_SEQUENTIAL 1
+#define BED_ADVISE_RANDOM 2
+
+uint32_t bed_mmap_init(FILE* bedfile);
+
+void bed_mmap_advise(uint32_t advice);
+
+void bed_mmap_willneed(uint64_t offset, uint64_t len);
+
+void bed_mmap_cleanup();
+
+int32_t bed_seek(FILE* bedfile, uint64_t offset);
+
+uintptr_t bed_fread(void* buf, uintptr_t len, FILE* bedfile);
+
 // void collapse_copy_2bitarr(uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_exclude);
 
 uint32_t load_and_collapse(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_exclude, uint32_t do_reverse);
@@ -1656,6 +1983,8 @@ void collapse_copy_2bitarr_incl(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t
 
 uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_include, uint32_t do_reverse);
 
+uint32_t load_and_collapse_incl_at(FILE* bedfile, uint64_t offset, uintptr_t* rawbuf, uint32_t unfiltered_indiv_ct, uintptr_t* mainbuf, uint32_t indiv_ct, uintptr_t* indiv_include, uint32_t do_reverse);
+
 uint32_t block_load_autosomal(FILE* bedfile, int32_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct_autosomal, uint32_t block_max_size, uintptr_t unfiltered_indiv_ct4, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_weights, unsigned char* readbuf, uint32_t* chrom_fo_idx_ptr, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr, double* set_allele_freq_buf, float* set_allele_freq_buf_fl, uint32_t* wtbuf);
 
 void vec_include_init(uintptr_t unfiltered_indiv_ct, uintptr_t* new_include2, uintptr_t* old_include);
@@ -1766,6 +2095,8 @@ int32_t spawn_threads(pthread_t* threads, unsigned (__stdcall *start_routine)(vo
 int32_t spawn_threads(pthread_t* threads, void* (*start_routine)(void*), uintptr_t ct);
 #endif
 
+void thread_arenas_touch(pthread_t* threads, Thread_arenas* tap);
+
 int32_t regress_distance(uint64_t calculation_type, double* dists_local, double* pheno_d_local, uintptr_t unfiltered_indiv_ct, uintptr_t* indiv_exclude, uintptr_t indiv_ct, uint32_t thread_ct, uintptr_t regress_iters, uint32_t regress_d);
 
 typedef struct {
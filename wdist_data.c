@@ -4,6 +4,7 @@
 #ifndef _WIN32
 #include <sys/mman.h>
 #include <unistd.h>
+#include "yarn.h"
 #endif
 
 #include <sys/stat.h>
@@ -245,6 +246,157 @@ int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr
   return RET_CALC_NOT_YET_SUPPORTED;
 }
 #else
+// Individual-major -> SNP-major transposition.  The input is viewed as a
+// matrix of 2-bit genotypes with one row per individual; it is cut into
+// tile columns of IMT_STRIPE_BYTES input bytes (4x as many markers), each
+// thread transposes a contiguous range of tile columns
+// IMT_TILE_INDIV_CT individuals at a time (so the output tile stays in L2),
+// and the main thread writes each completed superblock of markers.
+#define IMT_STRIPE_BYTES 64
+#define IMT_TILE_INDIV_CT 1024
+
+static unsigned char* g_imt_in;
+static unsigned char* g_imt_out;
+static uintptr_t g_imt_in_stride;
+static uintptr_t g_imt_out_stride;
+static uintptr_t g_imt_indiv_ct;
+static uintptr_t g_imt_marker_ct;
+static uintptr_t g_imt_byte_start;
+static uintptr_t g_imt_byte_end;
+static uint32_t g_imt_thread_ct;
+
+static inline uint32_t transpose_2bit_4x4(uint32_t uii) {
+  // byte i, bits 2j..2j+1 <-> byte j, bits 2i..2i+1
+  uint32_t ujj = (uii ^ (uii >> 6)) & 0x00cc00cc;
+  uii ^= ujj ^ (ujj << 6);
+  ujj = (uii ^ (uii >> 12)) & 0x0000f0f0;
+  return uii ^ ujj ^ (ujj << 12);
+}
+
+void imt_transpose_tile(uintptr_t byte_start, uintptr_t byte_end, uintptr_t indiv_start, uintptr_t indiv_end) {
+  // indiv_start must be a multiple of 4.
+  uintptr_t in_stride = g_imt_in_stride;
+  uintptr_t out_stride = g_imt_out_stride;
+  uintptr_t indiv_ct = g_imt_indiv_ct;
+  uintptr_t marker_ct = g_imt_marker_ct;
+  // output row of marker 4 * byte_idx + j is
+  // out_base[(4 * byte_idx + j) * out_stride]
+  unsigned char* out_base = &(g_imt_out[-((intptr_t)(4 * g_imt_byte_start * out_stride))]);
+  unsigned char* in_rows[4];
+  unsigned char* out_ptr;
+  uintptr_t indiv_idx;
+  uintptr_t group_idx;
+  uintptr_t byte_idx;
+  uint32_t row_ct;
+  uint32_t marker_ct_rem;
+  uint32_t uii;
+  uint32_t ujj;
+#ifdef __LP64__
+  const __m128i m6 = {0x00cc00cc00cc00ccLLU, 0x00cc00cc00cc00ccLLU};
+  const __m128i m12 = {0x0000f0f00000f0f0LLU, 0x0000f0f00000f0f0LLU};
+  __m128i vv[4];
+  __m128i ww[4];
+  __m128i vtmp;
+  uint32_t* uiptr;
+  uint32_t ukk;
+  // markers past the end of the last byte never get a vector pass
+  uintptr_t vec_byte_end = marker_ct / 4;
+  if (vec_byte_end > byte_end) {
+    vec_byte_end = byte_end;
+  }
+#endif
+  for (indiv_idx = indiv_start; indiv_idx < indiv_end; indiv_idx += 4) {
+    group_idx = indiv_idx / 4;
+    row_ct = indiv_ct - indiv_idx;
+    if (row_ct > 4) {
+      row_ct = 4;
+    }
+    for (uii = 0; uii < row_ct; uii++) {
+      in_rows[uii] = &(g_imt_in[(indiv_idx + uii) * in_stride]);
+    }
+    byte_idx = byte_start;
+#ifdef __LP64__
+    if (row_ct == 4) {
+      for (; byte_idx + 16 <= vec_byte_end; byte_idx += 16) {
+	vv[0] = _mm_loadu_si128((__m128i*)(&(in_rows[0][byte_idx])));
+	vv[1] = _mm_loadu_si128((__m128i*)(&(in_rows[1][byte_idx])));
+	vv[2] = _mm_loadu_si128((__m128i*)(&(in_rows[2][byte_idx])));
+	vv[3] = _mm_loadu_si128((__m128i*)(&(in_rows[3][byte_idx])));
+	ww[0] = _mm_unpacklo_epi8(vv[0], vv[1]);
+	ww[1] = _mm_unpackhi_epi8(vv[0], vv[1]);
+	ww[2] = _mm_unpacklo_epi8(vv[2], vv[3]);
+	ww[3] = _mm_unpackhi_epi8(vv[2], vv[3]);
+	// 32-bit lane k of vv[] now holds input byte byte_idx + k of all four
+	// rows
+	vv[0] = _mm_unpacklo_epi16(ww[0], ww[2]);
+	vv[1] = _mm_unpackhi_epi16(ww[0], ww[2]);
+	vv[2] = _mm_unpacklo_epi16(ww[1], ww[3]);
+	vv[3] = _mm_unpackhi_epi16(ww[1], ww[3]);
+	for (uii = 0; uii < 4; uii++) {
+	  vtmp = _mm_and_si128(_mm_xor_si128(vv[uii], _mm_srli_epi32(vv[uii], 6)), m6);
+	  vv[uii] = _mm_xor_si128(vv[uii], _mm_xor_si128(vtmp, _mm_slli_epi32(vtmp, 6)));
+	  vtmp = _mm_and_si128(_mm_xor_si128(vv[uii], _mm_srli_epi32(vv[uii], 12)), m12);
+	  vv[uii] = _mm_xor_si128(vv[uii], _mm_xor_si128(vtmp, _mm_slli_epi32(vtmp, 12)));
+	}
+	uiptr = (uint32_t*)vv;
+	out_ptr = &(out_base[4 * byte_idx * out_stride + group_idx]);
+	for (uii = 0; uii < 16; uii++) {
+	  ukk = *uiptr++;
+	  out_ptr[0] = (unsigned char)ukk;
+	  out_ptr[out_stride] = (unsigned char)(ukk >> 8);
+	  out_ptr[2 * out_stride] = (unsigned char)(ukk >> 16);
+	  out_ptr[3 * out_stride] = (unsigned char)(ukk >> 24);
+	  out_ptr = &(out_ptr[4 * out_stride]);
+	}
+      }
+    }
+#endif
+    for (; byte_idx < byte_end; byte_idx++) {
+      ujj = 0;
+      for (uii = 0; uii < row_ct; uii++) {
+	ujj |= ((uint32_t)in_rows[uii][byte_idx]) << (8 * uii);
+      }
+      ujj = transpose_2bit_4x4(ujj);
+      marker_ct_rem = marker_ct - 4 * byte_idx;
+      if (marker_ct_rem > 4) {
+	marker_ct_rem = 4;
+      }
+      out_ptr = &(out_base[4 * byte_idx * out_stride + group_idx]);
+      for (uii = 0; uii < marker_ct_rem; uii++) {
+	*out_ptr = (unsigned char)(ujj >> (8 * uii));
+	out_ptr = &(out_ptr[out_stride]);
+      }
+    }
+  }
+}
+
+THREAD_RET_TYPE imt_transpose_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t stripe_ct = (g_imt_byte_end - g_imt_byte_start + IMT_STRIPE_BYTES - 1) / IMT_STRIPE_BYTES;
+  uintptr_t stripe_idx = (tidx * stripe_ct) / g_imt_thread_ct;
+  uintptr_t stripe_end = ((tidx + 1) * stripe_ct) / g_imt_thread_ct;
+  uintptr_t indiv_ct = g_imt_indiv_ct;
+  uintptr_t byte_start;
+  uintptr_t byte_end;
+  uintptr_t indiv_idx;
+  uintptr_t indiv_end;
+  for (; stripe_idx < stripe_end; stripe_idx++) {
+    byte_start = g_imt_byte_start + stripe_idx * IMT_STRIPE_BYTES;
+    byte_end = byte_start + IMT_STRIPE_BYTES;
+    if (byte_end > g_imt_byte_end) {
+      byte_end = g_imt_byte_end;
+    }
+    for (indiv_idx = 0; indiv_idx < indiv_ct; indiv_idx = indiv_end) {
+      indiv_end = indiv_idx + IMT_TILE_INDIV_CT;
+      if (indiv_end > indiv_ct) {
+	indiv_end = indiv_ct;
+      }
+      imt_transpose_tile(byte_start, byte_end, indiv_idx, indiv_end);
+    }
+  }
+  THREAD_RETURN;
+}
+
 int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr_t unfiltered_marker_ct) {
   // This implementation only handles large files on 64-bit Unix systems; a
   // more portable version needs to be written for Windows and 32-bit Unix.
@@ -252,20 +404,18 @@ int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr
   int32_t in_fd = open(indiv_major_fname, O_RDONLY);
   unsigned char* in_contents = (unsigned char*)MAP_FAILED;
   uintptr_t unfiltered_marker_ct4 = (unfiltered_marker_ct + 3) / 4;
+  pthread_t threads[MAX_THREADS];
   struct stat sb;
-  unsigned char* icoff;
   int32_t retval;
   uintptr_t indiv_ct;
   uintptr_t indiv_ct4;
-  uintptr_t indiv_ct4l;
   uintptr_t max_4blocks_in_mem;
   uintptr_t superblock_offset;
-  uint32_t block_last_marker;
+  uintptr_t superblock_end;
+  uintptr_t block_marker_ct;
+  uintptr_t stripe_ct;
+  uintptr_t ulii;
   uint32_t uii;
-  uint32_t add_val;
-  uint32_t rshift_val;
-  uint32_t ujj;
-  unsigned char* write_ptr;
   if (in_fd == -1) {
     sprintf(logbuf, errstr_fopen, indiv_major_fname);
     logprintb();
@@ -289,49 +439,61 @@ int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr
   } else {
     uii = 0;
   }
-  icoff = &(in_contents[uii]);
+  g_imt_in = &(in_contents[uii]);
   if ((sb.st_size - uii) % unfiltered_marker_ct4) {
     goto indiv_major_to_snp_major_ret_INVALID_FORMAT;
   }
   if (fwrite_checked("l\x1b\x01", 3, outfile)) {
     goto indiv_major_to_snp_major_ret_WRITE_FAIL;
   }
-  indiv_ct = sb.st_size / unfiltered_marker_ct4;
-  indiv_ct4l = indiv_ct / 4;
+  indiv_ct = (sb.st_size - uii) / unfiltered_marker_ct4;
   indiv_ct4 = (indiv_ct + 3) / 4;
   // 4 * indiv_ct4 bytes needed per 4-marker block
   max_4blocks_in_mem = wkspace_left / (4 * indiv_ct4);
+  if (!max_4blocks_in_mem) {
+    goto indiv_major_to_snp_major_ret_NOMEM;
+  }
+  g_imt_out = wkspace_base;
+  g_imt_in_stride = unfiltered_marker_ct4;
+  g_imt_out_stride = indiv_ct4;
+  g_imt_indiv_ct = indiv_ct;
+  g_imt_marker_ct = unfiltered_marker_ct;
   superblock_offset = 0;
   while (superblock_offset < unfiltered_marker_ct4) {
-    block_last_marker = unfiltered_marker_ct - (superblock_offset * 4);
-    if (block_last_marker > (max_4blocks_in_mem * 4)) {
-      block_last_marker = max_4blocks_in_mem * 4;
+    superblock_end = superblock_offset + max_4blocks_in_mem;
+    if (superblock_end > unfiltered_marker_ct4) {
+      superblock_end = unfiltered_marker_ct4;
     }
-    write_ptr = wkspace_base;
-    for (uii = 0; uii < block_last_marker; uii++) {
-      rshift_val = (uii % 4) * 2;
-      add_val = uii / 4;
-      for (ujj = 0; ujj < indiv_ct4l; ujj++) {
-        *write_ptr++ = ((icoff[4 * ujj * unfiltered_marker_ct4 + add_val] >> rshift_val) & 3) + (((icoff[(4 * ujj + 1) * unfiltered_marker_ct4 + add_val] >> rshift_val) & 3) << 2) + (((icoff[(4 * ujj + 2) * unfiltered_marker_ct4 + add_val] >> rshift_val) & 3) << 4) + (((icoff[(4 * ujj + 3) * unfiltered_marker_ct4 + add_val] >> rshift_val) & 3) << 6);
-      }
-      if (indiv_ct % 4) {
-	*write_ptr = 0;
-	for (ujj = 0; ujj < (indiv_ct % 4); ujj++) {
-	  *write_ptr |= ((icoff[(ujj + indiv_ct) * unfiltered_marker_ct4 + add_val] >> rshift_val) & 3) << (ujj * 2);
-	}
-	write_ptr++;
-      }
+    block_marker_ct = unfiltered_marker_ct - (superblock_offset * 4);
+    if (block_marker_ct > (superblock_end - superblock_offset) * 4) {
+      block_marker_ct = (superblock_end - superblock_offset) * 4;
     }
-    if (fwrite_checked(wkspace_base, ((int64_t)block_last_marker) * indiv_ct4, outfile)) {
+    g_imt_byte_start = superblock_offset;
+    g_imt_byte_end = superblock_end;
+    stripe_ct = (superblock_end - superblock_offset + IMT_STRIPE_BYTES - 1) / IMT_STRIPE_BYTES;
+    g_imt_thread_ct = g_thread_ct;
+    if (g_imt_thread_ct > stripe_ct) {
+      g_imt_thread_ct = stripe_ct;
+    }
+    if (spawn_threads(threads, &imt_transpose_thread, g_imt_thread_ct)) {
+      goto indiv_major_to_snp_major_ret_THREAD_CREATE_FAIL;
+    }
+    ulii = 0;
+    imt_transpose_thread((void*)ulii);
+    join_threads(threads, g_imt_thread_ct);
+    if (fwrite_checked(wkspace_base, ((uint64_t)block_marker_ct) * indiv_ct4, outfile)) {
       goto indiv_major_to_snp_major_ret_WRITE_FAIL;
     }
-    superblock_offset += max_4blocks_in_mem;
+    superblock_offset = superblock_end;
   }
   if (fclose_null(&outfile)) {
     goto indiv_major_to_snp_major_ret_WRITE_FAIL;
   }
   retval = 0;
   while (0) {
+  indiv_major_to_snp_major_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
   indiv_major_to_snp_major_ret_INVALID_FORMAT:
     sprintf(logbuf, "Error: %s's file size is inconsistent with the marker count.\n", indiv_major_fname);
     logprintb();
@@ -346,6 +508,10 @@ int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr
   indiv_major_to_snp_major_ret_READ_FAIL:
     retval = RET_READ_FAIL;
     break;
+  indiv_major_to_snp_major_ret_THREAD_CREATE_FAIL:
+    logprint(errstr_thread_create);
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   }
   fclose_cond(outfile);
   if (in_contents != MAP_FAILED) {
@@ -358,6 +524,291 @@ int32_t indiv_major_to_snp_major(char* indiv_major_fname, char* outname, uintptr
 
 const char errstr_map_format[] = "Error: Improperly formatted .map file.\n";
 
+static inline uint32_t sf_out_of_range(uint32_t cur_pos, uint32_t chrom_idx, uint32_t* sf_start_idxs, uint32_t* sf_pos) {
+  uint32_t cur_idx = sf_start_idxs[chrom_idx];
+  uint32_t end_idx = sf_start_idxs[chrom_idx + 1];
+  while (cur_idx < end_idx) {
+    if ((cur_pos >= sf_pos[cur_idx]) && (cur_pos <= sf_pos[cur_idx + 1])) {
+      return 0;
+    }
+    cur_idx += 2;
+  }
+  return 1;
+}
+
+// Second pass of load_map() and load_bim(), parallelized.  The file is read
+// in large blocks which end at line boundaries; the main thread locates the
+// nonempty, noncomment lines, worker threads parse disjoint line ranges
+// straight into marker_ids/marker_pos/marker_alleles, and the caller then
+// replays the order-dependent bookkeeping (chromosome boundaries, sortedness,
+// exclusion counts) line by line.  Since every line before the first bad one
+// is fully parsed, the caller still reports the first bad line.
+
+// per-line parse results
+#define MARKER_PARSE_INCLUDE 0
+// excluded before the position column was examined
+#define MARKER_PARSE_SKIP_NOPOS 1
+// excluded by a position filter; position still matters for sortedness
+#define MARKER_PARSE_SKIP_POS 2
+#define MARKER_PARSE_ERR_CHROM 3
+#define MARKER_PARSE_ERR_FORMAT 4
+#define MARKER_PARSE_ERR_CM 5
+// flag: a (possibly zero) centimorgan value was stored in g_mp_cms
+#define MARKER_PARSE_CM_SET 0x80
+
+#define MARKER_PARSE_BLOCK_MAX 16777216
+// don't bother spawning another thread for fewer lines than this
+#define MARKER_PARSE_MIN_LINES_PER_THREAD 16384
+
+static char* g_mp_buf;
+static uintptr_t g_mp_buf_size;
+static uintptr_t g_mp_buf_len;
+static uintptr_t g_mp_buf_offset;
+static uint32_t g_mp_eof;
+static uint32_t g_mp_line_max;
+static uint32_t g_mp_line_ct;
+static uint32_t g_mp_thread_ct;
+static uintptr_t g_mp_marker_uidx_base;
+static char** g_mp_line_starts;
+static int32_t* g_mp_chroms;
+static uint32_t* g_mp_pos;
+static double* g_mp_cms;
+static unsigned char* g_mp_status;
+
+static Chrom_info* g_mp_chrom_info_ptr;
+static uint32_t g_mp_pos_skip;
+static char* g_mp_marker_ids;
+static uintptr_t g_mp_max_marker_id_len;
+static uint32_t* g_mp_marker_pos;
+static char* g_mp_marker_alleles;
+static uintptr_t g_mp_max_marker_allele_len;
+static uint32_t g_mp_sf_ct;
+static uint32_t* g_mp_sf_start_idxs;
+static uint32_t* g_mp_sf_pos;
+static uint32_t g_mp_exclude_snp;
+static uint32_t g_mp_snp_chrom;
+static int32_t g_mp_marker_pos_start;
+static int32_t g_mp_marker_pos_end;
+static int32_t g_mp_exclude_window_start;
+static int32_t g_mp_exclude_window_end;
+
+int32_t marker_parse_init(uintptr_t* topsize_ptr, uint32_t cms_needed) {
+  // Allocates the temporary buffers from the top of the workspace, and resets
+  // the filter parameters (load_bim() sets them afterward).
+  uintptr_t per_line_bytes = sizeof(intptr_t) + sizeof(int32_t) * 2 + 1 + (cms_needed? sizeof(double) : 0);
+  uintptr_t buf_size = MARKER_PARSE_BLOCK_MAX;
+  uintptr_t avail = wkspace_left - *topsize_ptr;
+  // each line is at least two bytes, but typical lines are far longer, so
+  // budget one line slot per 16 bytes and just process oversized line counts
+  // in multiple batches
+  if (buf_size + (buf_size / 16) * per_line_bytes + 256 > avail) {
+    buf_size = ((avail - 256) / (16 + per_line_bytes)) * 16;
+    if (buf_size < 4 * MAXLINELEN) {
+      return 1;
+    }
+  }
+  g_mp_line_max = buf_size / 16;
+  g_mp_buf = (char*)top_alloc(topsize_ptr, buf_size + 1);
+  g_mp_line_starts = (char**)top_alloc(topsize_ptr, g_mp_line_max * sizeof(intptr_t));
+  g_mp_chroms = (int32_t*)top_alloc(topsize_ptr, g_mp_line_max * sizeof(int32_t));
+  g_mp_pos = (uint32_t*)top_alloc(topsize_ptr, g_mp_line_max * sizeof(int32_t));
+  g_mp_status = (unsigned char*)top_alloc(topsize_ptr, g_mp_line_max);
+  g_mp_cms = NULL;
+  if (cms_needed) {
+    g_mp_cms = (double*)top_alloc(topsize_ptr, g_mp_line_max * sizeof(double));
+  }
+  if (!g_mp_status) {
+    return 1;
+  }
+  if (cms_needed && (!g_mp_cms)) {
+    return 1;
+  }
+  g_mp_buf_size = buf_size;
+  g_mp_buf_len = 0;
+  g_mp_buf_offset = 0;
+  g_mp_eof = 0;
+  g_mp_marker_pos = NULL;
+  g_mp_marker_alleles = NULL;
+  g_mp_sf_ct = 0;
+  g_mp_exclude_snp = 0;
+  g_mp_marker_pos_start = -1;
+  return 0;
+}
+
+THREAD_RET_TYPE marker_parse_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uint32_t line_idx = (((uint64_t)tidx) * g_mp_line_ct) / g_mp_thread_ct;
+  uint32_t line_end = (((uint64_t)tidx + 1) * g_mp_line_ct) / g_mp_thread_ct;
+  uintptr_t marker_uidx = g_mp_marker_uidx_base + line_idx;
+  Chrom_info* chrom_info_ptr = g_mp_chrom_info_ptr;
+  uintptr_t* chrom_mask = chrom_info_ptr->chrom_mask;
+  uintptr_t max_marker_id_len = g_mp_max_marker_id_len;
+  uintptr_t max_marker_allele_len = g_mp_max_marker_allele_len;
+  char* marker_alleles = g_mp_marker_alleles;
+  double* cms = g_mp_cms;
+  uint32_t pos_skip = g_mp_pos_skip;
+  int32_t marker_pos_start = g_mp_marker_pos_start;
+  int32_t marker_pos_end = g_mp_marker_pos_end;
+  uint32_t sf_ct = g_mp_sf_ct;
+  uint32_t exclude_snp = g_mp_exclude_snp;
+  char* bufptr;
+  char* bufptr2;
+  uintptr_t ulii;
+  uint32_t uii;
+  uint32_t cur_pos;
+  unsigned char cm_flag;
+  int32_t jj;
+  for (; line_idx < line_end; line_idx++, marker_uidx++) {
+    bufptr = g_mp_line_starts[line_idx];
+    cm_flag = 0;
+    jj = marker_code(chrom_info_ptr, bufptr);
+    g_mp_chroms[line_idx] = jj;
+    if (jj == -1) {
+      g_mp_status[line_idx] = MARKER_PARSE_ERR_CHROM;
+      break;
+    }
+    if (!is_set(chrom_mask, jj)) {
+      g_mp_status[line_idx] = MARKER_PARSE_SKIP_NOPOS;
+      continue;
+    }
+    bufptr = next_item(bufptr);
+    if (no_more_items_kns(bufptr)) {
+      goto marker_parse_thread_FORMAT;
+    }
+    read_next_terminate(&(g_mp_marker_ids[marker_uidx * max_marker_id_len]), bufptr);
+    if (cms) {
+      bufptr = next_item(bufptr);
+      if (no_more_items_kns(bufptr)) {
+	goto marker_parse_thread_FORMAT;
+      }
+      if ((*bufptr != '0') || (bufptr[1] > ' ')) {
+	if (scan_double(bufptr, &(cms[line_idx]))) {
+	  g_mp_status[line_idx] = MARKER_PARSE_ERR_CM;
+	  break;
+	}
+	cm_flag = MARKER_PARSE_CM_SET;
+      }
+      bufptr = next_item(bufptr);
+    } else {
+      bufptr = next_item_mult(bufptr, pos_skip);
+    }
+    if (no_more_items_kns(bufptr)) {
+      goto marker_parse_thread_FORMAT;
+    }
+    if (*bufptr == '-') {
+      // negative marker positions now have same effect in .bim as .map
+      g_mp_status[line_idx] = MARKER_PARSE_SKIP_NOPOS | cm_flag;
+      continue;
+    }
+    cur_pos = atoi(bufptr);
+    g_mp_pos[line_idx] = cur_pos;
+    if ((sf_ct && (exclude_snp ^ sf_out_of_range(cur_pos, (uint32_t)jj, g_mp_sf_start_idxs, g_mp_sf_pos))) || ((marker_pos_start != -1) && ((((int32_t)cur_pos) < marker_pos_start) || (((int32_t)cur_pos) > marker_pos_end))) || (exclude_snp && (((int32_t)cur_pos) <= g_mp_exclude_window_end) && (((int32_t)cur_pos) >= g_mp_exclude_window_start) && ((uint32_t)jj == g_mp_snp_chrom))) {
+      g_mp_status[line_idx] = MARKER_PARSE_SKIP_POS | cm_flag;
+      continue;
+    }
+    if (g_mp_marker_pos) {
+      g_mp_marker_pos[marker_uidx] = cur_pos;
+    }
+    if (marker_alleles) {
+      bufptr = next_item(bufptr);
+      bufptr2 = next_item(bufptr);
+      if (max_marker_allele_len == 1) {
+	marker_alleles[marker_uidx * 2] = *bufptr;
+	marker_alleles[marker_uidx * 2 + 1] = *bufptr2;
+      } else {
+	uii = strlen_se(bufptr);
+	ulii = marker_uidx * 2 * max_marker_allele_len;
+	memcpy(&(marker_alleles[ulii]), bufptr, uii);
+	// no need to append \0 since was zeroed out earlier
+	uii = strlen_se(bufptr2);
+	memcpy(&(marker_alleles[ulii + max_marker_allele_len]), bufptr2, uii);
+      }
+    }
+    g_mp_status[line_idx] = MARKER_PARSE_INCLUDE | cm_flag;
+    continue;
+  marker_parse_thread_FORMAT:
+    g_mp_status[line_idx] = MARKER_PARSE_ERR_FORMAT;
+    break;
+  }
+  THREAD_RETURN;
+}
+
+int32_t marker_parse_batch(FILE* infile, uintptr_t marker_uidx, uintptr_t unfiltered_marker_ct, uint32_t* line_ct_ptr) {
+  // Locates and parses up to g_mp_line_max more lines.  Returns RET_READ_FAIL
+  // if the file ends early, or RET_THREAD_CREATE_FAIL (after logging) on
+  // thread creation failure.
+  pthread_t threads[MAX_THREADS];
+  uintptr_t line_max = unfiltered_marker_ct - marker_uidx;
+  uint32_t line_ct = 0;
+  uintptr_t ulii;
+  char* line_end;
+  char* bufptr;
+  if (line_max > g_mp_line_max) {
+    line_max = g_mp_line_max;
+  }
+  while (1) {
+    bufptr = &(g_mp_buf[g_mp_buf_offset]);
+    line_end = (char*)memchr(bufptr, '\n', g_mp_buf_len - g_mp_buf_offset);
+    if (!line_end) {
+      if (g_mp_eof) {
+	if (g_mp_buf_offset == g_mp_buf_len) {
+	  break;
+	}
+	// final line with no trailing newline
+	line_end = &(g_mp_buf[g_mp_buf_len]);
+	*line_end = '\n';
+      } else {
+	// shift the partial line to the front, then refill
+	if (line_ct) {
+	  // can't move memory that already-located lines point into
+	  break;
+	}
+	ulii = g_mp_buf_len - g_mp_buf_offset;
+	memmove(g_mp_buf, bufptr, ulii);
+	g_mp_buf_offset = 0;
+	g_mp_buf_len = ulii + fread(&(g_mp_buf[ulii]), 1, g_mp_buf_size - ulii, infile);
+	if (g_mp_buf_len < g_mp_buf_size) {
+	  if (ferror(infile)) {
+	    return RET_READ_FAIL;
+	  }
+	  g_mp_eof = 1;
+	}
+	continue;
+      }
+    }
+    g_mp_buf_offset = (uintptr_t)(line_end - g_mp_buf) + 1;
+    if (g_mp_buf_offset > g_mp_buf_len) {
+      g_mp_buf_offset = g_mp_buf_len;
+    }
+    bufptr = skip_initial_spaces(bufptr);
+    if (!is_eoln_or_comment(*bufptr)) {
+      g_mp_line_starts[line_ct] = bufptr;
+      if (++line_ct == line_max) {
+	break;
+      }
+    }
+  }
+  if (!line_ct) {
+    return RET_READ_FAIL;
+  }
+  g_mp_line_ct = line_ct;
+  g_mp_marker_uidx_base = marker_uidx;
+  g_mp_thread_ct = 1 + line_ct / MARKER_PARSE_MIN_LINES_PER_THREAD;
+  if (g_mp_thread_ct > g_thread_ct) {
+    g_mp_thread_ct = g_thread_ct;
+  }
+  if (spawn_threads(threads, &marker_parse_thread, g_mp_thread_ct)) {
+    logprint(errstr_thread_create);
+    return RET_THREAD_CREATE_FAIL;
+  }
+  ulii = 0;
+  marker_parse_thread((void*)ulii);
+  join_threads(threads, g_mp_thread_ct);
+  *line_ct_ptr = line_ct;
+  return 0;
+}
+
+
 int32_t load_map(FILE** mapfile_ptr, char* mapname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_marker_ct_ptr, uintptr_t* marker_exclude_ct_ptr, uintptr_t* max_marker_id_len_ptr, uintptr_t** marker_exclude_ptr, char** marker_ids_ptr, Chrom_info* chrom_info_ptr, uint32_t** marker_pos_ptr, uint32_t* map_is_unsorted_ptr) {
   // todo: some cleanup
   uintptr_t marker_exclude_ct = *marker_exclude_ct_ptr;
@@ -372,8 +823,12 @@ int32_t load_map(FILE** mapfile_ptr, char* mapname, uint32_t* map_cols_ptr, uint
   uintptr_t* marker_exclude;
   uintptr_t unfiltered_marker_ctl;
   char* bufptr;
+  uintptr_t topsize = 0;
   uintptr_t marker_uidx;
   uintptr_t ulii;
+  uint32_t line_ct;
+  uint32_t line_idx;
+  unsigned char ucc;
   int32_t jj;
   int32_t cur_pos;
   fill_ulong_zero(loaded_chrom_mask, CHROM_MASK_WORDS);
@@ -452,63 +907,62 @@ int32_t load_map(FILE** mapfile_ptr, char* mapname, uint32_t* map_cols_ptr, uint
   }
 
   // second pass: actually load stuff
-  for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
-    if (get_next_noncomment(*mapfile_ptr, &bufptr)) {
-      goto load_map_ret_READ_FAIL;
-    }
-    jj = marker_code(chrom_info_ptr, bufptr);
-    if (jj == -1) {
-      logprint("Error: Invalid chromosome index in .map file.\n");
-      goto load_map_ret_INVALID_FORMAT;
+  if (marker_parse_init(&topsize, 0)) {
+    goto load_map_ret_NOMEM;
+  }
+  g_mp_chrom_info_ptr = chrom_info_ptr;
+  g_mp_pos_skip = *map_cols_ptr - 2;
+  g_mp_marker_ids = *marker_ids_ptr;
+  g_mp_max_marker_id_len = max_marker_id_len;
+  if (marker_pos_needed) {
+    g_mp_marker_pos = *marker_pos_ptr;
+  }
+  marker_uidx = 0;
+  while (marker_uidx < unfiltered_marker_ct) {
+    retval = marker_parse_batch(*mapfile_ptr, marker_uidx, unfiltered_marker_ct, &line_ct);
+    if (retval) {
+      goto load_map_ret_1;
     }
-    if (jj != last_chrom) {
-      if (last_chrom != -1) {
-	chrom_info_ptr->chrom_end[last_chrom] = marker_uidx;
-      }
-      if (jj < last_chrom) {
-	*map_is_unsorted_ptr |= UNSORTED_CHROM;
+    for (line_idx = 0; line_idx < line_ct; line_idx++, marker_uidx++) {
+      jj = g_mp_chroms[line_idx];
+      if (jj == -1) {
+	logprint("Error: Invalid chromosome index in .map file.\n");
+	goto load_map_ret_INVALID_FORMAT;
       }
-      last_chrom = jj;
-      if (is_set(loaded_chrom_mask, jj)) {
-	*map_is_unsorted_ptr |= UNSORTED_SPLIT_CHROM;
-      } else {
-	set_bit(loaded_chrom_mask, jj);
-	chrom_info_ptr->chrom_start[(uint32_t)jj] = marker_uidx;
-	chrom_info_ptr->chrom_file_order[++chroms_encountered_m1] = jj;
-	chrom_info_ptr->chrom_file_order_marker_idx[chroms_encountered_m1] = marker_uidx;
+      if (jj != last_chrom) {
+	if (last_chrom != -1) {
+	  chrom_info_ptr->chrom_end[last_chrom] = marker_uidx;
+	}
+	if (jj < last_chrom) {
+	  *map_is_unsorted_ptr |= UNSORTED_CHROM;
+	}
+	last_chrom = jj;
+	if (is_set(loaded_chrom_mask, jj)) {
+	  *map_is_unsorted_ptr |= UNSORTED_SPLIT_CHROM;
+	} else {
+	  set_bit(loaded_chrom_mask, jj);
+	  chrom_info_ptr->chrom_start[(uint32_t)jj] = marker_uidx;
+	  chrom_info_ptr->chrom_file_order[++chroms_encountered_m1] = jj;
+	  chrom_info_ptr->chrom_file_order_marker_idx[chroms_encountered_m1] = marker_uidx;
+	}
+	last_pos = 0;
       }
-      last_pos = 0;
-    }
-
-    if (!is_set(chrom_info_ptr->chrom_mask, jj)) {
-      SET_BIT(marker_exclude, marker_uidx);
-      marker_exclude_ct++;
-    } else {
-      bufptr = next_item(bufptr);
-      if (no_more_items_kns(bufptr)) {
+      ucc = g_mp_status[line_idx];
+      if (ucc == MARKER_PARSE_ERR_FORMAT) {
 	logprint(errstr_map_format);
 	goto load_map_ret_INVALID_FORMAT;
       }
-      read_next_terminate(&((*marker_ids_ptr)[marker_uidx * max_marker_id_len]), bufptr);
-      bufptr = next_item_mult(bufptr, *map_cols_ptr - 2);
-      if (no_more_items_kns(bufptr)) {
-        logprint(errstr_map_format);
-	goto load_map_ret_INVALID_FORMAT;
-      }
-      if (*bufptr == '-') {
-	// negative marker positions now have same effect in .bim as .map
-	SET_BIT(marker_exclude, marker_uidx);
-	marker_exclude_ct++;
-      } else {
-	cur_pos = atoi(bufptr);
+      if (ucc != MARKER_PARSE_SKIP_NOPOS) {
+	cur_pos = g_mp_pos[line_idx];
 	if (cur_pos < last_pos) {
 	  *map_is_unsorted_ptr |= UNSORTED_BP;
 	} else {
 	  last_pos = cur_pos;
 	}
-	if (marker_pos_needed && jj) {
-	  (*marker_pos_ptr)[marker_uidx] = cur_pos;
-	}
+      }
+      if (ucc != MARKER_PARSE_INCLUDE) {
+	SET_BIT(marker_exclude, marker_uidx);
+	marker_exclude_ct++;
       }
     }
   }
@@ -530,6 +984,7 @@ int32_t load_map(FILE** mapfile_ptr, char* mapname, uint32_t* map_cols_ptr, uint
     retval = RET_INVALID_FORMAT;
     break;
   }
+ load_map_ret_1:
   return retval;
 }
 
@@ -627,18 +1082,6 @@ void load_bim_sf_insert(uint32_t chrom_idx, uint32_t pos_start, uint32_t pos_end
   *entry_ct_ptr = entry_ct;
 }
 
-static inline uint32_t sf_out_of_range(uint32_t cur_pos, uint32_t chrom_idx, uint32_t* sf_start_idxs, uint32_t* sf_pos) {
-  uint32_t cur_idx = sf_start_idxs[chrom_idx];
-  uint32_t end_idx = sf_start_idxs[chrom_idx + 1];
-  while (cur_idx < end_idx) {
-    if ((cur_pos >= sf_pos[cur_idx]) && (cur_pos <= sf_pos[cur_idx + 1])) {
-      return 0;
-    }
-    cur_idx += 2;
-  }
-  return 1;
-}
-
 int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_marker_ct_ptr, uintptr_t* marker_exclude_ct_ptr, uintptr_t* max_marker_id_len_ptr, uintptr_t** marker_exclude_ptr, double** set_allele_freqs_ptr, char** marker_alleles_ptr, uintptr_t* max_marker_allele_len_ptr, char** marker_ids_ptr, uint32_t allow_extra_chroms, Chrom_info* chrom_info_ptr, double** marker_cms_ptr, uint32_t** marker_pos_ptr, char* freqname, uint64_t calculation_type, uint32_t recode_modifier, int32_t marker_pos_start, int32_t marker_pos_end, uint32_t snp_window_size, char* markername_from, char* markername_to, char* markername_snp, uint32_t exclude_snp, Range_list* sf_range_list_ptr, uint32_t* map_is_unsorted_ptr, uint32_t marker_pos_needed, uint32_t marker_cms_needed, uint32_t marker_alleles_needed, const char* extension, const char* split_chrom_cmd) {
   unsigned char* wkspace_mark = wkspace_base;
   FILE* bimfile = NULL;
@@ -689,6 +1132,10 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   int32_t jj;
   uint32_t cur_pos;
   uintptr_t marker_uidx;
+  uintptr_t topsize = 0;
+  uint32_t line_ct;
+  uint32_t line_idx;
+  unsigned char ucc;
   int32_t retval;
   fill_ulong_zero(loaded_chrom_mask, CHROM_MASK_WORDS);
   if (sf_ct) {
@@ -1037,102 +1484,94 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   }
 
   // second pass: actually load stuff
-  for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
-    if (get_next_noncomment(bimfile, &bufptr)) {
-      goto load_bim_ret_READ_FAIL;
-    }
-    jj = marker_code(chrom_info_ptr, bufptr);
-    if (jj != prev_chrom) {
-      if (!split_chrom) {
-	if (prev_chrom != -1) {
-	  chrom_info_ptr->chrom_end[(uint32_t)prev_chrom] = marker_uidx;
-	}
-	if (jj < prev_chrom) {
-	  *map_is_unsorted_ptr |= UNSORTED_CHROM;
-	}
-	prev_chrom = jj;
-	if (is_set(loaded_chrom_mask, jj)) {
-	  if (split_chrom_cmd) {
-	    sprintf(logbuf, "Error: .%s file has a split chromosome.  Use --%s by itself to\nremedy this.\n", extension, split_chrom_cmd);
-	    goto load_bim_ret_INVALID_FORMAT;
-	  }
-	  split_chrom = 1;
-	  *map_is_unsorted_ptr = UNSORTED_CHROM | UNSORTED_BP | UNSORTED_SPLIT_CHROM;
-	} else {
-	  chrom_info_ptr->chrom_start[(uint32_t)jj] = marker_uidx;
-	  chrom_info_ptr->chrom_file_order[++chroms_encountered_m1] = jj;
-	  chrom_info_ptr->chrom_file_order_marker_idx[chroms_encountered_m1] = marker_uidx;
-	}
-        last_pos = 0;
-      }
-      set_bit(loaded_chrom_mask, jj);
+  if (marker_parse_init(&topsize, marker_cms_needed)) {
+    goto load_bim_ret_NOMEM;
+  }
+  g_mp_chrom_info_ptr = chrom_info_ptr;
+  g_mp_pos_skip = mcm2;
+  g_mp_marker_ids = *marker_ids_ptr;
+  g_mp_max_marker_id_len = max_marker_id_len;
+  if (marker_pos_needed) {
+    g_mp_marker_pos = *marker_pos_ptr;
+  }
+  g_mp_marker_alleles = marker_alleles;
+  g_mp_max_marker_allele_len = max_marker_allele_len;
+  g_mp_sf_ct = sf_ct;
+  g_mp_sf_start_idxs = sf_start_idxs;
+  g_mp_sf_pos = sf_pos;
+  g_mp_exclude_snp = exclude_snp;
+  g_mp_snp_chrom = snp_chrom;
+  g_mp_marker_pos_start = marker_pos_start;
+  g_mp_marker_pos_end = marker_pos_end;
+  g_mp_exclude_window_start = exclude_window_start;
+  g_mp_exclude_window_end = exclude_window_end;
+  marker_uidx = 0;
+  while (marker_uidx < unfiltered_marker_ct) {
+    retval = marker_parse_batch(bimfile, marker_uidx, unfiltered_marker_ct, &line_ct);
+    if (retval) {
+      goto load_bim_ret_1;
     }
-
-    if (is_set(chrom_info_ptr->chrom_mask, jj)) {
-      bufptr = next_item(bufptr);
-      if (no_more_items_kns(bufptr)) {
+    for (line_idx = 0; line_idx < line_ct; line_idx++, marker_uidx++) {
+      jj = g_mp_chroms[line_idx];
+      if (jj == -1) {
 	goto load_bim_ret_INVALID_FORMAT_5;
       }
-      read_next_terminate(&((*marker_ids_ptr)[marker_uidx * max_marker_id_len]), bufptr);
-      if (marker_cms_needed) {
-	bufptr = next_item(bufptr);
-	if (no_more_items_kns(bufptr)) {
-	  goto load_bim_ret_INVALID_FORMAT_5;
-	}
-	if ((*bufptr != '0') || (bufptr[1] > ' ')) {
-	  if (!(*marker_cms_ptr)) {
-	    if (wkspace_alloc_d_checked(marker_cms_ptr, unfiltered_marker_ct * sizeof(double))) {
-	      goto load_bim_ret_NOMEM;
-	    }
-	    fill_double_zero(*marker_cms_ptr, unfiltered_marker_ct);
+      if (jj != prev_chrom) {
+	if (!split_chrom) {
+	  if (prev_chrom != -1) {
+	    chrom_info_ptr->chrom_end[(uint32_t)prev_chrom] = marker_uidx;
 	  }
-	  if (scan_double(bufptr, &((*marker_cms_ptr)[marker_uidx]))) {
-	    sprintf(logbuf, "Error: Invalid centimorgan position in .%s file.\n", extension);
-	    goto load_bim_ret_INVALID_FORMAT_2;
+	  if (jj < prev_chrom) {
+	    *map_is_unsorted_ptr |= UNSORTED_CHROM;
+	  }
+	  prev_chrom = jj;
+	  if (is_set(loaded_chrom_mask, jj)) {
+	    if (split_chrom_cmd) {
+	      sprintf(logbuf, "Error: .%s file has a split chromosome.  Use --%s by itself to\nremedy this.\n", extension, split_chrom_cmd);
+	      goto load_bim_ret_INVALID_FORMAT;
+	    }
+	    split_chrom = 1;
+	    *map_is_unsorted_ptr = UNSORTED_CHROM | UNSORTED_BP | UNSORTED_SPLIT_CHROM;
+	  } else {
+	    chrom_info_ptr->chrom_start[(uint32_t)jj] = marker_uidx;
+	    chrom_info_ptr->chrom_file_order[++chroms_encountered_m1] = jj;
+	    chrom_info_ptr->chrom_file_order_marker_idx[chroms_encountered_m1] = marker_uidx;
 	  }
+	  last_pos = 0;
 	}
-	bufptr = next_item(bufptr);
-      } else {
-        bufptr = next_item_mult(bufptr, mcm2);
+	set_bit(loaded_chrom_mask, jj);
       }
-      if (no_more_items_kns(bufptr)) {
+      ucc = g_mp_status[line_idx];
+      if (ucc == MARKER_PARSE_ERR_FORMAT) {
 	goto load_bim_ret_INVALID_FORMAT_5;
+      } else if (ucc == MARKER_PARSE_ERR_CM) {
+	sprintf(logbuf, "Error: Invalid centimorgan position in .%s file.\n", extension);
+	goto load_bim_ret_INVALID_FORMAT_2;
       }
-      if (*bufptr == '-') {
-	// negative marker positions now have same effect in .bim as .map
-	goto load_bim_skip_marker;
-      }
-      cur_pos = atoi(bufptr);
-      if (cur_pos < last_pos) {
-	*map_is_unsorted_ptr |= UNSORTED_BP;
-      } else {
-	last_pos = cur_pos;
-      }
-      if ((sf_ct && (exclude_snp ^ sf_out_of_range(cur_pos, (uint32_t)jj, sf_start_idxs, sf_pos))) || ((marker_pos_start != -1) && ((((int32_t)cur_pos) < marker_pos_start) || (((int32_t)cur_pos) > marker_pos_end))) || (exclude_snp && (((int32_t)cur_pos) <= exclude_window_end) && (((int32_t)cur_pos) >= exclude_window_start) && ((uint32_t)jj == snp_chrom))) {
-	goto load_bim_skip_marker;
-      }
-      if (marker_pos_needed) {
-	(*marker_pos_ptr)[marker_uidx] = cur_pos;
+      if (ucc & MARKER_PARSE_CM_SET) {
+	if (!(*marker_cms_ptr)) {
+	  // temporaries are still at the top of the workspace
+	  if (wkspace_left - topsize < CACHEALIGN(unfiltered_marker_ct * sizeof(double))) {
+	    goto load_bim_ret_NOMEM;
+	  }
+	  *marker_cms_ptr = (double*)wkspace_alloc(unfiltered_marker_ct * sizeof(double));
+	  fill_double_zero(*marker_cms_ptr, unfiltered_marker_ct);
+	}
+	(*marker_cms_ptr)[marker_uidx] = g_mp_cms[line_idx];
+	ucc -= MARKER_PARSE_CM_SET;
       }
-      if (marker_alleles_needed) {
-	bufptr = next_item(bufptr);
-	bufptr2 = next_item(bufptr);
-	if (max_marker_allele_len == 1) {
-	  marker_alleles[marker_uidx * 2] = *bufptr;
-	  marker_alleles[marker_uidx * 2 + 1] = *bufptr2;
+      if (ucc != MARKER_PARSE_SKIP_NOPOS) {
+	cur_pos = g_mp_pos[line_idx];
+	if (cur_pos < last_pos) {
+	  *map_is_unsorted_ptr |= UNSORTED_BP;
 	} else {
-	  uii = strlen_se(bufptr);
-	  ulii = marker_uidx * 2 * max_marker_allele_len;
-	  memcpy(&(marker_alleles[ulii]), bufptr, uii);
-	  // no need to append \0 since was zeroed out earlier
-	  uii = strlen_se(bufptr2);
-	  memcpy(&(marker_alleles[ulii + max_marker_allele_len]), bufptr2, uii);
+	  last_pos = cur_pos;
 	}
       }
-    } else {
-    load_bim_skip_marker:
-      SET_BIT(marker_exclude, marker_uidx);
-      marker_exclude_ct++;
+      if (ucc != MARKER_PARSE_INCLUDE) {
+	SET_BIT(marker_exclude, marker_uidx);
+	marker_exclude_ct++;
+      }
     }
   }
   if (unfiltered_marker_ct == marker_exclude_ct) {
@@ -3951,7 +4390,7 @@ int32_t make_bed_one_marker(FILE* bedfile, uintptr_t* loadbuf, uint32_t unfilter
   uint32_t indiv_idx = 0;
   uint32_t indiv_uidx2;
   if (indiv_sort_map) {
-    if (fread(loadbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+    if (bed_fread(loadbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
       return RET_READ_FAIL;
     }
     for (; indiv_idx < indiv_ct; indiv_idx++) {
@@ -4024,7 +4463,7 @@ int32_t make_bed(FILE* bedfile, uintptr_t bed_offset, char* bimname, uint32_t ma
     goto make_bed_ret_WRITE_FAIL;
   }
   fflush(stdout);
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto make_bed_ret_READ_FAIL;
   }
   if (map_is_unsorted || update_chr) {
@@ -4076,7 +4515,7 @@ int32_t make_bed(FILE* bedfile, uintptr_t bed_offset, char* bimname, uint32_t ma
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto make_bed_ret_READ_FAIL;
 	  }
 	}
@@ -4121,7 +4560,7 @@ int32_t make_bed(FILE* bedfile, uintptr_t bed_offset, char* bimname, uint32_t ma
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
         if (IS_SET(marker_exclude, marker_uidx)) {
           marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
             goto make_bed_ret_READ_FAIL;
 	  }
 	}
@@ -5086,190 +5525,137 @@ int32_t ped_to_bed_multichar_allele(uintptr_t max_marker_allele_len, FILE** pedf
   return retval;
 }
 
-int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_end, uint32_t fam_cols, uint32_t affection_01, int32_t missing_pheno, Chrom_info* chrom_info_ptr) {
-  unsigned char* wkspace_mark = wkspace_base;
-  FILE* mapfile = NULL;
-  FILE* pedfile = NULL;
-  FILE* outfile = NULL;
-  uintptr_t* marker_exclude;
-  uintptr_t max_marker_id_len = 0;
-  uintptr_t unfiltered_marker_ct = 0;
-  uintptr_t marker_exclude_ct = 0;
-  uintptr_t marker_ct = 0;
-  uint32_t map_is_unsorted = 0;
-  int32_t last_chrom = 0;
-  uint32_t last_mpos = 0;
+// Parallel .ped -> .bed conversion (single-character alleles only).  The .ped
+// is split into g_pb_thread_ct line-aligned byte ranges, each read through its
+// own file handle.  During the scan, each thread writes its .fam lines to a
+// temporary file and tallies alleles in a private table; since the ranges are
+// in file order, merging the tables in thread order preserves the first-seen
+// allele order of the serial scan.
+#define PED_SCAN_OK 0
+#define PED_SCAN_RESTART 1
+#define PED_SCAN_MISSING_TOKENS 2
+#define PED_SCAN_LONG_TOKENS 3
+#define PED_SCAN_TOO_FEW_MARKERS 4
+// line didn't fit in the thread's buffer; redo the scan serially
+#define PED_SCAN_LINE_TOO_LONG 5
+#define PED_SCAN_READ_FAIL 6
+#define PED_SCAN_WRITE_FAIL 7
+
+#define PED_MIN_BYTES_PER_THREAD 1048576
+
+static uint32_t g_pb_thread_ct;
+static FILE* g_pb_pedfiles[MAX_THREADS];
+static FILE* g_pb_famfiles[MAX_THREADS];
+static int64_t g_pb_chunk_starts[MAX_THREADS + 1];
+static char* g_pb_loadbufs[MAX_THREADS];
+static uintptr_t g_pb_loadbuf_size;
+static char* g_pb_marker_alleles[MAX_THREADS];
+static uint32_t* g_pb_marker_allele_cts[MAX_THREADS];
+static uintptr_t g_pb_indiv_cts[MAX_THREADS];
+// .bed encoding ranges; interior boundaries are multiples of 4 so that no two
+// threads write to the same byte
+static uintptr_t g_pb_indiv_starts[MAX_THREADS + 1];
+static uintptr_t g_pb_ped_buflens[MAX_THREADS];
+static uint32_t g_pb_status[MAX_THREADS];
+static char* g_pb_err_lines[MAX_THREADS];
+static uintptr_t g_pb_unfiltered_marker_ct;
+static uintptr_t* g_pb_marker_exclude;
+static uintptr_t g_pb_marker_ct;
+static uint32_t* g_pb_map_reverse;
+static uint32_t g_pb_fam_cols;
+static uint32_t g_pb_ped_col_skip;
+static char* g_pb_marker_alleles_f;
+static unsigned char* g_pb_writebuf;
+static uintptr_t g_pb_indiv_ct4;
+
+void ped_to_bed_parallel_cleanup(char* outname, char* outname_end) {
+  // Closes the extra .ped handles, and removes any remaining temporary .fam
+  // files.  (g_pb_pedfiles[0] and g_pb_famfiles[0] belong to the caller.)
+  uint32_t tidx;
+  for (tidx = 1; tidx < g_pb_thread_ct; tidx++) {
+    fclose_cond(g_pb_pedfiles[tidx]);
+    fclose_cond(g_pb_famfiles[tidx]);
+    g_pb_pedfiles[tidx] = NULL;
+    g_pb_famfiles[tidx] = NULL;
+    sprintf(outname_end, ".fam.tmp%u", tidx);
+    unlink(outname);
+  }
+  g_pb_thread_ct = 0;
+}
+
+int64_t ped_chunk_seek(FILE* pedfile, uint32_t tidx) {
+  // Positions pedfile at the first line starting at or after
+  // g_pb_chunk_starts[tidx], and returns that offset (-1 on failure).
+  int32_t ii;
+  if (!tidx) {
+    rewind(pedfile);
+    return 0;
+  }
+  if (fseeko(pedfile, g_pb_chunk_starts[tidx] - 1, SEEK_SET)) {
+    return -1;
+  }
+  do {
+    ii = getc(pedfile);
+  } while ((ii != '\n') && (ii != EOF));
+  if (ferror(pedfile)) {
+    return -1;
+  }
+  return ftello(pedfile);
+}
+
+THREAD_RET_TYPE ped_scan_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  FILE* pedfile = g_pb_pedfiles[tidx];
+  FILE* famfile = g_pb_famfiles[tidx];
+  char* loadbuf = g_pb_loadbufs[tidx];
+  uintptr_t loadbuf_size = g_pb_loadbuf_size;
+  char* marker_alleles = g_pb_marker_alleles[tidx];
+  uint32_t* marker_allele_cts = g_pb_marker_allele_cts[tidx];
+  uintptr_t unfiltered_marker_ct = g_pb_unfiltered_marker_ct;
+  uintptr_t* marker_exclude = g_pb_marker_exclude;
+  uint32_t* map_reverse = g_pb_map_reverse;
+  uint32_t fam_cols = g_pb_fam_cols;
+  uint32_t ped_col_skip = g_pb_ped_col_skip;
+  int64_t chunk_end = g_pb_chunk_starts[tidx + 1];
+  int64_t ped_next_thresh = chunk_end / 100;
+  int64_t cur_pos = ped_chunk_seek(pedfile, tidx);
   uintptr_t indiv_ct = 0;
-  uint32_t ped_buflen = 1;
-  int32_t retval = 0;
-  uint32_t ped_col_skip = 1 + ((fam_cols & FAM_COL_1) / FAM_COL_1) + 2 * ((fam_cols & FAM_COL_34) / FAM_COL_34) + ((fam_cols & FAM_COL_5) / FAM_COL_5) + ((fam_cols & FAM_COL_6) / FAM_COL_6);
-  uint32_t last_pass = 0;
-  int64_t* line_starts = NULL;
-  uintptr_t max_marker_allele_len = 1;
-  uint32_t pass_ct;
-  uintptr_t indiv_ct4;
-  uint32_t pct;
-  char* marker_alleles_f;
-  char* marker_alleles;
-  uint32_t* marker_allele_cts;
-  uint32_t* map_reverse;
-  uint32_t cm_col;
-  uint32_t markers_per_pass;
-  uint32_t marker_start;
-  uint32_t marker_end;
+  uintptr_t ped_buflen = 1;
+  uint32_t status = PED_SCAN_OK;
+  uint32_t pct = 0;
+  char* col1_ptr = NULL;
+  char* col2_ptr;
+  char* bufptr;
+  char* bufptr2;
   uintptr_t marker_uidx;
   uintptr_t marker_idx;
-  uint32_t loop_end;
-  uintptr_t indiv_idx;
   uintptr_t ulii;
   uint32_t uii;
-  uint32_t ujj;
-  uint32_t ukk;
-  uint32_t umm;
-  int32_t ii;
-  char* loadbuf;
-  uintptr_t loadbuf_size;
-  char* col1_ptr;
-  char* col2_ptr;
-  char* bufptr;
-  char* bufptr2;
   char cc;
   char cc2;
-  unsigned char ucc;
-  uint32_t ii_shift;
-  unsigned char* writebuf;
-  unsigned char* wbufptr;
-  int64_t ped_size;
-  int64_t ped_next_thresh;
-  marker_exclude = (uintptr_t*)wkspace_base;
-  marker_exclude[0] = 0;
-  if (fopen_checked(&mapfile, mapname, "r")) {
-    goto ped_to_bed_ret_OPEN_FAIL;
+  if (cur_pos < 0) {
+    status = PED_SCAN_READ_FAIL;
+    goto ped_scan_thread_ret;
   }
-  tbuf[MAXLINELEN - 6] = ' ';
-  if (check_cm_col(mapfile, tbuf, 0, &cm_col)) {
-    sprintf(logbuf, "Error: Missing token(s) in .map line: %s", skip_initial_spaces(tbuf));
-    goto ped_to_bed_ret_INVALID_FORMAT_2;
-  }
-  do {
-    if (!tbuf[MAXLINELEN - 6]) {
-      sprintf(logbuf, "Error: Excessively long line in .map file (max %u chars).\n", MAXLINELEN - 8);
-      goto ped_to_bed_ret_INVALID_FORMAT_2;
-    }
-    col1_ptr = skip_initial_spaces(tbuf);
-    if (is_eoln_or_comment(*col1_ptr)) {
-      continue;
-    }
-    col2_ptr = next_item(col1_ptr);
-    bufptr = next_item_mult(col2_ptr, 1 + cm_col);
-    if (no_more_items_kns(bufptr)) {
-      sprintf(logbuf, "Error: Missing token(s) in .map line: %s", col1_ptr);
-      goto ped_to_bed_ret_INVALID_FORMAT_2;
-    }
-    ii = marker_code(chrom_info_ptr, col1_ptr);
-    if (ii == -1) {
-      // no need to support allow_extra_chroms in .map files
-      logprint("Error: Invalid chromosome index in .map file.\n");
-      goto ped_to_bed_ret_INVALID_FORMAT;
-    }
-    if ((*bufptr == '-') || (!is_set(chrom_info_ptr->chrom_mask, ii))) {
-      SET_BIT(marker_exclude, unfiltered_marker_ct);
-      marker_exclude_ct++;
-    } else {
-      if ((*bufptr < '0') || (*bufptr > '9')) {
-	logprint("Error: Non-numeric marker position in .map file.\n");
-	goto ped_to_bed_ret_INVALID_FORMAT;
-      }
-      if (!map_is_unsorted) {
-	uii = atoi(bufptr);
-	if ((ii < last_chrom) || ((ii == last_chrom) && (uii < last_mpos))) {
-	  map_is_unsorted = 1;
-	}
-	last_chrom = ii;
-	last_mpos = uii;
-      }
-      uii = strlen_se(col2_ptr) + 1;
-      if (uii > max_marker_id_len) {
-	max_marker_id_len = uii;
-      }
-    }
-    unfiltered_marker_ct++;
-    if (unfiltered_marker_ct > 0x7fffffff) {
-      logprint("Error: Too many markers in .map file (max 2147483647).\n");
-      goto ped_to_bed_ret_INVALID_FORMAT;
-    }
-    if (!(unfiltered_marker_ct & (BITCT - 1))) {
-      if ((unfiltered_marker_ct / 8) == wkspace_left) {
-	goto ped_to_bed_ret_NOMEM;
+  loadbuf[loadbuf_size - 1] = ' ';
+  while (cur_pos < chunk_end) {
+    if (!fgets(loadbuf, loadbuf_size, pedfile)) {
+      if (ferror(pedfile)) {
+	status = PED_SCAN_READ_FAIL;
       }
-      marker_exclude[unfiltered_marker_ct / BITCT] = 0;
-    }
-  } while (fgets(tbuf, MAXLINELEN - 5, mapfile));
-  if (!feof(mapfile)) {
-    goto ped_to_bed_ret_READ_FAIL;
-  }
-  marker_ct = unfiltered_marker_ct - marker_exclude_ct;
-  if (!marker_ct) {
-    logprint("Error: No markers in current analysis.\n");
-    goto ped_to_bed_ret_INVALID_FORMAT;
-  }
-  marker_exclude = (uintptr_t*)wkspace_alloc(((unfiltered_marker_ct + (BITCT - 1)) / BITCT) * sizeof(intptr_t));
-
-  // provisionally assume max_marker_allele_len == 1
-  if (wkspace_alloc_c_checked(&marker_alleles_f, marker_ct * 2)) {
-    goto ped_to_bed_ret_NOMEM;
-  }
-  if (map_is_unsorted) {
-    retval = load_sort_and_write_map(&map_reverse, mapfile, 3 + cm_col, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 1, chrom_info_ptr);
-    if (retval) {
-      goto ped_to_bed_ret_1;
+      break;
     }
-    cm_col = 1;
-    fclose_null(&mapfile);
-  }
-  if (wkspace_alloc_c_checked(&marker_alleles, marker_ct * 4) ||
-      wkspace_alloc_ui_checked(&marker_allele_cts, marker_ct * 4 * sizeof(int32_t))) {
-    goto ped_to_bed_ret_NOMEM;
-  }
-  memset(marker_alleles, 0, marker_ct * 4);
-
-  // first .ped scan: count indivs, write .fam, note alleles at each locus
-  if (fopen_checked(&pedfile, pedname, "rb")) {
-    goto ped_to_bed_ret_OPEN_FAIL;
-  }
-  memcpy(outname_end, ".fam", 5);
-  if (fopen_checked(&outfile, outname, "w")) {
-    goto ped_to_bed_ret_OPEN_FAIL;
-  }
-  loadbuf = (char*)wkspace_base;
-  loadbuf_size = wkspace_left;
-  if (loadbuf_size > MAXLINEBUFLEN) {
-    loadbuf_size = MAXLINEBUFLEN;
-  }
-  if (loadbuf_size <= MAXLINELEN) {
-    goto ped_to_bed_ret_NOMEM;
-  }
-  if (fseeko(pedfile, 0, SEEK_END)) {
-    goto ped_to_bed_ret_READ_FAIL;
-  }
-  ped_size = ftello(pedfile);
-  rewind(pedfile);
-  logprint("Scanning .ped file...");
-  fputs(" 0%", stdout);
-  fflush(stdout);
-  ped_next_thresh = ped_size / 100;
-  loadbuf[loadbuf_size - 1] = ' ';
-  pct = 0;
-  while (fgets(loadbuf, loadbuf_size, pedfile)) {
     if (!loadbuf[loadbuf_size - 1]) {
-      goto ped_to_bed_ret_NOMEM;
+      status = PED_SCAN_LINE_TOO_LONG;
+      break;
+    }
+    ulii = strlen(loadbuf);
+    cur_pos += ulii;
+    if (ulii >= ped_buflen) {
+      ped_buflen = ulii + 1;
     }
     col1_ptr = skip_initial_spaces(loadbuf);
     if (is_eoln_or_comment(*col1_ptr)) {
-      ulii = strlen(loadbuf) + 1;
-      if (ulii > ped_buflen) {
-	ped_buflen = ulii;
-      }
       continue;
     }
     if (fam_cols & FAM_COL_1) {
@@ -5279,49 +5665,53 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
     }
     bufptr = next_item_mult(col2_ptr, ped_col_skip - 1);
     if (no_more_items_kns(bufptr)) {
-      sprintf(logbuf, "\nError: Missing token(s) in .ped line: %s\n", col1_ptr);
-      goto ped_to_bed_ret_INVALID_FORMAT_2;
+      status = PED_SCAN_MISSING_TOKENS;
+      break;
     }
     if ((bufptr - col1_ptr) > (MAXLINELEN / 2) - 4) {
-      logprint("\nError: Pathologically long token(s) in .ped file.\n");
-      goto ped_to_bed_ret_INVALID_FORMAT;
+      status = PED_SCAN_LONG_TOKENS;
+      break;
     }
-    if (fwrite_checked(col1_ptr, strlen_se(col1_ptr), outfile)) {
-      goto ped_to_bed_ret_WRITE_FAIL;
+    if (fwrite_checked(col1_ptr, strlen_se(col1_ptr), famfile)) {
+      status = PED_SCAN_WRITE_FAIL;
+      break;
     }
-    putc('\t', outfile);
-    bufptr2 = write_item(col2_ptr, outfile);
+    putc('\t', famfile);
+    bufptr2 = write_item(col2_ptr, famfile);
     if (fam_cols & FAM_COL_34) {
-      bufptr2 = write_item(bufptr2, outfile);
-      bufptr2 = write_item(bufptr2, outfile);
+      bufptr2 = write_item(bufptr2, famfile);
+      bufptr2 = write_item(bufptr2, famfile);
     } else {
-      fwrite("0\t0\t", 1, 4, outfile);
+      fwrite("0\t0\t", 1, 4, famfile);
     }
     if (fam_cols & FAM_COL_5) {
-      bufptr2 = write_item_nt(bufptr2, outfile);
+      bufptr2 = write_item_nt(bufptr2, famfile);
     } else {
-      putc('0', outfile);
+      putc('0', famfile);
     }
-    putc('\t', outfile);
+    putc('\t', famfile);
     if (fam_cols & FAM_COL_6) {
-      fwrite(bufptr2, 1, strlen_se(bufptr2), outfile);
+      fwrite(bufptr2, 1, strlen_se(bufptr2), famfile);
     } else {
-      putc('-', outfile);
-      putc('9', outfile);
+      putc('-', famfile);
+      putc('9', famfile);
     }
-    if (putc_checked('\n', outfile)) {
-      goto ped_to_bed_ret_WRITE_FAIL;
+    if (putc_checked('\n', famfile)) {
+      status = PED_SCAN_WRITE_FAIL;
+      break;
     }
     marker_idx = 0;
     for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
       cc = *bufptr++;
       if (!cc) {
-        goto ped_to_bed_ret_INVALID_FORMAT_3;
+	status = PED_SCAN_TOO_FEW_MARKERS;
+	goto ped_scan_thread_ret;
       }
       bufptr = skip_initial_spaces(bufptr);
       cc2 = *bufptr++;
       if (!cc2) {
-	goto ped_to_bed_ret_INVALID_FORMAT_3;
+	status = PED_SCAN_TOO_FEW_MARKERS;
+	goto ped_scan_thread_ret;
       }
       bufptr = skip_initial_spaces(bufptr);
       if (IS_SET(marker_exclude, marker_uidx)) {
@@ -5329,1106 +5719,2609 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
       }
       if (cc == '0') {
 	if (cc2 != '0') {
-	  max_marker_allele_len = 2;
-	  break;
+	  status = PED_SCAN_RESTART;
+	  goto ped_scan_thread_ret;
 	}
 	marker_idx++;
 	continue;
       } else if (cc2 == '0') {
-	max_marker_allele_len = 2;
-	break;
+	status = PED_SCAN_RESTART;
+	goto ped_scan_thread_ret;
       }
-      uii = 4 * (map_is_unsorted? map_reverse[marker_idx] : marker_idx);
+      uii = 4 * (map_reverse? map_reverse[marker_idx] : marker_idx);
       if (incr_text_allele0(cc, &(marker_alleles[uii]), &(marker_allele_cts[uii])) ||
 	  incr_text_allele0(cc2, &(marker_alleles[uii]), &(marker_allele_cts[uii]))) {
-	max_marker_allele_len = 2;
-	break;
+	status = PED_SCAN_RESTART;
+	goto ped_scan_thread_ret;
       }
       marker_idx++;
     }
-    if ((max_marker_allele_len == 2) || (!is_eoln_kns(*bufptr))) {
-      // either multi-character alleles, or invalid format.  Restart scan.
-      putchar('\r');
-      logstr("\n");
-      sprintf(logbuf, "Possibly irregular .ped line.  Restarting scan, assuming multichar alleles.\n");
-      logprintb();
-      max_marker_allele_len = 2;
+    if (!is_eoln_kns(*bufptr)) {
+      status = PED_SCAN_RESTART;
       break;
     }
-    ulii = strlen(bufptr) + (uintptr_t)(bufptr - loadbuf) + 1;
-    if (ulii > ped_buflen) {
-      ped_buflen = ulii;
-    }
     indiv_ct++;
-    if (ftello(pedfile) >= ped_next_thresh) {
-      uii = (ftello(pedfile) * 100) / ped_size;
-      if (pct >= 10) {
-	putchar('\b');
+    if ((!tidx) && (cur_pos >= ped_next_thresh)) {
+      uii = (cur_pos * 100) / chunk_end;
+      if (uii > pct) {
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", uii);
+	fflush(stdout);
+	pct = uii;
       }
-      printf("\b\b%u%%", uii);
-      fflush(stdout);
-      pct = uii;
+      ped_next_thresh = ((uii + 1) * chunk_end) / 100;
     }
   }
-  if (max_marker_allele_len == 1) {
-    if (!feof(pedfile)) {
-      goto ped_to_bed_ret_READ_FAIL;
-    }
-    if (!indiv_ct) {
-      sprintf(logbuf, "\nError: No %s in .ped file.\n", g_species_plural);
-      goto ped_to_bed_ret_INVALID_FORMAT_2;
-    }
-    if (fclose_null(&outfile)) {
-      goto ped_to_bed_ret_WRITE_FAIL;
-    }
-    memcpy(outname_end, ".bim", 5);
-    if (fopen_checked(&outfile, outname, "w")) {
-      goto ped_to_bed_ret_OPEN_FAIL;
-    }
-    if (map_is_unsorted) {
-      memcpy(outname_end, ".map.tmp", 9);
-      if (fopen_checked(&mapfile, outname, "r")) {
-	goto ped_to_bed_ret_OPEN_FAIL;
+ ped_scan_thread_ret:
+  g_pb_status[tidx] = status;
+  g_pb_err_lines[tidx] = col1_ptr;
+  g_pb_indiv_cts[tidx] = indiv_ct;
+  g_pb_ped_buflens[tidx] = ped_buflen;
+  THREAD_RETURN;
+}
+
+int32_t ped_scan_merge_alleles(uint32_t tidx, uintptr_t marker_ct) {
+  // Folds thread tidx's allele table into thread 0's.  Returns 1 if some
+  // marker ends up with more than four alleles.
+  char* src_alleles = g_pb_marker_alleles[tidx];
+  uint32_t* src_cts = g_pb_marker_allele_cts[tidx];
+  char* dst_alleles = g_pb_marker_alleles[0];
+  uint32_t* dst_cts = g_pb_marker_allele_cts[0];
+  uintptr_t ulii;
+  uint32_t uii;
+  uint32_t ujj;
+  char cc;
+  for (ulii = 0; ulii < marker_ct * 4; ulii += 4) {
+    for (uii = 0; uii < 4; uii++) {
+      cc = src_alleles[ulii + uii];
+      if (!cc) {
+	break;
       }
-    } else {
-      rewind(mapfile);
-    }
-    logstr(" done.\n");
-    fputs("\r.ped scan complete (for binary autoconversion).\n", stdout);
-    marker_uidx = 0;
-    for (marker_idx = 0; marker_idx < marker_ct; marker_idx++) {
-      if (map_is_unsorted) {
-	if (!fgets(tbuf, MAXLINELEN, mapfile)) {
-	  goto ped_to_bed_ret_READ_FAIL;
-	}
-      } else {
-	if (get_next_noncomment_excl(mapfile, &bufptr, marker_exclude, &marker_uidx)) {
-	  goto ped_to_bed_ret_READ_FAIL;
+      for (ujj = 0; ujj < 4; ujj++) {
+	if (!dst_alleles[ulii + ujj]) {
+	  dst_alleles[ulii + ujj] = cc;
+	  dst_cts[ulii + ujj] = src_cts[ulii + uii];
+	  break;
+	} else if (dst_alleles[ulii + ujj] == cc) {
+	  dst_cts[ulii + ujj] += src_cts[ulii + uii];
+	  break;
 	}
       }
-      if (marker_alleles[marker_idx * 4 + 2]) {
-	cc = marker_alleles[marker_idx * 4 + 3];
-	if (map_is_unsorted) {
-	  sprintf(logbuf, "Warning: Marker %u (post-sort/filter) %sallelic; setting rarest missing.\n", map_reverse[marker_idx] + 1, (cc? "quad" : "tri"));
-	} else {
-	  sprintf(logbuf, "Warning: Marker %" PRIuPTR " %sallelic; setting rarest alleles missing.\n", marker_idx + 1, (cc? "quad" : "tri"));
-	}
-	logprintb();
-	ujj = (cc? 4 : 3);
-	// insertion sort
-	for (uii = 1; uii < ujj; uii++) {
-	  ukk = marker_allele_cts[4 * marker_idx + uii];
-	  if (marker_allele_cts[4 * marker_idx + uii - 1] < ukk) {
-	    cc = marker_alleles[4 * marker_idx + uii];
-	    umm = uii;
-	    do {
-	      umm--;
-	      marker_alleles[4 * marker_idx + umm + 1] = marker_alleles[4 * marker_idx + umm];
-	      marker_allele_cts[4 * marker_idx + umm + 1] = marker_allele_cts[4 * marker_idx + umm];
-	    } while (umm && (marker_allele_cts[4 * marker_idx + umm - 1] < ukk));
-	    marker_alleles[4 * marker_idx + umm] = cc;
-	    marker_allele_cts[4 * marker_idx + umm] = ukk;
-	  }
-	}
-	cc = marker_alleles[marker_idx * 4 + 1];
-	cc2 = marker_alleles[marker_idx * 4];
-      } else {
-	if (marker_allele_cts[marker_idx * 4] >= marker_allele_cts[marker_idx * 4 + 1]) {
-	  cc = marker_alleles[marker_idx * 4 + 1];
-	  cc2 = marker_alleles[marker_idx * 4];
-	} else {
-	  cc = marker_alleles[marker_idx * 4];
-	  cc2 = marker_alleles[marker_idx * 4 + 1];
-	}
+      if (ujj == 4) {
+	return 1;
       }
-      marker_alleles_f[marker_idx * 2] = cc;
-      marker_alleles_f[marker_idx * 2 + 1] = cc2;
-      if (!cc) {
-	cc = '0';
+    }
+  }
+  return 0;
+}
+
+int32_t ped_scan_parallel(char* pedname, char* outname, char* outname_end, FILE* pedfile, FILE* famfile, int64_t ped_size, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, uint32_t* map_reverse, uint32_t fam_cols, uint32_t ped_col_skip, char* marker_alleles, uint32_t* marker_allele_cts, uintptr_t* indiv_ct_ptr, uint32_t* ped_buflen_ptr, uintptr_t* max_marker_allele_len_ptr) {
+  // Parallel version of ped_to_bed()'s first scan.  Returns -1 if the caller
+  // should fall back on the serial scan (too little memory, or a line too
+  // long for the per-thread buffers).  On success, the per-thread .ped handles
+  // are left open for ped_encode_parallel(), unless the scan ran into
+  // multichar alleles, in which case *max_marker_allele_len_ptr is set to 2.
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t table_size = CACHEALIGN(marker_ct * 4) + CACHEALIGN(marker_ct * 4 * sizeof(int32_t));
+  uintptr_t min_line_len = 4 * unfiltered_marker_ct + MAXLINELEN;
+  uintptr_t thread_ct = g_thread_ct;
+  uintptr_t indiv_ct = 0;
+  uintptr_t ped_buflen = 1;
+  int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
+  uintptr_t loadbuf_size;
+  uint32_t status = PED_SCAN_OK;
+  uintptr_t tidx;
+  size_t read_ct;
+  if ((uint64_t)thread_ct > 1 + (uint64_t)ped_size / PED_MIN_BYTES_PER_THREAD) {
+    thread_ct = 1 + ped_size / PED_MIN_BYTES_PER_THREAD;
+  }
+  while ((thread_ct > 1) && ((thread_ct - 1) * table_size + thread_ct * (min_line_len + CACHELINE) > wkspace_left)) {
+    thread_ct--;
+  }
+  if (thread_ct < 2) {
+    return -1;
+  }
+  g_pb_marker_alleles[0] = marker_alleles;
+  g_pb_marker_allele_cts[0] = marker_allele_cts;
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    g_pb_marker_alleles[tidx] = (char*)wkspace_alloc(marker_ct * 4);
+    g_pb_marker_allele_cts[tidx] = (uint32_t*)wkspace_alloc(marker_ct * 4 * sizeof(int32_t));
+    memset(g_pb_marker_alleles[tidx], 0, marker_ct * 4);
+  }
+  loadbuf_size = (wkspace_left / thread_ct) & (~(CACHELINE - ONELU));
+  if (loadbuf_size > MAXLINEBUFLEN) {
+    loadbuf_size = MAXLINEBUFLEN;
+  }
+  for (tidx = 0; tidx < thread_ct; tidx++) {
+    g_pb_loadbufs[tidx] = (char*)wkspace_alloc(loadbuf_size);
+    g_pb_pedfiles[tidx] = NULL;
+    g_pb_famfiles[tidx] = NULL;
+    g_pb_chunk_starts[tidx] = (ped_size * tidx) / thread_ct;
+  }
+  g_pb_chunk_starts[thread_ct] = ped_size;
+  g_pb_loadbuf_size = loadbuf_size;
+  g_pb_thread_ct = thread_ct;
+  g_pb_pedfiles[0] = pedfile;
+  g_pb_famfiles[0] = famfile;
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    if (fopen_checked(&(g_pb_pedfiles[tidx]), pedname, "rb")) {
+      goto ped_scan_parallel_ret_OPEN_FAIL;
+    }
+    sprintf(outname_end, ".fam.tmp%" PRIuPTR, tidx);
+    if (fopen_checked(&(g_pb_famfiles[tidx]), outname, "w")) {
+      goto ped_scan_parallel_ret_OPEN_FAIL;
+    }
+  }
+  g_pb_unfiltered_marker_ct = unfiltered_marker_ct;
+  g_pb_marker_exclude = marker_exclude;
+  g_pb_map_reverse = map_reverse;
+  g_pb_fam_cols = fam_cols;
+  g_pb_ped_col_skip = ped_col_skip;
+  if (spawn_threads(threads, &ped_scan_thread, thread_ct)) {
+    logprint(errstr_thread_create);
+    goto ped_scan_parallel_ret_THREAD_CREATE_FAIL;
+  }
+  tidx = 0;
+  ped_scan_thread((void*)tidx);
+  join_threads(threads, thread_ct);
+  for (tidx = 0; tidx < thread_ct; tidx++) {
+    // tables must be merged before the status check, since the serial scan
+    // would have restarted on a fifth allele before reaching a truncated line
+    if (tidx && ped_scan_merge_alleles(tidx, marker_ct)) {
+      status = PED_SCAN_RESTART;
+    } else {
+      status = g_pb_status[tidx];
+    }
+    if (g_pb_ped_buflens[tidx] > ped_buflen) {
+      ped_buflen = g_pb_ped_buflens[tidx];
+    }
+    if (status != PED_SCAN_OK) {
+      break;
+    }
+    indiv_ct += g_pb_indiv_cts[tidx];
+  }
+  switch (status) {
+  case PED_SCAN_OK:
+    // append the other threads' .fam lines
+    for (tidx = 1; tidx < thread_ct; tidx++) {
+      if (fclose_null(&(g_pb_famfiles[tidx]))) {
+	goto ped_scan_parallel_ret_WRITE_FAIL;
       }
-      if (!cc2) {
-	cc2 = '0';
+      sprintf(outname_end, ".fam.tmp%" PRIuPTR, tidx);
+      if (fopen_checked(&(g_pb_famfiles[tidx]), outname, "rb")) {
+	goto ped_scan_parallel_ret_OPEN_FAIL;
       }
-      if (map_is_unsorted) {
-	bufptr = (char*)memchr(tbuf, '\n', MAXLINELEN);
-	if (fwrite_checked(tbuf, bufptr - tbuf, outfile)) {
-	  goto ped_to_bed_ret_WRITE_FAIL;
-	}
-      } else {
-	bufptr = write_item(bufptr, outfile);
-	bufptr = write_item(bufptr, outfile);
-	if (cm_col) {
-	  bufptr = write_item_nt(bufptr, outfile);
-	} else {
-	  putc('0', outfile);
+      do {
+	read_ct = fread(tbuf, 1, MAXLINELEN, g_pb_famfiles[tidx]);
+	if (fwrite_checked(tbuf, read_ct, famfile)) {
+	  goto ped_scan_parallel_ret_WRITE_FAIL;
 	}
-	putc('\t', outfile);
-	fwrite(bufptr, 1, strlen_se(bufptr), outfile);
-      }
-      putc('\t', outfile);
-      putc(cc, outfile);
-      putc('\t', outfile);
-      putc(cc2, outfile);
-      if (putc_checked('\n', outfile)) {
-	goto ped_to_bed_ret_WRITE_FAIL;
+      } while (read_ct == MAXLINELEN);
+      if (ferror(g_pb_famfiles[tidx])) {
+	goto ped_scan_parallel_ret_READ_FAIL;
       }
-      marker_uidx++;
-    }
-    indiv_ct4 = (indiv_ct + 3) / 4;
-    wkspace_reset((unsigned char*)marker_alleles);
-    fclose_null(&mapfile);
-    if (map_is_unsorted) {
+      fclose_null(&(g_pb_famfiles[tidx]));
       unlink(outname);
     }
-    fclose_null(&outfile);
-    if (wkspace_alloc_c_checked(&loadbuf, ped_buflen)) {
-      goto ped_to_bed_ret_NOMEM;
+    *indiv_ct_ptr = indiv_ct;
+    *ped_buflen_ptr = ped_buflen;
+    break;
+  case PED_SCAN_RESTART:
+    putchar('\r');
+    logstr("\n");
+    sprintf(logbuf, "Possibly irregular .ped line.  Restarting scan, assuming multichar alleles.\n");
+    logprintb();
+    *max_marker_allele_len_ptr = 2;
+    ped_to_bed_parallel_cleanup(outname, outname_end);
+    break;
+  case PED_SCAN_MISSING_TOKENS:
+    sprintf(logbuf, "\nError: Missing token(s) in .ped line: %s\n", g_pb_err_lines[tidx]);
+    goto ped_scan_parallel_ret_INVALID_FORMAT_2;
+  case PED_SCAN_LONG_TOKENS:
+    logprint("\nError: Pathologically long token(s) in .ped file.\n");
+    goto ped_scan_parallel_ret_INVALID_FORMAT;
+  case PED_SCAN_TOO_FEW_MARKERS:
+    sprintf(logbuf, "Error: Not enough markers in .ped line %" PRIuPTR ".\n", indiv_ct + g_pb_indiv_cts[tidx] + 1);
+    goto ped_scan_parallel_ret_INVALID_FORMAT_2;
+  case PED_SCAN_LINE_TOO_LONG:
+    retval = -1;
+    ped_to_bed_parallel_cleanup(outname, outname_end);
+    break;
+  case PED_SCAN_READ_FAIL:
+    goto ped_scan_parallel_ret_READ_FAIL;
+  case PED_SCAN_WRITE_FAIL:
+    goto ped_scan_parallel_ret_WRITE_FAIL;
+  }
+  while (0) {
+  ped_scan_parallel_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  ped_scan_parallel_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  ped_scan_parallel_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  ped_scan_parallel_ret_INVALID_FORMAT_2:
+    logprintb();
+  ped_scan_parallel_ret_INVALID_FORMAT:
+    retval = RET_INVALID_FORMAT;
+    break;
+  ped_scan_parallel_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
+  }
+  if (retval > 0) {
+    ped_to_bed_parallel_cleanup(outname, outname_end);
+  }
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+THREAD_RET_TYPE ped_encode_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  FILE* pedfile = g_pb_pedfiles[tidx];
+  char* loadbuf = g_pb_loadbufs[tidx];
+  uintptr_t loadbuf_size = g_pb_loadbuf_size;
+  uintptr_t unfiltered_marker_ct = g_pb_unfiltered_marker_ct;
+  uintptr_t* marker_exclude = g_pb_marker_exclude;
+  uintptr_t marker_ct = g_pb_marker_ct;
+  uint32_t* map_reverse = g_pb_map_reverse;
+  uint32_t ped_col_skip = g_pb_ped_col_skip;
+  char* marker_alleles_f = g_pb_marker_alleles_f;
+  unsigned char* writebuf = g_pb_writebuf;
+  uintptr_t indiv_ct4 = g_pb_indiv_ct4;
+  uintptr_t indiv_start = g_pb_indiv_starts[tidx];
+  uintptr_t indiv_end = g_pb_indiv_starts[tidx + 1];
+  uintptr_t indiv_idx = indiv_start;
+  uint32_t status = PED_SCAN_OK;
+  uint32_t pct = 0;
+  uintptr_t skip_ct;
+  unsigned char* wbufptr;
+  char* col1_ptr;
+  char* bufptr;
+  uintptr_t marker_uidx;
+  uintptr_t marker_idx;
+  uint32_t ii_shift;
+  uint32_t uii;
+  uint32_t ukk;
+  uint32_t umm;
+  unsigned char ucc;
+  char cc;
+  char cc2;
+  if (indiv_idx >= indiv_end) {
+    goto ped_encode_thread_ret;
+  }
+  // the first few lines of this chunk may belong to the previous range
+  skip_ct = indiv_idx;
+  for (uii = 0; uii < tidx; uii++) {
+    skip_ct -= g_pb_indiv_cts[uii];
+  }
+  if (ped_chunk_seek(pedfile, tidx) < 0) {
+    status = PED_SCAN_READ_FAIL;
+    goto ped_encode_thread_ret;
+  }
+  while (indiv_idx < indiv_end) {
+    if (!fgets(loadbuf, loadbuf_size, pedfile)) {
+      status = PED_SCAN_READ_FAIL;
+      break;
     }
-    if (wkspace_left >= marker_ct * indiv_ct4) {
-      markers_per_pass = marker_ct;
-      sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " marker%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", indiv_ct, species_str(indiv_ct));
-      pass_ct = 1;
+    col1_ptr = skip_initial_spaces(loadbuf);
+    if (is_eoln_or_comment(*col1_ptr)) {
+      continue;
+    }
+    if (skip_ct) {
+      skip_ct--;
+      continue;
+    }
+    bufptr = next_item_mult(col1_ptr, ped_col_skip);
+    ii_shift = (indiv_idx % 4) * 2;
+    wbufptr = &(writebuf[indiv_idx / 4]);
+    if (map_reverse) {
+      umm = 0;
+      for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+	cc = *bufptr++;
+	bufptr = skip_initial_spaces(bufptr);
+	cc2 = *bufptr++;
+	bufptr = skip_initial_spaces(bufptr);
+	if (IS_SET(marker_exclude, marker_uidx)) {
+	  continue;
+	}
+	ukk = map_reverse[umm++];
+	ucc = 1;
+	if (cc == marker_alleles_f[2 * ukk + 1]) {
+	  if (cc2 == cc) {
+	    ucc = 3;
+	  } else if (cc2 == marker_alleles_f[2 * ukk]) {
+	    ucc = 2;
+	  }
+	} else if (cc == marker_alleles_f[2 * ukk]) {
+	  if (cc2 == cc) {
+	    ucc = 0;
+	  } else if (cc2 == marker_alleles_f[2 * ukk + 1]) {
+	    ucc = 2;
+	  }
+	}
+	wbufptr[ukk * indiv_ct4] |= ucc << ii_shift;
+      }
     } else {
-      if (!map_is_unsorted) {
-	if (wkspace_alloc_ll_checked(&line_starts, indiv_ct * sizeof(int64_t))) {
-	  goto ped_to_bed_ret_NOMEM;
+      marker_idx = 0;
+      for (marker_uidx = 0; marker_idx < marker_ct; marker_uidx++) {
+	cc = *bufptr++;
+	bufptr = skip_initial_spaces(bufptr);
+	cc2 = *bufptr++;
+	bufptr = skip_initial_spaces(bufptr);
+	if (IS_SET(marker_exclude, marker_uidx)) {
+	  continue;
+	}
+	ucc = 1;
+	if (cc == marker_alleles_f[2 * marker_idx + 1]) {
+	  if (cc2 == cc) {
+	    ucc = 3;
+	  } else if (cc2 == marker_alleles_f[2 * marker_idx]) {
+	    ucc = 2;
+	  }
+	} else if (cc == marker_alleles_f[2 * marker_idx]) {
+	  if (cc2 == cc) {
+	    ucc = 0;
+	  } else if (cc2 == marker_alleles_f[2 * marker_idx + 1]) {
+	    ucc = 2;
+	  }
 	}
+	*wbufptr |= ucc << ii_shift;
+	wbufptr = &(wbufptr[indiv_ct4]);
+	marker_idx++;
       }
-      markers_per_pass = wkspace_left / indiv_ct4;
-      if (!markers_per_pass) {
-	goto ped_to_bed_ret_NOMEM;
+    }
+    indiv_idx++;
+    if (!tidx) {
+      // 94 instead of 100 due to big fwrite at the end
+      uii = ((uint64_t)(indiv_idx - indiv_start) * 94) / (indiv_end - indiv_start);
+      if (uii > pct) {
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", uii);
+	fflush(stdout);
+	pct = uii;
       }
-      pass_ct = (marker_ct + markers_per_pass - 1) / markers_per_pass;
-      sprintf(logbuf, "Performing %u-pass .bed write (%u/%" PRIuPTR " marker%s/pass, %" PRIuPTR " %s).\n", pass_ct, markers_per_pass, marker_ct, (markers_per_pass == 1)? "" : "s", indiv_ct, species_str(indiv_ct));
     }
-    logprintb();
-    writebuf = wkspace_base;
-    memcpy(outname_end, ".bed", 5);
-    if (fopen_checked(&outfile, outname, "wb")) {
-      goto ped_to_bed_ret_OPEN_FAIL;
+  }
+ ped_encode_thread_ret:
+  g_pb_status[tidx] = status;
+  THREAD_RETURN;
+}
+
+int32_t ped_encode_parallel(char* outname, char* outname_end, FILE** outfile_ptr, char* loadbuf, uintptr_t ped_buflen, uintptr_t marker_ct, uintptr_t indiv_ct, char* marker_alleles_f) {
+  // Single-pass .bed write using the handles opened by ped_scan_parallel().
+  // Returns -1, without writing anything, if there isn't enough memory to
+  // hold the entire .bed plus a line buffer per thread.
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t thread_ct = g_pb_thread_ct;
+  uintptr_t indiv_ct4 = (indiv_ct + 3) / 4;
+  uintptr_t chunk_indiv_start = 0;
+  int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
+  uintptr_t tidx;
+  if ((thread_ct - 1) * CACHEALIGN(ped_buflen) + marker_ct * indiv_ct4 > wkspace_left) {
+    return -1;
+  }
+  g_pb_loadbufs[0] = loadbuf;
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    g_pb_loadbufs[tidx] = (char*)wkspace_alloc(ped_buflen);
+  }
+  g_pb_loadbuf_size = ped_buflen;
+  g_pb_indiv_starts[0] = 0;
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    chunk_indiv_start += g_pb_indiv_cts[tidx - 1];
+    g_pb_indiv_starts[tidx] = (chunk_indiv_start + 3) & (~(3 * ONELU));
+    if (g_pb_indiv_starts[tidx] > indiv_ct) {
+      g_pb_indiv_starts[tidx] = indiv_ct;
     }
-    if (fwrite_checked("l\x1b\x01", 3, outfile)) {
-      goto ped_to_bed_ret_WRITE_FAIL;
+  }
+  g_pb_indiv_starts[thread_ct] = indiv_ct;
+  sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " marker%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", indiv_ct, species_str(indiv_ct));
+  logprintb();
+  g_pb_writebuf = wkspace_base;
+  memset(g_pb_writebuf, 0, marker_ct * indiv_ct4);
+  g_pb_marker_ct = marker_ct;
+  g_pb_marker_alleles_f = marker_alleles_f;
+  g_pb_indiv_ct4 = indiv_ct4;
+  memcpy(outname_end, ".bed", 5);
+  if (fopen_checked(outfile_ptr, outname, "wb")) {
+    wkspace_reset(wkspace_mark);
+    return RET_OPEN_FAIL;
+  }
+  fputs("0%", stdout);
+  fflush(stdout);
+  if (spawn_threads(threads, &ped_encode_thread, thread_ct)) {
+    putchar('\n');
+    logprint(errstr_thread_create);
+    wkspace_reset(wkspace_mark);
+    return RET_THREAD_CREATE_FAIL;
+  }
+  tidx = 0;
+  ped_encode_thread((void*)tidx);
+  join_threads(threads, thread_ct);
+  for (tidx = 0; tidx < thread_ct; tidx++) {
+    if (g_pb_status[tidx]) {
+      putchar('\n');
+      retval = RET_READ_FAIL;
+      goto ped_encode_parallel_ret_1;
     }
-    rewind(pedfile);
-    umm = 0;
-    for (uii = 0; uii < pass_ct; uii++) {
-      marker_start = uii * markers_per_pass;
-      if (uii + 1 == pass_ct) {
-	ujj = marker_ct - marker_start;
-	last_pass = 1;
-      } else {
-	ujj = markers_per_pass;
-      }
-      memset(writebuf, 0, ujj * indiv_ct4);
-      marker_end = marker_start + ujj;
-      fputs("0%", stdout);
-      indiv_idx = 0;
-      // 94 instead of 100 due to big fwrite at the end
-      for (pct = 1; pct <= 94; pct++) {
-	loop_end = (((uint64_t)pct) * indiv_ct) / 94LLU;
-	for (; indiv_idx < loop_end; indiv_idx++) {
-	  if ((!uii) || map_is_unsorted) {
-	    do {
-	      if (!last_pass) {
-		ped_next_thresh = ftello(pedfile);
-	      }
-	      if (!fgets(loadbuf, ped_buflen, pedfile)) {
-		goto ped_to_bed_ret_READ_FAIL_2;
-	      }
-	      col1_ptr = skip_initial_spaces(loadbuf);
-	    } while (is_eoln_or_comment(*col1_ptr));
-	    bufptr = next_item_mult(col1_ptr, ped_col_skip);
-	  } else {
-	    ped_next_thresh = line_starts[indiv_idx];
-	    if (fseeko(pedfile, line_starts[indiv_idx], SEEK_SET)) {
-	      goto ped_to_bed_ret_READ_FAIL_2;
-	    }
-	    if (!fgets(loadbuf, ped_buflen, pedfile)) {
-	      goto ped_to_bed_ret_READ_FAIL_2;
-	    }
-	    bufptr = loadbuf;
-	  }
-	  marker_idx = uii * markers_per_pass;
-	  ii_shift = (indiv_idx % 4) * 2;
-	  wbufptr = &(writebuf[indiv_idx / 4]);
-	  if (map_is_unsorted) {
-	    // multipass optimizations are possible, but we won't bother,
-	    // especially since the .map should rarely be unsorted in the first
-	    // place...
-	    umm = 0;
-	    for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
-	      cc = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      cc2 = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      if (IS_SET(marker_exclude, marker_uidx)) {
-		continue;
-	      }
-	      ukk = map_reverse[umm++];
-	      if ((ukk >= marker_start) && (ukk < marker_end)) {
-		ucc = 1;
-		if (cc == marker_alleles_f[2 * ukk + 1]) {
-		  if (cc2 == cc) {
-		    ucc = 3;
-		  } else if (cc2 == marker_alleles_f[2 * ukk]) {
-		    ucc = 2;
-		  }
-		} else if (cc == marker_alleles_f[2 * ukk]) {
-		  if (cc2 == cc) {
-		    ucc = 0;
-		  } else if (cc2 == marker_alleles_f[2 * ukk + 1]) {
-		    ucc = 2;
-		  }
-		}
-		wbufptr[(ukk - marker_start) * indiv_ct4] |= ucc << ii_shift;
-		marker_idx++;
-	      }
-	    }
-	  } else {
-	    for (marker_uidx = umm; marker_idx < marker_end; marker_uidx++) {
-	      cc = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      cc2 = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      if (IS_SET(marker_exclude, marker_uidx)) {
-		continue;
-	      }
-	      ucc = 1;
-	      if (cc == marker_alleles_f[2 * marker_idx + 1]) {
-		if (cc2 == cc) {
-		  ucc = 3;
-		} else if (cc2 == marker_alleles_f[2 * marker_idx]) {
-		  ucc = 2;
-		}
-	      } else if (cc == marker_alleles_f[2 * marker_idx]) {
-		if (cc2 == cc) {
-		  ucc = 0;
-		} else if (cc2 == marker_alleles_f[2 * marker_idx + 1]) {
-		  ucc = 2;
-		}
-	      }
-	      *wbufptr |= ucc << ii_shift;
-	      wbufptr = &(wbufptr[indiv_ct4]);
-	      marker_idx++;
-	    }
-	    if (!last_pass) {
-	      line_starts[indiv_idx] = ped_next_thresh + (uintptr_t)(bufptr - loadbuf);
-	    }
-	  }
-	}
-	if (pct > 10) {
-	  putchar('\b');
-	}
-	printf("\b\b%u%%", pct);
-	fflush(stdout);
-      }
-      if (fwrite_checked(writebuf, ujj * indiv_ct4, outfile)) {
-	goto ped_to_bed_ret_WRITE_FAIL_2;
-      }
-      if (!last_pass) {
-	printf("\rPass %u:    \b\b\b", uii + 2);
-	fflush(stdout);
-	if (map_is_unsorted) {
-	  rewind(pedfile);
-	} else {
-	  umm = marker_uidx;
-	}
-      }
-    }
-  } else {
-    retval = ped_to_bed_multichar_allele(max_marker_allele_len, &pedfile, &outfile, outname, outname_end, &mapfile, unfiltered_marker_ct, marker_exclude, marker_ct, marker_alleles_f, map_is_unsorted, fam_cols, ped_col_skip, cm_col, map_reverse, ped_size);
-    if (retval) {
-      goto ped_to_bed_ret_1;
-    }
-  }
-
-  if (fclose_null(&outfile)) {
-    goto ped_to_bed_ret_WRITE_FAIL_2;
   }
-  putchar('\r');
-  sprintf(logbuf, "--file: binary fileset written to %s + .bim + .fam.\n", outname);
-  logprintb();
-
-  while (0) {
-  ped_to_bed_ret_NOMEM:
-    retval = RET_NOMEM;
-    break;
-  ped_to_bed_ret_OPEN_FAIL:
-    retval = RET_OPEN_FAIL;
-    break;
-  ped_to_bed_ret_READ_FAIL_2:
-    putchar('\n');
-  ped_to_bed_ret_READ_FAIL:
-    retval = RET_READ_FAIL;
-    break;
-  ped_to_bed_ret_WRITE_FAIL_2:
+  if (fwrite_checked("l\x1b\x01", 3, *outfile_ptr) || fwrite_checked(g_pb_writebuf, marker_ct * indiv_ct4, *outfile_ptr)) {
     putchar('\n');
-  ped_to_bed_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
-    break;
-  ped_to_bed_ret_INVALID_FORMAT_3:
-    sprintf(logbuf, "Error: Not enough markers in .ped line %" PRIuPTR ".\n", indiv_ct + 1);
-  ped_to_bed_ret_INVALID_FORMAT_2:
-    logprintb();
-  ped_to_bed_ret_INVALID_FORMAT:
-    retval = RET_INVALID_FORMAT;
-    break;
   }
- ped_to_bed_ret_1:
-  fclose_cond(pedfile);
-  fclose_cond(mapfile);
-  fclose_cond(outfile);
+ ped_encode_parallel_ret_1:
   wkspace_reset(wkspace_mark);
   return retval;
 }
 
-// 256 - 32 = 224
-char one_char_strs[448];
-
-int32_t heapstr_alloc(char** new_sptr, char* new_str, uint32_t slen) {
-  char* sptr;
-  if (slen == 1) {
-    *new_sptr = &(one_char_strs[2 * (((unsigned char)(*new_str)) - ' ')]);
-    return 0;
-  } else {
-    sptr = (char*)malloc(slen + 1);
-    if (!sptr) {
-      return -1;
-    }
-    memcpy(sptr, new_str, slen + 1);
-    *new_sptr = sptr;
-    return 0;
-  }
-}
-
-void fill_bmap_short(unsigned char* bmap_short, uint32_t ct_mod4) {
-  unsigned char imap[4] = {3, 1, 2, 0};
-  unsigned char* bmap = bmap_short;
-  uint32_t uii;
-  uint32_t ujj;
-  uint32_t ukk;
-  uint32_t umm;
-  uint32_t unn;
-  uint32_t extra_ct;
-  for (uii = 0; uii < 4; uii++) {
-    umm = imap[uii] * 64;
-    for (ujj = 0; ujj < 4; ujj++) {
-      unn = umm + imap[ujj] * 16;
-      for (ukk = 0; ukk < 4; ukk++) {
-	extra_ct = unn + imap[ukk] * 4;
-	*bmap++ = extra_ct + 3;
-	*bmap++ = extra_ct + 1;
-	*bmap++ = extra_ct + 2;
-	*bmap++ = extra_ct;
-      }
-    }
-  }
-  if (ct_mod4) {
-    switch (ct_mod4) {
-    case 1:
-      bmap[0] = 3;
-      bmap[1] = 1;
-      bmap[2] = 2;
-      bmap[3] = 0;
-      return;
-    case 2:
-      for (uii = 0; uii < 4; uii++) {
-	ukk = imap[uii] * 4;
-	*bmap++ = ukk + 3;
-	*bmap++ = ukk + 1;
-	*bmap++ = ukk + 2;
-	*bmap++ = ukk;
-      }
-      return;
-    case 3:
-      for (uii = 0; uii < 4; uii++) {
-	ukk = imap[uii] * 16;
-	for (ujj = 0; ujj < 4; ujj++) {
-	  umm = ukk + imap[ujj] * 4;
-	  *bmap++ = umm + 3;
-	  *bmap++ = umm + 1;
-	  *bmap++ = umm + 2;
-	  *bmap++ = umm;
-	}
-      }
-    }
-  }
-}
-
-void fill_bmap_raw(unsigned char* bmap_raw, uint32_t ct_mod4) {
-  // possibilities:
-  // 0. A1 -> A1, A2 -> A2 [0..255]
-  // 1. A1 -> A2, A2 -> A1 [256..511]
-  // 1 last char. [512..575]
-  uint32_t uii = 0;
-  do {
-    *bmap_raw++ = uii++;
-  } while (uii < 256);
-  fill_bmap_short(bmap_raw, ct_mod4);
-}
-
-int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, char missing_geno, int32_t missing_pheno, uint64_t misc_flags, uint32_t lgen_modifier, char* lgen_reference_fname, Chrom_info* chrom_info_ptr) {
+int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_end, uint32_t fam_cols, uint32_t affection_01, int32_t missing_pheno, Chrom_info* chrom_info_ptr) {
   unsigned char* wkspace_mark = wkspace_base;
-  FILE* infile = NULL;
+  FILE* mapfile = NULL;
+  FILE* pedfile = NULL;
   FILE* outfile = NULL;
-  char* name_end = (char*)memchr(lgen_namebuf, 0, FNAMESIZE);
-  uint32_t lgen_allele_count = lgen_modifier & LGEN_ALLELE_COUNT;
-  uint32_t affection_01 = (misc_flags / MISC_AFFECTION_01) & 1;
-  uint32_t map_cols = 3;
-  uintptr_t* marker_exclude = NULL;
-  uintptr_t marker_exclude_ct = 0;
+  uintptr_t* marker_exclude;
   uintptr_t max_marker_id_len = 0;
   uintptr_t unfiltered_marker_ct = 0;
-  uintptr_t max_person_id_len = 4;
+  uintptr_t marker_exclude_ct = 0;
   uintptr_t marker_ct = 0;
-  char** marker_alleles = NULL;
-  char* marker_ids = NULL;
-  uint32_t* marker_pos = NULL;
-  uintptr_t indiv_ct = 0;
-  char* person_ids = NULL;
-  char* paternal_ids = NULL;
-  uintptr_t max_paternal_id_len = 2;
-  char* maternal_ids = NULL;
-  uintptr_t max_maternal_id_len = 2;
-  uintptr_t* sex_nm = NULL;
-  uintptr_t* sex_male = NULL;
-  uint32_t affection = 0;
-  uintptr_t* founder_info = NULL;
-  uintptr_t* indiv_exclude = NULL;
   uint32_t map_is_unsorted = 0;
-  uint32_t compound_genotypes = 1; // 0 = no, 1 = unresolved, 2 = yes
-  uintptr_t* pheno_nm = NULL;
-  uintptr_t* pheno_c = NULL;
-  double* pheno_d = NULL;
-  char* sorted_marker_ids;
-  uint32_t* marker_id_map;
-  uint32_t* map_reverse;
-  char* sorted_indiv_ids;
-  uint32_t* indiv_id_map;
-  unsigned char* writebuf;
+  int32_t last_chrom = 0;
+  uint32_t last_mpos = 0;
+  uintptr_t indiv_ct = 0;
+  uint32_t ped_buflen = 1;
+  int32_t retval = 0;
+  uint32_t ped_col_skip = 1 + ((fam_cols & FAM_COL_1) / FAM_COL_1) + 2 * ((fam_cols & FAM_COL_34) / FAM_COL_34) + ((fam_cols & FAM_COL_5) / FAM_COL_5) + ((fam_cols & FAM_COL_6) / FAM_COL_6);
+  uint32_t last_pass = 0;
+  int64_t* line_starts = NULL;
+  uintptr_t max_marker_allele_len = 1;
+  uint32_t pass_ct;
   uintptr_t indiv_ct4;
+  uint32_t pct;
+  char* marker_alleles_f;
+  char* marker_alleles;
+  uint32_t* marker_allele_cts;
+  uint32_t* map_reverse;
+  uint32_t cm_col;
+  uint32_t markers_per_pass;
+  uint32_t marker_start;
+  uint32_t marker_end;
+  uintptr_t marker_uidx;
   uintptr_t marker_idx;
-  unsigned char ucc;
-  unsigned char* ucptr;
-  unsigned char bmap_short[320];
-  unsigned char* bmap2;
-  char* id_buf;
-  char* cptr;
-  char* cptr2;
-  char* cptr3;
-  char* cptr4;
-  char* a1ptr;
-  char* a2ptr;
-  char* sptr;
-  char* sptr2;
-  char** ma_end;
-  uint32_t a1len;
-  uint32_t a2len;
+  uint32_t loop_end;
   uintptr_t indiv_idx;
   uintptr_t ulii;
   uint32_t uii;
   uint32_t ujj;
   uint32_t ukk;
   uint32_t umm;
-  int64_t lgen_size;
-  uint32_t pct;
-  int64_t lgen_next_thresh;
   int32_t ii;
-  int32_t retval;
-  if (lgen_modifier == LGEN_ALLELE_COUNT) {
-    logprint("Error: --allele-count must be used with --reference.\n");
-    goto lgen_to_bed_ret_INVALID_CMDLINE;
+  char* loadbuf;
+  uintptr_t loadbuf_size;
+  char* col1_ptr;
+  char* col2_ptr;
+  char* bufptr;
+  char* bufptr2;
+  char cc;
+  char cc2;
+  unsigned char ucc;
+  uint32_t ii_shift;
+  unsigned char* writebuf;
+  unsigned char* wbufptr;
+  int64_t ped_size;
+  int64_t ped_next_thresh;
+  marker_exclude = (uintptr_t*)wkspace_base;
+  marker_exclude[0] = 0;
+  if (fopen_checked(&mapfile, mapname, "r")) {
+    goto ped_to_bed_ret_OPEN_FAIL;
   }
-  cptr = one_char_strs;
-  for (uii = 0; uii < 224; uii++) {
-    *cptr++ = (char)(uii + ' ');
-    *cptr++ = '\0';
+  tbuf[MAXLINELEN - 6] = ' ';
+  if (check_cm_col(mapfile, tbuf, 0, &cm_col)) {
+    sprintf(logbuf, "Error: Missing token(s) in .map line: %s", skip_initial_spaces(tbuf));
+    goto ped_to_bed_ret_INVALID_FORMAT_2;
   }
-
-  memcpy(name_end, ".map", 5);
-  retval = load_map(&infile, lgen_namebuf, &map_cols, &unfiltered_marker_ct, &marker_exclude_ct, &max_marker_id_len, &marker_exclude, &marker_ids, chrom_info_ptr, &marker_pos, &map_is_unsorted);
-  if (retval) {
-    goto lgen_to_bed_ret_1;
+  do {
+    if (!tbuf[MAXLINELEN - 6]) {
+      sprintf(logbuf, "Error: Excessively long line in .map file (max %u chars).\n", MAXLINELEN - 8);
+      goto ped_to_bed_ret_INVALID_FORMAT_2;
+    }
+    col1_ptr = skip_initial_spaces(tbuf);
+    if (is_eoln_or_comment(*col1_ptr)) {
+      continue;
+    }
+    col2_ptr = next_item(col1_ptr);
+    bufptr = next_item_mult(col2_ptr, 1 + cm_col);
+    if (no_more_items_kns(bufptr)) {
+      sprintf(logbuf, "Error: Missing token(s) in .map line: %s", col1_ptr);
+      goto ped_to_bed_ret_INVALID_FORMAT_2;
+    }
+    ii = marker_code(chrom_info_ptr, col1_ptr);
+    if (ii == -1) {
+      // no need to support allow_extra_chroms in .map files
+      logprint("Error: Invalid chromosome index in .map file.\n");
+      goto ped_to_bed_ret_INVALID_FORMAT;
+    }
+    if ((*bufptr == '-') || (!is_set(chrom_info_ptr->chrom_mask, ii))) {
+      SET_BIT(marker_exclude, unfiltered_marker_ct);
+      marker_exclude_ct++;
+    } else {
+      if ((*bufptr < '0') || (*bufptr > '9')) {
+	logprint("Error: Non-numeric marker position in .map file.\n");
+	goto ped_to_bed_ret_INVALID_FORMAT;
+      }
+      if (!map_is_unsorted) {
+	uii = atoi(bufptr);
+	if ((ii < last_chrom) || ((ii == last_chrom) && (uii < last_mpos))) {
+	  map_is_unsorted = 1;
+	}
+	last_chrom = ii;
+	last_mpos = uii;
+      }
+      uii = strlen_se(col2_ptr) + 1;
+      if (uii > max_marker_id_len) {
+	max_marker_id_len = uii;
+      }
+    }
+    unfiltered_marker_ct++;
+    if (unfiltered_marker_ct > 0x7fffffff) {
+      logprint("Error: Too many markers in .map file (max 2147483647).\n");
+      goto ped_to_bed_ret_INVALID_FORMAT;
+    }
+    if (!(unfiltered_marker_ct & (BITCT - 1))) {
+      if ((unfiltered_marker_ct / 8) == wkspace_left) {
+	goto ped_to_bed_ret_NOMEM;
+      }
+      marker_exclude[unfiltered_marker_ct / BITCT] = 0;
+    }
+  } while (fgets(tbuf, MAXLINELEN - 5, mapfile));
+  if (!feof(mapfile)) {
+    goto ped_to_bed_ret_READ_FAIL;
   }
   marker_ct = unfiltered_marker_ct - marker_exclude_ct;
-  retval = sort_item_ids(&sorted_marker_ids, &marker_id_map, unfiltered_marker_ct, marker_exclude, marker_exclude_ct, marker_ids, max_marker_id_len, 0, 0, strcmp_deref);
-  if (retval) {
-    goto lgen_to_bed_ret_1;
+  if (!marker_ct) {
+    logprint("Error: No markers in current analysis.\n");
+    goto ped_to_bed_ret_INVALID_FORMAT;
+  }
+  marker_exclude = (uintptr_t*)wkspace_alloc(((unfiltered_marker_ct + (BITCT - 1)) / BITCT) * sizeof(intptr_t));
+
+  // provisionally assume max_marker_allele_len == 1
+  if (wkspace_alloc_c_checked(&marker_alleles_f, marker_ct * 2)) {
+    goto ped_to_bed_ret_NOMEM;
   }
   if (map_is_unsorted) {
-    // Writes a temporary .map which is read later, and then deleted.
-    retval = load_sort_and_write_map(&map_reverse, infile, map_cols, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 0, chrom_info_ptr);
+    retval = load_sort_and_write_map(&map_reverse, mapfile, 3 + cm_col, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 1, chrom_info_ptr);
     if (retval) {
-      goto lgen_to_bed_ret_1;
-    }
-    for (uii = 0; uii < marker_ct; uii++) {
-      marker_id_map[uii] = map_reverse[marker_id_map[uii]];
+      goto ped_to_bed_ret_1;
     }
+    cm_col = 1;
+    fclose_null(&mapfile);
   }
-  // collapse
-  if (wkspace_alloc_ui_checked(&indiv_id_map, unfiltered_marker_ct * sizeof(int32_t))) {
-    goto lgen_to_bed_ret_NOMEM;
-  }
-  fill_uidx_to_idx(marker_exclude, unfiltered_marker_ct, marker_ct, indiv_id_map);
-  for (uii = 0; uii < marker_ct; uii++) {
-    marker_id_map[uii] = indiv_id_map[marker_id_map[uii]];
+  if (wkspace_alloc_c_checked(&marker_alleles, marker_ct * 4) ||
+      wkspace_alloc_ui_checked(&marker_allele_cts, marker_ct * 4 * sizeof(int32_t))) {
+    goto ped_to_bed_ret_NOMEM;
   }
-  fclose_null(&infile);
-  memcpy(marker_ids, sorted_marker_ids, marker_ct * max_marker_id_len);
-  wkspace_reset((unsigned char*)sorted_marker_ids);
+  memset(marker_alleles, 0, marker_ct * 4);
 
-  memcpy(name_end, ".fam", 5);
-  if (fopen_checked(&infile, lgen_namebuf, "r")) {
-    goto lgen_to_bed_ret_OPEN_FAIL;
-  }
-  retval = load_fam(infile, MAXLINELEN, FAM_COL_13456, 1, missing_pheno, intlen(missing_pheno), affection_01, &indiv_ct, &person_ids, &max_person_id_len, &paternal_ids, &max_paternal_id_len, &maternal_ids, &max_maternal_id_len, &sex_nm, &sex_male, &affection, &pheno_nm, &pheno_c, &pheno_d, &founder_info, &indiv_exclude);
-  if (retval) {
-    goto lgen_to_bed_ret_1;
+  // first .ped scan: count indivs, write .fam, note alleles at each locus
+  if (fopen_checked(&pedfile, pedname, "rb")) {
+    goto ped_to_bed_ret_OPEN_FAIL;
   }
-  fclose_null(&infile);
-  retval = sort_item_ids_nx(&sorted_indiv_ids, &indiv_id_map, indiv_ct, person_ids, max_person_id_len);
-  if (retval) {
-    goto lgen_to_bed_ret_1;
+  memcpy(outname_end, ".fam", 5);
+  if (fopen_checked(&outfile, outname, "w")) {
+    goto ped_to_bed_ret_OPEN_FAIL;
   }
-  if (wkspace_alloc_c_checked(&id_buf, MAXV(max_marker_id_len, max_person_id_len))) {
-    goto lgen_to_bed_ret_NOMEM;
+  loadbuf = (char*)wkspace_base;
+  loadbuf_size = wkspace_left;
+  if (loadbuf_size > MAXLINEBUFLEN) {
+    loadbuf_size = MAXLINEBUFLEN;
   }
-  marker_alleles = (char**)wkspace_alloc(2 * marker_ct * sizeof(char*));
-  if (!marker_alleles) {
-    goto lgen_to_bed_ret_NOMEM;
+  if (loadbuf_size <= MAXLINELEN) {
+    goto ped_to_bed_ret_NOMEM;
   }
-  memset(marker_alleles, 0, 2 * marker_ct * sizeof(char*));
-  indiv_ct4 = (indiv_ct + 3) / 4;
-  if (wkspace_alloc_uc_checked(&writebuf, ((uintptr_t)marker_ct) * indiv_ct4)) {
-    logprint("Error: Multipass .lgen -> .bed autoconversions are not yet supported.  Try\nusing --chr and/or --memory (perhaps with a better machine).\n");
-    goto lgen_to_bed_ret_CALC_NOT_YET_SUPPORTED;
+  if (fseeko(pedfile, 0, SEEK_END)) {
+    goto ped_to_bed_ret_READ_FAIL;
   }
-  if (indiv_ct % 4) {
-    ucc = 0x15 >> (6 - 2 * (indiv_ct % 4));
-    for (marker_idx = 0; marker_idx < marker_ct; marker_idx++) {
-      memset(&(writebuf[marker_idx * indiv_ct4]), 0x55, indiv_ct4 - 1);
-      writebuf[(marker_idx + 1) * indiv_ct4 - 1] = ucc;
+  ped_size = ftello(pedfile);
+  rewind(pedfile);
+  logprint("Scanning .ped file...");
+  fputs(" 0%", stdout);
+  fflush(stdout);
+  if (g_thread_ct > 1) {
+    retval = ped_scan_parallel(pedname, outname, outname_end, pedfile, outfile, ped_size, unfiltered_marker_ct, marker_exclude, marker_ct, map_is_unsorted? map_reverse : NULL, fam_cols, ped_col_skip, marker_alleles, marker_allele_cts, &indiv_ct, &ped_buflen, &max_marker_allele_len);
+    if (!retval) {
+      goto ped_to_bed_scan_done;
+    } else if (retval != -1) {
+      goto ped_to_bed_ret_1;
     }
-  } else {
-    memset(writebuf, 0x55, marker_ct * indiv_ct4);
+    // fall back on serial scan
+    retval = 0;
+    fclose_null(&outfile);
+    memcpy(outname_end, ".fam", 5);
+    if (fopen_checked(&outfile, outname, "w")) {
+      goto ped_to_bed_ret_OPEN_FAIL;
+    }
+    memset(marker_alleles, 0, marker_ct * 4);
+    rewind(pedfile);
   }
-  if (lgen_modifier & LGEN_REFERENCE) {
-    if (fopen_checked(&infile, lgen_reference_fname, "r")) {
-      goto lgen_to_bed_ret_OPEN_FAIL;
+  ped_next_thresh = ped_size / 100;
+  loadbuf[loadbuf_size - 1] = ' ';
+  pct = 0;
+  while (fgets(loadbuf, loadbuf_size, pedfile)) {
+    if (!loadbuf[loadbuf_size - 1]) {
+      goto ped_to_bed_ret_NOMEM;
     }
-    while (fgets(tbuf, MAXLINELEN, infile)) {
-      cptr = skip_initial_spaces(tbuf);
-      if (is_eoln_kns(*cptr)) {
-	continue;
-      }
-      cptr2 = item_end(cptr);
-      a1ptr = skip_initial_spaces(cptr2);
-      if (no_more_items_kns(a1ptr)) {
-	goto lgen_to_bed_ret_INVALID_FORMAT_4;
+    col1_ptr = skip_initial_spaces(loadbuf);
+    if (is_eoln_or_comment(*col1_ptr)) {
+      ulii = strlen(loadbuf) + 1;
+      if (ulii > ped_buflen) {
+	ped_buflen = ulii;
       }
-      a1len = strlen_se(cptr);
-      if (a1len < max_marker_id_len) {
-	memcpyx(id_buf, cptr, a1len, '\0');
-	ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
-	if (ii != -1) {
-	  marker_idx = marker_id_map[ii];
-	  if (marker_alleles[2 * marker_idx + 1]) {
-	    goto lgen_to_bed_ret_INVALID_FORMAT_4;
-	  }
-	  sptr = item_end(a1ptr);
-	  a2ptr = skip_initial_spaces(sptr);
-	  a1len = (uintptr_t)(sptr - a1ptr);
-	  a1ptr[a1len] = '\0';
-	  if (heapstr_alloc(&(marker_alleles[2 * marker_idx + 1]), a1ptr, a1len)) {
-	    goto lgen_to_bed_ret_NOMEM;
-	  }
-	  if (no_more_items_kns(a2ptr)) {
-	    if (lgen_allele_count) {
-	      a1ptr[a1len++] = 'v';
-	      a1ptr[a1len] = '\0';
-	      if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a1ptr, a1len)) {
-		goto lgen_to_bed_ret_NOMEM;
-	      }
-	    }
-	  } else {
-	    a2len = strlen_se(a2ptr);
-	    a2ptr[a2len] = '\0';
-	    if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
-	      goto lgen_to_bed_ret_NOMEM;
-	    }
-	  }
-	  memset(&(writebuf[marker_idx * indiv_ct4]), 0xff, indiv_ct / 4);
-	  if (indiv_ct % 4) {
-	    writebuf[(marker_idx + 1) * indiv_ct4 - 1] = 0x3f >> (6 - 2 * (indiv_ct % 4));
-	  }
+      continue;
+    }
+    if (fam_cols & FAM_COL_1) {
+      col2_ptr = next_item(col1_ptr);
+    } else {
+      col2_ptr = col1_ptr;
+    }
+    bufptr = next_item_mult(col2_ptr, ped_col_skip - 1);
+    if (no_more_items_kns(bufptr)) {
+      sprintf(logbuf, "\nError: Missing token(s) in .ped line: %s\n", col1_ptr);
+      goto ped_to_bed_ret_INVALID_FORMAT_2;
+    }
+    if ((bufptr - col1_ptr) > (MAXLINELEN / 2) - 4) {
+      logprint("\nError: Pathologically long token(s) in .ped file.\n");
+      goto ped_to_bed_ret_INVALID_FORMAT;
+    }
+    if (fwrite_checked(col1_ptr, strlen_se(col1_ptr), outfile)) {
+      goto ped_to_bed_ret_WRITE_FAIL;
+    }
+    putc('\t', outfile);
+    bufptr2 = write_item(col2_ptr, outfile);
+    if (fam_cols & FAM_COL_34) {
+      bufptr2 = write_item(bufptr2, outfile);
+      bufptr2 = write_item(bufptr2, outfile);
+    } else {
+      fwrite("0\t0\t", 1, 4, outfile);
+    }
+    if (fam_cols & FAM_COL_5) {
+      bufptr2 = write_item_nt(bufptr2, outfile);
+    } else {
+      putc('0', outfile);
+    }
+    putc('\t', outfile);
+    if (fam_cols & FAM_COL_6) {
+      fwrite(bufptr2, 1, strlen_se(bufptr2), outfile);
+    } else {
+      putc('-', outfile);
+      putc('9', outfile);
+    }
+    if (putc_checked('\n', outfile)) {
+      goto ped_to_bed_ret_WRITE_FAIL;
+    }
+    marker_idx = 0;
+    for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+      cc = *bufptr++;
+      if (!cc) {
+        goto ped_to_bed_ret_INVALID_FORMAT_3;
+      }
+      bufptr = skip_initial_spaces(bufptr);
+      cc2 = *bufptr++;
+      if (!cc2) {
+	goto ped_to_bed_ret_INVALID_FORMAT_3;
+      }
+      bufptr = skip_initial_spaces(bufptr);
+      if (IS_SET(marker_exclude, marker_uidx)) {
+	continue;
+      }
+      if (cc == '0') {
+	if (cc2 != '0') {
+	  max_marker_allele_len = 2;
+	  break;
 	}
+	marker_idx++;
+	continue;
+      } else if (cc2 == '0') {
+	max_marker_allele_len = 2;
+	break;
+      }
+      uii = 4 * (map_is_unsorted? map_reverse[marker_idx] : marker_idx);
+      if (incr_text_allele0(cc, &(marker_alleles[uii]), &(marker_allele_cts[uii])) ||
+	  incr_text_allele0(cc2, &(marker_alleles[uii]), &(marker_allele_cts[uii]))) {
+	max_marker_allele_len = 2;
+	break;
       }
+      marker_idx++;
     }
-    if (!feof(infile)) {
-      goto lgen_to_bed_ret_READ_FAIL;
+    if ((max_marker_allele_len == 2) || (!is_eoln_kns(*bufptr))) {
+      // either multi-character alleles, or invalid format.  Restart scan.
+      putchar('\r');
+      logstr("\n");
+      sprintf(logbuf, "Possibly irregular .ped line.  Restarting scan, assuming multichar alleles.\n");
+      logprintb();
+      max_marker_allele_len = 2;
+      break;
+    }
+    ulii = strlen(bufptr) + (uintptr_t)(bufptr - loadbuf) + 1;
+    if (ulii > ped_buflen) {
+      ped_buflen = ulii;
+    }
+    indiv_ct++;
+    if (ftello(pedfile) >= ped_next_thresh) {
+      uii = (ftello(pedfile) * 100) / ped_size;
+      if (pct >= 10) {
+	putchar('\b');
+      }
+      printf("\b\b%u%%", uii);
+      fflush(stdout);
+      pct = uii;
     }
-    fclose_null(&infile);
-  }
-  // PLINK reports an error whenever there are 3+ alleles at one locus, so
-  // backwards compatibility does not mandate that we worry about that case.
-  // Thus we just use the obvious one-pass load, and save proper handling of
-  // triallelic sites, etc. for the future VCF engine.
-  memcpy(outname_end, ".bed", 5);
-  if (fopen_checked(&outfile, outname, "wb")) {
-    goto lgen_to_bed_ret_OPEN_FAIL;
-  }
-  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
-    goto lgen_to_bed_ret_WRITE_FAIL;
-  }
-  memcpy(name_end, ".lgen", 6);
-  if (fopen_checked(&infile, lgen_namebuf, "r")) {
-    goto lgen_to_bed_ret_OPEN_FAIL;
-  }
-  if (fseeko(infile, 0, SEEK_END)) {
-    goto lgen_to_bed_ret_READ_FAIL;
   }
-  lgen_size = ftello(infile);
-  rewind(infile);
-  logprint("Processing .lgen file... ");
-  fputs("0%", stdout);
-  fflush(stdout);
-  lgen_next_thresh = lgen_size / 100;
-  pct = 0;
-  if (!lgen_allele_count) {
-    while (fgets(tbuf, MAXLINELEN, infile)) {
-      cptr = skip_initial_spaces(tbuf);
-      if (is_eoln_kns(*cptr)) {
-	continue;
+ ped_to_bed_scan_done:
+  if (max_marker_allele_len == 1) {
+    if ((!g_pb_thread_ct) && (!feof(pedfile))) {
+      goto ped_to_bed_ret_READ_FAIL;
+    }
+    if (!indiv_ct) {
+      sprintf(logbuf, "\nError: No %s in .ped file.\n", g_species_plural);
+      goto ped_to_bed_ret_INVALID_FORMAT_2;
+    }
+    if (fclose_null(&outfile)) {
+      goto ped_to_bed_ret_WRITE_FAIL;
+    }
+    memcpy(outname_end, ".bim", 5);
+    if (fopen_checked(&outfile, outname, "w")) {
+      goto ped_to_bed_ret_OPEN_FAIL;
+    }
+    if (map_is_unsorted) {
+      memcpy(outname_end, ".map.tmp", 9);
+      if (fopen_checked(&mapfile, outname, "r")) {
+	goto ped_to_bed_ret_OPEN_FAIL;
       }
-      cptr2 = next_item(cptr);
-      cptr3 = next_item(cptr2);
-      cptr4 = item_end(cptr3);
-      if (!cptr4) {
-	goto lgen_to_bed_ret_INVALID_FORMAT;
+    } else {
+      rewind(mapfile);
+    }
+    logstr(" done.\n");
+    fputs("\r.ped scan complete (for binary autoconversion).\n", stdout);
+    marker_uidx = 0;
+    for (marker_idx = 0; marker_idx < marker_ct; marker_idx++) {
+      if (map_is_unsorted) {
+	if (!fgets(tbuf, MAXLINELEN, mapfile)) {
+	  goto ped_to_bed_ret_READ_FAIL;
+	}
+      } else {
+	if (get_next_noncomment_excl(mapfile, &bufptr, marker_exclude, &marker_uidx)) {
+	  goto ped_to_bed_ret_READ_FAIL;
+	}
       }
-      a1ptr = skip_initial_spaces(cptr4);
-      sptr = item_end(a1ptr);
-      a1len = (uintptr_t)(sptr - a1ptr);
-      a2ptr = next_item(sptr);
-      if (compound_genotypes == 1) {
-	if (no_more_items_kns(a2ptr)) {
-	  compound_genotypes = 2;
+      if (marker_alleles[marker_idx * 4 + 2]) {
+	cc = marker_alleles[marker_idx * 4 + 3];
+	if (map_is_unsorted) {
+	  sprintf(logbuf, "Warning: Marker %u (post-sort/filter) %sallelic; setting rarest missing.\n", map_reverse[marker_idx] + 1, (cc? "quad" : "tri"));
 	} else {
-	  compound_genotypes = 0;
+	  sprintf(logbuf, "Warning: Marker %" PRIuPTR " %sallelic; setting rarest alleles missing.\n", marker_idx + 1, (cc? "quad" : "tri"));
 	}
-      }
-      if (!compound_genotypes) {
-	if (no_more_items_kns(a2ptr)) {
-	  goto lgen_to_bed_ret_INVALID_FORMAT;
+	logprintb();
+	ujj = (cc? 4 : 3);
+	// insertion sort
+	for (uii = 1; uii < ujj; uii++) {
+	  ukk = marker_allele_cts[4 * marker_idx + uii];
+	  if (marker_allele_cts[4 * marker_idx + uii - 1] < ukk) {
+	    cc = marker_alleles[4 * marker_idx + uii];
+	    umm = uii;
+	    do {
+	      umm--;
+	      marker_alleles[4 * marker_idx + umm + 1] = marker_alleles[4 * marker_idx + umm];
+	      marker_allele_cts[4 * marker_idx + umm + 1] = marker_allele_cts[4 * marker_idx + umm];
+	    } while (umm && (marker_allele_cts[4 * marker_idx + umm - 1] < ukk));
+	    marker_alleles[4 * marker_idx + umm] = cc;
+	    marker_allele_cts[4 * marker_idx + umm] = ukk;
+	  }
 	}
-	a2len = strlen_se(a2ptr);
+	cc = marker_alleles[marker_idx * 4 + 1];
+	cc2 = marker_alleles[marker_idx * 4];
       } else {
-	if (a1len != 2) {
-	  goto lgen_to_bed_ret_INVALID_FORMAT;
+	if (marker_allele_cts[marker_idx * 4] >= marker_allele_cts[marker_idx * 4 + 1]) {
+	  cc = marker_alleles[marker_idx * 4 + 1];
+	  cc2 = marker_alleles[marker_idx * 4];
+	} else {
+	  cc = marker_alleles[marker_idx * 4];
+	  cc2 = marker_alleles[marker_idx * 4 + 1];
 	}
-	a1len = 1;
-	a2ptr = &(a1ptr[2]);
-	*a2ptr = a1ptr[1];
-	a2len = 1;
       }
-      ii = bsearch_fam_indiv(id_buf, sorted_indiv_ids, max_person_id_len, indiv_ct, cptr, cptr2);
-      if (ii == -1) {
-	goto lgen_to_bed_ret_INVALID_FORMAT_2;
+      marker_alleles_f[marker_idx * 2] = cc;
+      marker_alleles_f[marker_idx * 2 + 1] = cc2;
+      if (!cc) {
+	cc = '0';
       }
-      indiv_idx = indiv_id_map[(uint32_t)ii];
-      ulii = (uintptr_t)(cptr4 - cptr3);
-      memcpyx(id_buf, cptr3, ulii, '\0');
-      ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
-      if (ii != -1) {
-	marker_idx = marker_id_map[ii];
-	sptr = marker_alleles[2 * marker_idx + 1]; // existing A2
-	a1ptr[a1len] = '\0';
-	a2ptr[a2len] = '\0';
-	if ((*a1ptr == missing_geno) && (a1len == 1)) {
-	  if ((*a2ptr == missing_geno) && (a2len == 1)) {
-	    uii = 1;
+      if (!cc2) {
+	cc2 = '0';
+      }
+      if (map_is_unsorted) {
+	bufptr = (char*)memchr(tbuf, '\n', MAXLINELEN);
+	if (fwrite_checked(tbuf, bufptr - tbuf, outfile)) {
+	  goto ped_to_bed_ret_WRITE_FAIL;
+	}
+      } else {
+	bufptr = write_item(bufptr, outfile);
+	bufptr = write_item(bufptr, outfile);
+	if (cm_col) {
+	  bufptr = write_item_nt(bufptr, outfile);
+	} else {
+	  putc('0', outfile);
+	}
+	putc('\t', outfile);
+	fwrite(bufptr, 1, strlen_se(bufptr), outfile);
+      }
+      putc('\t', outfile);
+      putc(cc, outfile);
+      putc('\t', outfile);
+      putc(cc2, outfile);
+      if (putc_checked('\n', outfile)) {
+	goto ped_to_bed_ret_WRITE_FAIL;
+      }
+      marker_uidx++;
+    }
+    indiv_ct4 = (indiv_ct + 3) / 4;
+    wkspace_reset((unsigned char*)marker_alleles);
+    fclose_null(&mapfile);
+    if (map_is_unsorted) {
+      unlink(outname);
+    }
+    fclose_null(&outfile);
+    if (wkspace_alloc_c_checked(&loadbuf, ped_buflen)) {
+      goto ped_to_bed_ret_NOMEM;
+    }
+    if (g_pb_thread_ct) {
+      retval = ped_encode_parallel(outname, outname_end, &outfile, loadbuf, ped_buflen, marker_ct, indiv_ct, marker_alleles_f);
+      if (!retval) {
+	goto ped_to_bed_write_done;
+      } else if (retval != -1) {
+	goto ped_to_bed_ret_1;
+      }
+      retval = 0;
+    }
+    if (wkspace_left >= marker_ct * indiv_ct4) {
+      markers_per_pass = marker_ct;
+      sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " marker%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", indiv_ct, species_str(indiv_ct));
+      pass_ct = 1;
+    } else {
+      if (!map_is_unsorted) {
+	if (wkspace_alloc_ll_checked(&line_starts, indiv_ct * sizeof(int64_t))) {
+	  goto ped_to_bed_ret_NOMEM;
+	}
+      }
+      markers_per_pass = wkspace_left / indiv_ct4;
+      if (!markers_per_pass) {
+	goto ped_to_bed_ret_NOMEM;
+      }
+      pass_ct = (marker_ct + markers_per_pass - 1) / markers_per_pass;
+      sprintf(logbuf, "Performing %u-pass .bed write (%u/%" PRIuPTR " marker%s/pass, %" PRIuPTR " %s).\n", pass_ct, markers_per_pass, marker_ct, (markers_per_pass == 1)? "" : "s", indiv_ct, species_str(indiv_ct));
+    }
+    logprintb();
+    writebuf = wkspace_base;
+    memcpy(outname_end, ".bed", 5);
+    if (fopen_checked(&outfile, outname, "wb")) {
+      goto ped_to_bed_ret_OPEN_FAIL;
+    }
+    if (fwrite_checked("l\x1b\x01", 3, outfile)) {
+      goto ped_to_bed_ret_WRITE_FAIL;
+    }
+    rewind(pedfile);
+    umm = 0;
+    for (uii = 0; uii < pass_ct; uii++) {
+      marker_start = uii * markers_per_pass;
+      if (uii + 1 == pass_ct) {
+	ujj = marker_ct - marker_start;
+	last_pass = 1;
+      } else {
+	ujj = markers_per_pass;
+      }
+      memset(writebuf, 0, ujj * indiv_ct4);
+      marker_end = marker_start + ujj;
+      fputs("0%", stdout);
+      indiv_idx = 0;
+      // 94 instead of 100 due to big fwrite at the end
+      for (pct = 1; pct <= 94; pct++) {
+	loop_end = (((uint64_t)pct) * indiv_ct) / 94LLU;
+	for (; indiv_idx < loop_end; indiv_idx++) {
+	  if ((!uii) || map_is_unsorted) {
+	    do {
+	      if (!last_pass) {
+		ped_next_thresh = ftello(pedfile);
+	      }
+	      if (!fgets(loadbuf, ped_buflen, pedfile)) {
+		goto ped_to_bed_ret_READ_FAIL_2;
+	      }
+	      col1_ptr = skip_initial_spaces(loadbuf);
+	    } while (is_eoln_or_comment(*col1_ptr));
+	    bufptr = next_item_mult(col1_ptr, ped_col_skip);
 	  } else {
-	    goto lgen_to_bed_ret_INVALID_FORMAT_5;
-	  }
-	} else if ((*a2ptr == missing_geno) && (a2len == 1)) {
-	  goto lgen_to_bed_ret_INVALID_FORMAT_5;
-        } else {
-          if (!sptr) {
-	    if (heapstr_alloc(&(marker_alleles[2 * marker_idx + 1]), a1ptr, a1len)) {
-	      goto lgen_to_bed_ret_NOMEM;
+	    ped_next_thresh = line_starts[indiv_idx];
+	    if (fseeko(pedfile, line_starts[indiv_idx], SEEK_SET)) {
+	      goto ped_to_bed_ret_READ_FAIL_2;
 	    }
-	    if (!strcmp(a1ptr, a2ptr)) {
-	      uii = 2;
-	    } else {
-	      uii = 1;
-	      if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
-		goto lgen_to_bed_ret_NOMEM;
-	      }
+	    if (!fgets(loadbuf, ped_buflen, pedfile)) {
+	      goto ped_to_bed_ret_READ_FAIL_2;
 	    }
-	  } else {
-	    sptr2 = marker_alleles[2 * marker_idx];
-	    if (!sptr2) {
-	      if (!strcmp(a1ptr, sptr)) {
-		if (!strcmp(a2ptr, sptr)) {
-		  uii = 2;
-		} else {
-		  uii = 1;
-		  if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
-		    goto lgen_to_bed_ret_NOMEM;
+	    bufptr = loadbuf;
+	  }
+	  marker_idx = uii * markers_per_pass;
+	  ii_shift = (indiv_idx % 4) * 2;
+	  wbufptr = &(writebuf[indiv_idx / 4]);
+	  if (map_is_unsorted) {
+	    // multipass optimizations are possible, but we won't bother,
+	    // especially since the .map should rarely be unsorted in the first
+	    // place...
+	    umm = 0;
+	    for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+	      cc = *bufptr++;
+	      bufptr = skip_initial_spaces(bufptr);
+	      cc2 = *bufptr++;
+	      bufptr = skip_initial_spaces(bufptr);
+	      if (IS_SET(marker_exclude, marker_uidx)) {
+		continue;
+	      }
+	      ukk = map_reverse[umm++];
+	      if ((ukk >= marker_start) && (ukk < marker_end)) {
+		ucc = 1;
+		if (cc == marker_alleles_f[2 * ukk + 1]) {
+		  if (cc2 == cc) {
+		    ucc = 3;
+		  } else if (cc2 == marker_alleles_f[2 * ukk]) {
+		    ucc = 2;
+		  }
+		} else if (cc == marker_alleles_f[2 * ukk]) {
+		  if (cc2 == cc) {
+		    ucc = 0;
+		  } else if (cc2 == marker_alleles_f[2 * ukk + 1]) {
+		    ucc = 2;
 		  }
 		}
-	      } else {
-		if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a1ptr, a1len)) {
-		  goto lgen_to_bed_ret_NOMEM;
-		}
-		if (!strcmp(a2ptr, sptr)) {
-		  uii = 1;
-		} else if (!strcmp(a2ptr, a1ptr)) {
-		  uii = 0;
-		} else {
-		  goto lgen_to_bed_ret_INVALID_FORMAT_3;
-		}
+		wbufptr[(ukk - marker_start) * indiv_ct4] |= ucc << ii_shift;
+		marker_idx++;
 	      }
-	    } else {
-	      if (!strcmp(a1ptr, sptr)) {
-		uii = 1;
-	      } else if (!strcmp(a1ptr, sptr2)) {
-		uii = 0;
-	      } else {
-		goto lgen_to_bed_ret_INVALID_FORMAT_3;
+	    }
+	  } else {
+	    for (marker_uidx = umm; marker_idx < marker_end; marker_uidx++) {
+	      cc = *bufptr++;
+	      bufptr = skip_initial_spaces(bufptr);
+	      cc2 = *bufptr++;
+	      bufptr = skip_initial_spaces(bufptr);
+	      if (IS_SET(marker_exclude, marker_uidx)) {
+		continue;
 	      }
-	      if (!strcmp(a2ptr, sptr)) {
-		uii++;
-	      } else if (strcmp(a2ptr, sptr2)) {
-		goto lgen_to_bed_ret_INVALID_FORMAT_3;
+	      ucc = 1;
+	      if (cc == marker_alleles_f[2 * marker_idx + 1]) {
+		if (cc2 == cc) {
+		  ucc = 3;
+		} else if (cc2 == marker_alleles_f[2 * marker_idx]) {
+		  ucc = 2;
+		}
+	      } else if (cc == marker_alleles_f[2 * marker_idx]) {
+		if (cc2 == cc) {
+		  ucc = 0;
+		} else if (cc2 == marker_alleles_f[2 * marker_idx + 1]) {
+		  ucc = 2;
+		}
 	      }
+	      *wbufptr |= ucc << ii_shift;
+	      wbufptr = &(wbufptr[indiv_ct4]);
+	      marker_idx++;
+	    }
+	    if (!last_pass) {
+	      line_starts[indiv_idx] = ped_next_thresh + (uintptr_t)(bufptr - loadbuf);
 	    }
-	  }
-	  if (uii) {
-	    uii++;
 	  }
 	}
-	ulii = marker_idx * indiv_ct4 + (indiv_idx / 4);
-	ujj = (indiv_idx % 4) * 2;
-	writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
-      }
-      if (ftello(infile) >= lgen_next_thresh) {
-	uii = (ftello(infile) * 100) / lgen_size;
-	if (pct >= 10) {
+	if (pct > 10) {
 	  putchar('\b');
 	}
-	printf("\b\b%u%%", uii);
+	printf("\b\b%u%%", pct);
 	fflush(stdout);
-	pct = uii;
-	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
       }
+      if (fwrite_checked(writebuf, ujj * indiv_ct4, outfile)) {
+	goto ped_to_bed_ret_WRITE_FAIL_2;
+      }
+      if (!last_pass) {
+	printf("\rPass %u:    \b\b\b", uii + 2);
+	fflush(stdout);
+	if (map_is_unsorted) {
+	  rewind(pedfile);
+	} else {
+	  umm = marker_uidx;
+	}
+      }
+    }
+  } else {
+    retval = ped_to_bed_multichar_allele(max_marker_allele_len, &pedfile, &outfile, outname, outname_end, &mapfile, unfiltered_marker_ct, marker_exclude, marker_ct, marker_alleles_f, map_is_unsorted, fam_cols, ped_col_skip, cm_col, map_reverse, ped_size);
+    if (retval) {
+      goto ped_to_bed_ret_1;
+    }
+  }
+ ped_to_bed_write_done:
+  if (fclose_null(&outfile)) {
+    goto ped_to_bed_ret_WRITE_FAIL_2;
+  }
+  putchar('\r');
+  sprintf(logbuf, "--file: binary fileset written to %s + .bim + .fam.\n", outname);
+  logprintb();
+
+  while (0) {
+  ped_to_bed_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  ped_to_bed_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  ped_to_bed_ret_READ_FAIL_2:
+    putchar('\n');
+  ped_to_bed_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  ped_to_bed_ret_WRITE_FAIL_2:
+    putchar('\n');
+  ped_to_bed_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  ped_to_bed_ret_INVALID_FORMAT_3:
+    sprintf(logbuf, "Error: Not enough markers in .ped line %" PRIuPTR ".\n", indiv_ct + 1);
+  ped_to_bed_ret_INVALID_FORMAT_2:
+    logprintb();
+  ped_to_bed_ret_INVALID_FORMAT:
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+ ped_to_bed_ret_1:
+  ped_to_bed_parallel_cleanup(outname, outname_end);
+  fclose_cond(pedfile);
+  fclose_cond(mapfile);
+  fclose_cond(outfile);
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+// 256 - 32 = 224
+char one_char_strs[448];
+
+int32_t heapstr_alloc(char** new_sptr, char* new_str, uint32_t slen) {
+  char* sptr;
+  if (slen == 1) {
+    *new_sptr = &(one_char_strs[2 * (((unsigned char)(*new_str)) - ' ')]);
+    return 0;
+  } else {
+    sptr = (char*)malloc(slen + 1);
+    if (!sptr) {
+      return -1;
+    }
+    memcpy(sptr, new_str, slen + 1);
+    *new_sptr = sptr;
+    return 0;
+  }
+}
+
+void fill_bmap_short(unsigned char* bmap_short, uint32_t ct_mod4) {
+  unsigned char imap[4] = {3, 1, 2, 0};
+  unsigned char* bmap = bmap_short;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t ukk;
+  uint32_t umm;
+  uint32_t unn;
+  uint32_t extra_ct;
+  for (uii = 0; uii < 4; uii++) {
+    umm = imap[uii] * 64;
+    for (ujj = 0; ujj < 4; ujj++) {
+      unn = umm + imap[ujj] * 16;
+      for (ukk = 0; ukk < 4; ukk++) {
+	extra_ct = unn + imap[ukk] * 4;
+	*bmap++ = extra_ct + 3;
+	*bmap++ = extra_ct + 1;
+	*bmap++ = extra_ct + 2;
+	*bmap++ = extra_ct;
+      }
+    }
+  }
+  if (ct_mod4) {
+    switch (ct_mod4) {
+    case 1:
+      bmap[0] = 3;
+      bmap[1] = 1;
+      bmap[2] = 2;
+      bmap[3] = 0;
+      return;
+    case 2:
+      for (uii = 0; uii < 4; uii++) {
+	ukk = imap[uii] * 4;
+	*bmap++ = ukk + 3;
+	*bmap++ = ukk + 1;
+	*bmap++ = ukk + 2;
+	*bmap++ = ukk;
+      }
+      return;
+    case 3:
+      for (uii = 0; uii < 4; uii++) {
+	ukk = imap[uii] * 16;
+	for (ujj = 0; ujj < 4; ujj++) {
+	  umm = ukk + imap[ujj] * 4;
+	  *bmap++ = umm + 3;
+	  *bmap++ = umm + 1;
+	  *bmap++ = umm + 2;
+	  *bmap++ = umm;
+	}
+      }
+    }
+  }
+}
+
+void fill_bmap_raw(unsigned char* bmap_raw, uint32_t ct_mod4) {
+  // possibilities:
+  // 0. A1 -> A1, A2 -> A2 [0..255]
+  // 1. A1 -> A2, A2 -> A1 [256..511]
+  // 1 last char. [512..575]
+  uint32_t uii = 0;
+  do {
+    *bmap_raw++ = uii++;
+  } while (uii < 256);
+  fill_bmap_short(bmap_raw, ct_mod4);
+}
+
+// don't bother with a multipass conversion if the per-range record buffers
+// would be smaller than this
+#define LGEN_SPILL_MIN_RECS 4096
+
+uint32_t lgen_spill(FILE** spill_files, uint64_t** spill_bufs, uint32_t* spill_rec_cts, uint32_t spill_rec_max, uintptr_t range_marker_ct, uintptr_t indiv_ct4, uintptr_t marker_idx, uintptr_t indiv_idx, uint32_t geno_code) {
+  // Multipass .lgen conversion: append one genotype to the temporary file for
+  // its marker range.  Records are (byte offset within the range's .bed rows,
+  // 2-bit slot, genotype code); since each file is replayed in order, later
+  // .lgen lines still overwrite earlier ones for the same marker/individual.
+  // Returns 1 on write failure.
+  uintptr_t spill_idx = marker_idx / range_marker_ct;
+  uint32_t rec_ct = spill_rec_cts[spill_idx];
+  if (rec_ct == spill_rec_max) {
+    if (fwrite_checked(spill_bufs[spill_idx], rec_ct * sizeof(int64_t), spill_files[spill_idx])) {
+      return 1;
+    }
+    rec_ct = 0;
+  }
+  spill_bufs[spill_idx][rec_ct] = (((uint64_t)((marker_idx % range_marker_ct) * indiv_ct4 + (indiv_idx / 4))) << 4) | ((indiv_idx % 4) << 2) | geno_code;
+  spill_rec_cts[spill_idx] = rec_ct + 1;
+  return 0;
+}
+
+void lgen_spill_cleanup(FILE** spill_files, uint32_t spill_ct, char* outname, char* outname_end) {
+  uint32_t spill_idx;
+  for (spill_idx = 0; spill_idx < spill_ct; spill_idx++) {
+    if (spill_files[spill_idx]) {
+      fclose_null(&(spill_files[spill_idx]));
+      sprintf(outname_end, ".lgen.%u.tmp", spill_idx);
+      unlink(outname);
+    }
+  }
+}
+
+int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, char missing_geno, int32_t missing_pheno, uint64_t misc_flags, uint32_t lgen_modifier, char* lgen_reference_fname, Chrom_info* chrom_info_ptr) {
+  unsigned char* wkspace_mark = wkspace_base;
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  char* name_end = (char*)memchr(lgen_namebuf, 0, FNAMESIZE);
+  uint32_t lgen_allele_count = lgen_modifier & LGEN_ALLELE_COUNT;
+  uint32_t affection_01 = (misc_flags / MISC_AFFECTION_01) & 1;
+  uint32_t map_cols = 3;
+  uintptr_t* marker_exclude = NULL;
+  uintptr_t marker_exclude_ct = 0;
+  uintptr_t max_marker_id_len = 0;
+  uintptr_t unfiltered_marker_ct = 0;
+  uintptr_t max_person_id_len = 4;
+  uintptr_t marker_ct = 0;
+  char** marker_alleles = NULL;
+  char* marker_ids = NULL;
+  uint32_t* marker_pos = NULL;
+  uintptr_t indiv_ct = 0;
+  char* person_ids = NULL;
+  char* paternal_ids = NULL;
+  uintptr_t max_paternal_id_len = 2;
+  char* maternal_ids = NULL;
+  uintptr_t max_maternal_id_len = 2;
+  uintptr_t* sex_nm = NULL;
+  uintptr_t* sex_male = NULL;
+  uint32_t affection = 0;
+  uintptr_t* founder_info = NULL;
+  uintptr_t* indiv_exclude = NULL;
+  uint32_t map_is_unsorted = 0;
+  uint32_t compound_genotypes = 1; // 0 = no, 1 = unresolved, 2 = yes
+  uintptr_t* pheno_nm = NULL;
+  uintptr_t* pheno_c = NULL;
+  double* pheno_d = NULL;
+  // multipass conversion state; spill_ct is zero in the usual one-pass case
+  uint32_t spill_ct = 0;
+  FILE** spill_files = NULL;
+  uint64_t** spill_bufs = NULL;
+  uint32_t* spill_rec_cts = NULL;
+  uintptr_t* marker_ref = NULL;
+  uint32_t spill_rec_max = 0;
+  uintptr_t range_marker_ct;
+  uintptr_t range_start;
+  uintptr_t range_end;
+  uint64_t* spill_recs;
+  uint64_t ullii;
+  char* sorted_marker_ids;
+  uint32_t* marker_id_map;
+  uint32_t* map_reverse;
+  char* sorted_indiv_ids;
+  uint32_t* indiv_id_map;
+  unsigned char* writebuf;
+  uintptr_t indiv_ct4;
+  uintptr_t marker_idx;
+  unsigned char ucc;
+  unsigned char* ucptr;
+  unsigned char bmap_short[320];
+  unsigned char* bmap2;
+  char* id_buf;
+  char* cptr;
+  char* cptr2;
+  char* cptr3;
+  char* cptr4;
+  char* a1ptr;
+  char* a2ptr;
+  char* sptr;
+  char* sptr2;
+  char** ma_end;
+  uint32_t a1len;
+  uint32_t a2len;
+  uintptr_t indiv_idx;
+  uintptr_t ulii;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t ukk;
+  uint32_t umm;
+  int64_t lgen_size;
+  uint32_t pct;
+  int64_t lgen_next_thresh;
+  int32_t ii;
+  int32_t retval;
+  if (lgen_modifier == LGEN_ALLELE_COUNT) {
+    logprint("Error: --allele-count must be used with --reference.\n");
+    goto lgen_to_bed_ret_INVALID_CMDLINE;
+  }
+  cptr = one_char_strs;
+  for (uii = 0; uii < 224; uii++) {
+    *cptr++ = (char)(uii + ' ');
+    *cptr++ = '\0';
+  }
+
+  memcpy(name_end, ".map", 5);
+  retval = load_map(&infile, lgen_namebuf, &map_cols, &unfiltered_marker_ct, &marker_exclude_ct, &max_marker_id_len, &marker_exclude, &marker_ids, chrom_info_ptr, &marker_pos, &map_is_unsorted);
+  if (retval) {
+    goto lgen_to_bed_ret_1;
+  }
+  marker_ct = unfiltered_marker_ct - marker_exclude_ct;
+  retval = sort_item_ids(&sorted_marker_ids, &marker_id_map, unfiltered_marker_ct, marker_exclude, marker_exclude_ct, marker_ids, max_marker_id_len, 0, 0, strcmp_deref);
+  if (retval) {
+    goto lgen_to_bed_ret_1;
+  }
+  if (map_is_unsorted) {
+    // Writes a temporary .map which is read later, and then deleted.
+    retval = load_sort_and_write_map(&map_reverse, infile, map_cols, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 0, chrom_info_ptr);
+    if (retval) {
+      goto lgen_to_bed_ret_1;
+    }
+    for (uii = 0; uii < marker_ct; uii++) {
+      marker_id_map[uii] = map_reverse[marker_id_map[uii]];
+    }
+  }
+  // collapse
+  if (wkspace_alloc_ui_checked(&indiv_id_map, unfiltered_marker_ct * sizeof(int32_t))) {
+    goto lgen_to_bed_ret_NOMEM;
+  }
+  fill_uidx_to_idx(marker_exclude, unfiltered_marker_ct, marker_ct, indiv_id_map);
+  for (uii = 0; uii < marker_ct; uii++) {
+    marker_id_map[uii] = indiv_id_map[marker_id_map[uii]];
+  }
+  fclose_null(&infile);
+  memcpy(marker_ids, sorted_marker_ids, marker_ct * max_marker_id_len);
+  wkspace_reset((unsigned char*)sorted_marker_ids);
+
+  memcpy(name_end, ".fam", 5);
+  if (fopen_checked(&infile, lgen_namebuf, "r")) {
+    goto lgen_to_bed_ret_OPEN_FAIL;
+  }
+  retval = load_fam(infile, MAXLINELEN, FAM_COL_13456, 1, missing_pheno, intlen(missing_pheno), affection_01, &indiv_ct, &person_ids, &max_person_id_len, &paternal_ids, &max_paternal_id_len, &maternal_ids, &max_maternal_id_len, &sex_nm, &sex_male, &affection, &pheno_nm, &pheno_c, &pheno_d, &founder_info, &indiv_exclude);
+  if (retval) {
+    goto lgen_to_bed_ret_1;
+  }
+  fclose_null(&infile);
+  retval = sort_item_ids_nx(&sorted_indiv_ids, &indiv_id_map, indiv_ct, person_ids, max_person_id_len);
+  if (retval) {
+    goto lgen_to_bed_ret_1;
+  }
+  if (wkspace_alloc_c_checked(&id_buf, MAXV(max_marker_id_len, max_person_id_len))) {
+    goto lgen_to_bed_ret_NOMEM;
+  }
+  marker_alleles = (char**)wkspace_alloc(2 * marker_ct * sizeof(char*));
+  if (!marker_alleles) {
+    goto lgen_to_bed_ret_NOMEM;
+  }
+  memset(marker_alleles, 0, 2 * marker_ct * sizeof(char*));
+  indiv_ct4 = (indiv_ct + 3) / 4;
+  range_marker_ct = marker_ct;
+  if (wkspace_alloc_uc_checked(&writebuf, ((uintptr_t)marker_ct) * indiv_ct4)) {
+    // The genotype matrix doesn't fit.  Use half the workspace for one marker
+    // range's worth of .bed rows and the rest for per-range record buffers;
+    // the .lgen scan appends each genotype to its range's temporary file, and
+    // the ranges are then assembled and written out in order.
+    range_marker_ct = (wkspace_left / 2) / indiv_ct4;
+    if (!range_marker_ct) {
+      goto lgen_to_bed_ret_NOMEM;
+    }
+    spill_ct = (marker_ct + range_marker_ct - 1) / range_marker_ct;
+    writebuf = wkspace_alloc(range_marker_ct * indiv_ct4);
+    if (wkspace_alloc_ul_checked(&marker_ref, ((marker_ct + (BITCT - 1)) / BITCT) * sizeof(intptr_t)) ||
+	wkspace_alloc_ui_checked(&spill_rec_cts, spill_ct * sizeof(int32_t))) {
+      goto lgen_to_bed_ret_NOMEM;
+    }
+    spill_files = (FILE**)wkspace_alloc(spill_ct * sizeof(intptr_t));
+    if (!spill_files) {
+      goto lgen_to_bed_ret_NOMEM;
+    }
+    memset(spill_files, 0, spill_ct * sizeof(intptr_t));
+    spill_bufs = (uint64_t**)wkspace_alloc(spill_ct * sizeof(intptr_t));
+    if (!spill_bufs) {
+      goto lgen_to_bed_ret_NOMEM;
+    }
+    ulii = ((wkspace_left / spill_ct) & (~(CACHELINE - ONELU))) / sizeof(int64_t);
+    if (ulii < LGEN_SPILL_MIN_RECS) {
+      goto lgen_to_bed_ret_NOMEM;
+    } else if (ulii > 0x10000000) {
+      ulii = 0x10000000;
+    }
+    spill_rec_max = ulii;
+    fill_ulong_zero(marker_ref, (marker_ct + (BITCT - 1)) / BITCT);
+    fill_uint_zero(spill_rec_cts, spill_ct);
+    for (uii = 0; uii < spill_ct; uii++) {
+      spill_bufs[uii] = (uint64_t*)wkspace_alloc(spill_rec_max * sizeof(int64_t));
+      sprintf(outname_end, ".lgen.%u.tmp", uii);
+      if (fopen_checked(&(spill_files[uii]), outname, "w+b")) {
+	goto lgen_to_bed_ret_OPEN_FAIL;
+      }
+    }
+    sprintf(logbuf, "Genotype matrix too large for workspace; converting .lgen in %u passes.\n", spill_ct);
+    logprintb();
+  } else if (indiv_ct % 4) {
+    ucc = 0x15 >> (6 - 2 * (indiv_ct % 4));
+    for (marker_idx = 0; marker_idx < marker_ct; marker_idx++) {
+      memset(&(writebuf[marker_idx * indiv_ct4]), 0x55, indiv_ct4 - 1);
+      writebuf[(marker_idx + 1) * indiv_ct4 - 1] = ucc;
+    }
+  } else {
+    memset(writebuf, 0x55, marker_ct * indiv_ct4);
+  }
+  if (lgen_modifier & LGEN_REFERENCE) {
+    if (fopen_checked(&infile, lgen_reference_fname, "r")) {
+      goto lgen_to_bed_ret_OPEN_FAIL;
+    }
+    while (fgets(tbuf, MAXLINELEN, infile)) {
+      cptr = skip_initial_spaces(tbuf);
+      if (is_eoln_kns(*cptr)) {
+	continue;
+      }
+      cptr2 = item_end(cptr);
+      a1ptr = skip_initial_spaces(cptr2);
+      if (no_more_items_kns(a1ptr)) {
+	goto lgen_to_bed_ret_INVALID_FORMAT_4;
+      }
+      a1len = strlen_se(cptr);
+      if (a1len < max_marker_id_len) {
+	memcpyx(id_buf, cptr, a1len, '\0');
+	ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
+	if (ii != -1) {
+	  marker_idx = marker_id_map[ii];
+	  if (marker_alleles[2 * marker_idx + 1]) {
+	    goto lgen_to_bed_ret_INVALID_FORMAT_4;
+	  }
+	  sptr = item_end(a1ptr);
+	  a2ptr = skip_initial_spaces(sptr);
+	  a1len = (uintptr_t)(sptr - a1ptr);
+	  a1ptr[a1len] = '\0';
+	  if (heapstr_alloc(&(marker_alleles[2 * marker_idx + 1]), a1ptr, a1len)) {
+	    goto lgen_to_bed_ret_NOMEM;
+	  }
+	  if (no_more_items_kns(a2ptr)) {
+	    if (lgen_allele_count) {
+	      a1ptr[a1len++] = 'v';
+	      a1ptr[a1len] = '\0';
+	      if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a1ptr, a1len)) {
+		goto lgen_to_bed_ret_NOMEM;
+	      }
+	    }
+	  } else {
+	    a2len = strlen_se(a2ptr);
+	    a2ptr[a2len] = '\0';
+	    if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
+	      goto lgen_to_bed_ret_NOMEM;
+	    }
+	  }
+	  if (spill_ct) {
+	    SET_BIT(marker_ref, marker_idx);
+	  } else {
+	    memset(&(writebuf[marker_idx * indiv_ct4]), 0xff, indiv_ct / 4);
+	    if (indiv_ct % 4) {
+	      writebuf[(marker_idx + 1) * indiv_ct4 - 1] = 0x3f >> (6 - 2 * (indiv_ct % 4));
+	    }
+	  }
+	}
+      }
+    }
+    if (!feof(infile)) {
+      goto lgen_to_bed_ret_READ_FAIL;
+    }
+    fclose_null(&infile);
+  }
+  // PLINK reports an error whenever there are 3+ alleles at one locus, so
+  // backwards compatibility does not mandate that we worry about that case.
+  // Thus we just use the obvious one-pass load, and save proper handling of
+  // triallelic sites, etc. for the future VCF engine.
+  memcpy(outname_end, ".bed", 5);
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto lgen_to_bed_ret_OPEN_FAIL;
+  }
+  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
+    goto lgen_to_bed_ret_WRITE_FAIL;
+  }
+  memcpy(name_end, ".lgen", 6);
+  if (fopen_checked(&infile, lgen_namebuf, "r")) {
+    goto lgen_to_bed_ret_OPEN_FAIL;
+  }
+  if (fseeko(infile, 0, SEEK_END)) {
+    goto lgen_to_bed_ret_READ_FAIL;
+  }
+  lgen_size = ftello(infile);
+  rewind(infile);
+  logprint("Processing .lgen file... ");
+  fputs("0%", stdout);
+  fflush(stdout);
+  lgen_next_thresh = lgen_size / 100;
+  pct = 0;
+  if (!lgen_allele_count) {
+    while (fgets(tbuf, MAXLINELEN, infile)) {
+      cptr = skip_initial_spaces(tbuf);
+      if (is_eoln_kns(*cptr)) {
+	continue;
+      }
+      cptr2 = next_item(cptr);
+      cptr3 = next_item(cptr2);
+      cptr4 = item_end(cptr3);
+      if (!cptr4) {
+	goto lgen_to_bed_ret_INVALID_FORMAT;
+      }
+      a1ptr = skip_initial_spaces(cptr4);
+      sptr = item_end(a1ptr);
+      a1len = (uintptr_t)(sptr - a1ptr);
+      a2ptr = next_item(sptr);
+      if (compound_genotypes == 1) {
+	if (no_more_items_kns(a2ptr)) {
+	  compound_genotypes = 2;
+	} else {
+	  compound_genotypes = 0;
+	}
+      }
+      if (!compound_genotypes) {
+	if (no_more_items_kns(a2ptr)) {
+	  goto lgen_to_bed_ret_INVALID_FORMAT;
+	}
+	a2len = strlen_se(a2ptr);
+      } else {
+	if (a1len != 2) {
+	  goto lgen_to_bed_ret_INVALID_FORMAT;
+	}
+	a1len = 1;
+	a2ptr = &(a1ptr[2]);
+	*a2ptr = a1ptr[1];
+	a2len = 1;
+      }
+      ii = bsearch_fam_indiv(id_buf, sorted_indiv_ids, max_person_id_len, indiv_ct, cptr, cptr2);
+      if (ii == -1) {
+	goto lgen_to_bed_ret_INVALID_FORMAT_2;
+      }
+      indiv_idx = indiv_id_map[(uint32_t)ii];
+      ulii = (uintptr_t)(cptr4 - cptr3);
+      memcpyx(id_buf, cptr3, ulii, '\0');
+      ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
+      if (ii != -1) {
+	marker_idx = marker_id_map[ii];
+	sptr = marker_alleles[2 * marker_idx + 1]; // existing A2
+	a1ptr[a1len] = '\0';
+	a2ptr[a2len] = '\0';
+	if ((*a1ptr == missing_geno) && (a1len == 1)) {
+	  if ((*a2ptr == missing_geno) && (a2len == 1)) {
+	    uii = 1;
+	  } else {
+	    goto lgen_to_bed_ret_INVALID_FORMAT_5;
+	  }
+	} else if ((*a2ptr == missing_geno) && (a2len == 1)) {
+	  goto lgen_to_bed_ret_INVALID_FORMAT_5;
+        } else {
+          if (!sptr) {
+	    if (heapstr_alloc(&(marker_alleles[2 * marker_idx + 1]), a1ptr, a1len)) {
+	      goto lgen_to_bed_ret_NOMEM;
+	    }
+	    if (!strcmp(a1ptr, a2ptr)) {
+	      uii = 2;
+	    } else {
+	      uii = 1;
+	      if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
+		goto lgen_to_bed_ret_NOMEM;
+	      }
+	    }
+	  } else {
+	    sptr2 = marker_alleles[2 * marker_idx];
+	    if (!sptr2) {
+	      if (!strcmp(a1ptr, sptr)) {
+		if (!strcmp(a2ptr, sptr)) {
+		  uii = 2;
+		} else {
+		  uii = 1;
+		  if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a2ptr, a2len)) {
+		    goto lgen_to_bed_ret_NOMEM;
+		  }
+		}
+	      } else {
+		if (heapstr_alloc(&(marker_alleles[2 * marker_idx]), a1ptr, a1len)) {
+		  goto lgen_to_bed_ret_NOMEM;
+		}
+		if (!strcmp(a2ptr, sptr)) {
+		  uii = 1;
+		} else if (!strcmp(a2ptr, a1ptr)) {
+		  uii = 0;
+		} else {
+		  goto lgen_to_bed_ret_INVALID_FORMAT_3;
+		}
+	      }
+	    } else {
+	      if (!strcmp(a1ptr, sptr)) {
+		uii = 1;
+	      } else if (!strcmp(a1ptr, sptr2)) {
+		uii = 0;
+	      } else {
+		goto lgen_to_bed_ret_INVALID_FORMAT_3;
+	      }
+	      if (!strcmp(a2ptr, sptr)) {
+		uii++;
+	      } else if (strcmp(a2ptr, sptr2)) {
+		goto lgen_to_bed_ret_INVALID_FORMAT_3;
+	      }
+	    }
+	  }
+	  if (uii) {
+	    uii++;
+	  }
+	}
+	if (spill_ct) {
+	  if (lgen_spill(spill_files, spill_bufs, spill_rec_cts, spill_rec_max, range_marker_ct, indiv_ct4, marker_idx, indiv_idx, uii)) {
+	    goto lgen_to_bed_ret_WRITE_FAIL;
+	  }
+	} else {
+	  ulii = marker_idx * indiv_ct4 + (indiv_idx / 4);
+	  ujj = (indiv_idx % 4) * 2;
+	  writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
+	}
+      }
+      if (ftello(infile) >= lgen_next_thresh) {
+	uii = (ftello(infile) * 100) / lgen_size;
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", uii);
+	fflush(stdout);
+	pct = uii;
+	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
+      }
+    }
+  } else {
+    while (fgets(tbuf, MAXLINELEN, infile)) {
+      cptr = skip_initial_spaces(tbuf);
+      if (is_eoln_kns(*cptr)) {
+	continue;
+      }
+      cptr2 = next_item(cptr);
+      cptr3 = next_item(cptr2);
+      cptr4 = item_end(cptr3);
+      if (!cptr4) {
+	goto lgen_to_bed_ret_INVALID_FORMAT;
+      }
+      a1ptr = skip_initial_spaces(cptr4);
+      if (no_more_items_kns(a1ptr)) {
+	goto lgen_to_bed_ret_INVALID_FORMAT;
+      }
+      ii = bsearch_fam_indiv(id_buf, sorted_indiv_ids, max_person_id_len, indiv_ct, cptr, cptr2);
+      if (ii == -1) {
+	goto lgen_to_bed_ret_INVALID_FORMAT_2;
+      }
+      indiv_idx = indiv_id_map[(uint32_t)ii];
+      ulii = (uintptr_t)(cptr4 - cptr3);
+      memcpyx(id_buf, cptr3, ulii, '\0');
+      ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
+      if (ii != -1) {
+	marker_idx = marker_id_map[ii];
+	a1len = strlen_se(a1ptr);
+	ucc = (unsigned char)(*a1ptr);
+	if ((a1len != 1) || (ucc < 48) || (ucc > 50)) {
+	  uii = 1;
+	} else {
+	  uii = ucc - 48;
+	  if (uii) {
+	    uii++;
+	  }
+	}
+	if (spill_ct) {
+	  if (lgen_spill(spill_files, spill_bufs, spill_rec_cts, spill_rec_max, range_marker_ct, indiv_ct4, marker_idx, indiv_idx, uii)) {
+	    goto lgen_to_bed_ret_WRITE_FAIL;
+	  }
+	} else {
+	  ulii = marker_idx * indiv_ct4 + (indiv_idx / 4);
+	  ujj = (indiv_idx % 4) * 2;
+	  writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
+	}
+      }
+      if (ftello(infile) >= lgen_next_thresh) {
+	uii = (ftello(infile) * 100) / lgen_size;
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", uii);
+	fflush(stdout);
+	pct = uii;
+	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
+      }
+    }
+  }
+  if (!feof(infile)) {
+    goto lgen_to_bed_ret_READ_FAIL;
+  }
+  fclose_null(&infile);
+  if (pct < 10) {
+    fputs("\b\b", stdout);
+  } else if (pct < 100) {
+    fputs("\b\b\b", stdout);
+  } else {
+    fputs("\b\b\b\b", stdout);
+  }
+  logprint("done.\n");
+  ukk = indiv_ct / 4;
+  umm = indiv_ct % 4;
+  fill_bmap_short(bmap_short, umm);
+  bmap2 = &(bmap_short[256]);
+  range_start = 0;
+  do {
+    range_end = range_start + range_marker_ct;
+    if (range_end > marker_ct) {
+      range_end = marker_ct;
+    }
+    if (spill_ct) {
+      ucc = 0x15 >> (6 - 2 * umm);
+      for (marker_idx = range_start; marker_idx < range_end; marker_idx++) {
+	ucptr = &(writebuf[(marker_idx - range_start) * indiv_ct4]);
+	if (IS_SET(marker_ref, marker_idx)) {
+	  memset(ucptr, 0xff, ukk);
+	  if (umm) {
+	    ucptr[ukk] = 0x3f >> (6 - 2 * umm);
+	  }
+	} else {
+	  memset(ucptr, 0x55, ukk);
+	  if (umm) {
+	    ucptr[ukk] = ucc;
+	  }
+	}
+      }
+      uii = range_start / range_marker_ct;
+      spill_recs = spill_bufs[uii];
+      if (fwrite_checked(spill_recs, spill_rec_cts[uii] * sizeof(int64_t), spill_files[uii])) {
+	goto lgen_to_bed_ret_WRITE_FAIL;
+      }
+      rewind(spill_files[uii]);
+      while (1) {
+	ulii = fread(spill_recs, sizeof(int64_t), spill_rec_max, spill_files[uii]);
+	if (!ulii) {
+	  break;
+	}
+	do {
+	  ullii = *spill_recs++;
+	  ucptr = &(writebuf[ullii >> 4]);
+	  ujj = ((ullii >> 2) & 3) * 2;
+	  *ucptr = ((*ucptr) & (~(3 << ujj))) | ((ullii & 3) << ujj);
+	} while (--ulii);
+	spill_recs = spill_bufs[uii];
+      }
+      if (ferror(spill_files[uii])) {
+	goto lgen_to_bed_ret_READ_FAIL;
+      }
+      fclose_null(&(spill_files[uii]));
+      sprintf(outname_end, ".lgen.%u.tmp", uii);
+      unlink(outname);
+    }
+    for (uii = range_start; uii < range_end; uii++) {
+      ulii = uii - range_start;
+      if (popcount_chars((uintptr_t*)writebuf, ulii * indiv_ct4, (ulii + 1) * indiv_ct4) < indiv_ct) {
+	ucptr = &(writebuf[ulii * indiv_ct4]);
+	for (ujj = 0; ujj < ukk; ujj++) {
+	  *ucptr = bmap_short[*ucptr];
+	  ucptr++;
+	}
+	if (umm) {
+	  *ucptr = bmap2[*ucptr];
+	  ucptr++;
+	}
+	cptr = marker_alleles[uii * 2];
+	marker_alleles[uii * 2] = marker_alleles[uii * 2 + 1];
+	marker_alleles[uii * 2 + 1] = cptr;
+      }
+    }
+    if (fwrite_checked(writebuf, (range_end - range_start) * indiv_ct4, outfile)) {
+      goto lgen_to_bed_ret_WRITE_FAIL;
+    }
+    range_start = range_end;
+  } while (range_start < marker_ct);
+  if (fclose_null(&outfile)) {
+    goto lgen_to_bed_ret_WRITE_FAIL;
+  }
+  if (map_is_unsorted) {
+    memcpy(outname_end, ".map.tmp", 9);
+    if (fopen_checked(&infile, outname, "r")) {
+      goto lgen_to_bed_ret_OPEN_FAIL;
+    }
+  } else {
+    memcpy(name_end, ".map", 5);
+    if (fopen_checked(&infile, lgen_namebuf, "r")) {
+      goto lgen_to_bed_ret_OPEN_FAIL;
+    }
+  }
+  memcpy(outname_end, ".bim", 5);
+  if (fopen_checked(&outfile, outname, "w")) {
+    goto lgen_to_bed_ret_OPEN_FAIL;
+  }
+  uii = 2 * marker_ct;
+  for (ujj = 0; ujj < uii; ujj++) {
+    if (!marker_alleles[ujj]) {
+      marker_alleles[ujj] = &(one_char_strs[(((unsigned char)missing_geno) - ' ') * 2]);
+    }
+  }
+  uii = 0;
+  marker_idx = 0;
+  while (fgets(tbuf, MAXLINELEN, infile)) {
+    if (is_eoln_or_comment(*(skip_initial_spaces(tbuf)))) {
+      continue;
+    }
+    if (IS_SET(marker_exclude, uii)) {
+      uii++;
+      continue;
+    }
+    cptr = (char*)memchr(tbuf, 0, MAXLINELEN);
+    if (cptr[-1] == '\n') {
+      cptr--;
+      if (cptr[-1] == '\r') {
+	cptr--;
+      }
+    }
+    *cptr++ = '\t';
+    fwrite(tbuf, 1, cptr - tbuf, outfile);
+    fputs(marker_alleles[marker_idx * 2], outfile);
+    putc('\t', outfile);
+    fputs(marker_alleles[marker_idx * 2 + 1], outfile);
+    if (putc_checked('\n', outfile)) {
+      goto lgen_to_bed_ret_WRITE_FAIL;
+    }
+    uii++;
+    marker_idx++;
+  }
+  if (!feof(infile)) {
+    goto lgen_to_bed_ret_READ_FAIL;
+  }
+  fclose_null(&infile);
+  if (map_is_unsorted) {
+    memcpy(outname_end, ".map.tmp", 9);
+    unlink(outname);
+  }
+  if (fclose_null(&outfile)) {
+    goto lgen_to_bed_ret_WRITE_FAIL;
+  }
+  memcpy(name_end, ".fam", 5);
+  memcpy(outname_end, ".fam", 5);
+#if _WIN32
+  uii = GetFullPathName(lgen_namebuf, FNAMESIZE, tbuf, NULL);
+  if ((!uii) || (uii > FNAMESIZE))
+#else
+  if (!realpath(lgen_namebuf, tbuf))
+#endif
+  {
+    sprintf(logbuf, "Error: Failed to open %s.\n", outname);
+    logprintb();
+    goto lgen_to_bed_ret_OPEN_FAIL;
+  }
+#if _WIN32
+  uii = GetFullPathName(outname, FNAMESIZE, &(tbuf[FNAMESIZE + 64]), NULL);
+  if (!(uii && (uii <= FNAMESIZE) && (!strcmp(tbuf, &(tbuf[FNAMESIZE + 64])))))
+#else
+  cptr = realpath(outname, &(tbuf[FNAMESIZE + 64]));
+  if (!(cptr && (!strcmp(tbuf, &(tbuf[FNAMESIZE + 64])))))
+#endif
+  {
+    if (fopen_checked(&infile, lgen_namebuf, "r")) {
+      goto lgen_to_bed_ret_OPEN_FAIL;
+    }
+    if (fopen_checked(&outfile, outname, "w")) {
+      goto lgen_to_bed_ret_OPEN_FAIL;
+    }
+    while (fgets(tbuf, MAXLINELEN, infile)) {
+      cptr = skip_initial_spaces(tbuf);
+      if (is_eoln_kns(*cptr)) {
+	continue;
+      }
+      ulii = strlen(cptr);
+      if (cptr[ulii - 1] != '\n') {
+	cptr[ulii++] = '\n';
+      }
+      if (fwrite_checked(cptr, ulii, outfile)) {
+	goto lgen_to_bed_ret_WRITE_FAIL;
+      }
+    }
+    if (!feof(infile)) {
+      goto lgen_to_bed_ret_READ_FAIL;
+    }
+  }
+  memcpy(outname_end, ".bed", 5);
+  sprintf(logbuf, "Binary fileset written to %s + .bim + .fam.\n", outname);
+  logprintb();
+
+  while (0) {
+  lgen_to_bed_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  lgen_to_bed_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  lgen_to_bed_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  lgen_to_bed_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  lgen_to_bed_ret_INVALID_FORMAT_2:
+    cptr[strlen_se(cptr)] = '\0';
+    cptr2[strlen_se(cptr2)] = '\0';
+    sprintf(logbuf, "Error: Person %s %s in .lgen file but missing from .fam.\n", cptr, cptr2);
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  lgen_to_bed_ret_INVALID_FORMAT_5:
+    logprint("Error: Half-missing call in .lgen file.\n");
+    retval = RET_INVALID_FORMAT;
+    break;
+  lgen_to_bed_ret_INVALID_FORMAT_4:
+    logprint("Error: Improperly formatted --reference file.\n");
+    retval = RET_INVALID_FORMAT;
+    break;
+  lgen_to_bed_ret_INVALID_FORMAT:
+    logprint("Error: Improperly formatted .lgen file.\n");
+    retval = RET_INVALID_FORMAT;
+    break;
+  lgen_to_bed_ret_INVALID_FORMAT_3:
+    sprintf(logbuf, "Error: Marker %s in .lgen file has 3+ different alleles.\n", id_buf);
+    logprintb();
+    retval = RET_INVALID_FORMAT;
+    break;
+  lgen_to_bed_ret_INVALID_CMDLINE:
+    retval = RET_INVALID_CMDLINE;
+    break;
+  }
+ lgen_to_bed_ret_1:
+  if (spill_files) {
+    lgen_spill_cleanup(spill_files, spill_ct, outname, outname_end);
+  }
+  if (marker_alleles) {
+    ma_end = &(marker_alleles[2 * marker_ct]);
+    cptr = &(one_char_strs[448]);
+    while (marker_alleles < ma_end) {
+      sptr = *marker_alleles++;
+      if (sptr && (((uintptr_t)sptr < (uintptr_t)one_char_strs) || ((uintptr_t)sptr >= (uintptr_t)cptr))) {
+	free(sptr);
+      }
+    }
+  }
+  wkspace_reset(wkspace_mark);
+  if (infile) {
+    fclose(infile);
+  }
+  if (outfile) {
+    fclose(outfile);
+  }
+  return retval;
+}
+
+uint32_t update_alleles_and_cts(char** alleles, uint32_t* allele_cts, char* ss, uint32_t slen) {
+  if ((!memcmp(ss, alleles[0], slen)) && (alleles[0][slen] == '\0')) {
+    allele_cts[0] += 1;
+    return 0;
+  } else if (!alleles[0][0]) {
+    memcpy(alleles[0], ss, slen);
+    alleles[0][slen] = '\0';
+    allele_cts[0] = 1;
+    return 0;
+  } else if ((!memcmp(ss, alleles[1], slen)) && (alleles[1][slen] == '\0')) {
+    allele_cts[1] += 1;
+    return 1;
+  } else if (!alleles[1][0]) {
+    memcpy(alleles[1], ss, slen);
+    alleles[1][slen] = '\0';
+    allele_cts[1] = 1;
+    return 1;
+  } else if ((!memcmp(ss, alleles[2], slen)) && (alleles[2][slen] == '\0')) {
+    allele_cts[2] += 1;
+    return 2;
+  } else if (!alleles[2][0]) {
+    memcpy(alleles[2], ss, slen);
+    alleles[2][slen] = '\0';
+    allele_cts[2] = 1;
+    return 2;
+  } else if ((!memcmp(ss, alleles[3], slen)) && (alleles[3][slen] == '\0')) {
+    allele_cts[3] += 1;
+    return 3;
+  } else if (!alleles[2][0]) {
+    memcpy(alleles[3], ss, slen);
+    alleles[3][slen] = '\0';
+    allele_cts[3] = 1;
+    return 3;
+  } else {
+    return 4;
+  }
+}
+
+void transposed_to_bed_print_pct(uint32_t pct) {
+  printf("Processing .tped file... %u%%", pct);
+  fflush(stdout);
+}
+
+#ifndef _WIN32
+// Pipelined .tped -> .bed conversion.  The main thread reads blocks of lines
+// and handles the order-dependent first four columns (chromosome name
+// resolution, position sortedness), g_tp_encoder_ct threads encode the
+// genotype columns of whole blocks, and a writer thread emits the .bed rows,
+// .bim lines, notes and errors strictly in file order.  Blocks live in a ring
+// of g_tp_slot_ct slots; yarn locks carry the handoffs.
+#define TPED_LINE_INCLUDE 0
+#define TPED_LINE_SKIP 1
+// everything from here on terminates the conversion
+#define TPED_LINE_ERR_FORMAT 2
+#define TPED_LINE_ERR_CHROM 3
+// reader-side failure with return code g_tp_reader_retval
+#define TPED_LINE_ERR_RETVAL 4
+#define TPED_LINE_ERR_LONG_ALLELE 5
+#define TPED_LINE_ERR_HALF_MISSING 6
+#define TPED_LINE_ERR_ALLELE_CT 7
+
+#define TPED_FLAG_EXTRA_COLS 1
+#define TPED_FLAG_TRIALLELIC 2
+#define TPED_FLAG_QUADALLELIC 4
+
+#define TPED_BLOCK_SIZE 8388608
+// lock value signalling "no more blocks" / "abort"
+#define TPED_LOCK_MAX 0x7fffffff
+
+typedef struct tped_block_struct {
+  char* buf;
+  char** line_starts;
+  unsigned char* line_status;
+  unsigned char* line_flags;
+  // end of each line's .bim text in bimbuf
+  uintptr_t* bim_ends;
+  char* bimbuf;
+  unsigned char* bedbuf;
+  uint32_t line_ct;
+  uintptr_t err_indiv_idx;
+  uintptr_t max_allele_len;
+  int64_t end_pos;
+} Tped_block;
+
+static Tped_block g_tp_blocks[2 * MAX_THREADS + 2];
+static uint32_t g_tp_slot_ct;
+static uint32_t g_tp_encoder_ct;
+static uintptr_t g_tp_block_size;
+static uint32_t g_tp_line_max;
+static char* g_tp_allele_bufs[MAX_THREADS];
+static unsigned char* g_tp_prewritebufs[MAX_THREADS];
+static uintptr_t g_tp_indiv_ct;
+static char g_tp_missing_geno;
+// number of blocks read (TPED_LOCK_MAX once the reader is done)
+static lock* g_tp_read_lock;
+// next block to encode
+static lock* g_tp_encode_lock;
+// 1 + sequence number of the block most recently encoded in each slot
+static lock* g_tp_slot_locks[2 * MAX_THREADS + 2];
+// number of blocks written (TPED_LOCK_MAX on abort)
+static lock* g_tp_written_lock;
+static uintptr_t g_tp_block_ct;
+static uint32_t g_tp_abort;
+static int32_t g_tp_reader_retval;
+static int32_t g_tp_writer_retval;
+static FILE* g_tp_bimfile;
+static FILE* g_tp_bedfile;
+static int64_t g_tp_tped_size;
+static uintptr_t g_tp_max_marker_allele_len;
+
+void tped_encode_block(Tped_block* tbp, char** alleles, unsigned char* prewritebuf) {
+  // Same per-marker logic as the serial loop in transposed_to_bed().
+  uintptr_t indiv_ct = g_tp_indiv_ct;
+  uintptr_t indiv_ct4 = (indiv_ct + 3) / 4;
+  uint32_t line_ct = tbp->line_ct;
+  char missing_geno = g_tp_missing_geno;
+  char* bimbuf = tbp->bimbuf;
+  unsigned char* bedbuf = tbp->bedbuf;
+  uintptr_t bim_len = 0;
+  uintptr_t max_allele_len = 0;
+  char* salleles[4];
+  uint32_t allele_cts[4];
+  unsigned char writemap[17];
+  uint32_t line_idx;
+  uintptr_t indiv_idx;
+  char* cptr;
+  char* cptr2;
+  char* a1ptr;
+  char* a2ptr;
+  unsigned char* ucptr;
+  unsigned char* ucptr2;
+  unsigned char ucc;
+  uint32_t a1len;
+  uint32_t a2len;
+  uint32_t uii;
+  uint32_t ujj;
+  int32_t ii;
+  writemap[16] = 1;
+  for (line_idx = 0; line_idx < line_ct; line_idx++) {
+    if (tbp->line_status[line_idx] != TPED_LINE_INCLUDE) {
+      tbp->bim_ends[line_idx] = bim_len;
+      if (tbp->line_status[line_idx] != TPED_LINE_SKIP) {
+	break;
+      }
+      continue;
     }
-  } else {
-    while (fgets(tbuf, MAXLINELEN, infile)) {
-      cptr = skip_initial_spaces(tbuf);
-      if (is_eoln_kns(*cptr)) {
-	continue;
+    tbp->line_flags[line_idx] = 0;
+    cptr = tbp->line_starts[line_idx];
+    for (uii = 0; uii < 4; uii++) {
+      cptr2 = item_endnn(cptr);
+      memcpy(&(bimbuf[bim_len]), cptr, cptr2 - cptr);
+      bim_len += cptr2 - cptr;
+      bimbuf[bim_len++] = '\t';
+      cptr = skip_initial_spaces(cptr2);
+    }
+    alleles[0][0] = '\0';
+    alleles[1][0] = '\0';
+    alleles[2][0] = '\0';
+    alleles[3][0] = '\0';
+    allele_cts[0] = 0;
+    allele_cts[1] = 0;
+    allele_cts[2] = 0;
+    allele_cts[3] = 0;
+    cptr2 = cptr;
+    for (indiv_idx = 0; indiv_idx < indiv_ct; indiv_idx++) {
+      a1ptr = cptr2;
+      a1len = strlen_se(cptr2);
+      if (a1len >= MAXLINELEN / 2) {
+	tbp->line_status[line_idx] = TPED_LINE_ERR_LONG_ALLELE;
+	goto tped_encode_block_ret;
       }
-      cptr2 = next_item(cptr);
-      cptr3 = next_item(cptr2);
-      cptr4 = item_end(cptr3);
-      if (!cptr4) {
-	goto lgen_to_bed_ret_INVALID_FORMAT;
+      cptr2 = skip_initial_spaces(&(a1ptr[a1len]));
+      a2ptr = cptr2;
+      a2len = strlen_se(cptr2);
+      if (a2len >= MAXLINELEN / 2) {
+	tbp->line_status[line_idx] = TPED_LINE_ERR_LONG_ALLELE;
+	goto tped_encode_block_ret;
       }
-      a1ptr = skip_initial_spaces(cptr4);
-      if (no_more_items_kns(a1ptr)) {
-	goto lgen_to_bed_ret_INVALID_FORMAT;
+      cptr2 = skip_initial_spaces(&(a2ptr[a2len]));
+      if ((a1len == 1) && (*a1ptr == missing_geno)) {
+	if ((a2len != 1) || (*a2ptr != missing_geno)) {
+	  goto tped_encode_block_HALF_MISSING;
+	}
+	prewritebuf[indiv_idx] = 16;
+      } else if ((a2len == 1) && (*a2ptr == missing_geno)) {
+	goto tped_encode_block_HALF_MISSING;
+      } else {
+	uii = update_alleles_and_cts(alleles, allele_cts, a1ptr, a1len);
+	ujj = update_alleles_and_cts(alleles, allele_cts, a2ptr, a2len);
+	if ((uii == 4) || (ujj == 4)) {
+	  tbp->line_status[line_idx] = TPED_LINE_ERR_ALLELE_CT;
+	  goto tped_encode_block_ret;
+	}
+	prewritebuf[indiv_idx] = uii * 4 + ujj;
       }
-      ii = bsearch_fam_indiv(id_buf, sorted_indiv_ids, max_person_id_len, indiv_ct, cptr, cptr2);
-      if (ii == -1) {
-	goto lgen_to_bed_ret_INVALID_FORMAT_2;
+    }
+    if (!is_eoln_kns(*cptr2)) {
+      tbp->line_flags[line_idx] = TPED_FLAG_EXTRA_COLS;
+    }
+    memcpy(salleles, alleles, 4 * sizeof(intptr_t));
+    for (uii = 1; uii < 4; uii++) {
+      ujj = allele_cts[uii];
+      if (allele_cts[uii - 1] < ujj) {
+	a1ptr = salleles[uii];
+	ii = uii;
+	do {
+	  ii--;
+	  salleles[ii + 1] = salleles[ii];
+	  allele_cts[ii + 1] = allele_cts[ii];
+	} while ((ii > 0) && (allele_cts[ii - 1] < ujj));
+	salleles[ii] = a1ptr;
+	allele_cts[ii] = ujj;
       }
-      indiv_idx = indiv_id_map[(uint32_t)ii];
-      ulii = (uintptr_t)(cptr4 - cptr3);
-      memcpyx(id_buf, cptr3, ulii, '\0');
-      ii = bsearch_str(id_buf, marker_ids, max_marker_id_len, 0, marker_ct - 1);
-      if (ii != -1) {
-	marker_idx = marker_id_map[ii];
-	a1len = strlen_se(a1ptr);
-	ucc = (unsigned char)(*a1ptr);
-	if ((a1len != 1) || (ucc < 48) || (ucc > 50)) {
-	  uii = 1;
-	} else {
-	  uii = ucc - 48;
-	  if (uii) {
-	    uii++;
+    }
+    if (allele_cts[2]) {
+      tbp->line_flags[line_idx] |= allele_cts[3]? TPED_FLAG_QUADALLELIC : TPED_FLAG_TRIALLELIC;
+    }
+    for (uii = 0; uii < 4; uii++) {
+      a1ptr = alleles[uii];
+      ucptr = &(writemap[4 * uii]);
+      if (*a1ptr == '\0') {
+	memset(ucptr, 1, 4);
+      } else if (a1ptr == salleles[0]) {
+	for (ujj = 0; ujj < 4; ujj++) {
+	  a1ptr = alleles[ujj];
+	  if (*a1ptr == '\0') {
+	    *ucptr++ = 1;
+	  } else if (a1ptr == salleles[0]) {
+	    *ucptr++ = 3;
+	  } else if (a1ptr == salleles[1]) {
+	    *ucptr++ = 2;
+	  } else {
+	    *ucptr++ = 1;
 	  }
 	}
-	ulii = marker_idx * indiv_ct4 + (indiv_idx / 4);
-	ujj = (indiv_idx % 4) * 2;
-	writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
-      }
-      if (ftello(infile) >= lgen_next_thresh) {
-	uii = (ftello(infile) * 100) / lgen_size;
-	if (pct >= 10) {
-	  putchar('\b');
+      } else if (a1ptr == salleles[1]) {
+	for (ujj = 0; ujj < 4; ujj++) {
+	  a1ptr = alleles[ujj];
+	  if (*a1ptr == '\0') {
+	    *ucptr++ = 1;
+	  } else if (a1ptr == salleles[0]) {
+	    *ucptr++ = 2;
+	  } else if (a1ptr == salleles[1]) {
+	    *ucptr++ = 0;
+	  } else {
+	    *ucptr++ = 1;
+	  }
 	}
-	printf("\b\b%u%%", uii);
-	fflush(stdout);
-	pct = uii;
-	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
+      } else {
+	memset(ucptr, 1, 4);
       }
     }
-  }
-  if (!feof(infile)) {
-    goto lgen_to_bed_ret_READ_FAIL;
-  }
-  fclose_null(&infile);
-  if (pct < 10) {
-    fputs("\b\b", stdout);
-  } else if (pct < 100) {
-    fputs("\b\b\b", stdout);
-  } else {
-    fputs("\b\b\b\b", stdout);
-  }
-  logprint("done.\n");
-  ukk = indiv_ct / 4;
-  umm = indiv_ct % 4;
-  fill_bmap_short(bmap_short, umm);
-  bmap2 = &(bmap_short[256]);
-  for (uii = 0; uii < marker_ct; uii++) {
-    if (popcount_chars((uintptr_t*)writebuf, uii * indiv_ct4, (uii + 1) * indiv_ct4) < indiv_ct) {
-      ucptr = &(writebuf[uii * indiv_ct4]);
-      for (ujj = 0; ujj < ukk; ujj++) {
-	*ucptr = bmap_short[*ucptr];
-	ucptr++;
+    uii = indiv_ct & (~3U);
+    ucptr = bedbuf;
+    for (ujj = 0; ujj < uii; ujj += 4) {
+      *ucptr++ = writemap[prewritebuf[ujj]] | (writemap[prewritebuf[ujj + 1]] << 2) | (writemap[prewritebuf[ujj + 2]] << 4) | (writemap[prewritebuf[ujj + 3]] << 6);
+    }
+    ucc = 0;
+    ucptr2 = &(prewritebuf[uii]);
+    uii = indiv_ct % 4;
+    if (uii) {
+      for (ujj = 0; ujj < uii; ujj++) {
+	ucc |= (writemap[*ucptr2++]) << (ujj * 2);
       }
-      if (umm) {
-        *ucptr = bmap2[*ucptr];
-	ucptr++;
+      *ucptr = ucc;
+    }
+    bedbuf = &(bedbuf[indiv_ct4]);
+    for (uii = 2; uii;) {
+      a1ptr = salleles[--uii];
+      if (*a1ptr == '\0') {
+	bimbuf[bim_len++] = '0';
+      } else {
+	ujj = strlen(a1ptr);
+	if (ujj > max_allele_len) {
+	  max_allele_len = ujj;
+	}
+	memcpy(&(bimbuf[bim_len]), a1ptr, ujj);
+	bim_len += ujj;
       }
-      cptr = marker_alleles[uii * 2];
-      marker_alleles[uii * 2] = marker_alleles[uii * 2 + 1];
-      marker_alleles[uii * 2 + 1] = cptr;
+      bimbuf[bim_len++] = uii? '\t' : '\n';
     }
+    tbp->bim_ends[line_idx] = bim_len;
   }
-  if (fwrite_checked(writebuf, ((uintptr_t)marker_ct) * indiv_ct4, outfile)) {
-    goto lgen_to_bed_ret_WRITE_FAIL;
-  }
-  if (fclose_null(&outfile)) {
-    goto lgen_to_bed_ret_WRITE_FAIL;
+  while (0) {
+  tped_encode_block_HALF_MISSING:
+    tbp->line_status[line_idx] = TPED_LINE_ERR_HALF_MISSING;
+    tbp->err_indiv_idx = indiv_idx;
   }
-  if (map_is_unsorted) {
-    memcpy(outname_end, ".map.tmp", 9);
-    if (fopen_checked(&infile, outname, "r")) {
-      goto lgen_to_bed_ret_OPEN_FAIL;
-    }
-  } else {
-    memcpy(name_end, ".map", 5);
-    if (fopen_checked(&infile, lgen_namebuf, "r")) {
-      goto lgen_to_bed_ret_OPEN_FAIL;
+ tped_encode_block_ret:
+  tbp->max_allele_len = max_allele_len;
+}
+
+void tped_encoder_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  char* alleles[4];
+  uintptr_t seq;
+  uint32_t slot_idx;
+  alleles[0] = g_tp_allele_bufs[tidx];
+  alleles[1] = &(alleles[0][MAXLINELEN / 2]);
+  alleles[2] = &(alleles[0][MAXLINELEN]);
+  alleles[3] = &(alleles[0][MAXLINELEN + (MAXLINELEN / 2)]);
+  while (1) {
+    possess(g_tp_encode_lock);
+    seq = peek_lock(g_tp_encode_lock);
+    twist(g_tp_encode_lock, BY, 1);
+    possess(g_tp_read_lock);
+    wait_for(g_tp_read_lock, TO_BE_MORE_THAN, seq);
+    if (seq >= g_tp_block_ct) {
+      release(g_tp_read_lock);
+      return;
     }
+    release(g_tp_read_lock);
+    slot_idx = seq % g_tp_slot_ct;
+    tped_encode_block(&(g_tp_blocks[slot_idx]), alleles, g_tp_prewritebufs[tidx]);
+    possess(g_tp_slot_locks[slot_idx]);
+    twist(g_tp_slot_locks[slot_idx], TO, seq + 1);
   }
-  memcpy(outname_end, ".bim", 5);
-  if (fopen_checked(&outfile, outname, "w")) {
-    goto lgen_to_bed_ret_OPEN_FAIL;
-  }
-  uii = 2 * marker_ct;
-  for (ujj = 0; ujj < uii; ujj++) {
-    if (!marker_alleles[ujj]) {
-      marker_alleles[ujj] = &(one_char_strs[(((unsigned char)missing_geno) - ' ') * 2]);
+}
+
+void tped_writer_thread(void* arg) {
+  uintptr_t indiv_ct4 = (g_tp_indiv_ct + 3) / 4;
+  int64_t tped_size = g_tp_tped_size;
+  uint32_t no_extra_cols = 1;
+  uint32_t pct = 0;
+  int32_t retval = 0;
+  Tped_block* tbp;
+  uintptr_t seq;
+  uintptr_t row_ct;
+  uintptr_t bim_len;
+  uint32_t slot_idx;
+  uint32_t line_idx;
+  uint32_t uii;
+  char* cptr;
+  for (seq = 0; ; seq++) {
+    possess(g_tp_read_lock);
+    wait_for(g_tp_read_lock, TO_BE_MORE_THAN, seq);
+    if (seq >= g_tp_block_ct) {
+      release(g_tp_read_lock);
+      break;
     }
-  }
-  uii = 0;
-  marker_idx = 0;
-  while (fgets(tbuf, MAXLINELEN, infile)) {
-    if (is_eoln_or_comment(*(skip_initial_spaces(tbuf)))) {
-      continue;
+    release(g_tp_read_lock);
+    slot_idx = seq % g_tp_slot_ct;
+    possess(g_tp_slot_locks[slot_idx]);
+    wait_for(g_tp_slot_locks[slot_idx], TO_BE, seq + 1);
+    release(g_tp_slot_locks[slot_idx]);
+    tbp = &(g_tp_blocks[slot_idx]);
+    row_ct = 0;
+    bim_len = 0;
+    for (line_idx = 0; line_idx < tbp->line_ct; line_idx++) {
+      if (tbp->line_status[line_idx] == TPED_LINE_SKIP) {
+	continue;
+      } else if (tbp->line_status[line_idx] != TPED_LINE_INCLUDE) {
+	break;
+      }
+      row_ct++;
+      if (tbp->line_flags[line_idx]) {
+	// notes reference the fourth column, like the serial converter's
+	cptr = next_item_mult(tbp->line_starts[line_idx], 3);
+	cptr[strlen_se(cptr)] = '\0';
+	if (no_extra_cols && (tbp->line_flags[line_idx] & TPED_FLAG_EXTRA_COLS)) {
+	  no_extra_cols = 0;
+	  putchar('\r');
+	  logprint("Note: Extra columns in .tped file.  Ignoring.\n");
+	  transposed_to_bed_print_pct(pct);
+	}
+	if (tbp->line_flags[line_idx] & (TPED_FLAG_TRIALLELIC | TPED_FLAG_QUADALLELIC)) {
+	  putchar('\r');
+	  sprintf(logbuf, "Note: Marker %s is %sallelic.  Setting rarest alleles to missing.\n", cptr, (tbp->line_flags[line_idx] & TPED_FLAG_QUADALLELIC)? "quad" : "tri");
+	  logprintb();
+	  transposed_to_bed_print_pct(pct);
+	}
+      }
     }
-    if (IS_SET(marker_exclude, uii)) {
-      uii++;
-      continue;
+    if (line_idx) {
+      bim_len = tbp->bim_ends[line_idx - 1];
     }
-    cptr = (char*)memchr(tbuf, 0, MAXLINELEN);
-    if (cptr[-1] == '\n') {
-      cptr--;
-      if (cptr[-1] == '\r') {
-	cptr--;
+    if (fwrite_checked(tbp->bimbuf, bim_len, g_tp_bimfile) || fwrite_checked(tbp->bedbuf, row_ct * indiv_ct4, g_tp_bedfile)) {
+      retval = RET_WRITE_FAIL;
+      goto tped_writer_thread_ret;
+    }
+    if (line_idx < tbp->line_ct) {
+      if (tbp->line_status[line_idx] != TPED_LINE_ERR_FORMAT) {
+	cptr = next_item_mult(tbp->line_starts[line_idx], 3);
+	cptr[strlen_se(cptr)] = '\0';
+      }
+      switch (tbp->line_status[line_idx]) {
+      case TPED_LINE_ERR_FORMAT:
+	putchar('\r');
+	logprint("Error: Improperly formatted .tped file.\n");
+	retval = RET_INVALID_FORMAT;
+	break;
+      case TPED_LINE_ERR_CHROM:
+	logprint("Error: Unrecognized chromosome code in .tped file.  (Did you forget\n--allow-extra-chroms?).\n");
+	retval = RET_INVALID_FORMAT;
+	break;
+      case TPED_LINE_ERR_RETVAL:
+	retval = g_tp_reader_retval;
+	break;
+      case TPED_LINE_ERR_LONG_ALLELE:
+	putchar('\r');
+	logprint("Error: Pathologically long allele code in .tped file.\n");
+	retval = RET_INVALID_FORMAT;
+	break;
+      case TPED_LINE_ERR_HALF_MISSING:
+	sprintf(logbuf, "Error: half-missing call at marker %s, indiv %" PRIuPTR " in .tped file.\n", cptr, tbp->err_indiv_idx);
+	putchar('\r');
+	logprintb();
+	retval = RET_INVALID_FORMAT;
+	break;
+      case TPED_LINE_ERR_ALLELE_CT:
+	putchar('\r');
+	sprintf(logbuf, "Error: More than four alleles at marker %s.\n", cptr);
+	logprintb();
+	retval = RET_INVALID_FORMAT;
+	break;
       }
+      goto tped_writer_thread_ret;
     }
-    *cptr++ = '\t';
-    fwrite(tbuf, 1, cptr - tbuf, outfile);
-    fputs(marker_alleles[marker_idx * 2], outfile);
-    putc('\t', outfile);
-    fputs(marker_alleles[marker_idx * 2 + 1], outfile);
-    if (putc_checked('\n', outfile)) {
-      goto lgen_to_bed_ret_WRITE_FAIL;
+    if (tbp->max_allele_len >= g_tp_max_marker_allele_len) {
+      g_tp_max_marker_allele_len = tbp->max_allele_len + 1;
     }
-    uii++;
-    marker_idx++;
+    uii = tped_size? ((tbp->end_pos * 100) / tped_size) : 0;
+    if (uii > pct) {
+      if (pct >= 10) {
+	putchar('\b');
+      }
+      printf("\b\b%u%%", uii);
+      fflush(stdout);
+      pct = uii;
+    }
+    possess(g_tp_written_lock);
+    twist(g_tp_written_lock, BY, 1);
   }
-  if (!feof(infile)) {
-    goto lgen_to_bed_ret_READ_FAIL;
+ tped_writer_thread_ret:
+  if (retval) {
+    g_tp_writer_retval = retval;
+    possess(g_tp_written_lock);
+    g_tp_abort = 1;
+    twist(g_tp_written_lock, TO, TPED_LOCK_MAX);
   }
-  fclose_null(&infile);
-  if (map_is_unsorted) {
-    memcpy(outname_end, ".map.tmp", 9);
-    unlink(outname);
+}
+
+int32_t tped_pipeline(FILE* infile, FILE* bimfile, FILE* bedfile, int64_t tped_size, uintptr_t indiv_ct, char missing_geno, uint32_t allow_extra_chroms, Chrom_info* chrom_info_ptr, int64_t* mapvals, uintptr_t* marker_ct_ptr, uint32_t* map_is_unsorted_ptr, uintptr_t* max_marker_id_len_ptr, uintptr_t* max_marker_allele_len_ptr) {
+  // Returns -1 if there isn't enough memory for a reasonable number of slots,
+  // in which case the caller should use the serial converter.  Otherwise,
+  // returns 0 or an error code (with error messages already printed).
+  uintptr_t topsize = 0;
+  uintptr_t indiv_ct4 = (indiv_ct + 3) / 4;
+  uintptr_t encoder_ct = g_thread_ct - 1;
+  uintptr_t block_size = TPED_BLOCK_SIZE;
+  uintptr_t max_marker_id_len = 0;
+  uintptr_t marker_idx = 0;
+  int64_t last_mapval = 0;
+  uint32_t map_is_unsorted = 0;
+  uint32_t stop = 0;
+  uint32_t eof = 0;
+  int64_t bytes_read = 0;
+  uintptr_t carry_len = 0;
+  char* carry_ptr = NULL;
+  int32_t retval = 0;
+  thread* threads[MAX_THREADS + 1];
+  Tped_block* tbp;
+  uintptr_t slot_bytes;
+  uintptr_t scratch_bytes;
+  uintptr_t mapval_max;
+  uintptr_t line_max;
+  uintptr_t buf_len;
+  uintptr_t buf_pos;
+  uintptr_t seq;
+  uintptr_t ulii;
+  uint32_t slot_idx;
+  uint32_t line_ct;
+  uint32_t status;
+  int64_t cur_mapval;
+  char* line_end;
+  char* cptr;
+  char* cptr2;
+  char* cptr3;
+  char* cptr4;
+  int32_t ii;
+  if (!encoder_ct) {
+    encoder_ct = 1;
   }
-  if (fclose_null(&outfile)) {
-    goto lgen_to_bed_ret_WRITE_FAIL;
+  if (block_size < 4 * (4 * indiv_ct + MAXLINELEN)) {
+    block_size = 4 * (4 * indiv_ct + MAXLINELEN);
   }
-  memcpy(name_end, ".fam", 5);
-  memcpy(outname_end, ".fam", 5);
-#if _WIN32
-  uii = GetFullPathName(lgen_namebuf, FNAMESIZE, tbuf, NULL);
-  if ((!uii) || (uii > FNAMESIZE))
-#else
-  if (!realpath(lgen_namebuf, tbuf))
-#endif
-  {
-    sprintf(logbuf, "Error: Failed to open %s.\n", outname);
-    logprintb();
-    goto lgen_to_bed_ret_OPEN_FAIL;
+  // a well-formed line can't be shorter than this
+  line_max = block_size / (4 * indiv_ct + 8) + 1;
+  slot_bytes = CACHEALIGN(block_size + 1) + 2 * CACHEALIGN(line_max * sizeof(intptr_t)) + 2 * CACHEALIGN(line_max) + CACHEALIGN(block_size + 8 * line_max) + CACHEALIGN(line_max * indiv_ct4);
+  scratch_bytes = CACHEALIGN(2 * MAXLINELEN) + CACHEALIGN(indiv_ct);
+  // leave at least half the workspace for the marker positions
+  while ((encoder_ct > 1) && (encoder_ct * scratch_bytes + (2 * encoder_ct + 2) * slot_bytes > wkspace_left / 2)) {
+    encoder_ct--;
   }
-#if _WIN32
-  uii = GetFullPathName(outname, FNAMESIZE, &(tbuf[FNAMESIZE + 64]), NULL);
-  if (!(uii && (uii <= FNAMESIZE) && (!strcmp(tbuf, &(tbuf[FNAMESIZE + 64])))))
-#else
-  cptr = realpath(outname, &(tbuf[FNAMESIZE + 64]));
-  if (!(cptr && (!strcmp(tbuf, &(tbuf[FNAMESIZE + 64])))))
-#endif
-  {
-    if (fopen_checked(&infile, lgen_namebuf, "r")) {
-      goto lgen_to_bed_ret_OPEN_FAIL;
+  if ((encoder_ct * scratch_bytes + (2 * encoder_ct + 2) * slot_bytes > wkspace_left / 2) || (slot_bytes > 0xffffffffU)) {
+    return -1;
+  }
+  g_tp_encoder_ct = encoder_ct;
+  g_tp_slot_ct = 2 * encoder_ct + 2;
+  g_tp_block_size = block_size;
+  g_tp_line_max = line_max;
+  for (ulii = 0; ulii < encoder_ct; ulii++) {
+    g_tp_allele_bufs[ulii] = (char*)top_alloc(&topsize, 2 * MAXLINELEN);
+    g_tp_prewritebufs[ulii] = top_alloc(&topsize, indiv_ct);
+  }
+  for (slot_idx = 0; slot_idx < g_tp_slot_ct; slot_idx++) {
+    tbp = &(g_tp_blocks[slot_idx]);
+    tbp->buf = (char*)top_alloc(&topsize, block_size + 1);
+    tbp->line_starts = (char**)top_alloc(&topsize, line_max * sizeof(intptr_t));
+    tbp->line_status = top_alloc(&topsize, line_max);
+    tbp->line_flags = top_alloc(&topsize, line_max);
+    tbp->bim_ends = (uintptr_t*)top_alloc(&topsize, line_max * sizeof(intptr_t));
+    tbp->bimbuf = (char*)top_alloc(&topsize, block_size + 8 * line_max);
+    tbp->bedbuf = top_alloc(&topsize, line_max * indiv_ct4);
+  }
+  // mapvals starts at wkspace_base
+  mapval_max = (wkspace_left - topsize) / sizeof(int64_t);
+  g_tp_indiv_ct = indiv_ct;
+  g_tp_missing_geno = missing_geno;
+  g_tp_block_ct = ~ZEROLU;
+  g_tp_abort = 0;
+  g_tp_reader_retval = 0;
+  g_tp_writer_retval = 0;
+  g_tp_bimfile = bimfile;
+  g_tp_bedfile = bedfile;
+  g_tp_tped_size = tped_size;
+  g_tp_max_marker_allele_len = *max_marker_allele_len_ptr;
+  g_tp_read_lock = new_lock(0);
+  g_tp_encode_lock = new_lock(0);
+  g_tp_written_lock = new_lock(0);
+  for (slot_idx = 0; slot_idx < g_tp_slot_ct; slot_idx++) {
+    g_tp_slot_locks[slot_idx] = new_lock(0);
+  }
+  threads[0] = launch(tped_writer_thread, NULL);
+  for (ulii = 0; ulii < encoder_ct; ulii++) {
+    threads[ulii + 1] = launch(tped_encoder_thread, (void*)ulii);
+  }
+  for (seq = 0; !stop; seq++) {
+    slot_idx = seq % g_tp_slot_ct;
+    possess(g_tp_written_lock);
+    if (seq >= g_tp_slot_ct) {
+      // wait for the writer to be done with this slot's previous block
+      wait_for(g_tp_written_lock, TO_BE_MORE_THAN, seq - g_tp_slot_ct);
+    }
+    stop = g_tp_abort;
+    release(g_tp_written_lock);
+    if (stop) {
+      break;
     }
-    if (fopen_checked(&outfile, outname, "w")) {
-      goto lgen_to_bed_ret_OPEN_FAIL;
+    tbp = &(g_tp_blocks[slot_idx]);
+    if (carry_len) {
+      memcpy(tbp->buf, carry_ptr, carry_len);
     }
-    while (fgets(tbuf, MAXLINELEN, infile)) {
-      cptr = skip_initial_spaces(tbuf);
+    buf_len = carry_len;
+    if (!eof) {
+      ulii = fread(&(tbp->buf[buf_len]), 1, block_size - buf_len, infile);
+      bytes_read += ulii;
+      buf_len += ulii;
+      if (buf_len < block_size) {
+	if (ferror(infile)) {
+	  g_tp_reader_retval = RET_READ_FAIL;
+	}
+	eof = 1;
+      }
+    }
+    buf_pos = 0;
+    line_ct = 0;
+    if (g_tp_reader_retval) {
+      goto tped_pipeline_reader_fail;
+    }
+    while (line_ct < line_max) {
+      cptr = &(tbp->buf[buf_pos]);
+      line_end = (char*)memchr(cptr, '\n', buf_len - buf_pos);
+      if (!line_end) {
+	if ((!eof) || (buf_pos == buf_len)) {
+	  break;
+	}
+	// final line with no trailing newline
+	line_end = &(tbp->buf[buf_len]);
+      }
+      // the item-scanning helpers expect each line to be null-terminated
+      *line_end = '\0';
+      buf_pos = (uintptr_t)(line_end - tbp->buf) + 1;
+      if (buf_pos > buf_len) {
+	buf_pos = buf_len;
+      }
+      cptr = skip_initial_spaces(cptr);
       if (is_eoln_kns(*cptr)) {
 	continue;
       }
-      ulii = strlen(cptr);
-      if (cptr[ulii - 1] != '\n') {
-	cptr[ulii++] = '\n';
-      }
-      if (fwrite_checked(cptr, ulii, outfile)) {
-	goto lgen_to_bed_ret_WRITE_FAIL;
+      cptr2 = next_item(cptr);
+      cptr3 = next_item_mult(cptr2, 2);
+      cptr4 = next_item(cptr3);
+      status = TPED_LINE_INCLUDE;
+      if (no_more_items_kns(cptr4)) {
+	status = TPED_LINE_ERR_FORMAT;
+      } else {
+	ii = marker_code(chrom_info_ptr, cptr);
+	if (ii == -1) {
+	  if (!allow_extra_chroms) {
+	    status = TPED_LINE_ERR_CHROM;
+	  } else {
+	    g_tp_reader_retval = resolve_or_add_chrom_name(chrom_info_ptr, cptr, &ii);
+	    if (g_tp_reader_retval) {
+	      status = TPED_LINE_ERR_RETVAL;
+	    }
+	  }
+	}
+	if (status == TPED_LINE_INCLUDE) {
+	  if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
+	    status = TPED_LINE_SKIP;
+	  } else {
+	    ulii = strlen_se(cptr2) + 1;
+	    if (ulii > max_marker_id_len) {
+	      max_marker_id_len = ulii;
+	    }
+	    if (*cptr3 == '-') {
+	      status = TPED_LINE_SKIP;
+	    } else if (marker_idx == mapval_max) {
+	      g_tp_reader_retval = RET_NOMEM;
+	      status = TPED_LINE_ERR_RETVAL;
+	    } else {
+	      cur_mapval = (((int64_t)ii) << 32) | atoi(cptr3);
+	      mapvals[marker_idx++] = cur_mapval;
+	      if (last_mapval > cur_mapval) {
+		map_is_unsorted = 1;
+	      } else {
+		last_mapval = cur_mapval;
+	      }
+	    }
+	  }
+	}
       }
-    }
-    if (!feof(infile)) {
-      goto lgen_to_bed_ret_READ_FAIL;
-    }
-  }
-  memcpy(outname_end, ".bed", 5);
-  sprintf(logbuf, "Binary fileset written to %s + .bim + .fam.\n", outname);
-  logprintb();
-
-  while (0) {
-  lgen_to_bed_ret_NOMEM:
-    retval = RET_NOMEM;
-    break;
-  lgen_to_bed_ret_CALC_NOT_YET_SUPPORTED:
-    retval = RET_CALC_NOT_YET_SUPPORTED;
-    break;
-  lgen_to_bed_ret_OPEN_FAIL:
-    retval = RET_OPEN_FAIL;
-    break;
-  lgen_to_bed_ret_READ_FAIL:
-    retval = RET_READ_FAIL;
-    break;
-  lgen_to_bed_ret_WRITE_FAIL:
-    retval = RET_WRITE_FAIL;
-    break;
-  lgen_to_bed_ret_INVALID_FORMAT_2:
-    cptr[strlen_se(cptr)] = '\0';
-    cptr2[strlen_se(cptr2)] = '\0';
-    sprintf(logbuf, "Error: Person %s %s in .lgen file but missing from .fam.\n", cptr, cptr2);
-    logprintb();
-    retval = RET_INVALID_FORMAT;
-    break;
-  lgen_to_bed_ret_INVALID_FORMAT_5:
-    logprint("Error: Half-missing call in .lgen file.\n");
-    retval = RET_INVALID_FORMAT;
-    break;
-  lgen_to_bed_ret_INVALID_FORMAT_4:
-    logprint("Error: Improperly formatted --reference file.\n");
-    retval = RET_INVALID_FORMAT;
-    break;
-  lgen_to_bed_ret_INVALID_FORMAT:
-    logprint("Error: Improperly formatted .lgen file.\n");
-    retval = RET_INVALID_FORMAT;
-    break;
-  lgen_to_bed_ret_INVALID_FORMAT_3:
-    sprintf(logbuf, "Error: Marker %s in .lgen file has 3+ different alleles.\n", id_buf);
-    logprintb();
-    retval = RET_INVALID_FORMAT;
-    break;
-  lgen_to_bed_ret_INVALID_CMDLINE:
-    retval = RET_INVALID_CMDLINE;
-    break;
-  }
- lgen_to_bed_ret_1:
-  if (marker_alleles) {
-    ma_end = &(marker_alleles[2 * marker_ct]);
-    cptr = &(one_char_strs[448]);
-    while (marker_alleles < ma_end) {
-      sptr = *marker_alleles++;
-      if (sptr && (((uintptr_t)sptr < (uintptr_t)one_char_strs) || ((uintptr_t)sptr >= (uintptr_t)cptr))) {
-	free(sptr);
+      tbp->line_starts[line_ct] = cptr;
+      tbp->line_status[line_ct++] = status;
+      if (status > TPED_LINE_SKIP) {
+	stop = 1;
+	break;
       }
     }
-  }
-  wkspace_reset(wkspace_mark);
-  if (infile) {
-    fclose(infile);
-  }
-  if (outfile) {
-    fclose(outfile);
+    if ((!line_ct) && (!stop) && (buf_len == block_size) && (!buf_pos)) {
+      // line doesn't fit in a block
+      g_tp_reader_retval = RET_NOMEM;
+    tped_pipeline_reader_fail:
+      tbp->line_status[line_ct++] = TPED_LINE_ERR_RETVAL;
+      stop = 1;
+    }
+    carry_ptr = &(tbp->buf[buf_pos]);
+    carry_len = buf_len - buf_pos;
+    if (eof && (!carry_len)) {
+      stop = 1;
+    }
+    tbp->line_ct = line_ct;
+    tbp->end_pos = bytes_read - carry_len;
+    possess(g_tp_read_lock);
+    twist(g_tp_read_lock, BY, 1);
+  }
+  possess(g_tp_read_lock);
+  g_tp_block_ct = seq;
+  twist(g_tp_read_lock, TO, TPED_LOCK_MAX);
+  for (ulii = 0; ulii <= encoder_ct; ulii++) {
+    join(threads[ulii]);
+  }
+  free_lock(g_tp_read_lock);
+  free_lock(g_tp_encode_lock);
+  free_lock(g_tp_written_lock);
+  for (slot_idx = 0; slot_idx < g_tp_slot_ct; slot_idx++) {
+    free_lock(g_tp_slot_locks[slot_idx]);
+  }
+  retval = g_tp_writer_retval;
+  if (!retval) {
+    *marker_ct_ptr = marker_idx;
+    *map_is_unsorted_ptr = map_is_unsorted;
+    *max_marker_id_len_ptr = max_marker_id_len;
+    *max_marker_allele_len_ptr = g_tp_max_marker_allele_len;
   }
   return retval;
 }
-
-uint32_t update_alleles_and_cts(char** alleles, uint32_t* allele_cts, char* ss, uint32_t slen) {
-  if ((!memcmp(ss, alleles[0], slen)) && (alleles[0][slen] == '\0')) {
-    allele_cts[0] += 1;
-    return 0;
-  } else if (!alleles[0][0]) {
-    memcpy(alleles[0], ss, slen);
-    alleles[0][slen] = '\0';
-    allele_cts[0] = 1;
-    return 0;
-  } else if ((!memcmp(ss, alleles[1], slen)) && (alleles[1][slen] == '\0')) {
-    allele_cts[1] += 1;
-    return 1;
-  } else if (!alleles[1][0]) {
-    memcpy(alleles[1], ss, slen);
-    alleles[1][slen] = '\0';
-    allele_cts[1] = 1;
-    return 1;
-  } else if ((!memcmp(ss, alleles[2], slen)) && (alleles[2][slen] == '\0')) {
-    allele_cts[2] += 1;
-    return 2;
-  } else if (!alleles[2][0]) {
-    memcpy(alleles[2], ss, slen);
-    alleles[2][slen] = '\0';
-    allele_cts[2] = 1;
-    return 2;
-  } else if ((!memcmp(ss, alleles[3], slen)) && (alleles[3][slen] == '\0')) {
-    allele_cts[3] += 1;
-    return 3;
-  } else if (!alleles[2][0]) {
-    memcpy(alleles[3], ss, slen);
-    alleles[3][slen] = '\0';
-    allele_cts[3] = 1;
-    return 3;
-  } else {
-    return 4;
-  }
-}
-
-void transposed_to_bed_print_pct(uint32_t pct) {
-  printf("Processing .tped file... %u%%", pct);
-  fflush(stdout);
-}
+#endif
 
 int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* outname_end, char missing_geno, uint64_t misc_flags, Chrom_info* chrom_info_ptr) {
   FILE* infile = NULL;
@@ -6562,6 +8455,17 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
   if (fwrite_checked("l\x1b\x01", 3, outfile)) {
     goto transposed_to_bed_ret_WRITE_FAIL;
   }
+#ifndef _WIN32
+  if (g_thread_ct > 1) {
+    retval = tped_pipeline(infile, bimfile, outfile, tped_size, indiv_ct, missing_geno, allow_extra_chroms, chrom_info_ptr, mapvals, &marker_idx, &map_is_unsorted, &max_marker_id_len, &max_marker_allele_len);
+    if (!retval) {
+      goto transposed_to_bed_pipeline_done;
+    } else if (retval != -1) {
+      goto transposed_to_bed_ret_1;
+    }
+    retval = 0;
+  }
+#endif
   while (fgets(loadbuf, loadbuf_size, infile)) {
     cptr = skip_initial_spaces(loadbuf);
     if (is_eoln_kns(*cptr)) {
@@ -6791,6 +8695,9 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
   if (!feof(infile)) {
     goto transposed_to_bed_ret_READ_FAIL;
   }
+#ifndef _WIN32
+ transposed_to_bed_pipeline_done:
+#endif
   fclose_null(&infile);
   if (fclose_null(&bimfile)) {
     goto transposed_to_bed_ret_WRITE_FAIL;
@@ -8740,13 +10647,13 @@ uint32_t recode_load_to(unsigned char* loadbuf, FILE* bedfile, uintptr_t bed_off
   uintptr_t marker_uidx_start;
   uintptr_t marker_uidx_stop;
   uintptr_t ulii;
-  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
     return 1;
   }
   while (marker_idx < marker_idx_end) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	return 1;
       }
     }
@@ -8759,7 +10666,7 @@ uint32_t recode_load_to(unsigned char* loadbuf, FILE* bedfile, uintptr_t bed_off
     marker_uidx_stop = marker_uidx + ulii;
     marker_idx += ulii;
     ulii *= unfiltered_indiv_ct4;
-    if (fread(loadbuf, 1, ulii, bedfile) < ulii) {
+    if (bed_fread(loadbuf, ulii, bedfile) < ulii) {
       return 1;
     }
     while (1) {
@@ -8776,6 +10683,94 @@ uint32_t recode_load_to(unsigned char* loadbuf, FILE* bedfile, uintptr_t bed_off
   return 0;
 }
 
+uintptr_t recode_slab_indiv_ct(uintptr_t unfiltered_indiv_ct, uintptr_t marker_ct) {
+  // Number of individuals to load at a time for individual-major --recode
+  // output.  This is unfiltered_indiv_ct when the whole dataset fits;
+  // otherwise it's a multiple of 64 (so that each slab row stays 16-byte
+  // aligned for the haploid fixers), with room reserved for one full .bed
+  // row.  Returns 0 if even 64 individuals don't fit.
+  uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+  uintptr_t row_size = CACHEALIGN(unfiltered_indiv_ct4);
+  if (wkspace_left >= ((uint64_t)unfiltered_indiv_ct4) * marker_ct) {
+    return unfiltered_indiv_ct;
+  }
+  if (wkspace_left <= row_size) {
+    return 0;
+  }
+  return ((wkspace_left - row_size) / (16 * marker_ct)) * 64;
+}
+
+uint32_t recode_load_slab(unsigned char* loadbuf, unsigned char* rowbuf, uintptr_t slab_indiv_ct, uintptr_t indiv_uidx, uintptr_t* slab_start_ptr, uintptr_t* slab_end_ptr, FILE* bedfile, uintptr_t bed_offset, uintptr_t marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, uintptr_t unfiltered_indiv_ct, uint32_t set_hh_missing, Chrom_info* chrom_info_ptr, uint32_t hh_exists, uintptr_t* indiv_include2, uintptr_t* indiv_male_include2) {
+  // Multipass version of recode_load_to(): loads the slab_indiv_ct-individual
+  // slab containing indiv_uidx for every included marker, streaming through
+  // the whole .bed file once.  Rows are slab_indiv_ct / 4 bytes apart.
+  uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+  uintptr_t slab_stride = slab_indiv_ct / 4;
+  uintptr_t slab_start = indiv_uidx - (indiv_uidx % slab_indiv_ct);
+  uintptr_t slab_end = slab_start + slab_indiv_ct;
+  unsigned char* loadbuf_iter = loadbuf;
+  uintptr_t marker_uidx = 0;
+  uintptr_t slab_ct4;
+  uintptr_t marker_idx;
+  if (slab_end > unfiltered_indiv_ct) {
+    slab_end = unfiltered_indiv_ct;
+  }
+  *slab_start_ptr = slab_start;
+  *slab_end_ptr = slab_end;
+  slab_indiv_ct = slab_end - slab_start;
+  slab_ct4 = (slab_indiv_ct + 3) / 4;
+  if (bed_seek(bedfile, bed_offset)) {
+    return 1;
+  }
+  for (marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
+    if (IS_SET(marker_exclude, marker_uidx)) {
+      marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
+	return 1;
+      }
+    }
+    if (bed_fread(rowbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+      return 1;
+    }
+    memcpy(loadbuf_iter, &(rowbuf[slab_start / 4]), slab_ct4);
+    if (IS_SET(marker_reverse, marker_uidx)) {
+      reverse_loadbuf(loadbuf_iter, slab_indiv_ct);
+    }
+    loadbuf_iter = &(loadbuf_iter[slab_stride]);
+  }
+  if (set_hh_missing) {
+    haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, indiv_include2? (&(indiv_include2[slab_start / BITCT2])) : NULL, indiv_male_include2? (&(indiv_male_include2[slab_start / BITCT2])) : NULL, slab_indiv_ct, slab_stride, loadbuf);
+  }
+  return 0;
+}
+
+uint32_t recode_load_init(unsigned char** loadbuf_ptr, unsigned char** rowbuf_ptr, uintptr_t* loadbuf_stride_ptr, uintptr_t* slab_end_ptr, uintptr_t slab_indiv_ct, FILE* bedfile, uintptr_t bed_offset, uintptr_t unfiltered_marker_ct, uintptr_t marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, uintptr_t unfiltered_indiv_ct, uint32_t set_hh_missing, Chrom_info* chrom_info_ptr, uint32_t hh_exists, uintptr_t* indiv_include2, uintptr_t* indiv_male_include2) {
+  // Shared setup for the individual-major --recode writers.  If the whole
+  // genotype matrix fits, it's loaded now and *slab_end_ptr covers everyone.
+  // Otherwise nothing is loaded yet: the front of the buffer becomes the .bed
+  // row buffer for recode_load_slab(), which the writer calls whenever it
+  // reaches an individual past *slab_end_ptr (initially 0).
+  uintptr_t unfiltered_indiv_ct4 = (unfiltered_indiv_ct + 3) / 4;
+  unsigned char* loadbuf = *loadbuf_ptr;
+  uintptr_t marker_uidx = 0;
+  if (slab_indiv_ct == unfiltered_indiv_ct) {
+    if (recode_load_to(loadbuf, bedfile, bed_offset, unfiltered_marker_ct, 0, marker_ct, marker_exclude, marker_reverse, &marker_uidx, unfiltered_indiv_ct)) {
+      return 1;
+    }
+    if (set_hh_missing) {
+      haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2, unfiltered_indiv_ct, unfiltered_indiv_ct4, loadbuf);
+    }
+    *loadbuf_stride_ptr = unfiltered_indiv_ct4;
+    *slab_end_ptr = unfiltered_indiv_ct;
+  } else {
+    *rowbuf_ptr = loadbuf;
+    *loadbuf_ptr = &(loadbuf[CACHEALIGN(unfiltered_indiv_ct4)]);
+    *loadbuf_stride_ptr = slab_indiv_ct / 4;
+    *slab_end_ptr = 0;
+  }
+  return 0;
+}
+
 static inline int32_t recode_write_first_cols(FILE* outfile, uintptr_t indiv_uidx, char delimiter, char* person_ids, uintptr_t max_person_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, char* output_missing_pheno) {
   char wbuf[16];
   char* cptr = &(person_ids[indiv_uidx * max_person_id_len]);
@@ -8884,7 +10879,7 @@ int32_t recode_beagle_new_chrom(char* outname, char* outname_end2, uintptr_t* ma
       refresh_chrom_info(chrom_info_ptr, marker_uidx, 0, 0, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_haploid);
       chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
     } while ((chrom_idx > 22) && (chrom_idx < 27));
-    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+    if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
       return RET_READ_FAIL;
     }
   }
@@ -8933,7 +10928,7 @@ int32_t open_and_write_fastphase_header(FILE** outfile_ptr, char* outname, uintp
   return 0;
 }
 
-uint32_t write_ped_lines(FILE* outfile, unsigned char* loadbuf, uintptr_t* marker_exclude, uintptr_t marker_uidx_start, uintptr_t marker_ct, uintptr_t unfiltered_indiv_ct4, uintptr_t* indiv_exclude, uintptr_t* indiv_uidx_ptr, uintptr_t indiv_idx_start, uintptr_t indiv_idx_end, uint32_t recode_compound, char* mk_alleles, uint32_t max_marker_allele_len, char delimiter, char delim2, char* person_ids, uintptr_t max_person_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, char output_missing_geno, char* output_missing_pheno, char* writebuf) {
+uint32_t write_ped_lines(FILE* outfile, unsigned char* loadbuf, uintptr_t* marker_exclude, uintptr_t marker_uidx_start, uintptr_t marker_ct, uintptr_t unfiltered_indiv_ct4, uintptr_t loadbuf_indiv_uidx_start, uintptr_t* indiv_exclude, uintptr_t* indiv_uidx_ptr, uintptr_t indiv_idx_start, uintptr_t indiv_idx_end, uint32_t recode_compound, char* mk_alleles, uint32_t max_marker_allele_len, char delimiter, char delim2, char* person_ids, uintptr_t max_person_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, char output_missing_geno, char* output_missing_pheno, char* writebuf) {
   uintptr_t indiv_uidx = *indiv_uidx_ptr;
   char missing4[4];
   unsigned char* bufptr;
@@ -8954,7 +10949,7 @@ uint32_t write_ped_lines(FILE* outfile, unsigned char* loadbuf, uintptr_t* marke
     if (recode_write_first_cols(outfile, indiv_uidx, delimiter, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno)) {
       return 1;
     }
-    bufptr = &(loadbuf[indiv_uidx / 4]);
+    bufptr = &(loadbuf[(indiv_uidx - loadbuf_indiv_uidx_start) / 4]);
     wbufptr = writebuf;
     shiftval = (indiv_uidx % 4) * 2;
     marker_uidx = marker_uidx_start;
@@ -9116,6 +11111,11 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
   uintptr_t indiv_uidx;
   uintptr_t indiv_idx;
   unsigned char* loadbuf;
+  unsigned char* rowbuf = NULL;
+  uintptr_t slab_indiv_ct;
+  uintptr_t slab_start = 0;
+  uintptr_t slab_end;
+  uintptr_t loadbuf_stride;
   uintptr_t* ulptr;
   uintptr_t* ulptr_end;
   char* writebuf;
@@ -9131,6 +11131,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
   uint32_t alen2;
   unsigned char ucc;
   unsigned char ucc2;
+  unsigned char ucc3;
   char cc;
   char cur_mk_alleles[8];
   char* cur_mk_allelesx_buf = NULL;
@@ -9554,7 +11555,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
     cur_mk_allelesx[2] = &(cur_mk_allelesx_buf[8]);
     cur_mk_allelesx[3] = &(cur_mk_allelesx_buf[12]);
   }
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto recode_ret_READ_FAIL;
   }
   marker_uidx = 0;
@@ -9605,7 +11606,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto recode_ret_READ_FAIL;
 	  }
 	}
@@ -9755,7 +11756,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
           marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto recode_ret_READ_FAIL;
 	  }
 	}
@@ -9866,14 +11867,13 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
 	ucc2 = ((chrom_idx == 24) || (chrom_idx == 26) || (ucc && (chrom_idx == 23) && (!xmhh_exists_orig)))? 1 : 0;
       }
 
-      if (fseeko(bedfile, bed_offset + (indiv_uidx / 4) + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + (indiv_uidx / 4) + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto recode_ret_READ_FAIL;
       }
-      ii = fgetc(bedfile);
-      if (ii == EOF) {
+      if (!bed_fread(&ucc3, 1, bedfile)) {
 	goto recode_ret_READ_FAIL;
       }
-      cur_word = (((uint32_t)ii) >> ((indiv_uidx % 4) * 2)) & 3;
+      cur_word = (((uint32_t)ucc3) >> ((indiv_uidx % 4) * 2)) & 3;
       if (is_haploid && set_hh_missing) {
 	haploid_fix(hh_exists, indiv_include2, indiv_male_include2, 1, is_x, is_y, (unsigned char*)(&cur_word));
       }
@@ -9925,7 +11925,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-          if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+          if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto recode_ret_READ_FAIL;
 	  }
 	}
@@ -10030,7 +12030,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
         goto recode_ret_INVALID_CMDLINE;
       }
       marker_uidx = ((uint32_t)ii);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto recode_ret_READ_FAIL;
       }
     }
@@ -10132,7 +12132,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-          if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+          if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
             goto recode_ret_READ_FAIL;
 	  }
         }
@@ -10306,7 +12306,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto recode_ret_READ_FAIL;
 	  }
 	}
@@ -10444,8 +12444,12 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
     indiv_delim_convert(unfiltered_indiv_ct, indiv_exclude, indiv_ct, person_ids, max_person_id_len, ' ', '\t');
   } else if (recode_modifier & (RECODE_A | RECODE_AD)) {
     memcpy(outname_end, ".raw", 5);
-    if (wkspace_left < ((uint64_t)unfiltered_indiv_ct4) * marker_ct) {
-      goto recode_ret_NO_MULTIPASS_YET;
+    slab_indiv_ct = recode_slab_indiv_ct(unfiltered_indiv_ct, marker_ct);
+    if (!slab_indiv_ct) {
+      goto recode_ret_NOMEM;
+    } else if (slab_indiv_ct < unfiltered_indiv_ct) {
+      sprintf(logbuf, "Genotype matrix too large for workspace; recoding in %" PRIuPTR " passes.\n", (unfiltered_indiv_ct + slab_indiv_ct - 1) / slab_indiv_ct);
+      logprintb();
     }
     if (fopen_checked(&outfile, outname, "w")) {
       goto recode_ret_OPEN_FAIL;
@@ -10497,12 +12501,9 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
     marker_uidx = 0;
     sprintf(logbuf, "--recode A%s to %s... ", (recode_modifier & RECODE_AD)? "D" : "", outname);
     logprintb();
-    if (recode_load_to(loadbuf, bedfile, bed_offset, unfiltered_marker_ct, 0, marker_ct, marker_exclude, marker_reverse, &marker_uidx, unfiltered_indiv_ct)) {
+    if (recode_load_init(&loadbuf, &rowbuf, &loadbuf_stride, &slab_end, slab_indiv_ct, bedfile, bed_offset, unfiltered_marker_ct, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
       goto recode_ret_READ_FAIL;
     }
-    if (set_hh_missing) {
-      haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2, unfiltered_indiv_ct, unfiltered_indiv_ct4, loadbuf);
-    }
     fputs("0%", stdout);
     indiv_uidx = 0;
     indiv_idx = 0;
@@ -10513,7 +12514,12 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
 	if (recode_write_first_cols(outfile, indiv_uidx, delimiter, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno)) {
 	  goto recode_ret_WRITE_FAIL;
 	}
-	bufptr = &(loadbuf[indiv_uidx / 4]);
+	if (indiv_uidx >= slab_end) {
+	  if (recode_load_slab(loadbuf, rowbuf, slab_indiv_ct, indiv_uidx, &slab_start, &slab_end, bedfile, bed_offset, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
+	    goto recode_ret_READ_FAIL;
+	  }
+	}
+	bufptr = &(loadbuf[(indiv_uidx - slab_start) / 4]);
 	wbufptr = writebuf;
 	shiftval = (indiv_uidx % 4) * 2;
 	marker_uidx = 0;
@@ -10534,7 +12540,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
 		*wbufptr++ = 'A';
 	      }
 	      *wbufptr++ = delimiter;
-	      bufptr = &(bufptr[unfiltered_indiv_ct4]);
+	      bufptr = &(bufptr[loadbuf_stride]);
 	    } while (++marker_uidx < ulii);
 	  } while (marker_idx < marker_ct);
 	} else {
@@ -10549,7 +12555,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
 	      } else {
 		wbufptr = memcpya(wbufptr, &(writebuf2[16]), 6);
 	      }
-	      bufptr = &(bufptr[unfiltered_indiv_ct4]);
+	      bufptr = &(bufptr[loadbuf_stride]);
 	    } while (++marker_uidx < ulii);
 	  } while (marker_idx < marker_ct);
 	}
@@ -10593,7 +12599,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	    goto recode_ret_READ_FAIL;
 	  }
 	}
@@ -10809,7 +12815,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       } else if (max_marker_allele_len == 1) {
 	writebuf[ulii * 4 - 1] = '\n';
       }
-      if (write_ped_lines(outfile, loadbuf, marker_exclude, marker_uidx_start, ulii, unfiltered_indiv_ct4, indiv_exclude, &indiv_uidx, 0, indiv_ct, recode_compound, mk_alleles, max_marker_allele_len, delimiter, delim2, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_geno, output_missing_pheno, writebuf)) {
+      if (write_ped_lines(outfile, loadbuf, marker_exclude, marker_uidx_start, ulii, unfiltered_indiv_ct4, 0, indiv_exclude, &indiv_uidx, 0, indiv_ct, recode_compound, mk_alleles, max_marker_allele_len, delimiter, delim2, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_geno, output_missing_pheno, writebuf)) {
 	goto recode_ret_WRITE_FAIL;
       }
       if (recode_compound) {
@@ -10845,8 +12851,12 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
     }
   } else if (recode_modifier & RECODE_STRUCTURE) {
     memcpy(outname_end, ".recode.strct_in", 17);
-    if (wkspace_left < ((uint64_t)unfiltered_indiv_ct4) * marker_ct) {
-      goto recode_ret_NO_MULTIPASS_YET;
+    slab_indiv_ct = recode_slab_indiv_ct(unfiltered_indiv_ct, marker_ct);
+    if (!slab_indiv_ct) {
+      goto recode_ret_NOMEM;
+    } else if (slab_indiv_ct < unfiltered_indiv_ct) {
+      sprintf(logbuf, "Genotype matrix too large for workspace; recoding in %" PRIuPTR " passes.\n", (unfiltered_indiv_ct + slab_indiv_ct - 1) / slab_indiv_ct);
+      logprintb();
     }
     if (fopen_checked(&outfile, outname, "w")) {
       goto recode_ret_OPEN_FAIL;
@@ -10881,12 +12891,9 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       goto recode_ret_WRITE_FAIL;
     }
     marker_uidx = 0;
-    if (recode_load_to(loadbuf, bedfile, bed_offset, unfiltered_marker_ct, 0, marker_ct, marker_exclude, marker_reverse, &marker_uidx, unfiltered_indiv_ct)) {
+    if (recode_load_init(&loadbuf, &rowbuf, &loadbuf_stride, &slab_end, slab_indiv_ct, bedfile, bed_offset, unfiltered_marker_ct, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
       goto recode_ret_READ_FAIL;
     }
-    if (set_hh_missing) {
-      haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2, unfiltered_indiv_ct, unfiltered_indiv_ct4, loadbuf);
-    }
     indiv_uidx = 0;
     indiv_idx = 0;
     fputs("0%", stdout);
@@ -10896,9 +12903,14 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
       loop_end = (((uint64_t)pct) * indiv_ct) / 100;
       for (; indiv_idx < loop_end; indiv_uidx++, indiv_idx++) {
 	next_unset_ul_unsafe_ck(indiv_exclude, &indiv_uidx);
-	bufptr = &(loadbuf[indiv_uidx / 4]);
+	if (indiv_uidx >= slab_end) {
+	  if (recode_load_slab(loadbuf, rowbuf, slab_indiv_ct, indiv_uidx, &slab_start, &slab_end, bedfile, bed_offset, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
+	    goto recode_ret_READ_FAIL;
+	  }
+	}
+	bufptr = &(loadbuf[(indiv_uidx - slab_start) / 4]);
 	shiftval = (indiv_uidx % 4) * 2;
-        cptr = &(person_ids[indiv_uidx * max_person_id_len]);
+	cptr = &(person_ids[indiv_uidx * max_person_id_len]);
         aptr = (char*)memchr(cptr, '\t', max_person_id_len);
         fputs(&(aptr[1]), outfile);
 	memcpy(tbuf, cptr, aptr - cptr);
@@ -10917,8 +12929,8 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
         for (marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
 	  next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
           ucc = ((*bufptr) >> shiftval) & 3;
-          wbufptr = memcpya(wbufptr, &(writebuf2[4 * ucc]), 4);
-	  bufptr = &(bufptr[unfiltered_indiv_ct4]);
+	  wbufptr = memcpya(wbufptr, &(writebuf2[4 * ucc]), 4);
+	  bufptr = &(bufptr[loadbuf_stride]);
 	}
 	fwrite(writebuf, 1, wbufptr - writebuf, outfile);
 	if (putc_checked('\n', outfile)) {
@@ -10935,29 +12947,43 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, FI
     }
   } else {
     memcpy(outname_end, ".ped", 5);
-    if (wkspace_left < ((uint64_t)unfiltered_indiv_ct4) * marker_ct) {
-      goto recode_ret_NO_MULTIPASS_YET;
+    slab_indiv_ct = recode_slab_indiv_ct(unfiltered_indiv_ct, marker_ct);
+    if (!slab_indiv_ct) {
+      goto recode_ret_NOMEM;
+    } else if (slab_indiv_ct < unfiltered_indiv_ct) {
+      sprintf(logbuf, "Genotype matrix too large for workspace; recoding in %" PRIuPTR " passes.\n", (unfiltered_indiv_ct + slab_indiv_ct - 1) / slab_indiv_ct);
+      logprintb();
     }
     if (fopen_checked(&outfile, outname, "w")) {
       goto recode_ret_OPEN_FAIL;
     }
     sprintf(logbuf, "--recode to %s + .map... ", outname);
     logprintb();
-    if (recode_load_to(loadbuf, bedfile, bed_offset, unfiltered_marker_ct, 0, marker_ct, marker_exclude, marker_reverse, &marker_uidx, unfiltered_indiv_ct)) {
+    if (recode_load_init(&loadbuf, &rowbuf, &loadbuf_stride, &slab_end, slab_indiv_ct, bedfile, bed_offset, unfiltered_marker_ct, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
       goto recode_ret_READ_FAIL;
     }
-    if (set_hh_missing) {
-      haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2, unfiltered_indiv_ct, unfiltered_indiv_ct4, loadbuf);
-    }
     indiv_uidx = 0;
     indiv_idx = 0;
     fputs("0%", stdout);
     for (pct = 1; pct <= 100; pct++) {
       loop_end = (((uint64_t)pct) * indiv_ct) / 100;
-      if (write_ped_lines(outfile, loadbuf, marker_exclude, 0, marker_ct, unfiltered_indiv_ct4, indiv_exclude, &indiv_uidx, indiv_idx, loop_end, recode_compound, mk_alleles, max_marker_allele_len, delimiter, delim2, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_geno, output_missing_pheno, writebuf)) {
-	goto recode_ret_WRITE_FAIL;
+      while (indiv_idx < loop_end) {
+	indiv_uidx = next_unset_ul_unsafe(indiv_exclude, indiv_uidx);
+	if (indiv_uidx >= slab_end) {
+	  if (recode_load_slab(loadbuf, rowbuf, slab_indiv_ct, indiv_uidx, &slab_start, &slab_end, bedfile, bed_offset, marker_ct, marker_exclude, marker_reverse, unfiltered_indiv_ct, set_hh_missing, chrom_info_ptr, hh_exists, indiv_include2, indiv_male_include2)) {
+	    goto recode_ret_READ_FAIL;
+	  }
+	}
+	// don't run past the end of the current slab
+	ulii = indiv_idx + (slab_end - indiv_uidx) - popcount_bit_idx(indiv_exclude, indiv_uidx, slab_end);
+	if (ulii > loop_end) {
+	  ulii = loop_end;
+	}
+	if (write_ped_lines(outfile, loadbuf, marker_exclude, 0, marker_ct, loadbuf_stride, slab_start, indiv_exclude, &indiv_uidx, indiv_idx, ulii, recode_compound, mk_alleles, max_marker_allele_len, delimiter, delim2, person_ids, max_person_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_geno, output_missing_pheno, writebuf)) {
+	  goto recode_ret_WRITE_FAIL;
+	}
+	indiv_idx = ulii;
       }
-      indiv_idx = loop_end;
       if (pct < 100) {
 	if (pct > 10) {
 	  putchar('\b');
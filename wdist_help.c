@@ -323,10 +323,12 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "  --gfile [prefix] : Specify .gvar + .fam + .map (genetic variant) prefix.\n\n"
 	       );
 #endif
-    help_print("grm\tgrm-bin\trel-cutoff\tgrm-cutoff", &help_ctrl, 1,
+    help_print("grm\tgrm-bin\tgrm-sparse\trel-cutoff\tgrm-cutoff", &help_ctrl, 1,
 "  --grm {prefix}   : Specify .grm.gz + .grm.id (GCTA rel. matrix) prefix.\n"
 "  --grm-bin {prfx} : Specify .grm.bin + .grm.N.bin + .grm.id (GCTA triangular\n"
-"                     binary relationship matrix) filename prefix.\n\n"
+"                     binary relationship matrix) filename prefix.\n"
+"  --grm-sparse {p} : Specify .grm.sparse.bin + .grm.id (--make-grm-sparse\n"
+"                     output) filename prefix.\n\n"
 	       );
     help_print("dummy", &help_ctrl, 1,
 "  --dummy [indiv ct] [marker ct] {missing geno freq} {missing pheno freq}\n"
@@ -514,8 +516,11 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "    support output formats better suited to parallel computation.\n\n"
 		);
     help_print("genome\tZ-genome\trel-check\timpossible\tnudge\tgenome-full\tunbounded", &help_ctrl, 1,
-"  --genome <gz> <rel-check> <full> <unbounded> <nudge>\n"
+"  --genome <gz | bin> <rel-check> <full> <unbounded> <nudge>\n"
 "    Generates an identity-by-descent report.\n"
+"    * 'bin' writes a compact fixed-width binary report (.genome.bin) holding\n"
+"      Z0/Z1/Z2, PI_HAT, DST, and PPC for each pair, which --read-genome loads\n"
+"      much faster than text.\n"
 "    * The 'rel-check' modifier excludes pairs of individuals with different\n"
 "      FIDs from the final report.\n"
 "    * 'full' adds raw pairwise comparison data to the report.\n"
@@ -708,10 +713,32 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "    Generates a list of markers in approximate linkage equilibrium.  With the\n"
 "    'kb' modifier, the window size is in kilobase units instead of marker\n"
 "    count.  (Pre-'kb' space is optional, i.e. '--indep-pairwise 500 kb 5 0.5'\n"
-"    and '--indep-pairwise 500kb 5 0.5' have the same effect.)\n"
+"    and '--indep-pairwise 500kb 5 0.5' have the same effect.)  With --threads,\n"
+"    --indep-pairwise prunes several chromosomes at once, and both flags compute\n"
+"    large windows' correlations in parallel; results do not depend on the\n"
+"    thread count.\n"
 "    Note that you need to rerun " PROG_NAME_CAPS " using --extract or --exclude on the\n"
 "    .prune.in/.prune.out file to apply the list to another computation.\n\n"
 		);
+    help_print("r2\tld-window\tld-window-kb\tld-window-r2\tld-snp\tld-snp-list", &help_ctrl, 1,
+"  --r2 <dprime> <bin>\n"
+"    Reports pairwise linkage disequilibrium within a window (see --ld-window,\n"
+"    --ld-window-kb) to {output prefix}.ld.  r^2 is the squared Pearson\n"
+"    correlation of the genotypes over the individuals called at both markers,\n"
+"    so no phasing is needed.  (--indep-pairwise instead divides by each\n"
+"    marker's variance over all its calls, so the two can differ slightly when\n"
+"    genotypes are missing.)  'dprime' adds a composite (genotype-based) |D'|\n"
+"    column.  Only pairs with r^2 at or above the --ld-window-r2 threshold are\n"
+"    written.  With --ld-snp[-list], only pairs involving the target marker(s)\n"
+"    are reported, in both directions.  With --threads, each block of windows\n"
+"    is split between threads.\n"
+"    * 'bin' instead writes every in-window value, unfiltered, as a fixed-width\n"
+"      band of 32-bit floats to {output prefix}.ld.bin: an 8-byte magic number,\n"
+"      a 32-byte header (version, flags, row count, column count, marker count,\n"
+"      window size, window bp, reserved), and then one row per marker (or\n"
+"      target), each starting with its marker index and first column's marker\n"
+"      index.  Cells outside a row's window are NaN.\n\n"
+		);
     help_print("make-rel", &help_ctrl, 1,
 "  --make-rel <square | square0 | triangle> <gz | bin> <cov | ibc2 | ibc3>\n"
 "             <single-prec>\n"
@@ -740,6 +767,19 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "    individual has a missing call) for each pair, which is useful input for\n"
 "    some scripts.\n\n"
 	       );
+    help_print("make-grm-sparse\tgrm-sparse\tmake-grm-bin\trel-cutoff", &help_ctrl, 1,
+"  --make-grm-sparse {threshold} <ibc2 | ibc3> <single-prec>\n"
+"    Writes only the relationships greater than the threshold (default 0.025),\n"
+"    plus the diagonal, to {output prefix}.grm.sparse.bin.  Each row is stored\n"
+"    as (column, single-precision value) pairs in increasing column order,\n"
+"    ending with its diagonal element, and {output prefix}.grm.sparse.idx holds\n"
+"    the 64-bit index of each row's first pair, followed by the total pair\n"
+"    count.  For unrelated samples this is a small fraction of the size of a\n"
+"    --make-grm-bin matrix.\n"
+"    * --grm-sparse + --rel-cutoff prunes from this file directly; the cutoff\n"
+"      cannot be smaller than the stored threshold.  Add --make-grm-sparse to\n"
+"      also write the pruned matrix.\n\n"
+	       );
     help_print("rel-cutoff\tgrm-cutoff", &help_ctrl, 1,
 "  --rel-cutoff {val}\n"
 "    (alias: --grm-cutoff)\n"
@@ -1177,7 +1217,8 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 	       );
     help_print("read-genome\tcluster\tneighbour\tneighbor", &help_ctrl, 0,
 "  --read-genome [f] : Load a --genome report for --cluster/--neighbour, instead\n"
-"                      of recalculating from scratch.\n"
+"                      of recalculating from scratch.  Text and '--genome bin'\n"
+"                      reports are both accepted.\n"
 	       );
     help_print("ppc\tmc\tmcc\tK\tk\tibm\tcluster", &help_ctrl, 0,
 "  --ppc [p-val]    : Specify minimum PPC-test p-value within a cluster.\n"
@@ -1252,8 +1293,18 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "  --mperm-save     : Save best max(T) permutation test statistics.\n"
 "  --mperm-save-all : Save all max(T) permutation test statistics.\n"
 	       );
-    help_print("indep\tindep-pairwise\tld-xchr", &help_ctrl, 0,
-"  --ld-xchr [code] : Specifies how --indep[-pairwise] handles the X chromosome.\n"
+    help_print("r2\tld-window\tld-window-kb\tld-window-r2", &help_ctrl, 0,
+"  --ld-window [ct]      : Set --r2 window size in markers (default 10).\n"
+"  --ld-window-kb [kbs]  : Set --r2 window size in kilobases (default 1000).\n"
+"  --ld-window-r2 [val]  : Set --r2 text report r^2 threshold (default 0.2).\n"
+	       );
+    help_print("r2\tld-snp\tld-snp-list", &help_ctrl, 0,
+"  --ld-snp [marker ID]  : Restrict --r2 to pairs involving the given marker.\n"
+"  --ld-snp-list [file]  : Restrict --r2 to pairs involving the listed markers.\n"
+	       );
+    help_print("indep\tindep-pairwise\tr2\tld-xchr", &help_ctrl, 0,
+"  --ld-xchr [code] : Specifies how --indep[-pairwise] and --r2 handle the X\n"
+"                     chromosome.\n"
 "                     1 (default) = males coded 0/1, females 0/1/2 (A1 dosage)\n"
 "                     2 = males coded 0/2\n"
 "                     3 = males coded 0/2, but females given double weighting\n"
@@ -1269,12 +1320,90 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "                       square matrix.  Choose the square0 or triangle format\n"
 "                       instead, and postprocess as necessary.\n"
 	       );
+    help_print("parallel-merge\tparallel\tmake-rel\tmake-grm-gz\tmake-grm-bin\tdistance\tgenome", &help_ctrl, 0,
+"  --parallel-merge [n] : Merge the n pieces written by --parallel into the final\n"
+"                         output file, after checking that each piece has the\n"
+"                         rows it should (and, for --genome bin, the same ID\n"
+"                         list).  Use the same --out prefix and the same\n"
+"                         --make-rel/--make-grm-gz/--make-grm-bin/--distance/\n"
+"                         --genome modifiers that created the pieces, without\n"
+"                         an input fileset.  The pieces are left in place.\n"
+	       );
+    help_print("matrix-passes\tparallel\tmemory\tmake-rel\tmake-grm-gz\tmake-grm-bin\tdistance", &help_ctrl, 0,
+"  --matrix-passes [n] : Compute the --make-rel/--make-grm/--distance matrix in\n"
+"                        n pieces, one .bed pass each, appending each piece to\n"
+"                        the output file as it finishes.  By default this\n"
+"                        happens automatically when the triangle does not fit\n"
+"                        in the --memory workspace.  Not compatible with\n"
+"                        square output shapes, --parallel, --dist-stats, or\n"
+"                        computations that reuse the matrix (--rel-cutoff,\n"
+"                        --cluster, --ibs-test, etc.).\n"
+	       );
+    help_print("dist-stats\tdist-stats-update\tdistance", &help_ctrl, 0,
+"  --dist-stats : Save the per-pair sufficient statistics behind --distance\n"
+"                 (allele-count distance and shared nonmissing marker count) to\n"
+"                 {output prefix}.dstat.bin, with the individual and marker\n"
+"                 lists in .dstat.id and .dstat.markers.\n"
+"  --dist-stats-update [prefix] : Extend a saved --dist-stats set with the\n"
+"                                 individuals added after the saved ones.  The\n"
+"                                 marker list must be unchanged.  Only the new\n"
+"                                 rows of the triangle are computed; they are\n"
+"                                 appended to [prefix].dstat.bin/.dstat.id and\n"
+"                                 written as the --distance output, ready to be\n"
+"                                 appended to the previous triangle.  Requires\n"
+"                                 '--distance flat-missing' and a triangular\n"
+"                                 shape.  (--exponent must be 0 for both flags.)\n"
+	       );
+    help_print("checkpoint\tresume\tmake-rel\tmake-grm-gz\tmake-grm-bin\tdistance\tgenome", &help_ctrl, 0,
+"  --checkpoint {min} : Save the partial --make-rel/--make-grm/--distance/\n"
+"                       --genome accumulators to {output name}.ckpt every min\n"
+"                       minutes (default 30).  The file is deleted once the\n"
+"                       output has been written.\n"
+"  --resume           : Continue from a checkpoint left by an interrupted run.\n"
+"                       The rest of the command line must be unchanged.\n"
+	       );
+    help_print("rel-engine\tmake-rel\tmake-grm-gz\tmake-grm-bin", &help_ctrl, 0,
+"  --rel-engine [mode] : Relationship matrix engine.  'bitwise' (default) uses\n"
+"                        the packed genotype lookup tables, 'gemm' uses blocked\n"
+"                        matrix multiplication.  There is no automatic choice,\n"
+"                        since 'bitwise' has been faster at every size measured\n"
+"                        so far.\n"
+	       );
     help_print("memory", &help_ctrl, 0,
 "  --memory [val]   : Set size, in MB, of initial malloc attempt.\n"
 	       );
+    help_print("memory-backing\tmemory", &help_ctrl, 0,
+"  --memory-backing <thp | hugetlb> <interleave> :\n"
+"    Back the main workspace with transparent ('thp') or explicit ('hugetlb')\n"
+"    huge pages, and/or interleave it across NUMA nodes (Linux only).  Explicit\n"
+"    huge pages must be reserved in advance (vm.nr_hugepages); if they aren't\n"
+"    available, transparent huge pages are used instead.  The log reports what\n"
+"    was actually obtained.\n"
+	       );
     help_print("threads\tthread-num\tnum_threads", &help_ctrl, 0,
 "  --threads [val]  : Set maximum number of concurrent threads.\n"
 	       );
+    help_print("bed-mmap", &help_ctrl, 0,
+"  --bed-mmap       : Memory-map the .bed file instead of reading it through\n"
+"                     buffered I/O.  This avoids a copy per marker, and lets\n"
+"                     repeated runs on the same fileset share the page cache.\n"
+	       );
+    help_print("bgzf", &help_ctrl, 0,
+"  --bgzf           : Write 'gz' outputs in the block-gzipped (BGZF) format used\n"
+"                     by bgzip/tabix.  Blocks are compressed independently, so\n"
+"                     this scales better with --threads, and the result can be\n"
+"                     indexed for random access.  Any gzip reader still works.\n"
+	       );
+    help_print("simd", &help_ctrl, 0,
+"  --simd [level]   : Cap the vector instruction set used by the IBS distance\n"
+"                     kernels (--distance, --cluster, --neighbour, --ibs-test,\n"
+"                     etc.), the LD kernels (--indep[-pairwise], --r2), and the\n"
+"                     allele/genotype counters behind allele frequencies,\n"
+"                     --freq, --hardy, --missing, and --assoc/--model.  Levels\n"
+"                     are 'sse2', 'avx2', 'avx512bw' (AVX-512 without\n"
+"                     VPOPCNTDQ), and 'avx512'.  By default, the widest set\n"
+"                     supported by the CPU is used.\n"
+	       );
     help_print("d\tsnps", &help_ctrl, 0,
 "  --d [char]       : Change marker range delimiter (would otherwise be '-').\n"
 	       );
@@ -848,7 +848,7 @@ int32_t populate_roh_slots_from_disk(FILE* bedfile, uint64_t bed_offset, uintptr
   uint32_t cidx_start;
   uint32_t write_shift;
   uint32_t indiv_uidx;
-  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
     return RET_READ_FAIL;
   }
   marker_uidx--;
@@ -856,11 +856,11 @@ int32_t populate_roh_slots_from_disk(FILE* bedfile, uint64_t bed_offset, uintptr
     marker_uidx++;
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
         return RET_READ_FAIL;
       }
     }
-    if (fread(rawbuf, 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+    if (bed_fread(rawbuf, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
       return RET_READ_FAIL;
     }
     marker_cidx = marker_uidx_to_cidx[marker_uidx - chrom_start];
@@ -1798,7 +1798,7 @@ int32_t roh_pool(Homozyg_info* hp, FILE* bedfile, uint64_t bed_offset, char* out
       }
 
       if (max_lookahead && (lookahead_end_uidx <= union_uidx2)) {
-	if (fseeko(bedfile, bed_offset + ((uint64_t)lookahead_end_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + ((uint64_t)lookahead_end_uidx) * unfiltered_indiv_ct4)) {
 	  goto roh_pool_ret_READ_FAIL;
 	}
 	ulii = cur_lookahead_start + cur_lookahead_size;
@@ -1808,14 +1808,14 @@ int32_t roh_pool(Homozyg_info* hp, FILE* bedfile, uint64_t bed_offset, char* out
 	do {
 	  if (IS_SET(marker_exclude, lookahead_end_uidx)) {
             lookahead_end_uidx = next_unset_unsafe(marker_exclude, lookahead_end_uidx);
-            if (fseeko(bedfile, bed_offset + ((uint64_t)lookahead_end_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+            if (bed_seek(bedfile, bed_offset + ((uint64_t)lookahead_end_uidx) * unfiltered_indiv_ct4)) {
 	      goto roh_pool_ret_READ_FAIL;
 	    }
 	  }
 
 	  // last few bytes of each lookahead_buf row may be filled with
 	  // garbage, but it doesn't matter
-	  if (fread(&(lookahead_buf[ulii * unfiltered_indiv_ctl2]), 1, unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
+	  if (bed_fread(&(lookahead_buf[ulii * unfiltered_indiv_ctl2]), unfiltered_indiv_ct4, bedfile) < unfiltered_indiv_ct4) {
 	    goto roh_pool_ret_READ_FAIL;
 	  }
 	  ulii++;
@@ -2641,7 +2641,7 @@ int32_t calc_homozyg(Homozyg_info* hp, FILE* bedfile, uintptr_t bed_offset, uint
     }
     collapse_copy_bitarr(indiv_ct, sex_male, indiv_exclude, popcount_longs_exclude(sex_male, indiv_exclude, indiv_ctl), indiv_male);
   }
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto calc_homozyg_ret_READ_FAIL;
   }
   fill_ulong_one(indiv_to_last_roh, indiv_ct);
@@ -2653,7 +2653,7 @@ int32_t calc_homozyg(Homozyg_info* hp, FILE* bedfile, uintptr_t bed_offset, uint
     if ((x_code == -1) || (uii != ((uint32_t)x_code))) {
       if (IS_SET(haploid_mask, uii)) {
 	marker_uidx = chrom_end;
-	if (fseeko(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4, SEEK_SET)) {
+	if (bed_seek(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4)) {
 	  goto calc_homozyg_ret_READ_FAIL;
 	}
 	continue;
@@ -2675,7 +2675,7 @@ int32_t calc_homozyg(Homozyg_info* hp, FILE* bedfile, uintptr_t bed_offset, uint
     for (widx = 0; widx < window_size; widx++) {
       if (IS_SET(marker_exclude, marker_uidx)) {
         marker_uidx = next_unset_ul(marker_exclude, marker_uidx, chrom_end);
-        if (fseeko(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4, SEEK_SET)) {
+        if (bed_seek(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4)) {
 	  goto calc_homozyg_ret_READ_FAIL;
 	}
       }
@@ -2736,7 +2736,7 @@ int32_t calc_homozyg(Homozyg_info* hp, FILE* bedfile, uintptr_t bed_offset, uint
 	}
 	if (IS_SET(marker_exclude, marker_uidx)) {
 	  marker_uidx = next_unset_ul(marker_exclude, marker_uidx, chrom_end);
-	  if (fseeko(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4, SEEK_SET)) {
+	  if (bed_seek(bedfile, bed_offset + (uint64_t)marker_uidx * unfiltered_indiv_ct4)) {
 	    goto calc_homozyg_ret_READ_FAIL;
 	  }
 	  if (marker_uidx == chrom_end) {
@@ -141,7 +141,7 @@ int32_t lasso(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* out
   }
 
   cur_mapping[1] = 0; // missing
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+  if (bed_seek(bedfile, bed_offset)) {
     goto lasso_ret_READ_FAIL;
   }
   dptr = data_arr;
@@ -151,7 +151,7 @@ int32_t lasso(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* out
   for (marker_uidx = 0, marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4, SEEK_SET)) {
+      if (bed_seek(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_indiv_ct4)) {
 	goto lasso_ret_READ_FAIL;
       }
     }
@@ -437,6 +437,48 @@ void col_major_matrix_multiply(__CLPK_integer row1_ct, __CLPK_integer col2_ct, _
 #endif // NOLAPACK
 }
 
+void col_major_matrix_multiply_transb(__CLPK_integer row1_ct, __CLPK_integer row2_ct, __CLPK_integer common_ct, double* inmatrix1, __CLPK_integer stride1, double* inmatrix2, __CLPK_integer stride2, double* outmatrix) {
+  // outmatrix := inmatrix1 * transpose(inmatrix2), where the inputs are
+  // row1_ct x common_ct and row2_ct x common_ct column-major submatrices with
+  // leading dimensions stride1 and stride2.  The output is row1_ct x row2_ct.
+#ifdef NOLAPACK
+  uintptr_t row1_ct_l = row1_ct;
+  uintptr_t row2_ct_l = row2_ct;
+  uintptr_t common_ct_l = common_ct;
+  uintptr_t row1_idx;
+  uintptr_t row2_idx;
+  uintptr_t com_idx;
+  double* dptr;
+  double* dptr2;
+  double dxx;
+  fill_double_zero(outmatrix, row1_ct_l * row2_ct_l);
+  // sequence of rank-1 updates, so the inner loop is contiguous
+  for (com_idx = 0; com_idx < common_ct_l; com_idx++) {
+    dptr = &(inmatrix1[com_idx * stride1]);
+    dptr2 = outmatrix;
+    for (row2_idx = 0; row2_idx < row2_ct_l; row2_idx++) {
+      dxx = inmatrix2[com_idx * stride2 + row2_idx];
+      if (dxx != 0.0) {
+	for (row1_idx = 0; row1_idx < row1_ct_l; row1_idx++) {
+	  dptr2[row1_idx] += dxx * dptr[row1_idx];
+	}
+      }
+      dptr2 = &(dptr2[row1_ct_l]);
+    }
+  }
+#else
+#ifdef _WIN32
+  char blas_char = 'N';
+  char blas_char2 = 'T';
+  double dyy = 1;
+  double dzz = 0;
+  dgemm_(&blas_char, &blas_char2, &row1_ct, &row2_ct, &common_ct, &dyy, inmatrix1, &stride1, inmatrix2, &stride2, &dzz, outmatrix, &row1_ct);
+#else
+  cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, row1_ct, row2_ct, common_ct, 1.0, inmatrix1, stride1, inmatrix2, stride2, 0.0, outmatrix, row1_ct);
+#endif // _WIN32
+#endif // NOLAPACK
+}
+
 void transpose_copy(uintptr_t old_maj, uintptr_t new_maj, double* old_matrix, double* new_matrix) {
   double* dptr;
   uintptr_t new_maj_idx;
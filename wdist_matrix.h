@@ -98,6 +98,8 @@ int32_t invert_matrix_trunc_singular(__CLPK_integer dim, double* matrix, MATRIX_
 
 void col_major_matrix_multiply(__CLPK_integer row1_ct, __CLPK_integer col2_ct, __CLPK_integer common_ct, double* inmatrix1, double* inmatrix2, double* outmatrix);
 
+void col_major_matrix_multiply_transb(__CLPK_integer row1_ct, __CLPK_integer row2_ct, __CLPK_integer common_ct, double* inmatrix1, __CLPK_integer stride1, double* inmatrix2, __CLPK_integer stride2, double* outmatrix);
+
 void transpose_copy(uintptr_t old_maj, uintptr_t new_maj, double* old_matrix, double* new_matrix);
 
 #endif // __WDIST_MATRIX_H__